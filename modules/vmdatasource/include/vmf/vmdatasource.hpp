@@ -16,11 +16,81 @@ limitations under the License.*/
 #define __VMF_DATASOURCE_HPP__
 
 #include <config.hpp>
+#include "vmf/metadatastream.hpp"
+#include <string>
+#include <vector>
 
 namespace vmf {
 
+/*!
+* \brief Kinds of metadata storage used by streams
+*/
+enum StorageKind
+{
+    StorageEmbedded, /**< XMP packet embedded into the media file */
+    StorageSidecar, /**< append-only log in a sidecar file next to the media file */
+    StorageEmbeddedAndSidecar, /**< sidecar log while the file is opened, embedded into the media file on close */
+    StorageMemory /**< process memory instead of media files, for tests and benchmarks */
+};
+
 void VMF_EXPORT initialize();
 
+/*!
+* \brief Initialize Video Metadata Framework with the selected kind of metadata storage
+* \param kind [in] kind of storage used by metadata streams
+*/
+void VMF_EXPORT initialize(StorageKind kind);
+
+/*!
+* \brief Get path of the sidecar file that keeps metadata of the media file
+* \param mediaFilePath [in] path to the media file
+*/
+std::string VMF_EXPORT getSidecarPath(const std::string& mediaFilePath);
+
+/*!
+* \brief Embed metadata stored in the sidecar file into the media file
+* \param mediaFilePath [in] path to the media file
+* \throw DataStorageException if metadata can't be read or written
+*/
+void VMF_EXPORT embedSidecar(const std::string& mediaFilePath);
+
+/*!
+* \brief Get names of all calls made to the memory storage since it was reset
+* \details Names are the names of data source methods, overloaded methods are
+* reported as "save(schema)", "save(id)" and "load(schemas)".
+*/
+std::vector<std::string> VMF_EXPORT getMemoryStorageCalls();
+
+/*!
+* \brief Drop all files, recorded calls, injected faults and latency of the memory storage
+*/
+void VMF_EXPORT resetMemoryStorage();
+
+/*!
+* \brief Set delay applied to every call to the memory storage
+* \param microseconds [in] delay of a call
+*/
+void VMF_EXPORT setMemoryStorageLatency(unsigned int microseconds);
+
+/*!
+* \brief Make a call to the memory storage fail with DataStorageException
+* \param call [in] name of the call as returned by getMemoryStorageCalls()
+* \param skipCalls [in] number of matching calls that succeed before the failure
+*/
+void VMF_EXPORT injectMemoryStorageFault(const std::string& call, unsigned int skipCalls = 0);
+
+/*!
+* \brief Compute digest of a file without opening it by VMF stream
+* \param filePath [in] path to the file
+* \param algorithm [in] checksum algorithm
+* \param excludeOffset [in] offset of a region skipped by hashing
+* \param excludeSize [in] size of the skipped region, zero if the whole file is hashed
+* \param threads [in] number of threads reading and hashing the file, zero selects number of cores
+* \throw DataStorageException if the file can't be read
+*/
+std::string VMF_EXPORT computeFileChecksum(const std::string& filePath, MetadataStream::ChecksumAlgorithm algorithm,
+                                           long long excludeOffset = 0, long long excludeSize = 0, unsigned int threads = 0);
+
 void VMF_EXPORT terminate();
 
 } // namespace vmf
@@ -0,0 +1,450 @@
+/*
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "checksumengine.hpp"
+
+#include "MD5.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <fstream>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace vmf
+{
+
+namespace
+{
+
+const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+const size_t MD5_BUFFER_SIZE = (size_t) ChecksumEngine::CHUNK_SIZE;
+
+inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+// digests don't depend on byte order of the platform
+inline uint64_t readLE64(const unsigned char* p)
+{
+    return (uint64_t) p[0] | ((uint64_t) p[1] << 8) | ((uint64_t) p[2] << 16) | ((uint64_t) p[3] << 24) |
+        ((uint64_t) p[4] << 32) | ((uint64_t) p[5] << 40) | ((uint64_t) p[6] << 48) | ((uint64_t) p[7] << 56);
+}
+
+inline uint32_t readLE32(const unsigned char* p)
+{
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+inline void writeLE64(unsigned char* p, uint64_t value)
+{
+    for (int i = 0; i < 8; i++)
+        p[i] = (unsigned char) (value >> (8 * i));
+}
+
+inline uint64_t round64(uint64_t acc, uint64_t input)
+{
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+inline uint64_t mergeRound64(uint64_t acc, uint64_t value)
+{
+    acc ^= round64(0, value);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+string toHex(const unsigned char* data, size_t size)
+{
+    static const char hexDigits[] = "0123456789ABCDEF";
+    string result(size * 2, '0');
+    for (size_t i = 0; i < size; i++)
+    {
+        result[2 * i] = hexDigits[data[i] >> 4];
+        result[2 * i + 1] = hexDigits[data[i] & 0xF];
+    }
+    return result;
+}
+
+unsigned int resolveThreads(unsigned int threads, size_t tasks)
+{
+    if (threads == 0)
+        threads = max(1u, thread::hardware_concurrency());
+    return (unsigned int) max<size_t>(1, min<size_t>(threads, tasks));
+}
+
+}
+
+const long long ChecksumEngine::CHUNK_SIZE;
+const char* ChecksumEngine::TREE_HASH_PREFIX = "xxh64tree:";
+
+ChecksumEngine::ChecksumEngine(const string& filePath, long long offset, long long size)
+  : path(filePath), fileSize(0), excludeOffset(0), excludeSize(0)
+{
+    ifstream file(path, ios::binary | ios::ate);
+    if (!file.is_open())
+        VMF_EXCEPTION(DataStorageException, "Can't open file " + path + " to compute checksum");
+    fileSize = (long long) file.tellg();
+
+    if (size > 0 && offset >= 0 && offset < fileSize)
+    {
+        excludeOffset = offset;
+        excludeSize = min(size, fileSize - offset);
+    }
+}
+
+long long ChecksumEngine::getMediaSize() const
+{
+    return fileSize - excludeSize;
+}
+
+size_t ChecksumEngine::getChunkCount() const
+{
+    return (size_t) ((getMediaSize() + CHUNK_SIZE - 1) / CHUNK_SIZE);
+}
+
+string ChecksumEngine::compute(MetadataStream::ChecksumAlgorithm algorithm, unsigned int threads, vector<uint64_t>* chunks) const
+{
+    switch (algorithm)
+    {
+    case MetadataStream::ChecksumMD5:
+        return computeMD5(threads, chunks);
+    case MetadataStream::ChecksumTreeHash:
+    {
+        vector<uint64_t> digests = computeChunks(0, getChunkCount(), threads);
+        if (chunks)
+            *chunks = digests;
+        return combineChunks(digests, getMediaSize());
+    }
+    default:
+        VMF_EXCEPTION(IncorrectParamException, "Unknown checksum algorithm");
+    }
+}
+
+size_t ChecksumEngine::readMedia(istream& file, long long offset, char* buffer, size_t size) const
+{
+    size_t done = 0;
+    while (done < size)
+    {
+        long long position = offset + (long long) done;
+        long long available;
+        if (excludeSize > 0 && position >= excludeOffset)
+        {
+            position += excludeSize;
+            available = fileSize - position;
+        }
+        else
+            available = (excludeSize > 0 ? excludeOffset : fileSize) - position;
+        if (available <= 0)
+            break;
+
+        size_t portion = (size_t) min<long long>(available, (long long) (size - done));
+        file.clear();
+        file.seekg(position);
+        file.read(buffer + done, portion);
+        size_t read = (size_t) file.gcount();
+        done += read;
+        if (read < portion)
+            break;
+    }
+    return done;
+}
+
+string ChecksumEngine::computeMD5(unsigned int threads, vector<uint64_t>* chunks) const
+{
+    ifstream file(path, ios::binary);
+    if (!file.is_open())
+        VMF_EXCEPTION(DataStorageException, "Can't open file " + path + " to compute checksum");
+
+    MD5_CTX context;
+    MD5Init(&context);
+
+    // buffers are of chunk size, so chunk digests are computed by the reading thread
+    if (chunks)
+        chunks->clear();
+    auto read = [this, &file, chunks](long long offset, char* buffer)
+    {
+        size_t size = readMedia(file, offset, buffer, MD5_BUFFER_SIZE);
+        if (chunks && size > 0)
+            chunks->push_back(xxhash64(buffer, size));
+        return size;
+    };
+
+    bool readAhead = resolveThreads(threads, 2) > 1;
+    vector<char> buffers[2] = { vector<char>(MD5_BUFFER_SIZE), vector<char>(MD5_BUFFER_SIZE) };
+    int current = 0;
+    long long offset = 0;
+    size_t size = read(offset, buffers[current].data());
+    while (size > 0)
+    {
+        long long nextOffset = offset + (long long) size;
+        char* nextBuffer = buffers[1 - current].data();
+        future<size_t> next;
+        if (readAhead)
+            next = async(launch::async, read, nextOffset, nextBuffer);
+
+        MD5Update(&context, (XMP_Uns8*) buffers[current].data(), (XMP_Uns32) size);
+
+        size = readAhead ? next.get() : read(nextOffset, nextBuffer);
+        offset = nextOffset;
+        current = 1 - current;
+    }
+    if (offset != getMediaSize())
+        VMF_EXCEPTION(DataStorageException, "Can't read file " + path + " to compute checksum");
+
+    XMP_Uns8 digest[16];
+    MD5Final(digest, &context);
+    return toHex(digest, sizeof(digest));
+}
+
+vector<uint64_t> ChecksumEngine::computeChunks(size_t first, size_t count, unsigned int threads) const
+{
+    vector<uint64_t> digests;
+    digests.reserve(count);
+    computeChunks(first, count, threads, count, [&](size_t, const vector<uint64_t>& batch)
+    {
+        digests.insert(digests.end(), batch.begin(), batch.end());
+        return true;
+    });
+    return digests;
+}
+
+size_t ChecksumEngine::computeChunks(size_t first, size_t count, unsigned int threads, size_t batchSize,
+                                     const function<bool(size_t, const vector<uint64_t>&)>& onBatch) const
+{
+    if (first > getChunkCount() || count > getChunkCount() - first)
+        VMF_EXCEPTION(OutOfRangeException, "Chunk range is out of the media part");
+    if (count == 0)
+        return first;
+    batchSize = max<size_t>(1, min(batchSize, count));
+
+    // workers of the pool keep their files open and wait for the next batch between batches
+    vector<uint64_t> digests;
+    size_t batchBegin = 0, batchEnd = 0;
+    atomic<size_t> nextChunk(0);
+    size_t generation = 0, busy = 0;
+    bool stop = false;
+    exception_ptr error;
+    mutex lock;
+    condition_variable started, finished;
+
+    auto hashBatch = [&](ifstream& file, vector<char>& buffer)
+    {
+        try
+        {
+            if (!file.is_open())
+            {
+                file.open(path, ios::binary);
+                if (!file.is_open())
+                    VMF_EXCEPTION(DataStorageException, "Can't open file " + path + " to compute checksum");
+            }
+            for (size_t i = nextChunk++; i < batchEnd; i = nextChunk++)
+            {
+                long long offset = (long long) i * CHUNK_SIZE;
+                size_t expected = (size_t) min(CHUNK_SIZE, getMediaSize() - offset);
+                if (readMedia(file, offset, buffer.data(), expected) != expected)
+                    VMF_EXCEPTION(DataStorageException, "Can't read file " + path + " to compute checksum");
+                digests[i - batchBegin] = xxhash64(buffer.data(), expected);
+            }
+        }
+        catch (...)
+        {
+            lock_guard<mutex> guard(lock);
+            if (!error)
+                error = current_exception();
+            nextChunk = batchEnd;
+        }
+    };
+
+    auto worker = [&]()
+    {
+        ifstream file;
+        vector<char> buffer((size_t) CHUNK_SIZE);
+        size_t seen = 0;
+        for (;;)
+        {
+            {
+                unique_lock<mutex> guard(lock);
+                started.wait(guard, [&]() { return stop || generation != seen; });
+                if (stop)
+                    return;
+                seen = generation;
+            }
+            hashBatch(file, buffer);
+            lock_guard<mutex> guard(lock);
+            if (--busy == 0)
+                finished.notify_one();
+        }
+    };
+
+    unsigned int workers = resolveThreads(threads, batchSize);
+    vector<thread> pool;
+    for (unsigned int i = 1; i < workers; i++)
+        pool.push_back(thread(worker));
+    auto stopPool = [&]()
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            stop = true;
+        }
+        started.notify_all();
+        for (auto& t : pool)
+            t.join();
+    };
+
+    ifstream file;
+    vector<char> buffer((size_t) CHUNK_SIZE);
+    size_t next = first, end = first + count;
+    try
+    {
+        while (next < end && !error)
+        {
+            {
+                lock_guard<mutex> guard(lock);
+                batchBegin = next;
+                batchEnd = next + min(batchSize, end - next);
+                digests.assign(batchEnd - batchBegin, 0);
+                nextChunk = batchBegin;
+                busy = pool.size();
+                generation++;
+            }
+            started.notify_all();
+            hashBatch(file, buffer);
+            {
+                unique_lock<mutex> guard(lock);
+                finished.wait(guard, [&]() { return busy == 0; });
+            }
+            if (error)
+                break;
+            next = batchEnd;
+            if (!onBatch(batchBegin, digests))
+                break;
+        }
+    }
+    catch (...)
+    {
+        stopPool();
+        throw;
+    }
+    stopPool();
+
+    if (error)
+        rethrow_exception(error);
+    return next;
+}
+
+string ChecksumEngine::combineChunks(const vector<uint64_t>& chunks, long long mediaSize)
+{
+    vector<unsigned char> leaves((chunks.size() + 1) * 8);
+    for (size_t i = 0; i < chunks.size(); i++)
+        writeLE64(&leaves[i * 8], chunks[i]);
+    writeLE64(&leaves[chunks.size() * 8], (uint64_t) mediaSize);
+
+    unsigned char root[8];
+    uint64_t digest = xxhash64(leaves.data(), leaves.size());
+    for (int i = 0; i < 8; i++)
+        root[i] = (unsigned char) (digest >> (56 - 8 * i));
+    return TREE_HASH_PREFIX + toHex(root, sizeof(root));
+}
+
+long long ChecksumEngine::getModificationTime(const string& filePath)
+{
+#ifdef _WIN32
+    struct _stat64 info;
+    if (_stat64(filePath.c_str(), &info) != 0)
+        return -1;
+#else
+    struct stat info;
+    if (stat(filePath.c_str(), &info) != 0)
+        return -1;
+#endif
+    return (long long) info.st_mtime;
+}
+
+uint64_t ChecksumEngine::xxhash64(const void* data, size_t size, uint64_t seed)
+{
+    const unsigned char* p = (const unsigned char*) data;
+    const unsigned char* end = p + size;
+    uint64_t h;
+
+    if (size >= 32)
+    {
+        const unsigned char* limit = end - 32;
+        uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+        uint64_t v2 = seed + PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME64_1;
+        do
+        {
+            v1 = round64(v1, readLE64(p));
+            v2 = round64(v2, readLE64(p + 8));
+            v3 = round64(v3, readLE64(p + 16));
+            v4 = round64(v4, readLE64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = mergeRound64(h, v1);
+        h = mergeRound64(h, v2);
+        h = mergeRound64(h, v3);
+        h = mergeRound64(h, v4);
+    }
+    else
+        h = seed + PRIME64_5;
+
+    h += (uint64_t) size;
+
+    for (; p + 8 <= end; p += 8)
+    {
+        h ^= round64(0, readLE64(p));
+        h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+    }
+    if (p + 4 <= end)
+    {
+        h ^= (uint64_t) readLE32(p) * PRIME64_1;
+        h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    for (; p < end; p++)
+    {
+        h ^= (*p) * PRIME64_5;
+        h = rotl64(h, 11) * PRIME64_1;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+} // namespace vmf
@@ -0,0 +1,159 @@
+/*
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __CHECKSUMENGINE_HPP__
+#define __CHECKSUMENGINE_HPP__
+
+/*!
+* \file checksumengine.hpp
+* \brief %ChecksumEngine header file
+*/
+
+#include "vmf/metadatastream.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace vmf
+{
+
+/*!
+ * \brief Class computes digests of media part of a file, i.e. of the file without the excluded region
+ * \details Tree hash splits the media part into chunks of CHUNK_SIZE bytes, hashes every chunk by
+ * 64-bit xxHash on a pool of threads and hashes the list of chunk digests into the root digest.
+ * MD5 can't be parallelized, so the file is read ahead by a separate thread while hashing.
+ */
+class VMF_EXPORT ChecksumEngine
+{
+public:
+    /*!
+     * \brief Size of a tree hash chunk in bytes
+     */
+    static const long long CHUNK_SIZE = 4 * 1024 * 1024;
+
+    /*!
+     * \brief Prefix of tree hash digests
+     */
+    static const char* TREE_HASH_PREFIX;
+
+    /*!
+     * \param filePath [in] path to the file
+     * \param excludeOffset [in] offset of the region excluded from the media part
+     * \param excludeSize [in] size of the excluded region, zero if the whole file is hashed
+     * \throw DataStorageException if the file can't be opened
+     */
+    ChecksumEngine(const std::string& filePath, long long excludeOffset = 0, long long excludeSize = 0);
+
+    /*!
+     * \brief Get size of the media part in bytes
+     */
+    long long getMediaSize() const;
+
+    /*!
+     * \brief Get number of tree hash chunks in the media part
+     */
+    size_t getChunkCount() const;
+
+    /*!
+     * \brief Compute digest of the media part
+     * \param threads [in] number of threads, zero selects number of cores
+     * \param chunks [out] optional digests of tree hash chunks computed along with the digest
+     */
+    std::string compute(MetadataStream::ChecksumAlgorithm algorithm, unsigned int threads,
+                        std::vector<uint64_t>* chunks = nullptr) const;
+
+    /*!
+     * \brief Compute digests of a range of tree hash chunks
+     * \param first [in] index of the first chunk
+     * \param count [in] number of chunks
+     * \param threads [in] number of threads, zero selects number of cores
+     */
+    std::vector<uint64_t> computeChunks(size_t first, size_t count, unsigned int threads) const;
+
+    /*!
+     * \brief Compute digests of a range of tree hash chunks by batches on one pool of threads
+     * \param first [in] index of the first chunk
+     * \param count [in] number of chunks
+     * \param threads [in] number of threads, zero selects number of cores
+     * \param batchSize [in] number of chunks in a batch
+     * \param onBatch [in] called in order with index of the first chunk of a batch and digests of the batch,
+     * the computation stops if it returns false
+     * \return index of the chunk following the last computed batch
+     */
+    size_t computeChunks(size_t first, size_t count, unsigned int threads, size_t batchSize,
+                         const std::function<bool(size_t, const std::vector<uint64_t>&)>& onBatch) const;
+
+    /*!
+     * \brief Compute tree hash digest from digests of all chunks
+     */
+    static std::string combineChunks(const std::vector<uint64_t>& chunks, long long mediaSize);
+
+    /*!
+     * \brief Compute 64-bit xxHash of a buffer
+     */
+    static uint64_t xxhash64(const void* data, size_t size, uint64_t seed = 0);
+
+    /*!
+     * \brief Get modification time of a file in seconds since epoch, -1 if the file doesn't exist
+     */
+    static long long getModificationTime(const std::string& filePath);
+
+private:
+    std::string computeMD5(unsigned int threads, std::vector<uint64_t>* chunks) const;
+
+    size_t readMedia(std::istream& file, long long offset, char* buffer, size_t size) const;
+
+    std::string path;
+    long long fileSize;
+    long long excludeOffset;
+    long long excludeSize;
+};
+
+/*!
+ * \brief State of a media file at the moment its digest was computed
+ * \details The digest of a file unchanged since it was hashed in the same session is verified by comparing
+ * the state only. A stored fingerprint has no modification time, the size and the packet location are compared
+ * and then digests of chunks, that is faster than recomputing MD5.
+ * Digests of chunks also serve as the manifest locating corrupt regions of the media data.
+ */
+struct ChecksumFingerprint
+{
+    ChecksumFingerprint() : mediaSize(-1), modified(-1), packetOffset(0), packetLength(0) {}
+
+    bool isValid() const { return !checksum.empty() && mediaSize >= 0; }
+
+    /*!
+     * \brief Check that the file state is the same, digests aren't compared
+     */
+    bool sameState(const ChecksumFingerprint& other) const
+    {
+        return mediaSize == other.mediaSize && modified == other.modified &&
+            packetOffset == other.packetOffset && packetLength == other.packetLength;
+    }
+
+    std::string checksum;
+    long long mediaSize;
+    long long modified;
+    long long packetOffset;
+    long long packetLength;
+    std::vector<uint64_t> chunks;
+};
+
+} // namespace vmf
+
+#endif // __CHECKSUMENGINE_HPP__
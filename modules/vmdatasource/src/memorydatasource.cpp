@@ -0,0 +1,445 @@
+/*
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "memorydatasource.hpp"
+
+#include "vmf/metadatastream.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+using namespace vmf;
+
+namespace
+{
+
+class MemoryMetadataStreamAccessor: public MetadataStream
+{
+public:
+    MemoryMetadataStreamAccessor()
+      : MetadataStream() { }
+    virtual ~MemoryMetadataStreamAccessor() { }
+    using MetadataStream::internalAdd;
+};
+
+struct MemoryStorage
+{
+    MemoryStorage() : latency(0) {}
+
+    mutex lock;
+    map<MetaString, MemoryDataSource::FileRecord> files;
+    vector<string> calls;
+    map<string, unsigned int> faults;
+    unsigned int latency;
+};
+
+MemoryStorage& storage()
+{
+    static MemoryStorage instance;
+    return instance;
+}
+
+MemoryDataSource::ItemRecord makeRecord(const Metadata& md)
+{
+    MemoryDataSource::ItemRecord record;
+    record.schema = md.getSchemaName();
+    record.name = md.getName();
+    record.frameIndex = md.getFrameIndex();
+    record.numOfFrames = md.getNumOfFrames();
+    record.time = md.getTime();
+    record.duration = md.getDuration();
+    record.fields.assign(md.begin(), md.end());
+    const vector<Reference>& refs = md.getAllReferences();
+    for (auto ref = refs.begin(); ref != refs.end(); ++ref)
+    {
+        shared_ptr<Metadata> target = ref->getReferenceMetadata().lock();
+        if (target)
+            record.refs.push_back(make_pair(target->getId(), ref->getReferenceDescription()->name));
+    }
+    return record;
+}
+
+}
+
+MemoryDataSource::MemoryDataSource()
+  : IDataSource(), opened(false), inTransaction(false), openMode(MetadataStream::InMemory)
+{
+}
+
+MemoryDataSource::~MemoryDataSource()
+{
+}
+
+MemoryDataSource::FileRecord& MemoryDataSource::enter(unique_lock<mutex>& guard, const string& call, bool write)
+{
+    MemoryStorage& state = storage();
+    unsigned int latency;
+    {
+        lock_guard<mutex> guard(state.lock);
+        state.calls.push_back(call);
+        latency = state.latency;
+    }
+    if (latency > 0)
+        this_thread::sleep_for(chrono::microseconds(latency));
+
+    guard = unique_lock<mutex>(state.lock);
+    auto fault = state.faults.find(call);
+    if (fault != state.faults.end())
+    {
+        if (fault->second == 0)
+        {
+            state.faults.erase(fault);
+            VMF_EXCEPTION(DataStorageException, "Injected failure of " + call);
+        }
+        fault->second--;
+    }
+    if (call != "openFile" && call != "closeFile")
+    {
+        if (!opened)
+            VMF_EXCEPTION(DataStorageException, "Memory file isn't opened");
+        if (write && openMode != MetadataStream::ReadWrite)
+            VMF_EXCEPTION(DataStorageException, "Memory file is opened for reading only");
+    }
+    // the caller uses the record while the guard holds the storage lock
+    return state.files[fileName];
+}
+
+void MemoryDataSource::openFile(const MetaString& name, MetadataStream::OpenMode mode)
+{
+    fileName = name;
+    if (mode != MetadataStream::ReadWrite)
+    {
+        MemoryStorage& state = storage();
+        lock_guard<mutex> guard(state.lock);
+        if (state.files.find(name) == state.files.end())
+            VMF_EXCEPTION(DataStorageException, "Memory file " + name + " doesn't exist");
+    }
+    unique_lock<mutex> guard;
+    enter(guard, "openFile");
+    openMode = mode;
+    opened = true;
+    inTransaction = false;
+}
+
+void MemoryDataSource::closeFile()
+{
+    unique_lock<mutex> guard;
+    enter(guard, "closeFile");
+    opened = false;
+}
+
+void MemoryDataSource::loadSchema(const MetaString& schemaName, MetadataStream& stream)
+{
+    unique_lock<mutex> guard;
+    FileRecord& file = enter(guard, "loadSchema");
+    if (file.schemas.find(schemaName) == file.schemas.end())
+        VMF_EXCEPTION(DataStorageException, "Schema " + schemaName + " not found");
+
+    for (auto it = file.items.begin(); it != file.items.end(); ++it)
+    {
+        if (it->second.schema == schemaName)
+            loadItem(file, it->first, stream);
+    }
+}
+
+void MemoryDataSource::loadProperty(const MetaString& schemaName, const MetaString& propertyName, MetadataStream& stream)
+{
+    unique_lock<mutex> guard;
+    FileRecord& file = enter(guard, "loadProperty");
+    for (auto it = file.items.begin(); it != file.items.end(); ++it)
+    {
+        if (it->second.schema == schemaName && it->second.name == propertyName)
+            loadItem(file, it->first, stream);
+    }
+}
+
+void MemoryDataSource::loadIndex(const MetaString& schemaName, vector<MetadataStream::IndexEntry>& index)
+{
+    unique_lock<mutex> guard;
+    FileRecord& file = enter(guard, "loadIndex");
+    if (file.schemas.find(schemaName) == file.schemas.end())
+        VMF_EXCEPTION(DataStorageException, "Schema " + schemaName + " not found");
+
+    for (auto it = file.items.begin(); it != file.items.end(); ++it)
+    {
+        if (it->second.schema != schemaName)
+            continue;
+        MetadataStream::IndexEntry entry;
+        entry.id = it->first;
+        entry.schema = it->second.schema;
+        entry.name = it->second.name;
+        entry.frameIndex = it->second.frameIndex;
+        entry.numOfFrames = it->second.numOfFrames;
+        entry.time = it->second.time;
+        entry.duration = it->second.duration;
+        index.push_back(entry);
+    }
+}
+
+void MemoryDataSource::loadItems(const vector<IdType>& ids, MetadataStream& stream)
+{
+    unique_lock<mutex> guard;
+    FileRecord& file = enter(guard, "loadItems");
+    for (auto id = ids.begin(); id != ids.end(); ++id)
+        loadItem(file, *id, stream);
+}
+
+shared_ptr<MetadataInternal> MemoryDataSource::loadPayload(const IdType& id, const MetadataStream& stream)
+{
+    unique_lock<mutex> guard;
+    FileRecord& file = enter(guard, "loadPayload");
+    auto record = file.items.find(id);
+    if (record == file.items.end())
+        VMF_EXCEPTION(DataStorageException, "Undefined item " + to_string(id));
+
+    shared_ptr<MetadataSchema> schema = stream.getSchema(record->second.schema);
+    if (!schema)
+        VMF_EXCEPTION(DataStorageException, "Schema " + record->second.schema + " isn't loaded");
+    shared_ptr<MetadataInternal> md = make_shared<MetadataInternal>(schema->findMetadataDesc(record->second.name));
+    md->setId(id);
+    md->assign(record->second.fields.begin(), record->second.fields.end());
+    md->vRefs = record->second.refs;
+    return md;
+}
+
+void MemoryDataSource::loadItem(FileRecord& file, const IdType& id, MetadataStream& stream)
+{
+    if (stream.getById(id))
+    {
+        // already loaded
+        return;
+    }
+
+    auto record = file.items.find(id);
+    if (record == file.items.end())
+        VMF_EXCEPTION(DataStorageException, "Undefined reference to item " + to_string(id));
+
+    shared_ptr<MetadataSchema> schema = stream.getSchema(record->second.schema);
+    if (!schema)
+        VMF_EXCEPTION(DataStorageException, "Schema " + record->second.schema + " isn't loaded");
+    shared_ptr<MetadataDesc> desc = schema->findMetadataDesc(record->second.name);
+    if (!desc)
+        VMF_EXCEPTION(DataStorageException, "Unknown metadata " + record->second.name);
+
+    shared_ptr<MetadataInternal> md = make_shared<MetadataInternal>(desc);
+    md->setId(id);
+    md->setFrameIndex(record->second.frameIndex, record->second.numOfFrames);
+    md->setTimestamp(record->second.time, record->second.duration);
+    for (auto field = record->second.fields.begin(); field != record->second.fields.end(); ++field)
+    {
+        if (field->getName().empty())
+            md->addValue(*field);
+        else
+            md->setFieldValue(field->getName(), *field);
+    }
+
+    MemoryMetadataStreamAccessor* streamAccessor = (MemoryMetadataStreamAccessor*) &stream;
+    streamAccessor->internalAdd(md);
+
+    // Load refs only after adding to steam to stop recursive loading when there are circular references
+    vector<pair<IdType, string> > refs = record->second.refs;
+    for (auto ref = refs.begin(); ref != refs.end(); ++ref)
+    {
+        loadItem(file, ref->first, stream);
+        md->addReference(stream.getById(ref->first), ref->second);
+    }
+}
+
+void MemoryDataSource::saveSchema(const MetaString& schemaName, const MetadataStream& stream)
+{
+    unique_lock<mutex> guard;
+    FileRecord& file = enter(guard, "saveSchema", true);
+    shared_ptr<MetadataSchema> schema = stream.getSchema(schemaName);
+    if (!schema)
+        VMF_EXCEPTION(DataStorageException, "Schema " + schemaName + " not found");
+    file.schemas[schemaName] = schema;
+
+    MetadataSet set = stream.queryBySchema(schemaName);
+    for (auto it = set.begin(); it != set.end(); ++it)
+    {
+        // evicted items are unchanged since they were loaded
+        if (!(*it)->isEvicted())
+            file.items[(*it)->getId()] = makeRecord(**it);
+    }
+}
+
+void MemoryDataSource::save(const shared_ptr<MetadataSchema>& schema)
+{
+    if (schema == nullptr)
+    {
+        VMF_EXCEPTION(NullPointerException, "Couldn't save nullptr schema");
+    }
+    unique_lock<mutex> guard;
+    FileRecord& file = enter(guard, "save(schema)", true);
+    file.schemas[schema->getName()] = schema;
+}
+
+void MemoryDataSource::remove(const vector<IdType>& ids)
+{
+    unique_lock<mutex> guard;
+    FileRecord& file = enter(guard, "remove", true);
+    for (auto id = ids.begin(); id != ids.end(); ++id)
+        file.items.erase(*id);
+}
+
+void MemoryDataSource::load(map<MetaString, shared_ptr<MetadataSchema> >& schemas)
+{
+    unique_lock<mutex> guard;
+    FileRecord& file = enter(guard, "load(schemas)");
+    for (auto it = file.schemas.begin(); it != file.schemas.end(); ++it)
+        schemas[it->first] = it->second;
+}
+
+void MemoryDataSource::clear()
+{
+    unique_lock<mutex> guard;
+    FileRecord& file = enter(guard, "clear", true);
+    file.schemas.clear();
+    file.items.clear();
+}
+
+void MemoryDataSource::save(const IdType& id)
+{
+    unique_lock<mutex> guard;
+    FileRecord& file = enter(guard, "save(id)", true);
+    file.nextId = id;
+}
+
+IdType MemoryDataSource::loadId()
+{
+    unique_lock<mutex> guard;
+    return enter(guard, "loadId").nextId;
+}
+
+void MemoryDataSource::removeSchema(const MetaString& schemaName)
+{
+    unique_lock<mutex> guard;
+    FileRecord& file = enter(guard, "removeSchema", true);
+    // an empty name removes all schemas like in the other data sources
+    if (schemaName.empty())
+    {
+        file.schemas.clear();
+        file.items.clear();
+        file.nextId = 0;
+        return;
+    }
+
+    file.schemas.erase(schemaName);
+    for (auto it = file.items.begin(); it != file.items.end();)
+    {
+        if (it->second.schema == schemaName)
+            it = file.items.erase(it);
+        else
+            ++it;
+    }
+}
+
+void MemoryDataSource::saveChecksum(const MetaString& checksum)
+{
+    unique_lock<mutex> guard;
+    enter(guard, "saveChecksum", true).checksum = checksum;
+}
+
+std::string MemoryDataSource::loadChecksum()
+{
+    unique_lock<mutex> guard;
+    return enter(guard, "loadChecksum").checksum;
+}
+
+std::string MemoryDataSource::computeChecksum(long long& XMPPacketSize, long long& XMPPacketOffset)
+{
+    unique_lock<mutex> guard;
+    enter(guard, "computeChecksum");
+    // there is no media content in memory
+    XMPPacketSize = 0;
+    XMPPacketOffset = 0;
+    return "";
+}
+
+void MemoryDataSource::saveVideoSegments(const vector<shared_ptr<MetadataStream::VideoSegment>>& segments)
+{
+    unique_lock<mutex> guard;
+    FileRecord& file = enter(guard, "saveVideoSegments", true);
+    file.segments.clear();
+    for (auto it = segments.begin(); it != segments.end(); ++it)
+        file.segments.push_back(make_shared<MetadataStream::VideoSegment>(**it));
+}
+
+void MemoryDataSource::loadVideoSegments(vector<shared_ptr<MetadataStream::VideoSegment>>& segments)
+{
+    unique_lock<mutex> guard;
+    FileRecord& file = enter(guard, "loadVideoSegments");
+    for (auto it = file.segments.begin(); it != file.segments.end(); ++it)
+        segments.push_back(make_shared<MetadataStream::VideoSegment>(**it));
+}
+
+void MemoryDataSource::beginTransaction()
+{
+    unique_lock<mutex> guard;
+    snapshot = enter(guard, "beginTransaction", true);
+    inTransaction = true;
+}
+
+void MemoryDataSource::commitTransaction()
+{
+    unique_lock<mutex> guard;
+    enter(guard, "commitTransaction", true);
+    snapshot = FileRecord();
+    inTransaction = false;
+}
+
+void MemoryDataSource::rollbackTransaction()
+{
+    unique_lock<mutex> guard;
+    FileRecord& file = enter(guard, "rollbackTransaction", true);
+    if (inTransaction)
+        file = snapshot;
+    snapshot = FileRecord();
+    inTransaction = false;
+}
+
+vector<string> MemoryDataSource::getCalls()
+{
+    MemoryStorage& state = storage();
+    lock_guard<mutex> guard(state.lock);
+    return state.calls;
+}
+
+void MemoryDataSource::reset()
+{
+    MemoryStorage& state = storage();
+    lock_guard<mutex> guard(state.lock);
+    state.files.clear();
+    state.calls.clear();
+    state.faults.clear();
+    state.latency = 0;
+}
+
+void MemoryDataSource::setLatency(unsigned int microseconds)
+{
+    MemoryStorage& state = storage();
+    lock_guard<mutex> guard(state.lock);
+    state.latency = microseconds;
+}
+
+void MemoryDataSource::injectFault(const string& call, unsigned int skipCalls)
+{
+    MemoryStorage& state = storage();
+    lock_guard<mutex> guard(state.lock);
+    state.faults[call] = skipCalls;
+}
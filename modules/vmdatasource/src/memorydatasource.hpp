@@ -0,0 +1,166 @@
+/*
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __MEMORYDATASOURCE_HPP__
+#define __MEMORYDATASOURCE_HPP__
+
+/*!
+* \file memorydatasource.hpp
+* \brief %MemoryDataSource header file
+*/
+
+#include "datasource.hpp"
+
+#include <map>
+#include <mutex>
+
+namespace vmf
+{
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable: 4251)
+#endif
+
+/*!
+ * \brief Class implements IDataSource interface keeping metadata in RAM instead of media files.
+ * \details Stored state is shared by all instances and addressed by the file name, so
+ * a stream can be reopened and reloaded while the process runs. Every call is recorded
+ * and can be delayed or made to fail, which allows to benchmark and stress %MetadataStream
+ * save/load logic without media file I/O.
+ * The data source isn't intended for concurrent access to the same file from several threads.
+ */
+class VMF_EXPORT MemoryDataSource: public IDataSource {
+public:
+    MemoryDataSource();
+
+    virtual ~MemoryDataSource();
+
+    virtual void openFile(const vmf::MetaString& fileName, vmf::MetadataStream::OpenMode mode);
+
+    virtual void closeFile();
+
+    virtual void loadSchema(const vmf::MetaString& schemaName, vmf::MetadataStream& stream);
+
+    virtual void loadProperty(const vmf::MetaString &schemaName, const vmf::MetaString &propertyName, MetadataStream &stream);
+
+    virtual void loadIndex(const vmf::MetaString& schemaName, std::vector<vmf::MetadataStream::IndexEntry>& index);
+
+    virtual void loadItems(const std::vector<vmf::IdType>& ids, vmf::MetadataStream& stream);
+
+    virtual std::shared_ptr<vmf::MetadataInternal> loadPayload(const vmf::IdType& id, const vmf::MetadataStream& stream);
+
+    virtual void saveSchema(const vmf::MetaString& schemaName, const vmf::MetadataStream& stream);
+
+    virtual void save(const std::shared_ptr<vmf::MetadataSchema>& schema);
+
+    virtual void remove(const std::vector<vmf::IdType>& ids);
+
+    virtual void load(std::map<MetaString, std::shared_ptr<vmf::MetadataSchema> >& schemas);
+
+    virtual void clear();
+
+    virtual void save(const vmf::IdType& id);
+
+    virtual vmf::IdType loadId();
+
+    virtual void removeSchema(const MetaString &schemaName);
+
+    virtual void saveChecksum(const MetaString& checksum);
+
+    virtual std::string loadChecksum();
+
+    virtual std::string computeChecksum(long long& XMPPacketSize, long long& XMPPacketOffset);
+
+    virtual void saveVideoSegments(const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments);
+
+    virtual void loadVideoSegments(std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments);
+
+    virtual void beginTransaction();
+
+    virtual void commitTransaction();
+
+    virtual void rollbackTransaction();
+
+    /*!
+     * \brief Get names of all calls made to memory data sources since the last reset
+     */
+    static std::vector<std::string> getCalls();
+
+    /*!
+     * \brief Drop all stored files, recorded calls, injected faults and latency
+     */
+    static void reset();
+
+    /*!
+     * \brief Set delay applied to every call
+     */
+    static void setLatency(unsigned int microseconds);
+
+    /*!
+     * \brief Make a call fail with DataStorageException
+     * \param call [in] name of the call as returned by getCalls()
+     * \param skipCalls [in] number of matching calls that succeed before the failure
+     */
+    static void injectFault(const std::string& call, unsigned int skipCalls);
+
+    struct ItemRecord
+    {
+        vmf::MetaString schema;
+        vmf::MetaString name;
+        long long frameIndex;
+        long long numOfFrames;
+        long long time;
+        long long duration;
+        std::vector<vmf::FieldValue> fields;
+        std::vector<std::pair<vmf::IdType, std::string> > refs;
+    };
+
+    struct FileRecord
+    {
+        FileRecord() : nextId(0) {}
+
+        std::map<vmf::MetaString, std::shared_ptr<vmf::MetadataSchema> > schemas;
+        std::map<vmf::IdType, ItemRecord> items;
+        std::vector<std::shared_ptr<MetadataStream::VideoSegment> > segments;
+        vmf::IdType nextId;
+        std::string checksum;
+    };
+
+protected:
+    // Records the call and locks the storage, the returned record may be used while the guard is locked
+    FileRecord& enter(std::unique_lock<std::mutex>& guard, const std::string& call, bool write = false);
+
+    void loadItem(FileRecord& file, const vmf::IdType& id, vmf::MetadataStream& stream);
+
+private:
+    MemoryDataSource(const MemoryDataSource& origin);
+    MemoryDataSource& operator=(const MemoryDataSource& origin);
+
+    bool opened;
+    bool inTransaction;
+    vmf::MetaString fileName;
+    vmf::MetadataStream::OpenMode openMode;
+    FileRecord snapshot;
+};
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+} // namespace vmf
+
+#endif // __MEMORYDATASOURCE_HPP__
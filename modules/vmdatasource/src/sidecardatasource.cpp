@@ -0,0 +1,773 @@
+/* 
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "sidecardatasource.hpp"
+
+#include "vmf/metadatastream.hpp"
+#include "vmf/xmlreader.hpp"
+#include "vmf/xmlwriter.hpp"
+
+#include "xmpdatasource.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <zlib.h>
+
+#define SIDECAR_EXTENSION ".vmf"
+#define SIDECAR_TMP_EXTENSION ".tmp"
+#define SIDECAR_SIGNATURE "VMF-SIDECAR 2"
+
+#define RECORD_SCHEMA "schema"
+#define RECORD_ITEM "item"
+#define RECORD_REMOVE "remove"
+#define RECORD_REMOVE_SCHEMA "remove-schema"
+#define RECORD_CLEAR "clear"
+#define RECORD_NEXT_ID "next-id"
+#define RECORD_CHECKSUM "checksum"
+#define RECORD_SEGMENTS "segments"
+
+// Minimal number of records appended between checkpoints
+#define CHECKPOINT_MIN_RECORDS 1024
+
+using namespace std;
+using namespace vmf;
+
+namespace
+{
+
+class SidecarMetadataStreamAccessor: public MetadataStream
+{
+public:
+    SidecarMetadataStreamAccessor()
+      : MetadataStream() { }
+    virtual ~SidecarMetadataStreamAccessor() { }
+    using MetadataStream::internalAdd;
+};
+
+unsigned long checksumOf(const string& data)
+{
+    uLong crc = crc32(0L, Z_NULL, 0);
+    return crc32(crc, (const Bytef*)data.data(), (uInt)data.size());
+}
+
+// The header line of a record holds the tag, the payload size and checksum and its own checksum,
+// so a damaged size is found before the payload is read
+void writeRecord(ostream& os, const string& tag, const string& payload)
+{
+    string header = tag + ' ' + to_string((unsigned long long)payload.size()) + ' ' + to_string(checksumOf(payload));
+    os << header << ' ' << checksumOf(header) << '\n' << payload << '\n';
+}
+
+bool parseRecordHeader(const string& header, string& tag, unsigned long long& size, unsigned long& crc)
+{
+    size_t pos = header.rfind(' ');
+    if (pos == string::npos)
+        return false;
+    unsigned long headerCrc;
+    istringstream crcStream(header.substr(pos + 1));
+    if (!(crcStream >> headerCrc) || checksumOf(header.substr(0, pos)) != headerCrc)
+        return false;
+    istringstream is(header.substr(0, pos));
+    return (is >> tag >> size >> crc) && (is >> ws).eof();
+}
+
+void writeString(ostream& os, const string& str)
+{
+    os << ' ' << str.size() << ':' << str;
+}
+
+string readString(istream& is)
+{
+    size_t size;
+    char delimiter;
+    if (!(is >> size) || !is.get(delimiter) || delimiter != ':')
+    {
+        VMF_EXCEPTION(DataStorageException, "Corrupted sidecar record");
+    }
+    string str(size, '\0');
+    if (size > 0 && !is.read(&str[0], size))
+    {
+        VMF_EXCEPTION(DataStorageException, "Corrupted sidecar record");
+    }
+    return str;
+}
+
+string serializeItem(const Metadata& md)
+{
+    ostringstream os;
+    writeString(os, md.getSchemaName());
+    writeString(os, md.getName());
+    os << ' ' << md.getId() << ' ' << md.getFrameIndex() << ' ' << md.getNumOfFrames()
+       << ' ' << md.getTime() << ' ' << md.getDuration() << ' ' << md.size();
+    for (auto field = md.begin(); field != md.end(); ++field)
+    {
+        writeString(os, field->getName());
+        writeString(os, field->toString());
+    }
+
+    const vector<Reference>& refs = md.getAllReferences();
+    os << ' ' << refs.size();
+    for (auto ref = refs.begin(); ref != refs.end(); ++ref)
+    {
+        shared_ptr<Metadata> spMetadata = ref->getReferenceMetadata().lock();
+        if (!spMetadata)
+            VMF_EXCEPTION(NullPointerException, "Trying to save nullptr reference");
+        os << ' ' << spMetadata->getId();
+        writeString(os, ref->getReferenceDescription()->name);
+    }
+    return os.str();
+}
+
+IdType parseItemId(const string& text)
+{
+    istringstream is(text);
+    readString(is);
+    readString(is);
+    IdType id;
+    if (!(is >> id))
+        VMF_EXCEPTION(DataStorageException, "Corrupted sidecar item record");
+    return id;
+}
+
+shared_ptr<MetadataInternal> parseItem(const string& text, const map<MetaString, shared_ptr<MetadataSchema> >& schemas)
+{
+    istringstream is(text);
+    MetaString schemaName = readString(is);
+    MetaString metadataName = readString(is);
+
+    auto schema = schemas.find(schemaName);
+    if (schema == schemas.end())
+        VMF_EXCEPTION(DataStorageException, "Unknown schema " + schemaName + " of sidecar item record");
+    shared_ptr<MetadataDesc> desc = schema->second->findMetadataDesc(metadataName);
+    if (!desc)
+        VMF_EXCEPTION(DataStorageException, "Unknown metadata " + metadataName + " of sidecar item record");
+
+    IdType id;
+    long long frameIndex, numOfFrames, timestamp, duration;
+    size_t fieldsCount;
+    if (!(is >> id >> frameIndex >> numOfFrames >> timestamp >> duration >> fieldsCount))
+        VMF_EXCEPTION(DataStorageException, "Corrupted sidecar item record");
+
+    shared_ptr<MetadataInternal> md = make_shared<MetadataInternal>(desc);
+    md->setId(id);
+    md->setFrameIndex(frameIndex, numOfFrames);
+    md->setTimestamp(timestamp, duration);
+    for (size_t i = 0; i < fieldsCount; i++)
+    {
+        MetaString fieldName = readString(is);
+        string value = readString(is);
+        FieldDesc fieldDesc;
+        if (!desc->getFieldDesc(fieldDesc, fieldName))
+            VMF_EXCEPTION(DataStorageException, "Extra field " + fieldName + " in sidecar item record");
+        Variant fieldValue;
+        fieldValue.fromString(fieldDesc.type, value);
+        if (fieldName.empty())
+            md->addValue(fieldValue);
+        else
+            md->setFieldValue(fieldName, fieldValue);
+    }
+
+    size_t refsCount;
+    if (!(is >> refsCount))
+        VMF_EXCEPTION(DataStorageException, "Corrupted sidecar item record");
+    for (size_t i = 0; i < refsCount; i++)
+    {
+        IdType refId;
+        if (!(is >> refId))
+            VMF_EXCEPTION(DataStorageException, "Corrupted sidecar item record");
+        md->vRefs.push_back(make_pair(refId, readString(is)));
+    }
+    return md;
+}
+
+string serializeSchema(const shared_ptr<MetadataSchema>& schema)
+{
+    vector<shared_ptr<MetadataSchema> > schemas(1, schema);
+    return XMLWriter().store(schemas);
+}
+
+} // namespace
+
+SidecarDataSource::SidecarDataSource(bool embed)
+  : IDataSource(), embedMode(embed), opened(false), modified(false), openMode(MetadataStream::ReadOnly),
+    recordsSinceCheckpoint(0), nextId(0)
+{
+}
+
+SidecarDataSource::~SidecarDataSource()
+{
+    try
+    {
+        closeFile();
+    }
+    catch(...)
+    {
+        // do nothing
+    }
+}
+
+std::string SidecarDataSource::getSidecarPath(const MetaString& mediaFileName)
+{
+    return mediaFileName + SIDECAR_EXTENSION;
+}
+
+void SidecarDataSource::openFile(const MetaString& fileName, MetadataStream::OpenMode mode)
+{
+    if (opened)
+        closeFile();
+
+    ifstream media(fileName, ios::binary);
+    if (!media.is_open())
+        VMF_EXCEPTION(DataStorageException, "Could not open media file " + fileName);
+    media.close();
+
+    mediaFileName = fileName;
+    sidecarFileName = getSidecarPath(fileName);
+    openMode = mode;
+    modified = false;
+    recordsSinceCheckpoint = 0;
+    schemas.clear();
+    schemaRecords.clear();
+    items.clear();
+    segmentsRecord.clear();
+    nextId = 0;
+    checksum.clear();
+
+    ifstream sidecar(sidecarFileName, ios::binary);
+    bool exists = sidecar.is_open();
+    sidecar.close();
+
+    if (exists)
+        replay();
+    else if (embedMode)
+        importEmbedded();
+
+    opened = true;
+}
+
+void SidecarDataSource::closeFile()
+{
+    if (!opened)
+        return;
+
+    flush();
+    log.close();
+    if (embedMode && modified && openMode == MetadataStream::ReadWrite)
+        exportEmbedded();
+    opened = false;
+}
+
+void SidecarDataSource::replay()
+{
+    ifstream in(sidecarFileName, ios::binary | ios::ate);
+    streamoff fileSize = in.tellg();
+    in.seekg(0);
+    string signature;
+    if (!getline(in, signature) || signature != SIDECAR_SIGNATURE)
+        VMF_EXCEPTION(DataStorageException, "Invalid sidecar file " + sidecarFileName);
+
+    // Only the last record may be partially written by an interrupted save,
+    // a damaged record followed by other data fails the replay
+    streamoff validSize = in.tellg();
+    string header;
+    while (getline(in, header))
+    {
+        if (in.eof())
+            break;
+        string tag;
+        unsigned long long size;
+        unsigned long crc;
+        if (!parseRecordHeader(header, tag, size, crc))
+            VMF_EXCEPTION(DataStorageException, "Corrupted record header in sidecar file " + sidecarFileName);
+        if (size >= (unsigned long long)(fileSize - (streamoff)in.tellg()))
+            break;
+        string payload((size_t)size, '\0');
+        if ((size > 0 && !in.read(&payload[0], (streamsize)size)) || in.get() != '\n' || checksumOf(payload) != crc)
+            VMF_EXCEPTION(DataStorageException, "Corrupted record in sidecar file " + sidecarFileName);
+        apply(tag, payload);
+        recordsSinceCheckpoint++;
+        validSize = in.tellg();
+    }
+    in.close();
+
+    // Drop a record partially written by an interrupted save
+    if (openMode == MetadataStream::ReadWrite && fileSize != validSize)
+        checkpoint();
+}
+
+void SidecarDataSource::apply(const string& tag, const string& payload)
+{
+    if (tag == RECORD_ITEM)
+    {
+        ItemRecord record;
+        istringstream is(payload);
+        record.schema = readString(is);
+        record.text = payload;
+        items[parseItemId(payload)] = record;
+    }
+    else if (tag == RECORD_SCHEMA)
+    {
+        vector<shared_ptr<MetadataSchema> > parsed;
+        if (!XMLReader().parseSchemas(payload, parsed) || parsed.size() != 1)
+            VMF_EXCEPTION(DataStorageException, "Corrupted sidecar schema record");
+        schemas[parsed[0]->getName()] = parsed[0];
+        schemaRecords[parsed[0]->getName()] = payload;
+    }
+    else if (tag == RECORD_REMOVE)
+    {
+        istringstream is(payload);
+        IdType id;
+        while (is >> id)
+            items.erase(id);
+    }
+    else if (tag == RECORD_REMOVE_SCHEMA || tag == RECORD_CLEAR)
+    {
+        bool all = tag == RECORD_CLEAR || payload.empty();
+        for (auto it = items.begin(); it != items.end(); )
+        {
+            if (all || it->second.schema == payload)
+                items.erase(it++);
+            else
+                ++it;
+        }
+        if (all)
+        {
+            schemas.clear();
+            schemaRecords.clear();
+        }
+        else
+        {
+            schemas.erase(payload);
+            schemaRecords.erase(payload);
+        }
+        if (tag == RECORD_REMOVE_SCHEMA && payload.empty())
+            nextId = 0;
+    }
+    else if (tag == RECORD_NEXT_ID)
+    {
+        nextId = stringTo<IdType>(payload);
+    }
+    else if (tag == RECORD_CHECKSUM)
+    {
+        checksum = payload;
+    }
+    else if (tag == RECORD_SEGMENTS)
+    {
+        segmentsRecord = payload;
+    }
+    else
+    {
+        VMF_EXCEPTION(DataStorageException, "Unknown sidecar record " + tag);
+    }
+}
+
+void SidecarDataSource::append(const string& tag, const string& payload)
+{
+    writeCheck();
+    apply(tag, payload);
+    modified = true;
+
+    // Compact the log when it holds more superseded records than live ones,
+    // so the amortized cost of a record stays constant
+    if (++recordsSinceCheckpoint >= std::max<size_t>(CHECKPOINT_MIN_RECORDS, 2 * (items.size() + schemas.size())))
+    {
+        checkpoint();
+        return;
+    }
+
+    if (!log.is_open())
+    {
+        log.open(sidecarFileName, ios::binary | ios::out | ios::app);
+        if (!log.is_open())
+            VMF_EXCEPTION(DataStorageException, "Could not open sidecar file " + sidecarFileName);
+        if (log.tellp() == 0)
+            log << SIDECAR_SIGNATURE << '\n';
+    }
+    writeRecord(log, tag, payload);
+    if (!log)
+        VMF_EXCEPTION(DataStorageException, "Could not write sidecar file " + sidecarFileName);
+}
+
+void SidecarDataSource::checkpoint()
+{
+    log.close();
+
+    string tmpFileName = sidecarFileName + SIDECAR_TMP_EXTENSION;
+    {
+        ofstream out(tmpFileName, ios::binary | ios::out | ios::trunc);
+        if (!out.is_open())
+            VMF_EXCEPTION(DataStorageException, "Could not create sidecar file " + tmpFileName);
+
+        auto write = [&](const string& tag, const string& payload)
+        {
+            writeRecord(out, tag, payload);
+        };
+
+        out << SIDECAR_SIGNATURE << '\n';
+        for (auto it = schemaRecords.begin(); it != schemaRecords.end(); ++it)
+            write(RECORD_SCHEMA, it->second);
+        for (auto it = items.begin(); it != items.end(); ++it)
+            write(RECORD_ITEM, it->second.text);
+        if (!segmentsRecord.empty())
+            write(RECORD_SEGMENTS, segmentsRecord);
+        write(RECORD_NEXT_ID, to_string(nextId));
+        if (!checksum.empty())
+            write(RECORD_CHECKSUM, checksum);
+
+        out.flush();
+        if (!out)
+            VMF_EXCEPTION(DataStorageException, "Could not write sidecar file " + tmpFileName);
+    }
+
+#ifdef _WIN32
+    std::remove(sidecarFileName.c_str());
+#endif
+    if (std::rename(tmpFileName.c_str(), sidecarFileName.c_str()) != 0)
+        VMF_EXCEPTION(DataStorageException, "Could not replace sidecar file " + sidecarFileName);
+
+    recordsSinceCheckpoint = 0;
+}
+
+void SidecarDataSource::flush()
+{
+    if (log.is_open())
+    {
+        log.flush();
+        if (!log)
+            VMF_EXCEPTION(DataStorageException, "Could not write sidecar file " + sidecarFileName);
+    }
+}
+
+void SidecarDataSource::openCheck()
+{
+    if (!opened)
+        VMF_EXCEPTION(DataStorageException, "Sidecar file isn't opened");
+}
+
+void SidecarDataSource::writeCheck()
+{
+    openCheck();
+    if (openMode != MetadataStream::ReadWrite)
+        VMF_EXCEPTION(DataStorageException, "Sidecar file is opened for reading only");
+}
+
+void SidecarDataSource::loadSchema(const MetaString& schemaName, MetadataStream& stream)
+{
+    openCheck();
+    if (schemas.find(schemaName) == schemas.end())
+        VMF_EXCEPTION(DataStorageException, "Schema " + schemaName + " not found");
+
+    LoadContext context;
+    prepareLoad(stream, context);
+
+    for (auto it = items.begin(); it != items.end(); ++it)
+    {
+        if (it->second.schema == schemaName)
+            loadItem(it->first, stream, context);
+    }
+}
+
+void SidecarDataSource::loadProperty(const MetaString& schemaName, const MetaString& propertyName, MetadataStream& stream)
+{
+    openCheck();
+    LoadContext context;
+    prepareLoad(stream, context);
+
+    for (auto it = items.begin(); it != items.end(); ++it)
+    {
+        if (it->second.schema != schemaName)
+            continue;
+        istringstream is(it->second.text);
+        readString(is);
+        if (readString(is) == propertyName)
+            loadItem(it->first, stream, context);
+    }
+}
+
+void SidecarDataSource::loadIndex(const MetaString& schemaName, vector<MetadataStream::IndexEntry>& index)
+{
+    openCheck();
+    if (schemas.find(schemaName) == schemas.end())
+        VMF_EXCEPTION(DataStorageException, "Schema " + schemaName + " not found");
+
+    for (auto it = items.begin(); it != items.end(); ++it)
+    {
+        if (it->second.schema != schemaName)
+            continue;
+        // only the header of the record is parsed, see serializeItem()
+        istringstream is(it->second.text);
+        MetadataStream::IndexEntry entry;
+        entry.schema = readString(is);
+        entry.name = readString(is);
+        if (!(is >> entry.id >> entry.frameIndex >> entry.numOfFrames >> entry.time >> entry.duration))
+            VMF_EXCEPTION(DataStorageException, "Corrupted sidecar item record");
+        index.push_back(entry);
+    }
+}
+
+void SidecarDataSource::loadItems(const vector<IdType>& ids, MetadataStream& stream)
+{
+    openCheck();
+    LoadContext context;
+    prepareLoad(stream, context);
+
+    for (auto id = ids.begin(); id != ids.end(); ++id)
+        loadItem(*id, stream, context);
+}
+
+shared_ptr<MetadataInternal> SidecarDataSource::loadPayload(const IdType& id, const MetadataStream& stream)
+{
+    openCheck();
+    auto record = items.find(id);
+    if (record == items.end())
+        VMF_EXCEPTION(DataStorageException, "Undefined item " + to_string(id));
+
+    map<MetaString, shared_ptr<MetadataSchema> > streamSchemas;
+    streamSchemas[record->second.schema] = stream.getSchema(record->second.schema);
+    return parseItem(record->second.text, streamSchemas);
+}
+
+void SidecarDataSource::prepareLoad(MetadataStream& stream, LoadContext& context)
+{
+    vector<string> names = stream.getAllSchemaNames();
+    for (auto it = names.begin(); it != names.end(); ++it)
+        context.schemas[*it] = stream.getSchema(*it);
+}
+
+void SidecarDataSource::loadItem(const IdType& id, MetadataStream& stream, LoadContext& context)
+{
+    if (stream.getById(id))
+    {
+        // already loaded
+        return;
+    }
+
+    auto record = items.find(id);
+    if (record == items.end())
+        VMF_EXCEPTION(DataStorageException, "Undefined reference to item " + to_string(id));
+
+    shared_ptr<MetadataInternal> md = parseItem(record->second.text, context.schemas);
+    SidecarMetadataStreamAccessor* streamAccessor = (SidecarMetadataStreamAccessor*) &stream;
+    streamAccessor->internalAdd(md);
+
+    // Load refs only after adding to steam to stop recursive loading when there are circular references
+    vector<pair<IdType, string> > refs;
+    refs.swap(md->vRefs);
+    for (auto ref = refs.begin(); ref != refs.end(); ++ref)
+    {
+        loadItem(ref->first, stream, context);
+        md->addReference(stream.getById(ref->first), ref->second);
+    }
+}
+
+void SidecarDataSource::saveSchema(const MetaString& schemaName, const MetadataStream& stream)
+{
+    writeCheck();
+    shared_ptr<MetadataSchema> schema = stream.getSchema(schemaName);
+    if (!schema)
+        VMF_EXCEPTION(DataStorageException, "Schema " + schemaName + " not found");
+    save(schema);
+
+    MetadataSet set = stream.queryBySchema(schemaName);
+    for (auto it = set.begin(); it != set.end(); ++it)
+    {
+        // unchanged items are already stored, evicted ones are unchanged since they were loaded
+        if ((*it)->isEvicted() || (!(*it)->isModified() && items.find((*it)->getId()) != items.end()))
+            continue;
+        append(RECORD_ITEM, serializeItem(**it));
+    }
+}
+
+void SidecarDataSource::save(const shared_ptr<MetadataSchema>& schema)
+{
+    if (schema == nullptr)
+    {
+        VMF_EXCEPTION(NullPointerException, "Couldn't save nullptr schema");
+    }
+    writeCheck();
+    string text = serializeSchema(schema);
+    auto record = schemaRecords.find(schema->getName());
+    if (record == schemaRecords.end() || record->second != text)
+        append(RECORD_SCHEMA, text);
+}
+
+void SidecarDataSource::remove(const vector<IdType>& ids)
+{
+    writeCheck();
+    ostringstream os;
+    for (auto id = ids.begin(); id != ids.end(); ++id)
+    {
+        if (items.find(*id) != items.end())
+            os << *id << ' ';
+    }
+    if (!os.str().empty())
+        append(RECORD_REMOVE, os.str());
+}
+
+void SidecarDataSource::load(map<MetaString, shared_ptr<MetadataSchema> >& loadedSchemas)
+{
+    openCheck();
+    for (auto it = schemas.begin(); it != schemas.end(); ++it)
+        loadedSchemas[it->first] = it->second;
+}
+
+void SidecarDataSource::clear()
+{
+    writeCheck();
+    append(RECORD_CLEAR, "");
+}
+
+void SidecarDataSource::save(const IdType& id)
+{
+    writeCheck();
+    if (id != nextId)
+        append(RECORD_NEXT_ID, to_string(id));
+    // next id is saved at the end of every stream save
+    flush();
+}
+
+IdType SidecarDataSource::loadId()
+{
+    openCheck();
+    return nextId;
+}
+
+void SidecarDataSource::removeSchema(const MetaString& schemaName)
+{
+    writeCheck();
+    append(RECORD_REMOVE_SCHEMA, schemaName);
+}
+
+void SidecarDataSource::saveChecksum(const MetaString& newChecksum)
+{
+    writeCheck();
+    if (newChecksum != checksum)
+        append(RECORD_CHECKSUM, newChecksum);
+}
+
+std::string SidecarDataSource::loadChecksum()
+{
+    openCheck();
+    return checksum;
+}
+
+std::string SidecarDataSource::computeChecksum(long long& XMPPacketSize, long long& XMPPacketOffset)
+{
+    openCheck();
+    XMPDataSource media;
+    media.openFile(mediaFileName, MetadataStream::ReadOnly);
+    std::string result = media.computeChecksum(XMPPacketSize, XMPPacketOffset);
+    media.closeFile();
+    return result;
+}
+
+std::string SidecarDataSource::computeChecksum(MetadataStream::ChecksumAlgorithm algorithm, unsigned int threads)
+{
+    openCheck();
+    XMPDataSource media;
+    media.openFile(mediaFileName, MetadataStream::ReadOnly);
+    std::string result = media.computeChecksum(algorithm, threads);
+    media.closeFile();
+    return result;
+}
+
+void SidecarDataSource::saveVideoSegments(const vector<shared_ptr<MetadataStream::VideoSegment>>& segments)
+{
+    writeCheck();
+    string text = segments.empty() ? string() : XMLWriter().store(segments);
+    if (text != segmentsRecord)
+        append(RECORD_SEGMENTS, text);
+}
+
+void SidecarDataSource::loadVideoSegments(vector<shared_ptr<MetadataStream::VideoSegment>>& segments)
+{
+    openCheck();
+    if (!segmentsRecord.empty() && !XMLReader().parseVideoSegments(segmentsRecord, segments))
+        VMF_EXCEPTION(DataStorageException, "Corrupted sidecar video segments record");
+}
+
+void SidecarDataSource::importEmbedded()
+{
+    MetadataStream stream;
+    XMPDataSource media;
+    media.openFile(mediaFileName, MetadataStream::ReadOnly);
+    media.load(schemas);
+    for (auto it = schemas.begin(); it != schemas.end(); ++it)
+    {
+        media.loadSchema(it->first, stream);
+        schemaRecords[it->first] = serializeSchema(it->second);
+    }
+    MetadataSet set = stream.getAll();
+    for (auto it = set.begin(); it != set.end(); ++it)
+    {
+        ItemRecord record;
+        record.schema = (*it)->getSchemaName();
+        record.text = serializeItem(**it);
+        items[(*it)->getId()] = record;
+    }
+    vector<shared_ptr<MetadataStream::VideoSegment> > segments;
+    media.loadVideoSegments(segments);
+    segmentsRecord = segments.empty() ? string() : XMLWriter().store(segments);
+    nextId = media.loadId();
+    checksum = media.loadChecksum();
+    media.closeFile();
+
+    if (openMode == MetadataStream::ReadWrite)
+        checkpoint();
+}
+
+void SidecarDataSource::exportEmbedded()
+{
+    MetadataStream stream;
+    for (auto it = schemas.begin(); it != schemas.end(); ++it)
+    {
+        shared_ptr<MetadataSchema> schema = it->second;
+        stream.addSchema(schema);
+    }
+    for (auto it = items.begin(); it != items.end(); ++it)
+    {
+        shared_ptr<MetadataInternal> md = parseItem(it->second.text, schemas);
+        stream.add(md);
+    }
+
+    XMPDataSource media;
+    media.openFile(mediaFileName, MetadataStream::ReadWrite);
+    media.beginTransaction();
+    media.clear();
+    for (auto it = schemas.begin(); it != schemas.end(); ++it)
+    {
+        media.saveSchema(it->first, stream);
+        media.save(it->second);
+    }
+    vector<shared_ptr<MetadataStream::VideoSegment> > segments;
+    if (!segmentsRecord.empty() && !XMLReader().parseVideoSegments(segmentsRecord, segments))
+        VMF_EXCEPTION(DataStorageException, "Corrupted sidecar video segments record");
+    media.saveVideoSegments(segments);
+    media.save(nextId);
+    if (!checksum.empty())
+        media.saveChecksum(checksum);
+    media.commitTransaction();
+    media.closeFile();
+}
+
+void SidecarDataSource::embed(const MetaString& mediaFileName)
+{
+    SidecarDataSource source(true);
+    source.openFile(mediaFileName, MetadataStream::ReadOnly);
+    source.exportEmbedded();
+    source.closeFile();
+}
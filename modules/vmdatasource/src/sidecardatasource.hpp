@@ -0,0 +1,166 @@
+/* 
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __SIDECARDATASOURCE_HPP__
+#define __SIDECARDATASOURCE_HPP__
+
+/*!
+* \file sidecardatasource.hpp
+* \brief %SidecarDataSource header file
+*/
+
+#include "datasource.hpp"
+
+#include <fstream>
+#include <map>
+
+namespace vmf
+{
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable: 4251)
+#endif
+
+/*!
+ * \brief Class implements IDataSource interface storing metadata in a sidecar file next to the media file.
+ * \details The sidecar file is an append-only log of records, every change of the stored state
+ * is appended as a separate record so a save costs a small sequential write.
+ * Records carry CRC32 checksums: a last record partially written by an interrupted save is dropped,
+ * any other damaged record fails the open.
+ * The log is periodically compacted into a checkpoint containing the current state only.
+ * In the embedding mode the final state is exported into the media file XMP packet on close.
+ */
+class VMF_EXPORT SidecarDataSource: public IDataSource {
+public:
+    /*!
+     * \brief Class constructor
+     * \param embed [in] export stored metadata into the media file on close and
+     * import the embedded metadata when the sidecar file doesn't exist yet
+     */
+    explicit SidecarDataSource(bool embed = false);
+
+    virtual ~SidecarDataSource();
+
+    virtual void openFile(const vmf::MetaString& fileName, vmf::MetadataStream::OpenMode mode);
+
+    virtual void closeFile();
+
+    virtual void loadSchema(const vmf::MetaString& schemaName, vmf::MetadataStream& stream);
+
+    virtual void loadProperty(const vmf::MetaString &schemaName, const vmf::MetaString &propertyName, MetadataStream &stream);
+
+    virtual void loadIndex(const vmf::MetaString& schemaName, std::vector<vmf::MetadataStream::IndexEntry>& index);
+
+    virtual void loadItems(const std::vector<vmf::IdType>& ids, vmf::MetadataStream& stream);
+
+    virtual std::shared_ptr<vmf::MetadataInternal> loadPayload(const vmf::IdType& id, const vmf::MetadataStream& stream);
+
+    virtual void saveSchema(const vmf::MetaString& schemaName, const vmf::MetadataStream& stream);
+
+    virtual void save(const std::shared_ptr<vmf::MetadataSchema>& schema);
+
+    virtual void remove(const std::vector<vmf::IdType>& ids);
+
+    virtual void load(std::map<MetaString, std::shared_ptr<vmf::MetadataSchema> >& schemas);
+
+    virtual void clear();
+
+    virtual void save(const vmf::IdType& id);
+
+    virtual vmf::IdType loadId();
+
+    virtual void removeSchema(const MetaString &schemaName);
+
+    virtual void saveChecksum(const MetaString& checksum);
+
+    virtual std::string loadChecksum();
+
+    virtual std::string computeChecksum(long long& XMPPacketSize, long long& XMPPacketOffset);
+
+    virtual std::string computeChecksum(vmf::MetadataStream::ChecksumAlgorithm algorithm, unsigned int threads);
+
+    virtual void saveVideoSegments(const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments);
+
+    virtual void loadVideoSegments(std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments);
+
+    /*!
+     * \brief Get path of the sidecar file that belongs to the media file
+     */
+    static std::string getSidecarPath(const vmf::MetaString& mediaFileName);
+
+    /*!
+     * \brief Embed metadata stored in the sidecar file into the media file
+     * \param mediaFileName [in] path to the media file
+     * \throws DataStorageException
+     */
+    static void embed(const vmf::MetaString& mediaFileName);
+
+protected:
+    struct ItemRecord
+    {
+        vmf::MetaString schema;
+        std::string text;
+    };
+
+    struct LoadContext
+    {
+        std::map<vmf::MetaString, std::shared_ptr<vmf::MetadataSchema> > schemas;
+    };
+
+    void replay();
+    void apply(const std::string& tag, const std::string& payload);
+    void append(const std::string& tag, const std::string& payload);
+    void checkpoint();
+    void flush();
+
+    void importEmbedded();
+    void exportEmbedded();
+
+    void prepareLoad(vmf::MetadataStream& stream, LoadContext& context);
+    void loadItem(const vmf::IdType& id, vmf::MetadataStream& stream, LoadContext& context);
+
+    void openCheck();
+    void writeCheck();
+
+private:
+    SidecarDataSource(const SidecarDataSource& origin);
+    SidecarDataSource& operator=(const SidecarDataSource& origin);
+
+    bool embedMode;
+    bool opened;
+    bool modified;
+    vmf::MetaString mediaFileName;
+    vmf::MetaString sidecarFileName;
+    vmf::MetadataStream::OpenMode openMode;
+    std::ofstream log;
+    size_t recordsSinceCheckpoint;
+
+    std::map<vmf::MetaString, std::shared_ptr<vmf::MetadataSchema> > schemas;
+    std::map<vmf::MetaString, std::string> schemaRecords;
+    std::map<vmf::IdType, ItemRecord> items;
+    std::string segmentsRecord;
+    vmf::IdType nextId;
+    std::string checksum;
+};
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+} // namespace vmf
+
+#endif // __SIDECARDATASOURCE_HPP__
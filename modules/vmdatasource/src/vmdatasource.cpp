@@ -21,6 +21,9 @@
 #include "datasourcefactory.hpp"
 #include "object_factory.hpp"
 #include "xmpdatasource.hpp"
+#include "sidecardatasource.hpp"
+#include "memorydatasource.hpp"
+#include "checksumengine.hpp"
 
 using namespace std;
 
@@ -30,14 +33,21 @@ namespace vmf
 class XMPDataSourceFactory: public IDataSourceFactory
 {
 public:
-    XMPDataSourceFactory()
+    XMPDataSourceFactory(StorageKind kind = StorageEmbedded)
+        : storageKind(kind)
     {
         XMPDataSource::initialize();
     }
 
     virtual shared_ptr<IDataSource> createDataSource()
     {
-        shared_ptr<IDataSource> ds = make_shared<XMPDataSource>();
+        shared_ptr<IDataSource> ds;
+        if (storageKind == StorageEmbedded)
+            ds = make_shared<XMPDataSource>();
+        else if (storageKind == StorageMemory)
+            ds = make_shared<MemoryDataSource>();
+        else
+            ds = make_shared<SidecarDataSource>(storageKind == StorageEmbeddedAndSidecar);
         return ds;
     }
 
@@ -45,6 +55,9 @@ public:
     {
         XMPDataSource::terminate();
     }
+
+private:
+    StorageKind storageKind;
 };
 
 void initialize()
@@ -53,6 +66,48 @@ void initialize()
     Initialize(dsf);
 }
 
+void initialize(StorageKind kind)
+{
+    shared_ptr<IDataSourceFactory> dsf(static_cast<IDataSourceFactory*>(new XMPDataSourceFactory(kind)));
+    Initialize(dsf);
+}
+
+std::string getSidecarPath(const std::string& mediaFilePath)
+{
+    return SidecarDataSource::getSidecarPath(mediaFilePath);
+}
+
+void embedSidecar(const std::string& mediaFilePath)
+{
+    SidecarDataSource::embed(mediaFilePath);
+}
+
+std::vector<std::string> getMemoryStorageCalls()
+{
+    return MemoryDataSource::getCalls();
+}
+
+void resetMemoryStorage()
+{
+    MemoryDataSource::reset();
+}
+
+void setMemoryStorageLatency(unsigned int microseconds)
+{
+    MemoryDataSource::setLatency(microseconds);
+}
+
+void injectMemoryStorageFault(const std::string& call, unsigned int skipCalls)
+{
+    MemoryDataSource::injectFault(call, skipCalls);
+}
+
+std::string computeFileChecksum(const std::string& filePath, MetadataStream::ChecksumAlgorithm algorithm,
+                                long long excludeOffset, long long excludeSize, unsigned int threads)
+{
+    return ChecksumEngine(filePath, excludeOffset, excludeSize).compute(algorithm, threads);
+}
+
 void terminate()
 {
     Uninitialize();
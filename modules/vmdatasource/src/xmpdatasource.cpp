@@ -21,8 +21,28 @@
 #include "xmpschemasource.hpp"
 #include "xmpmetadatasource.hpp"
 
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+#include <zlib.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
 #define VMF_GLOBAL_NEXT_ID "next-id"
 #define VMF_GLOBAL_CHECKSUM "media-checksum"
+#define VMF_GLOBAL_FINGERPRINT "media-fingerprint"
+#define VMF_FINGERPRINT_CHECKSUM "checksum"
+#define VMF_FINGERPRINT_MEDIA_SIZE "media-size"
+#define VMF_FINGERPRINT_PACKET_OFFSET "packet-offset"
+#define VMF_FINGERPRINT_PACKET_LENGTH "packet-length"
+#define VMF_FINGERPRINT_CHUNK_SIZE "chunk-size"
+#define VMF_FINGERPRINT_ROOT "root"
+#define VMF_FINGERPRINT_CHUNKS "chunks"
 
 #define VMF_INTERNAL "internal"
 #define VMF_VIDEO_SEGMENTS "video-segments"
@@ -33,6 +53,9 @@
 #define VMF_VIDEO_SEGMENT_RESOLUTION_W "resolution_width"
 #define VMF_VIDEO_SEGMENT_RESOLUTION_H "resolution_height"
 
+#define VMF_JOURNAL_EXTENSION ".vmf-journal"
+#define VMF_JOURNAL_SIGNATURE "VMF-JOURNAL 1"
+
 
 using namespace std;
 using namespace vmf;
@@ -83,9 +106,71 @@ void XMPDataSource::terminate()
 }
 
 XMPDataSource::XMPDataSource()
-  : IDataSource(), xmp(nullptr), metadataSource(nullptr)
+  : IDataSource(), xmp(nullptr), metadataSource(nullptr), inTransaction(false), modified(false)
+{
+
+}
+
+std::string XMPDataSource::getJournalPath(const MetaString& fileName)
+{
+    return fileName + VMF_JOURNAL_EXTENSION;
+}
+
+enum JournalState
+{
+    JournalMissing,
+    JournalIncomplete,
+    JournalComplete
+};
+
+static JournalState readJournal(const std::string& path, std::string& packet)
 {
+    std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+    if (!file.is_open())
+        return JournalMissing;
+
+    std::string signature;
+    unsigned long long size = 0;
+    unsigned long crc = 0;
+    if (!std::getline(file, signature) || signature != VMF_JOURNAL_SIGNATURE)
+        return JournalIncomplete;
+    if (!(file >> size >> crc) || file.get() != '\n')
+        return JournalIncomplete;
+
+    packet.resize((size_t)size);
+    if (size > 0 && !file.read(&packet[0], (std::streamsize)size))
+        return JournalIncomplete;
+
+    uLong actualCrc = crc32(0L, Z_NULL, 0);
+    actualCrc = crc32(actualCrc, (const Bytef*)packet.data(), (uInt)packet.size());
+    return actualCrc == crc ? JournalComplete : JournalIncomplete;
+}
 
+static void writeJournal(const std::string& path, const std::string& packet)
+{
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, (const Bytef*)packet.data(), (uInt)packet.size());
+    std::string header = std::string(VMF_JOURNAL_SIGNATURE) + "\n" +
+        to_string((unsigned long long)packet.size()) + " " + to_string((unsigned long)crc) + "\n";
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr)
+        VMF_EXCEPTION(DataStorageException, "Could not create journal file: " + path);
+
+    bool written = fwrite(header.data(), 1, header.size(), file) == header.size() &&
+        fwrite(packet.data(), 1, packet.size(), file) == packet.size() &&
+        fflush(file) == 0;
+#ifdef _WIN32
+    written = written && _commit(_fileno(file)) == 0;
+#else
+    written = written && fsync(fileno(file)) == 0;
+#endif
+    fclose(file);
+    if (!written)
+    {
+        std::remove(path.c_str());
+        VMF_EXCEPTION(DataStorageException, "Could not write journal file: " + path);
+    }
 }
 
 
@@ -96,27 +181,10 @@ void XMPDataSource::openFile(const MetaString& fileName, MetadataStream::OpenMod
         xmp = make_shared<SXMPMeta>();
         openMode = mode;
         metaFileName = fileName;
-        XMP_OptionBits modeFlags;
-        if (mode == MetadataStream::ReadWrite)
-        {
-            modeFlags = kXMPFiles_OpenForUpdate;
-        }
-        else
-        {
-            modeFlags = kXMPFiles_OpenForRead;
-        }
-        XMP_OptionBits opts = modeFlags | kXMPFiles_OpenUseSmartHandler;
-        bool opened = xmpFile.OpenFile(metaFileName, kXMP_UnknownFile, opts);
-        if (!opened)
-        {
-            opts = modeFlags | kXMPFiles_OpenUsePacketScanning;
-            opened = xmpFile.OpenFile(metaFileName, kXMP_UnknownFile, opts);
-            if (!opened)
-            {
-                VMF_EXCEPTION(DataStorageException, "Could not open XMP file.");
-            }
-        }
-        xmpFile.GetXMP(xmp.get());
+        openXMPFile();
+        // a torn packet in the file can't be parsed, so the journaled one is taken first
+        if (!recoverJournal())
+            xmpFile.GetXMP(xmp.get());
         schemaSource = make_shared<XMPSchemaSource>(xmp);
         metadataSource = make_shared<XMPMetadataSource>(xmp);
    }
@@ -132,6 +200,58 @@ void XMPDataSource::openFile(const MetaString& fileName, MetadataStream::OpenMod
 
 
 
+void XMPDataSource::openXMPFile()
+{
+    XMP_OptionBits modeFlags;
+    if (openMode == MetadataStream::ReadWrite)
+    {
+        modeFlags = kXMPFiles_OpenForUpdate;
+    }
+    else
+    {
+        modeFlags = kXMPFiles_OpenForRead;
+    }
+    XMP_OptionBits opts = modeFlags | kXMPFiles_OpenUseSmartHandler;
+    bool opened = xmpFile.OpenFile(metaFileName, kXMP_UnknownFile, opts);
+    if (!opened)
+    {
+        opts = modeFlags | kXMPFiles_OpenUsePacketScanning;
+        opened = xmpFile.OpenFile(metaFileName, kXMP_UnknownFile, opts);
+        if (!opened)
+        {
+            VMF_EXCEPTION(DataStorageException, "Could not open XMP file.");
+        }
+    }
+}
+
+bool XMPDataSource::recoverJournal()
+{
+    std::string journalPath = getJournalPath(metaFileName);
+    std::string packet;
+    JournalState state = readJournal(journalPath, packet);
+    if (state == JournalMissing)
+        return false;
+
+    if (state == JournalIncomplete)
+    {
+        // the media file was not touched yet, so the torn journal is just dropped
+        if (openMode == MetadataStream::ReadWrite)
+            std::remove(journalPath.c_str());
+        return false;
+    }
+
+    // the packet in the file isn't read, the journaled one replaces it
+    xmp = make_shared<SXMPMeta>(packet.c_str(), (XMP_StringLen)packet.size());
+    if (openMode == MetadataStream::ReadWrite)
+    {
+        xmpFile.PutXMP(*xmp);
+        xmpFile.CloseFile();
+        std::remove(journalPath.c_str());
+        openXMPFile();
+    }
+    return true;
+}
+
 void XMPDataSource::closeFile()
 {
     try
@@ -189,6 +309,57 @@ void XMPDataSource::loadProperty(const MetaString &schemaName, const MetaString
 }
 
 
+void XMPDataSource::loadIndex(const MetaString& schemaName, std::vector<MetadataStream::IndexEntry>& index)
+{
+    metadataSourceCheck();
+    try
+    {
+        metadataSource->loadIndex(schemaName, index);
+    }
+    catch(const XMP_Error& e)
+    {
+        VMF_EXCEPTION(DataStorageException, e.GetErrMsg());
+    }
+    catch(const std::exception& e)
+    {
+        VMF_EXCEPTION(DataStorageException, e.what());
+    }
+}
+
+void XMPDataSource::loadItems(const std::vector<IdType>& ids, MetadataStream& stream)
+{
+    metadataSourceCheck();
+    try
+    {
+        metadataSource->loadItems(ids, stream);
+    }
+    catch(const XMP_Error& e)
+    {
+        VMF_EXCEPTION(DataStorageException, e.GetErrMsg());
+    }
+    catch(const std::exception& e)
+    {
+        VMF_EXCEPTION(DataStorageException, e.what());
+    }
+}
+
+std::shared_ptr<MetadataInternal> XMPDataSource::loadPayload(const IdType& id, const MetadataStream& stream)
+{
+    metadataSourceCheck();
+    try
+    {
+        return metadataSource->loadPayload(id, stream);
+    }
+    catch(const XMP_Error& e)
+    {
+        VMF_EXCEPTION(DataStorageException, e.GetErrMsg());
+    }
+    catch(const std::exception& e)
+    {
+        VMF_EXCEPTION(DataStorageException, e.what());
+    }
+}
+
 void XMPDataSource::saveSchema(const MetaString& schemaName, const MetadataStream& stream)
 {
     metadataSourceCheck();
@@ -237,9 +408,7 @@ void XMPDataSource::remove(const vector<IdType>& ids)
     try
     {
         metadataSource->remove(ids);
-        xmpFile.PutXMP(*xmp);
-        closeFile();
-        openFile(this->metaFileName, this->openMode);
+        pushChanges();
     }
     catch(const XMP_Error& e)
     {
@@ -308,9 +477,72 @@ void XMPDataSource::save(const IdType &id)
 
 void XMPDataSource::pushChanges()
 {
+    if (inTransaction)
+    {
+        // the file is updated once on commit, the metadata source keeps its structure index up to date itself
+        modified = true;
+        return;
+    }
     xmpFile.PutXMP(*xmp);
     closeFile();
     openFile(this->metaFileName, this->openMode);
+    refreshFingerprint();
+}
+
+void XMPDataSource::beginTransaction()
+{
+    inTransaction = true;
+    modified = false;
+}
+
+void XMPDataSource::commitTransaction()
+{
+    inTransaction = false;
+    if (!modified)
+        return;
+    modified = false;
+    try
+    {
+        std::string journalPath = getJournalPath(metaFileName);
+        std::string packet;
+        xmp->SerializeToBuffer(&packet, kXMP_OmitPacketWrapper);
+        writeJournal(journalPath, packet);
+        xmpFile.PutXMP(*xmp);
+        closeFile();
+        std::remove(journalPath.c_str());
+        openFile(metaFileName, openMode);
+        refreshFingerprint();
+    }
+    catch(const XMP_Error& e)
+    {
+        VMF_EXCEPTION(DataStorageException, e.GetErrMsg());
+    }
+    catch(const std::exception& e)
+    {
+        VMF_EXCEPTION(DataStorageException, e.what());
+    }
+}
+
+void XMPDataSource::rollbackTransaction()
+{
+    inTransaction = false;
+    pendingFingerprint = ChecksumFingerprint();
+    if (!modified)
+        return;
+    modified = false;
+    try
+    {
+        closeFile();
+        openFile(metaFileName, openMode);
+    }
+    catch(const XMP_Error& e)
+    {
+        VMF_EXCEPTION(DataStorageException, e.GetErrMsg());
+    }
+    catch(const std::exception& e)
+    {
+        VMF_EXCEPTION(DataStorageException, e.what());
+    }
 }
 
 void XMPDataSource::metadataSourceCheck()
@@ -332,6 +564,7 @@ void XMPDataSource::schemaSourceCheck()
 void XMPDataSource::removeSchema(const MetaString &schemaName)
 {
     schemaSource->remove(schemaName);
+    metadataSource->invalidateIndex();
     pushChanges();
 }
 
@@ -358,6 +591,145 @@ std::string XMPDataSource::computeChecksum(long long& XMPPacketSize, long long&
     }
 }
 
+ChecksumEngine XMPDataSource::getChecksumEngine(ChecksumFingerprint& state)
+{
+    XMP_PacketInfo packet;
+    try
+    {
+        xmpFile.GetXMP(0, 0, &packet);
+    }
+    catch(const XMP_Error& e)
+    {
+        VMF_EXCEPTION(DataStorageException, e.GetErrMsg());
+    }
+
+    // skip the same region as XMPFiles::ComputeChecksum: the packet and 24 bytes of its header
+    long long excludeOffset = 0, excludeSize = 0;
+    if (packet.length > 0)
+    {
+        excludeOffset = packet.offset - 24;
+        excludeSize = packet.length + 24;
+    }
+    state.modified = ChecksumEngine::getModificationTime(metaFileName);
+    ChecksumEngine engine(metaFileName, excludeOffset, excludeSize);
+    state.mediaSize = engine.getMediaSize();
+    state.packetOffset = packet.length > 0 ? packet.offset : 0;
+    state.packetLength = packet.length > 0 ? packet.length : 0;
+    return engine;
+}
+
+std::string XMPDataSource::computeChecksum(MetadataStream::ChecksumAlgorithm algorithm, unsigned int threads)
+{
+    ChecksumFingerprint state;
+    ChecksumEngine engine = getChecksumEngine(state);
+    std::vector<uint64_t> chunks;
+    std::string checksum = engine.compute(algorithm, threads, &chunks);
+
+    // the state can be cached only if the file wasn't changed while it was hashed
+    if (ChecksumEngine::getModificationTime(metaFileName) == state.modified)
+    {
+        state.checksum = checksum;
+        state.chunks.swap(chunks);
+        computedFingerprint = state;
+    }
+    return checksum;
+}
+
+bool XMPDataSource::verifyChecksum(const std::string& checksum, unsigned int threads)
+{
+    ChecksumFingerprint state;
+    ChecksumEngine engine = getChecksumEngine(state);
+    ChecksumFingerprint fingerprints[] = { computedFingerprint, loadFingerprint() };
+    for (auto& fingerprint : fingerprints)
+    {
+        if (!fingerprint.isValid() || fingerprint.checksum != checksum)
+            continue;
+        if (fingerprint.sameState(state))
+            return true;
+        // chunks are hashed in parallel and much faster than MD5
+        if (fingerprint.mediaSize == state.mediaSize && fingerprint.chunks.size() == engine.getChunkCount())
+            return engine.computeChunks(0, engine.getChunkCount(), threads) == fingerprint.chunks;
+    }
+    return IDataSource::verifyChecksum(checksum, threads);
+}
+
+ChecksumFingerprint XMPDataSource::loadFingerprint()
+{
+    ChecksumFingerprint fingerprint;
+    if (!xmp->DoesPropertyExist(VMF_NS, VMF_GLOBAL_FINGERPRINT))
+        return fingerprint;
+
+    MetaString path, chunks, root;
+    long long chunkSize = 0;
+    SXMPUtils::ComposeStructFieldPath(VMF_NS, VMF_GLOBAL_FINGERPRINT, VMF_NS, VMF_FINGERPRINT_CHECKSUM, &path);
+    xmp->GetProperty(VMF_NS, path.c_str(), &fingerprint.checksum, nullptr);
+    SXMPUtils::ComposeStructFieldPath(VMF_NS, VMF_GLOBAL_FINGERPRINT, VMF_NS, VMF_FINGERPRINT_MEDIA_SIZE, &path);
+    xmp->GetProperty_Int64(VMF_NS, path.c_str(), &fingerprint.mediaSize, nullptr);
+    SXMPUtils::ComposeStructFieldPath(VMF_NS, VMF_GLOBAL_FINGERPRINT, VMF_NS, VMF_FINGERPRINT_PACKET_OFFSET, &path);
+    xmp->GetProperty_Int64(VMF_NS, path.c_str(), &fingerprint.packetOffset, nullptr);
+    SXMPUtils::ComposeStructFieldPath(VMF_NS, VMF_GLOBAL_FINGERPRINT, VMF_NS, VMF_FINGERPRINT_PACKET_LENGTH, &path);
+    xmp->GetProperty_Int64(VMF_NS, path.c_str(), &fingerprint.packetLength, nullptr);
+    SXMPUtils::ComposeStructFieldPath(VMF_NS, VMF_GLOBAL_FINGERPRINT, VMF_NS, VMF_FINGERPRINT_CHUNK_SIZE, &path);
+    xmp->GetProperty_Int64(VMF_NS, path.c_str(), &chunkSize, nullptr);
+    SXMPUtils::ComposeStructFieldPath(VMF_NS, VMF_GLOBAL_FINGERPRINT, VMF_NS, VMF_FINGERPRINT_ROOT, &path);
+    xmp->GetProperty(VMF_NS, path.c_str(), &root, nullptr);
+    SXMPUtils::ComposeStructFieldPath(VMF_NS, VMF_GLOBAL_FINGERPRINT, VMF_NS, VMF_FINGERPRINT_CHUNKS, &path);
+    xmp->GetProperty(VMF_NS, path.c_str(), &chunks, nullptr);
+
+    // the manifest is used only if chunks have the same size and match the root digest
+    if (chunkSize != ChecksumEngine::CHUNK_SIZE || chunks.size() % 16 != 0)
+        return fingerprint;
+    for (size_t i = 0; i < chunks.size(); i += 16)
+        fingerprint.chunks.push_back(std::strtoull(chunks.substr(i, 16).c_str(), nullptr, 16));
+    if (root != ChecksumEngine::combineChunks(fingerprint.chunks, fingerprint.mediaSize))
+        fingerprint.chunks.clear();
+    return fingerprint;
+}
+
+void XMPDataSource::saveFingerprint(const ChecksumFingerprint& fingerprint)
+{
+    static const char hexDigits[] = "0123456789ABCDEF";
+    std::string chunks(fingerprint.chunks.size() * 16, '0');
+    for (size_t i = 0; i < fingerprint.chunks.size(); i++)
+        for (int j = 0; j < 16; j++)
+            chunks[i * 16 + j] = hexDigits[(fingerprint.chunks[i] >> (60 - 4 * j)) & 0xF];
+
+    xmp->DeleteProperty(VMF_NS, VMF_GLOBAL_FINGERPRINT);
+    MetaString path;
+    SXMPUtils::ComposeStructFieldPath(VMF_NS, VMF_GLOBAL_FINGERPRINT, VMF_NS, VMF_FINGERPRINT_CHECKSUM, &path);
+    xmp->SetProperty(VMF_NS, path.c_str(), fingerprint.checksum.c_str());
+    SXMPUtils::ComposeStructFieldPath(VMF_NS, VMF_GLOBAL_FINGERPRINT, VMF_NS, VMF_FINGERPRINT_MEDIA_SIZE, &path);
+    xmp->SetProperty_Int64(VMF_NS, path.c_str(), fingerprint.mediaSize);
+    SXMPUtils::ComposeStructFieldPath(VMF_NS, VMF_GLOBAL_FINGERPRINT, VMF_NS, VMF_FINGERPRINT_PACKET_OFFSET, &path);
+    xmp->SetProperty_Int64(VMF_NS, path.c_str(), fingerprint.packetOffset);
+    SXMPUtils::ComposeStructFieldPath(VMF_NS, VMF_GLOBAL_FINGERPRINT, VMF_NS, VMF_FINGERPRINT_PACKET_LENGTH, &path);
+    xmp->SetProperty_Int64(VMF_NS, path.c_str(), fingerprint.packetLength);
+    if (fingerprint.chunks.empty())
+        return;
+    SXMPUtils::ComposeStructFieldPath(VMF_NS, VMF_GLOBAL_FINGERPRINT, VMF_NS, VMF_FINGERPRINT_CHUNK_SIZE, &path);
+    xmp->SetProperty_Int64(VMF_NS, path.c_str(), ChecksumEngine::CHUNK_SIZE);
+    SXMPUtils::ComposeStructFieldPath(VMF_NS, VMF_GLOBAL_FINGERPRINT, VMF_NS, VMF_FINGERPRINT_ROOT, &path);
+    xmp->SetProperty(VMF_NS, path.c_str(), ChecksumEngine::combineChunks(fingerprint.chunks, fingerprint.mediaSize).c_str());
+    SXMPUtils::ComposeStructFieldPath(VMF_NS, VMF_GLOBAL_FINGERPRINT, VMF_NS, VMF_FINGERPRINT_CHUNKS, &path);
+    xmp->SetProperty(VMF_NS, path.c_str(), chunks.c_str());
+}
+
+void XMPDataSource::refreshFingerprint()
+{
+    ChecksumFingerprint written = pendingFingerprint;
+    pendingFingerprint = ChecksumFingerprint();
+    if (!written.isValid())
+        return;
+
+    // writing the packet changes modification time of the file, the cached state takes the new time
+    // if the packet wasn't moved; otherwise verification compares digests of chunks
+    ChecksumFingerprint state;
+    getChecksumEngine(state);
+    written.modified = state.modified;
+    if (written.sameState(state))
+        computedFingerprint = written;
+}
+
 std::string XMPDataSource::loadChecksum()
 {
     std::string checksum;
@@ -367,11 +739,97 @@ std::string XMPDataSource::loadChecksum()
 }
 
 void XMPDataSource::saveChecksum(const MetaString& checksum)
+{
+    saveChecksum(checksum, true);
+}
+
+void XMPDataSource::saveChecksum(const MetaString& checksum, bool manifest)
 {
     xmp->SetProperty(VMF_NS, VMF_GLOBAL_CHECKSUM, checksum.c_str());
+
+    // prefer the fingerprint describing current state of the media data
+    ChecksumFingerprint state;
+    getChecksumEngine(state);
+    ChecksumFingerprint candidates[] = { computedFingerprint, loadFingerprint() };
+    ChecksumFingerprint fingerprint;
+    for (auto& candidate : candidates)
+    {
+        if (candidate.isValid() && candidate.checksum == checksum &&
+            (!fingerprint.isValid() || (!fingerprint.sameState(state) && candidate.sameState(state))))
+        {
+            fingerprint = candidate;
+        }
+    }
+    pendingFingerprint = ChecksumFingerprint();
+
+    if (fingerprint.isValid())
+    {
+        if (!manifest)
+            fingerprint.chunks.clear();
+        // otherwise the media data was changed after hashing, the stale state is kept for the manifest
+        if (fingerprint.sameState(state))
+            pendingFingerprint = fingerprint;
+        saveFingerprint(fingerprint);
+    }
+    else
+        xmp->DeleteProperty(VMF_NS, VMF_GLOBAL_FINGERPRINT);
     pushChanges();
 }
 
+bool XMPDataSource::loadChecksumManifest(const std::string& checksum, size_t& chunkCount, long long& chunkSize)
+{
+    ChecksumFingerprint manifest = loadFingerprint();
+    chunkCount = 0;
+    chunkSize = 0;
+    if (manifest.checksum != checksum || manifest.chunks.empty())
+        return false;
+    chunkCount = manifest.chunks.size();
+    chunkSize = ChecksumEngine::CHUNK_SIZE;
+    return true;
+}
+
+size_t XMPDataSource::verifyChecksumChunks(const std::string& checksum, size_t first, size_t count, unsigned int threads,
+                                          std::vector<size_t>& corruptChunks, const std::function<bool(size_t)>& progress)
+{
+    ChecksumFingerprint manifest = loadFingerprint();
+    if (manifest.checksum != checksum || manifest.chunks.empty())
+        VMF_EXCEPTION(DataStorageException, "There is no checksum manifest for the digest");
+    if (first > manifest.chunks.size() || count > manifest.chunks.size() - first)
+        VMF_EXCEPTION(OutOfRangeException, "Chunks are out of the checksum manifest");
+
+    // a batch is small enough to report progress often and large enough to keep all threads busy
+    const size_t batchSize = 4 * std::max(1u, threads ? threads : std::thread::hardware_concurrency());
+    const size_t end = first + count;
+
+    ChecksumFingerprint state;
+    ChecksumEngine engine = getChecksumEngine(state);
+    size_t available = engine.getChunkCount();
+    size_t readableEnd = std::min(end, std::max(first, available));
+    bool proceed = true;
+    size_t next = engine.computeChunks(first, readableEnd - first, threads, batchSize,
+        [&](size_t batchFirst, const std::vector<uint64_t>& chunks)
+    {
+        for (size_t i = 0; i < chunks.size(); i++)
+        {
+            if (chunks[i] != manifest.chunks[batchFirst + i])
+                corruptChunks.push_back(batchFirst + i);
+        }
+        size_t batchEnd = batchFirst + chunks.size();
+        proceed = batchEnd >= end || !progress || progress(batchEnd);
+        return proceed;
+    });
+
+    // chunks missing from truncated media data are corrupt as well
+    while (proceed && next < end)
+    {
+        size_t batchEnd = std::min(end, next + batchSize);
+        for (; next < batchEnd; next++)
+            corruptChunks.push_back(next);
+        proceed = next >= end || !progress || progress(next);
+    }
+    return next;
+}
+
 void XMPDataSource::saveVideoSegments(const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments)
 {
     xmp->DeleteProperty(VMF_NS, VMF_INTERNAL);
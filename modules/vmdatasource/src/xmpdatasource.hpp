@@ -23,6 +23,7 @@
 */
 
 #include "datasource.hpp"
+#include "checksumengine.hpp"
 
 #include "vmf/metadataschema.hpp"
 
@@ -59,6 +60,12 @@ public:
 
     virtual void loadProperty(const vmf::MetaString &schemaName, const vmf::MetaString &propertyName, MetadataStream &stream);
 
+    virtual void loadIndex(const vmf::MetaString& schemaName, std::vector<vmf::MetadataStream::IndexEntry>& index);
+
+    virtual void loadItems(const std::vector<vmf::IdType>& ids, vmf::MetadataStream& stream);
+
+    virtual std::shared_ptr<vmf::MetadataInternal> loadPayload(const vmf::IdType& id, const vmf::MetadataStream& stream);
+
     virtual void saveSchema(const vmf::MetaString& schemaName, const vmf::MetadataStream& stream);
 
     virtual void save(const std::shared_ptr<vmf::MetadataSchema>& schema);
@@ -77,14 +84,36 @@ public:
 
     virtual void saveChecksum(const MetaString& checksum);
 
+    virtual void saveChecksum(const MetaString& checksum, bool manifest);
+
+    virtual bool loadChecksumManifest(const std::string& checksum, size_t& chunkCount, long long& chunkSize);
+
+    virtual size_t verifyChecksumChunks(const std::string& checksum, size_t first, size_t count, unsigned int threads,
+                                        std::vector<size_t>& corruptChunks, const std::function<bool(size_t)>& progress);
+
     virtual std::string loadChecksum();
 
     virtual std::string computeChecksum(long long& XMPPacketSize, long long& XMPPacketOffset);
 
+    virtual std::string computeChecksum(vmf::MetadataStream::ChecksumAlgorithm algorithm, unsigned int threads);
+
+    virtual bool verifyChecksum(const std::string& checksum, unsigned int threads);
+
     virtual void saveVideoSegments(const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments);
 
     virtual void loadVideoSegments(std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments);
 
+    virtual void beginTransaction();
+
+    virtual void commitTransaction();
+
+    virtual void rollbackTransaction();
+
+    /*!
+     * \brief Get path of the journal file used to store changes of the media file atomically
+     */
+    static std::string getJournalPath(const vmf::MetaString& fileName);
+
     /*!
      * \brief Initializes XMPDataSource class dependecies
      * \throws DataStorageException
@@ -104,6 +133,19 @@ protected:
 
     virtual void metadataSourceCheck();
 
+    void openXMPFile();
+
+    // Returns true if the packet is taken from a complete journal
+    bool recoverJournal();
+
+    ChecksumEngine getChecksumEngine(ChecksumFingerprint& state);
+
+    ChecksumFingerprint loadFingerprint();
+
+    void saveFingerprint(const ChecksumFingerprint& fingerprint);
+
+    void refreshFingerprint();
+
 private:
 
     SXMPFiles xmpFile;
@@ -112,6 +154,10 @@ private:
     std::shared_ptr<XMPSchemaSource> schemaSource;
     vmf::MetaString metaFileName;
     vmf::MetadataStream::OpenMode openMode;
+    bool inTransaction;
+    bool modified;
+    ChecksumFingerprint computedFingerprint;
+    ChecksumFingerprint pendingFingerprint;
 };
 
 #ifdef _MSC_VER
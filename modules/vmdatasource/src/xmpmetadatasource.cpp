@@ -18,6 +18,13 @@
 
 #include "vmf/metadatastream.hpp"
 
+#include <zlib.h>
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+
 #define VMF_GLOBAL_SCHEMAS_ARRAY "metadata"
 
 #define SCHEMA_NAME "schema"
@@ -37,6 +44,10 @@
 #define FIELD_TYPE "type"
 #define FIELD_VALUE "value"
 #define FIELD_NAME "name"
+#define FIELD_COMPRESSION "compression"
+#define FIELD_LENGTH "length"
+
+#define COMPRESSION_ZLIB "zlib"
 
 #define REF_NAME "name"
 #define REF_SCHEMA "schema"
@@ -66,24 +77,68 @@ public:
     using MetadataStream::internalAdd;
 };
 
+// decoding of few items isn't worth starting a thread
+static const size_t MIN_ITEMS_PER_THREAD = 64;
+
+static unsigned int resolveThreads(unsigned int threads, size_t tasks)
+{
+    if (threads == 0)
+        threads = max(1u, thread::hardware_concurrency());
+    return (unsigned int) max<size_t>(1, min<size_t>(threads, tasks));
+}
+
+static vmf_rawbuffer compressValue(const vmf_rawbuffer& value, int level)
+{
+    uLongf size = compressBound((uLong) value.size());
+    vmf_rawbuffer compressed((size_t) size);
+    if (compress2((Bytef*) compressed.data(), &size, (const Bytef*) value.data(), (uLong) value.size(), level) != Z_OK)
+    {
+        VMF_EXCEPTION(DataStorageException, "Can't compress field value");
+    }
+    compressed.resize((size_t) size);
+    return compressed;
+}
+
+// deflate can't expand data more than about 1032 times, see zlib FAQ
+static const vmf_integer MAX_COMPRESSION_RATIO = 1032;
+
+static vmf_rawbuffer uncompressValue(const vmf_rawbuffer& compressed, vmf_integer storedLength)
+{
+    // the length is read from the file, so it's checked before the buffer is allocated
+    if (storedLength < 0 || (vmf_integer) compressed.size() < (storedLength + MAX_COMPRESSION_RATIO - 1) / MAX_COMPRESSION_RATIO)
+    {
+        VMF_EXCEPTION(DataStorageException, "Invalid length of compressed field value");
+    }
+    size_t length = (size_t) storedLength;
+    uLongf size = (uLongf) length;
+    vmf_rawbuffer value(length);
+    if (uncompress((Bytef*) value.data(), &size, (const Bytef*) compressed.data(), (uLong) compressed.size()) != Z_OK || size != length)
+    {
+        VMF_EXCEPTION(DataStorageException, "Can't uncompress field value");
+    }
+    return value;
+}
+
 XMPMetadataSource::XMPMetadataSource(const std::shared_ptr<SXMPMeta>& meta)
-  : xmp(meta)
+  : xmp(meta), indexed(false), compressionThreshold(0), compressionLevel(Z_DEFAULT_COMPRESSION)
 {
-    loadIds();
 }
 
 void XMPMetadataSource::saveSchema(const MetaString& schemaName, const MetadataStream& stream)
 {
     shared_ptr<MetadataSchema> thisSchemaDescription = stream.getSchema(schemaName);
+    compressionThreshold = stream.getCompressionThreshold();
+    compressionLevel = stream.getCompressionLevel();
+    buildIndex();
 
     MetaString thisSchemaPath = findSchema(schemaName);
 
     if (thisSchemaPath.empty())
     {
-        xmp->AppendArrayItem(VMF_NS, VMF_GLOBAL_SCHEMAS_ARRAY, kXMP_PropValueIsArray, NULL, kXMP_PropValueIsStruct);
-        SXMPUtils::ComposeArrayItemPath(VMF_NS, VMF_GLOBAL_SCHEMAS_ARRAY, kXMP_ArrayLastItem, &thisSchemaPath);
+        thisSchemaPath = appendStruct(VMF_GLOBAL_SCHEMAS_ARRAY);
         xmp->SetStructField(VMF_NS, thisSchemaPath.c_str(), VMF_NS, SCHEMA_NAME, schemaName);
         xmp->SetStructField(VMF_NS, thisSchemaPath.c_str(), VMF_NS, SCHEMA_SET, nullptr, kXMP_PropValueIsArray);
+        schemaMap[schemaName].path = thisSchemaPath;
     }
 
     MetadataSet thisSchemaSet = stream.queryBySchema(schemaName);
@@ -92,11 +147,11 @@ void XMPMetadataSource::saveSchema(const MetaString& schemaName, const MetadataS
     {
         MetaString metadataName = (*descIter)->getMetadataName();
         MetadataSet currentPropertySet(thisSchemaSet.queryByName(metadataName));
-        saveProperty(currentPropertySet, thisSchemaPath, metadataName);
+        saveProperty(currentPropertySet, schemaName, thisSchemaPath, metadataName);
     }
 }
 
-void XMPMetadataSource::saveProperty(const MetadataSet& property, const MetaString& pathToSchema, const MetaString& propertyName)
+void XMPMetadataSource::saveProperty(const MetadataSet& property, const MetaString& schemaName, const MetaString& pathToSchema, const MetaString& propertyName)
 {
     if (property.empty())
     {
@@ -107,26 +162,37 @@ void XMPMetadataSource::saveProperty(const MetadataSet& property, const MetaStri
     MetaString pathToPropertiesArray;
     SXMPUtils::ComposeStructFieldPath(VMF_NS, pathToSchema.c_str(), VMF_NS, SCHEMA_SET, &pathToPropertiesArray);
 
-    MetaString thisPropertyPath = findProperty(pathToSchema, propertyName);
-    if (thisPropertyPath.empty())
+    PropertyEntry* entry = findPropertyEntry(schemaName, propertyName);
+    if (!entry)
     {
-        xmp->AppendArrayItem(VMF_NS, pathToPropertiesArray.c_str(), kXMP_PropValueIsArray, nullptr, kXMP_PropValueIsStruct);
-        SXMPUtils::ComposeArrayItemPath(VMF_NS, pathToPropertiesArray.c_str(), kXMP_ArrayLastItem, &thisPropertyPath);
+        std::vector<PropertyEntry>& properties = schemaMap[schemaName].properties;
+        properties.push_back(PropertyEntry());
+        entry = &properties.back();
+        entry->name = propertyName;
+        entry->path = appendStruct(pathToPropertiesArray);
     }
+    MetaString thisPropertyPath = entry->path;
 
     savePropertyName(thisPropertyPath, propertyName);
-    xmp->SetStructField(VMF_NS, thisPropertyPath.c_str(), VMF_NS, PROPERTY_SET, nullptr, kXMP_PropValueIsArray);
     MetaString thisPropertySetPath;
     SXMPUtils::ComposeStructFieldPath(VMF_NS, thisPropertyPath.c_str(), VMF_NS, PROPERTY_SET, &thisPropertySetPath);
+    // stored items are updated in place, the property may be loaded partially by MetadataStream::loadByFrameIndex()
+    if (!xmp->DoesPropertyExist(VMF_NS, thisPropertySetPath.c_str()))
+    {
+        xmp->SetStructField(VMF_NS, thisPropertyPath.c_str(), VMF_NS, PROPERTY_SET, nullptr, kXMP_PropValueIsArray);
+    }
 
     for(auto metadata = property.begin(); metadata != property.end(); ++metadata)
     {
-        saveMetadata(*metadata, thisPropertySetPath);
+        // evicted items are unchanged since they were loaded
+        if (!(*metadata)->isEvicted())
+            saveMetadata(*metadata, thisPropertySetPath, schemaName, *entry);
     }
 }
 
 
-void XMPMetadataSource::saveMetadata(const shared_ptr<Metadata>& md, const MetaString& thisPropertySetPath)
+void XMPMetadataSource::saveMetadata(const shared_ptr<Metadata>& md, const MetaString& thisPropertySetPath,
+                                     const MetaString& schemaName, PropertyEntry& property)
 {
     if (md == nullptr)
         VMF_EXCEPTION(DataStorageException, "Trying to save nullptr metadata");
@@ -136,8 +202,13 @@ void XMPMetadataSource::saveMetadata(const shared_ptr<Metadata>& md, const MetaS
     auto it = idMap.find(md->getId());
     if (it == idMap.end())
     {
-        xmp->AppendArrayItem(VMF_NS, thisPropertySetPath.c_str(), kXMP_PropValueIsArray, nullptr, kXMP_PropValueIsStruct);
-        SXMPUtils::ComposeArrayItemPath(VMF_NS, thisPropertySetPath.c_str(), kXMP_ArrayLastItem, &pathToMetadata);
+        pathToMetadata = appendStruct(thisPropertySetPath);
+        InternalPath path;
+        path.schema = schemaName;
+        path.metadata = property.name;
+        path.path = pathToMetadata;
+        idMap[md->getId()] = path;
+        property.items.push_back(md->getId());
     }
     else
     {
@@ -156,82 +227,180 @@ void XMPMetadataSource::saveMetadata(const shared_ptr<Metadata>& md, const MetaS
 void XMPMetadataSource::saveField(const MetaString& fieldName, const Variant& _value, const MetaString& fieldsPath)
 {
     std::string value = _value.toString();
+    size_t length = 0;
+    if (compressionThreshold > 0 && value.size() >= compressionThreshold)
+    {
+        // raw buffers are compressed as is, not in base64 form
+        vmf_rawbuffer rawValue = (_value.getType() == Variant::type_rawbuffer) ?
+            _value.get_rawbuffer() : vmf_rawbuffer(value.c_str(), value.size());
+        std::string compressedValue = Variant::base64encode(compressValue(rawValue, compressionLevel));
+        if (compressedValue.size() < value.size())
+        {
+            value = compressedValue;
+            length = rawValue.size();
+        }
+    }
     if(value.empty())
         value = " ";
     xmp->AppendArrayItem(VMF_NS, fieldsPath.c_str(), kXMP_PropValueIsArray, value, kXMP_NoOptions);
+    MetaString thisFieldPath;
+    SXMPUtils::ComposeArrayItemPath(VMF_NS, fieldsPath.c_str(), kXMP_ArrayLastItem, &thisFieldPath);
     if (!fieldName.empty())
     {
-        MetaString thisFieldPath;
-        SXMPUtils::ComposeArrayItemPath(VMF_NS, fieldsPath.c_str(), kXMP_ArrayLastItem, &thisFieldPath);
         xmp->SetQualifier(VMF_NS, thisFieldPath.c_str(), VMF_NS, FIELD_NAME, fieldName.c_str(), kXMP_NoOptions);
     }
+    if (length > 0)
+    {
+        xmp->SetQualifier(VMF_NS, thisFieldPath.c_str(), VMF_NS, FIELD_COMPRESSION, COMPRESSION_ZLIB, kXMP_NoOptions);
+        xmp->SetQualifier(VMF_NS, thisFieldPath.c_str(), VMF_NS, FIELD_LENGTH, vmf::toString(length).c_str(), kXMP_NoOptions);
+    }
 }
 
 void XMPMetadataSource::loadSchema(const MetaString &schemaName, MetadataStream &stream)
 {
-    MetaString schemaPath = findSchema(schemaName);
-    if (schemaPath.empty())
+    buildIndex();
+    auto schema = schemaMap.find(schemaName);
+    if (schema == schemaMap.end())
     {
         VMF_EXCEPTION(DataStorageException, "Schema " + schemaName + " not found");
     }
 
-    MetaString pathToProperties;
-    SXMPUtils::ComposeStructFieldPath(VMF_NS, schemaPath.c_str(), VMF_NS, SCHEMA_SET, &pathToProperties);
-    SXMPIterator propIterator(*xmp, VMF_NS, pathToProperties.c_str(), kXMP_IterJustChildren);
-    MetaString currentPropertyPath;
-    while(propIterator.Next(NULL, &currentPropertyPath))
+    vector<StagedItem> items;
+    for (auto property = schema->second.properties.begin(); property != schema->second.properties.end(); ++property)
     {
-        loadPropertyByPath(currentPropertyPath, schemaName, stream);
+        stageProperty(*property, schemaName, stream, items);
     }
+    decodeItems(items, stream.getLoadThreads());
+    publishItems(items, stream);
 }
 
 void XMPMetadataSource::loadProperty(const MetaString& schemaName, const MetaString& metadataName, MetadataStream& stream)
 {
-    MetaString pathToSchema = findSchema(schemaName);
-    MetaString pathToProperty = findProperty(pathToSchema, metadataName);
-    loadPropertyByPath(pathToProperty, schemaName, stream);
+    buildIndex();
+    const PropertyEntry* property = findPropertyEntry(schemaName, metadataName);
+    if (!property)
+    {
+        VMF_EXCEPTION(DataStorageException, "Property " + metadataName + " of schema " + schemaName + " not found");
+    }
+    vector<StagedItem> items;
+    stageProperty(*property, schemaName, stream, items);
+    decodeItems(items, stream.getLoadThreads());
+    publishItems(items, stream);
 }
 
-void XMPMetadataSource::loadSchemaName(const MetaString &pathToSchema, MetaString& schemaName)
+void XMPMetadataSource::loadIndex(const MetaString& schemaName, vector<MetadataStream::IndexEntry>& index)
 {
-    if (!xmp->GetStructField(VMF_NS, pathToSchema.c_str(), VMF_NS, SCHEMA_NAME, &schemaName, nullptr))
+    buildIndex();
+    auto schema = schemaMap.find(schemaName);
+    if (schema == schemaMap.end())
     {
-        VMF_EXCEPTION(DataStorageException, "Broken schema by path " + pathToSchema);
+        VMF_EXCEPTION(DataStorageException, "Schema " + schemaName + " not found");
+    }
+
+    for (auto property = schema->second.properties.begin(); property != schema->second.properties.end(); ++property)
+    {
+        for (auto id = property->items.begin(); id != property->items.end(); ++id)
+        {
+            // fields and references are skipped
+            const MetaString& pathToCurrentMetadata = idMap[*id].path;
+            MetadataStream::IndexEntry entry;
+            entry.id = *id;
+            entry.schema = schemaName;
+            entry.name = property->name;
+            loadMetadataFrameIndex(pathToCurrentMetadata, entry.frameIndex);
+            loadMetadataNumOfFrames(pathToCurrentMetadata, entry.numOfFrames);
+            loadMetadataTime(pathToCurrentMetadata, entry.time);
+            loadMetadataDuration(pathToCurrentMetadata, entry.duration);
+            index.push_back(entry);
+        }
     }
 }
 
-void XMPMetadataSource::loadPropertyByPath(const MetaString& pathToProperty, const MetaString& schemaName, MetadataStream& stream)
+void XMPMetadataSource::loadItems(const vector<IdType>& ids, MetadataStream& stream)
 {
-    shared_ptr<MetadataSchema> schema(stream.getSchema(schemaName));
-    MetaString metadataName;
-    loadPropertyName(pathToProperty, metadataName);
-    MetaString pathToMetadataSet;
-    SXMPUtils::ComposeStructFieldPath(VMF_NS, pathToProperty.c_str(), VMF_NS, PROPERTY_SET, &pathToMetadataSet);
+    buildIndex();
+    vector<StagedItem> items;
+    set<IdType> staged;
+    for (auto id = ids.begin(); id != ids.end(); ++id)
+    {
+        auto it = idMap.find(*id);
+        if (it == idMap.end())
+        {
+            VMF_EXCEPTION(DataStorageException, "Undefined metadata with id " + to_string(*id));
+        }
+        std::shared_ptr<MetadataSchema> schema = stream.getSchema(it->second.schema);
+        if (!schema)
+        {
+            VMF_EXCEPTION(DataStorageException, "Schema " + it->second.schema + " isn't loaded");
+        }
+        if (stream.getById(*id) || !staged.insert(*id).second)
+        {
+            continue;
+        }
+        items.push_back(StagedItem());
+        stageMetadata(*id, it->second.path, schema->findMetadataDesc(it->second.metadata), items.back());
+    }
+    decodeItems(items, stream.getLoadThreads());
+    publishItems(items, stream);
+}
+
+shared_ptr<MetadataInternal> XMPMetadataSource::loadPayload(const IdType& id, const MetadataStream& stream)
+{
+    buildIndex();
+    auto it = idMap.find(id);
+    if (it == idMap.end())
+    {
+        VMF_EXCEPTION(DataStorageException, "Undefined metadata with id " + to_string(id));
+    }
+    std::shared_ptr<MetadataSchema> schema = stream.getSchema(it->second.schema);
+    if (!schema)
+    {
+        VMF_EXCEPTION(DataStorageException, "Schema " + it->second.schema + " isn't loaded");
+    }
+    shared_ptr<MetadataDesc> description = schema->findMetadataDesc(it->second.metadata);
+    shared_ptr<MetadataInternal> md = make_shared<MetadataInternal>(description);
+    md->setId(id);
+
+    MetaString fieldsPath;
+    SXMPUtils::ComposeStructFieldPath(VMF_NS, it->second.path.c_str(), VMF_NS, METADATA_FIELDS, &fieldsPath);
+    SXMPIterator fieldsIterator(*xmp, VMF_NS, fieldsPath.c_str(), kXMP_IterJustChildren);
+    MetaString currentFieldPath;
+    while(fieldsIterator.Next(NULL, &currentFieldPath))
+    {
+        loadField(currentFieldPath, md);
+    }
 
-    shared_ptr<MetadataDesc> description(schema->findMetadataDesc(metadataName));
+    loadReferenceIds(it->second.path, md->vRefs);
+    return md;
+}
 
-    SXMPIterator mIter(*xmp, VMF_NS, pathToMetadataSet.c_str(), kXMP_IterJustChildren);
-    MetaString pathToCurrentMetadata;
-    while(mIter.Next(nullptr, &pathToCurrentMetadata))
+void XMPMetadataSource::loadSchemaName(const MetaString &pathToSchema, MetaString& schemaName)
+{
+    if (!xmp->GetStructField(VMF_NS, pathToSchema.c_str(), VMF_NS, SCHEMA_NAME, &schemaName, nullptr))
     {
-        loadMetadata(pathToCurrentMetadata, description, stream);
+        VMF_EXCEPTION(DataStorageException, "Broken schema by path " + pathToSchema);
     }
-    //unsorted stream fails on save
-    stream.sortById();
 }
 
-void XMPMetadataSource::loadMetadata(const MetaString& pathToCurrentMetadata, const shared_ptr<MetadataDesc>& description, MetadataStream& stream)
+void XMPMetadataSource::stageProperty(const PropertyEntry& property, const MetaString& schemaName, const MetadataStream& stream, vector<StagedItem>& items)
 {
-    IdType id;
-    loadMetadataId(pathToCurrentMetadata, id);
+    shared_ptr<MetadataSchema> schema(stream.getSchema(schemaName));
+    shared_ptr<MetadataDesc> description(schema->findMetadataDesc(property.name));
 
-    shared_ptr<Metadata> thisMetadata = stream.getById(id);
-    if (thisMetadata)
+    for (auto id = property.items.begin(); id != property.items.end(); ++id)
     {
-        // already loaded
-        return;
+        if (stream.getById(*id))
+        {
+            // already loaded
+            continue;
+        }
+        items.push_back(StagedItem());
+        stageMetadata(*id, idMap[*id].path, description, items.back());
     }
+}
 
+void XMPMetadataSource::stageMetadata(const IdType& id, const MetaString& pathToCurrentMetadata, const shared_ptr<MetadataDesc>& description, StagedItem& item)
+{
     long long frameIndex;
     loadMetadataFrameIndex(pathToCurrentMetadata, frameIndex);
 
@@ -249,31 +418,126 @@ void XMPMetadataSource::loadMetadata(const MetaString& pathToCurrentMetadata, co
     metadataAccessor->setFrameIndex(frameIndex, numOfFrames);
     metadataAccessor->setTimestamp(timestamp, duration);
     metadataAccessor->setId(id);
+    item.path = pathToCurrentMetadata;
+    item.md = metadataAccessor;
+
     MetaString fieldsPath;
     SXMPUtils::ComposeStructFieldPath(VMF_NS, pathToCurrentMetadata.c_str(), VMF_NS, METADATA_FIELDS, &fieldsPath);
-
-    shared_ptr<MetadataSchema> thisSchemaDesc = stream.getSchema(description->getSchemaName());
-    shared_ptr<MetadataDesc> thisPropertyDesc = thisSchemaDesc->findMetadataDesc(description->getMetadataName());
     SXMPIterator fieldsIterator(*xmp, VMF_NS, fieldsPath.c_str(), kXMP_IterJustChildren);
     MetaString currentFieldPath;
     while(fieldsIterator.Next(NULL, &currentFieldPath))
     {
-        loadField(currentFieldPath, metadataAccessor, thisPropertyDesc);
+        item.fields.push_back(StagedField());
+        stageField(currentFieldPath, item.fields.back());
     }
+    loadReferenceIds(pathToCurrentMetadata, item.refs);
+}
 
-    MetadataStreamAccessor* streamAccessor = (MetadataStreamAccessor*) &stream;
-    streamAccessor->internalAdd(metadataAccessor);
-
-    // Load refs only after adding to steam to stop recursive loading when there are circular references
+void XMPMetadataSource::loadReferenceIds(const MetaString& pathToMetadata, vector<pair<IdType, MetaString>>& refs)
+{
     MetaString pathToRefs;
-    SXMPUtils::ComposeStructFieldPath(VMF_NS, pathToCurrentMetadata.c_str(), VMF_NS, METADATA_REFERENCES, &pathToRefs);
+    SXMPUtils::ComposeStructFieldPath(VMF_NS, pathToMetadata.c_str(), VMF_NS, METADATA_REFERENCES, &pathToRefs);
     SXMPIterator refsIterator(*xmp, VMF_NS, pathToRefs.c_str(), kXMP_IterJustChildren);
     MetaString currentRefPath;
     while(refsIterator.Next(NULL, &currentRefPath))
     {
-        loadReference(currentRefPath, metadataAccessor, stream);
+        IdType refId;
+        MetaString refName;
+        loadReferenceId(currentRefPath, refId, refName);
+        refs.push_back(make_pair(refId, refName));
+    }
+}
+
+void XMPMetadataSource::decodeItems(vector<StagedItem>& items, unsigned int threads)
+{
+    atomic<size_t> nextItem(0);
+    exception_ptr error;
+    mutex errorLock;
+
+    // items share nothing but descriptions, so they are decoded independently
+    auto worker = [&]()
+    {
+        try
+        {
+            for (size_t i = nextItem++; i < items.size(); i = nextItem++)
+            {
+                for (auto field = items[i].fields.begin(); field != items[i].fields.end(); ++field)
+                    decodeField(*field, items[i].md);
+                vector<StagedField>().swap(items[i].fields);
+            }
+        }
+        catch (...)
+        {
+            lock_guard<mutex> guard(errorLock);
+            if (!error)
+                error = current_exception();
+            nextItem = items.size();
+        }
+    };
+
+    unsigned int workers = resolveThreads(threads, items.size() / MIN_ITEMS_PER_THREAD);
+    vector<thread> pool;
+    for (unsigned int i = 1; i < workers; i++)
+        pool.push_back(thread(worker));
+    worker();
+    for (auto& t : pool)
+        t.join();
+
+    if (error)
+        rethrow_exception(error);
+}
+
+void XMPMetadataSource::publishItems(vector<StagedItem>& items, MetadataStream& stream)
+{
+    MetadataStreamAccessor* streamAccessor = (MetadataStreamAccessor*) &stream;
+
+    // Referenced items that aren't in the stream are loaded in rounds, a round per level of reference chains.
+    // References are resolved when all targets are in the stream, so circular references need no special care.
+    size_t published = 0;
+    while (published < items.size())
+    {
+        size_t end = items.size();
+        for (size_t i = published; i < end; i++)
+        {
+            streamAccessor->internalAdd(items[i].md);
+        }
+
+        vector<StagedItem> targets;
+        set<IdType> staged;
+        for (size_t i = published; i < end; i++)
+        {
+            for (auto ref = items[i].refs.begin(); ref != items[i].refs.end(); ++ref)
+            {
+                if (stream.getById(ref->first) || !staged.insert(ref->first).second)
+                {
+                    continue;
+                }
+                auto it = idMap.find(ref->first);
+                if (it == idMap.end())
+                {
+                    VMF_EXCEPTION(DataStorageException, "Undefined reference to metadata with id " + to_string(ref->first));
+                }
+                std::shared_ptr<MetadataSchema> schema = stream.getSchema(it->second.schema);
+                if (!schema)
+                {
+                    VMF_EXCEPTION(DataStorageException, "Schema " + it->second.schema + " isn't loaded");
+                }
+                targets.push_back(StagedItem());
+                stageMetadata(ref->first, it->second.path, schema->findMetadataDesc(it->second.metadata), targets.back());
+            }
+        }
+        decodeItems(targets, stream.getLoadThreads());
+        published = end;
+        items.insert(items.end(), make_move_iterator(targets.begin()), make_move_iterator(targets.end()));
     }
 
+    for (auto item = items.begin(); item != items.end(); ++item)
+    {
+        for (auto ref = item->refs.begin(); ref != item->refs.end(); ++ref)
+        {
+            item->md->addReference(stream.getById(ref->first), ref->second);
+        }
+    }
 }
 
 void XMPMetadataSource::loadPropertyName(const MetaString& pathToMetadata, MetaString& metadataName)
@@ -284,112 +548,108 @@ void XMPMetadataSource::loadPropertyName(const MetaString& pathToMetadata, MetaS
     }
 }
 
-void XMPMetadataSource::loadField(const MetaString& fieldPath, const shared_ptr<Metadata>& md, const shared_ptr<MetadataDesc>& thisPropertyDesc)
+void XMPMetadataSource::loadField(const MetaString& fieldPath, const shared_ptr<Metadata>& md)
 {
-    MetaString rawValue;
-    if (!xmp->GetProperty(VMF_NS, fieldPath.c_str(), &rawValue, NULL))
+    StagedField field;
+    stageField(fieldPath, field);
+    decodeField(field, md);
+}
+
+void XMPMetadataSource::stageField(const MetaString& fieldPath, StagedField& field)
+{
+    field.path = fieldPath;
+    if (!xmp->GetProperty(VMF_NS, fieldPath.c_str(), &field.value, NULL))
     {
         VMF_EXCEPTION(DataStorageException, "Corrupted field by path " + fieldPath);
     }
 
+    if (!xmp->GetQualifier(VMF_NS, fieldPath.c_str(), VMF_NS, FIELD_NAME, &field.name, NULL))
+    {
+        field.name = "";
+    }
 
-    MetaString fieldName;
-    if (!xmp->GetQualifier(VMF_NS, fieldPath.c_str(), VMF_NS, FIELD_NAME, &fieldName, NULL))
+    if (xmp->GetQualifier(VMF_NS, fieldPath.c_str(), VMF_NS, FIELD_COMPRESSION, &field.compression, NULL))
     {
-        fieldName = "";
+        if (field.compression != COMPRESSION_ZLIB || !xmp->GetQualifier(VMF_NS, fieldPath.c_str(), VMF_NS, FIELD_LENGTH, &field.length, NULL))
+        {
+            VMF_EXCEPTION(DataStorageException, "Unsupported compression of field by path " + fieldPath);
+        }
     }
+}
 
+void XMPMetadataSource::decodeField(const StagedField& field, const shared_ptr<Metadata>& md)
+{
     FieldDesc thisFieldDesc;
-    if (!thisPropertyDesc->getFieldDesc(thisFieldDesc, fieldName))
+    if (!md->getDesc()->getFieldDesc(thisFieldDesc, field.name))
     {
-        VMF_EXCEPTION(DataStorageException, "Extra field by path " + fieldPath);
+        VMF_EXCEPTION(DataStorageException, "Extra field by path " + field.path);
     }
 
-
     Variant fieldValue;
-    fieldValue.fromString(thisFieldDesc.type, rawValue);
-    if (fieldName.empty())
+    if (!field.compression.empty())
+    {
+        vmf_rawbuffer value = uncompressValue(Variant::base64decode(field.value), stringTo<vmf_integer>(field.length));
+        if (thisFieldDesc.type == Variant::type_rawbuffer)
+            fieldValue = value;
+        else
+            fieldValue.fromString(thisFieldDesc.type, std::string(value.data(), value.size()));
+    }
+    else
+    {
+        fieldValue.fromString(thisFieldDesc.type, field.value);
+    }
+    if (field.name.empty())
     {
         md->addValue(fieldValue);
     }
     else
     {
-        md->setFieldValue(fieldName, fieldValue);
+        md->setFieldValue(field.name, fieldValue);
     }
 }
 
-void XMPMetadataSource::loadReference(const MetaString& thisRefPath, const shared_ptr<Metadata>& md, MetadataStream& stream)
+void XMPMetadataSource::loadReferenceId(const MetaString& thisRefPath, IdType& id, MetaString& refName)
 {
-    XMP_Int64 id;
+    XMP_Int64 idValue;
     MetaString tmpPath;
-    MetaString refName;
     SXMPUtils::ComposeStructFieldPath(VMF_NS, thisRefPath.c_str(), VMF_NS, REF_NAME, &tmpPath);
     if (!xmp->GetProperty(VMF_NS, tmpPath.c_str(), &refName, nullptr))
         refName = "";
     
     SXMPUtils::ComposeStructFieldPath(VMF_NS, thisRefPath.c_str(), VMF_NS, REF_ID, &tmpPath);
-    if (!xmp->GetProperty_Int64(VMF_NS, tmpPath.c_str(), &id, nullptr))
+    if (!xmp->GetProperty_Int64(VMF_NS, tmpPath.c_str(), &idValue, nullptr))
     {
         VMF_EXCEPTION(DataStorageException, "Broken reference by path" + thisRefPath);
     }
-
-    IdType realId = id;
-    shared_ptr<Metadata> refTo = stream.getById(realId);
-    if (!refTo)
-    {
-        auto it = idMap.find(realId);
-        if (it == idMap.end())
-        {
-            VMF_EXCEPTION(DataStorageException, "Undefined reference by path " + thisRefPath);
-        }
-        InternalPath path = it->second;
-        std::shared_ptr<MetadataSchema> refSchemaDesc = stream.getSchema(path.schema);
-        std::shared_ptr<MetadataDesc> refMetadataDesc = refSchemaDesc->findMetadataDesc(path.metadata);
-        loadMetadata(path.path, refMetadataDesc, stream);
-        refTo = stream.getById(realId);
-    }
-    md->addReference(refTo, refName);
+    id = (IdType) idValue;
 }
 
 MetaString XMPMetadataSource::findSchema(const MetaString& name)
 {
-    SXMPIterator it(*xmp, VMF_NS, VMF_GLOBAL_SCHEMAS_ARRAY, kXMP_IterJustChildren);
-    MetaString currentSchemaPath;
-    while(it.Next(nullptr, &currentSchemaPath))
-    {
-        MetaString currentSchemaName;
-        loadSchemaName(currentSchemaPath, currentSchemaName);
-        if (currentSchemaName == name)
-        {
-            return currentSchemaPath;
-        }
-    }
-    return MetaString("");
+    auto schema = schemaMap.find(name);
+    return schema != schemaMap.end() ? schema->second.path : MetaString("");
 }
 
-MetaString XMPMetadataSource::findProperty(const MetaString& pathToSchema, const MetaString& name)
+XMPMetadataSource::PropertyEntry* XMPMetadataSource::findPropertyEntry(const MetaString& schemaName, const MetaString& name)
 {
-    MetaString pathToSchemaSet;
-    SXMPUtils::ComposeStructFieldPath(VMF_NS, pathToSchema.c_str(), VMF_NS, SCHEMA_SET, &pathToSchemaSet);
-    SXMPIterator pIter(*xmp, VMF_NS, pathToSchemaSet.c_str(), kXMP_IterJustChildren);
-    MetaString currentPropertyPath;
-    while(pIter.Next(nullptr, &currentPropertyPath))
+    auto schema = schemaMap.find(schemaName);
+    if (schema == schemaMap.end())
     {
-        MetaString currentPropertyName;
-        if (!xmp->GetStructField(VMF_NS, currentPropertyPath.c_str(), VMF_NS, PROPERTY_NAME, &currentPropertyName, 0))
-        {
-            VMF_EXCEPTION(DataStorageException, "Broken property by path " + currentPropertyPath);
-        }
-        if (currentPropertyName == name)
+        return nullptr;
+    }
+    for (auto property = schema->second.properties.begin(); property != schema->second.properties.end(); ++property)
+    {
+        if (property->name == name)
         {
-            return currentPropertyPath;
+            return &*property;
         }
     }
-    return MetaString("");
+    return nullptr;
 }
 
 void XMPMetadataSource::remove(const vector<IdType>& removedIds)
 {
+    buildIndex();
     for (auto id = removedIds.rbegin(); id != removedIds.rend(); ++id)
     {
         auto property = idMap.find(*id);
@@ -399,37 +659,64 @@ void XMPMetadataSource::remove(const vector<IdType>& removedIds)
             idMap.erase(property);
         }
     }
+    // paths of items following the removed ones are shifted
+    invalidateIndex();
 }
 
 void XMPMetadataSource::clear()
 {
     xmp->DeleteProperty(VMF_NS, VMF_GLOBAL_SCHEMAS_ARRAY);
+    invalidateIndex();
 }
 
-void XMPMetadataSource::loadIds()
+void XMPMetadataSource::buildIndex()
 {
+    if (indexed)
+    {
+        return;
+    }
+    schemaMap.clear();
     idMap.clear();
     SXMPIterator sIter(*xmp, VMF_NS, VMF_GLOBAL_SCHEMAS_ARRAY, kXMP_IterJustChildren);
     MetaString currentSchemaPath;
     while (sIter.Next(nullptr, &currentSchemaPath))
     {
-        loadIds(currentSchemaPath);
+        indexSchema(currentSchemaPath);
     }
+    indexed = true;
 }
 
-void XMPMetadataSource::loadIds(const vmf::MetaString& pathToSchema)
+void XMPMetadataSource::invalidateIndex()
+{
+    indexed = false;
+}
+
+MetaString XMPMetadataSource::appendStruct(const MetaString& arrayPath)
+{
+    xmp->AppendArrayItem(VMF_NS, arrayPath.c_str(), kXMP_PropValueIsArray, nullptr, kXMP_PropValueIsStruct);
+    // the path by index stays valid in the index until items are removed
+    MetaString path;
+    SXMPUtils::ComposeArrayItemPath(VMF_NS, arrayPath.c_str(), xmp->CountArrayItems(VMF_NS, arrayPath.c_str()), &path);
+    return path;
+}
+
+void XMPMetadataSource::indexSchema(const vmf::MetaString& pathToSchema)
 {
     MetaString pathToPropertiesArray;
     SXMPUtils::ComposeStructFieldPath(VMF_NS, pathToSchema.c_str(), VMF_NS, SCHEMA_SET, &pathToPropertiesArray);
     MetaString schemaName;
     loadSchemaName(pathToSchema, schemaName);
+    SchemaEntry& schema = schemaMap[schemaName];
+    schema.path = pathToSchema;
 
     SXMPIterator pIter(*xmp, VMF_NS, pathToPropertiesArray.c_str(), kXMP_IterJustChildren);
     MetaString pathToCurrentProperty;
     while (pIter.Next(nullptr, &pathToCurrentProperty))
     {
-        MetaString metadataName;
-        loadPropertyName(pathToCurrentProperty, metadataName);
+        schema.properties.push_back(PropertyEntry());
+        PropertyEntry& property = schema.properties.back();
+        property.path = pathToCurrentProperty;
+        loadPropertyName(pathToCurrentProperty, property.name);
 
         MetaString pathToCurrentMetadataSet;
         SXMPUtils::ComposeStructFieldPath(VMF_NS, pathToCurrentProperty.c_str(), VMF_NS, PROPERTY_SET, &pathToCurrentMetadataSet);
@@ -441,9 +728,10 @@ void XMPMetadataSource::loadIds(const vmf::MetaString& pathToSchema)
             loadMetadataId(pathToCurrentMetadata, id);
             InternalPath path;
             path.schema = schemaName;
-            path.metadata = metadataName;
+            path.metadata = property.name;
             path.path = pathToCurrentMetadata;
             idMap[id] = path;
+            property.items.push_back(id);
         }
     }
 }
@@ -611,12 +899,12 @@ void XMPMetadataSource::saveMetadataFields(const MetaString& pathToMetadata, con
 
 void XMPMetadataSource::saveMetadataReferences(const MetaString& pathToMetadata, const shared_ptr<Metadata>& md)
 {
+    xmp->DeleteStructField(VMF_NS, pathToMetadata.c_str(), VMF_NS, METADATA_REFERENCES);
     auto refs = md->getAllReferences();
     if (refs.empty())
     {
         return;
     }
-    xmp->DeleteStructField(VMF_NS, pathToMetadata.c_str(), VMF_NS, METADATA_REFERENCES);
     MetaString pathToRefs;
     SXMPUtils::ComposeStructFieldPath(VMF_NS, pathToMetadata.c_str(), VMF_NS, METADATA_REFERENCES, &pathToRefs);
     xmp->SetStructField(VMF_NS, pathToMetadata.c_str(), VMF_NS, METADATA_REFERENCES, nullptr, kXMP_PropValueIsArray);
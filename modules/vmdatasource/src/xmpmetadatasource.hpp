@@ -32,8 +32,12 @@ public:
     void saveSchema(const vmf::MetaString& schemaName, const vmf::MetadataStream& stream);
     void loadSchema(const vmf::MetaString& schemaName, vmf::MetadataStream& stream);
     void loadProperty(const vmf::MetaString& schemaName, const vmf::MetaString& metadataName, vmf::MetadataStream& stream);
+    void loadIndex(const vmf::MetaString& schemaName, std::vector<vmf::MetadataStream::IndexEntry>& index);
+    void loadItems(const std::vector<vmf::IdType>& ids, vmf::MetadataStream& stream);
+    std::shared_ptr<vmf::MetadataInternal> loadPayload(const vmf::IdType& id, const vmf::MetadataStream& stream);
     void remove(const std::vector<vmf::IdType>& removedIds);
     void clear();
+    void invalidateIndex();
 private:
     struct InternalPath {
         vmf::MetaString schema;
@@ -43,20 +47,59 @@ private:
 
     typedef std::map<vmf::IdType, InternalPath> IdMap;
 
-    void loadPropertyByPath(const vmf::MetaString& pathToProperty, const vmf::MetaString& schemaName, vmf::MetadataStream& stream);
-    void saveProperty(const vmf::MetadataSet& property, const vmf::MetaString& pathToSchema, const vmf::MetaString& propertyName);
+    struct PropertyEntry {
+        vmf::MetaString name;
+        vmf::MetaString path;
+        std::vector<vmf::IdType> items;
+    };
+
+    struct SchemaEntry {
+        vmf::MetaString path;
+        std::vector<PropertyEntry> properties;
+    };
+
+    typedef std::map<vmf::MetaString, SchemaEntry> SchemaMap;
+
+    struct StagedField {
+        vmf::MetaString path;
+        vmf::MetaString name;
+        vmf::MetaString value;
+        vmf::MetaString compression;
+        vmf::MetaString length;
+    };
+
+    // Item read from XMP with raw field values that aren't decoded yet
+    struct StagedItem {
+        vmf::MetaString path;
+        std::shared_ptr<vmf::Metadata> md;
+        std::vector<StagedField> fields;
+        std::vector<std::pair<vmf::IdType, vmf::MetaString>> refs;
+    };
+
+    void stageProperty(const PropertyEntry& property, const vmf::MetaString& schemaName, const vmf::MetadataStream& stream, std::vector<StagedItem>& items);
+    void saveProperty(const vmf::MetadataSet& property, const vmf::MetaString& schemaName, const vmf::MetaString& pathToSchema, const vmf::MetaString& propertyName);
+
+    void saveMetadata(const std::shared_ptr<vmf::Metadata>& md, const vmf::MetaString& thisPropertySetPath,
+                      const vmf::MetaString& schemaName, PropertyEntry& property);
 
-    void loadMetadata(const vmf::MetaString& pathToCurrentMetadata, const std::shared_ptr<MetadataDesc>& description, vmf::MetadataStream& stream);
-    void saveMetadata(const std::shared_ptr<vmf::Metadata>& md, const vmf::MetaString& thisPropertySetPath);
+    void stageMetadata(const vmf::IdType& id, const vmf::MetaString& pathToCurrentMetadata, const std::shared_ptr<MetadataDesc>& description, StagedItem& item);
+    void stageField(const vmf::MetaString& fieldPath, StagedField& field);
+    static void decodeField(const StagedField& field, const std::shared_ptr<vmf::Metadata>& md);
+    static void decodeItems(std::vector<StagedItem>& items, unsigned int threads);
+    void publishItems(std::vector<StagedItem>& items, vmf::MetadataStream& stream);
 
     void loadSchemaName(const vmf::MetaString& pathToSchema, vmf::MetaString& schemaName);
-    void loadReference(const vmf::MetaString& thisRefPath, const std::shared_ptr<vmf::Metadata>& md, vmf::MetadataStream& stream);
+    void loadReferenceIds(const vmf::MetaString& pathToMetadata, std::vector<std::pair<vmf::IdType, vmf::MetaString>>& refs);
+    void loadReferenceId(const vmf::MetaString& thisRefPath, vmf::IdType& id, vmf::MetaString& refName);
 
-    void loadField(const vmf::MetaString& fieldPath, const std::shared_ptr<vmf::Metadata>& md, const std::shared_ptr<MetadataDesc>& thisPropertyDesc);
+    void loadField(const vmf::MetaString& fieldPath, const std::shared_ptr<vmf::Metadata>& md);
     void saveField(const vmf::MetaString& fieldName, const vmf::Variant& value, const vmf::MetaString& fieldsPath);
 
-    void loadIds();
-    void loadIds(const vmf::MetaString& pathToSchema);
+    // Schemas, properties and item paths are collected by a single walk over the packet on first use,
+    // saved schemas, properties and items are added to the index as they are appended
+    void buildIndex();
+    vmf::MetaString appendStruct(const vmf::MetaString& arrayPath);
+    void indexSchema(const vmf::MetaString& pathToSchema);
 
     void loadMetadataId(const vmf::MetaString& pathToMetadata, vmf::IdType& id);
     void saveMetadataId(const vmf::MetaString& pathToMetadata, const vmf::IdType& id);
@@ -80,16 +123,18 @@ private:
 
     void saveMetadataReferences(const vmf::MetaString& pathToMetadata, const std::shared_ptr<vmf::Metadata>& md);
 
-    MetaString appendProperty(const vmf::MetaString& pathToSchema);
     MetaString findSchema(const vmf::MetaString& name);
-    MetaString findProperty(const vmf::MetaString& pathToSchema, const vmf::MetaString& name);
-    MetaString findId(const InternalPath& internalPath, const vmf::IdType& id);
+    PropertyEntry* findPropertyEntry(const vmf::MetaString& schemaName, const vmf::MetaString& name);
 
     XMPMetadataSource();
     XMPMetadataSource(const vmf::XMPMetadataSource& origin);
     XMPMetadataSource& operator=(const vmf::XMPMetadataSource& origin);
     std::shared_ptr<SXMPMeta> xmp;
+    SchemaMap schemaMap;
     IdMap idMap;
+    bool indexed;
+    size_t compressionThreshold;
+    int compressionLevel;
 };
 
 } // namespace vmf
@@ -0,0 +1,383 @@
+/*
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <fstream>
+#include <cstdio>
+#include <ctime>
+#include <vmf/vmf.hpp>
+#include <vmf/vmdatasource.hpp>
+#include "utils.hpp"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+
+#if TARGET_OS_IPHONE
+extern std::string tempPath;
+#define TEST_FILE (tempPath + "checksum_test.avi")
+#define TEST_RAW_FILE (tempPath + "checksum_test.bin")
+#else
+#define TEST_FILE "checksum_test.avi"
+#define TEST_RAW_FILE "checksum_test.bin"
+#endif /* TARGET_OS_IPHONE */
+
+#define TEST_FILE_SRC VIDEO_FILE
+
+using namespace vmf;
+
+static void writeFile(const std::string& path, const std::string& content)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << content;
+}
+
+static long long getModificationTime(const std::string& path)
+{
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 ? (long long) info.st_mtime : -1;
+}
+
+static void setModificationTime(const std::string& path, long long time)
+{
+    struct utimbuf times;
+    times.actime = times.modtime = (time_t) time;
+    utime(path.c_str(), &times);
+}
+
+static void patchFile(const std::string& path, long long offset, bool keepModificationTime)
+{
+    long long modified = getModificationTime(path);
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekg(offset);
+        char c = (char) file.get();
+        file.seekp(offset);
+        file.put((char) (c ^ 0x55));
+    }
+    if (keepModificationTime)
+        setModificationTime(path, modified);
+}
+
+// media file of several checksum chunks: the sample video with a large JUNK chunk appended
+static void writeLargeVideo(const std::string& src, const std::string& dst, unsigned int junkSize)
+{
+    std::ifstream in(src, std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    content += "JUNK";
+    for (int i = 0; i < 4; i++)
+        content += (char) ((junkSize >> (8 * i)) & 0xFF);
+    for (unsigned int i = 0; i < junkSize; i++)
+        content += (char) (i * 7 + i / 4096);
+    unsigned int riffSize = (unsigned int) content.size() - 8;
+    for (int i = 0; i < 4; i++)
+        content[4 + i] = (char) ((riffSize >> (8 * i)) & 0xFF);
+    writeFile(dst, content);
+}
+
+class TestChecksum : public TestWithVideoFile
+{
+protected:
+    TestChecksum() : TestWithVideoFile(TEST_FILE) {}
+
+    void SetUp()
+    {
+        TestWithVideoFile::SetUp();
+
+        spSchema = std::make_shared<MetadataSchema>("schema");
+        VMF_METADATA_BEGIN("desc");
+            VMF_FIELD_STR("name");
+        VMF_METADATA_END(spSchema);
+
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+        stream.addSchema(spSchema);
+        std::shared_ptr<Metadata> md = std::make_shared<Metadata>(spSchema->findMetadataDesc("desc"));
+        md->setFieldValue("name", "item");
+        stream.add(md);
+        ASSERT_TRUE(stream.save());
+        stream.close();
+    }
+
+    void TearDown()
+    {
+        TestWithVideoFile::TearDown();
+        std::remove(TEST_RAW_FILE);
+    }
+
+    void storeAndVerify(const std::string& checksum)
+    {
+        {
+            MetadataStream stream;
+            ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+            stream.setChecksum(checksum);
+            ASSERT_TRUE(stream.save());
+            stream.close();
+        }
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+        ASSERT_EQ(checksum, stream.getChecksum());
+        ASSERT_TRUE(stream.verifyChecksum());
+        ASSERT_TRUE(stream.verifyChecksum(1));
+        stream.close();
+    }
+
+    std::shared_ptr<MetadataSchema> spSchema;
+};
+
+TEST_F(TestChecksum, MD5MatchesXMPFiles)
+{
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    long long size, offset;
+    std::string gold = stream.computeChecksum(size, offset);
+    ASSERT_EQ(32u, gold.size());
+    ASSERT_EQ(gold, stream.computeChecksum());
+    ASSERT_EQ(gold, stream.computeChecksum(MetadataStream::ChecksumMD5, 1));
+    ASSERT_EQ(gold, stream.computeChecksum(MetadataStream::ChecksumMD5, 4));
+    ASSERT_EQ(MetadataStream::ChecksumMD5, MetadataStream::getChecksumAlgorithm(gold));
+    stream.close();
+}
+
+TEST_F(TestChecksum, TreeHashDoesNotDependOnThreads)
+{
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    std::string digest = stream.computeChecksum(MetadataStream::ChecksumTreeHash, 1);
+    ASSERT_EQ(0u, digest.find("xxh64tree:"));
+    ASSERT_EQ(digest, stream.computeChecksum(MetadataStream::ChecksumTreeHash, 8));
+    ASSERT_EQ(MetadataStream::ChecksumTreeHash, MetadataStream::getChecksumAlgorithm(digest));
+    ASSERT_THROW(MetadataStream::getChecksumAlgorithm("sha1:00"), IncorrectParamException);
+    stream.close();
+}
+
+TEST_F(TestChecksum, StoredDigestsAreVerifiable)
+{
+    std::string md5, tree;
+    {
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+        ASSERT_FALSE(stream.verifyChecksum());
+        md5 = stream.computeChecksum();
+        tree = stream.computeChecksum(MetadataStream::ChecksumTreeHash);
+        stream.close();
+    }
+    storeAndVerify(md5);
+    storeAndVerify(tree);
+
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    stream.setChecksum("xxh64tree:0000000000000000");
+    ASSERT_FALSE(stream.verifyChecksum());
+    stream.close();
+}
+
+TEST_F(TestChecksum, FingerprintSkipsHashing)
+{
+    std::string checksum;
+    long long saved = (long long) time(nullptr);
+    {
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+        checksum = stream.computeChecksum();
+        stream.setChecksum(checksum);
+        ASSERT_TRUE(stream.save());
+
+        // the state cached in the session is trusted while size, modification time and packet location are the same
+        long long written = getModificationTime(TEST_FILE);
+        patchFile(TEST_FILE, 5000, true);
+        ASSERT_TRUE(stream.verifyChecksum());
+        patchFile(TEST_FILE, 5000, true);
+        ASSERT_EQ(written, getModificationTime(TEST_FILE));
+        stream.close();
+    }
+
+    // modification time of the file isn't changed to match the stored fingerprint
+    ASSERT_GE(getModificationTime(TEST_FILE), saved);
+
+    // the stored fingerprint has no time, so a change keeping the time is found by digests of chunks
+    patchFile(TEST_FILE, 5000, true);
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    ASSERT_FALSE(stream.verifyChecksum());
+    stream.close();
+
+    patchFile(TEST_FILE, 5000, false);
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    ASSERT_TRUE(stream.verifyChecksum());
+    ASSERT_EQ(checksum, stream.computeChecksum());
+    stream.close();
+}
+
+TEST_F(TestChecksum, FingerprintIsDroppedWithForeignChecksum)
+{
+    {
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+        stream.setChecksum(stream.computeChecksum(MetadataStream::ChecksumTreeHash));
+        ASSERT_TRUE(stream.save());
+        stream.setChecksum("xxh64tree:0000000000000000");
+        ASSERT_TRUE(stream.save());
+        stream.close();
+    }
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    ASSERT_FALSE(stream.verifyChecksum());
+    stream.close();
+}
+
+TEST_F(TestChecksum, ManifestLocatesCorruptChunks)
+{
+    const long long chunkSize = 4 * 1024 * 1024;
+    writeLargeVideo(TEST_FILE_SRC, TEST_FILE, 5 * chunkSize);
+    {
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+        stream.addSchema(spSchema);
+        ASSERT_TRUE(stream.save());
+        stream.setChecksum(stream.computeChecksum());
+        ASSERT_TRUE(stream.save());
+        stream.close();
+    }
+
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    size_t chunkCount;
+    long long size;
+    ASSERT_TRUE(stream.getChecksumManifest(chunkCount, size));
+    ASSERT_EQ(chunkSize, size);
+    ASSERT_EQ(6u, chunkCount);
+    ASSERT_TRUE(stream.verifyChecksumRange(0, 6 * chunkSize - 1, 2).empty());
+    stream.close();
+
+    // the packet is at the beginning, so this byte is in the third chunk of media part
+    patchFile(TEST_FILE, 2 * chunkSize + 100000, false);
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    ASSERT_FALSE(stream.verifyChecksum());
+    ASSERT_TRUE(stream.verifyChecksumRange(0, 2 * chunkSize).empty());
+    ASSERT_EQ(std::vector<size_t>(1, 2), stream.verifyChecksumRange(2 * chunkSize + 5, 1));
+    ASSERT_EQ(std::vector<size_t>(1, 2), stream.verifyChecksumRange(chunkSize, 3 * chunkSize, 3));
+    ASSERT_THROW(stream.verifyChecksumRange(6 * chunkSize, 1), OutOfRangeException);
+    stream.close();
+}
+
+TEST_F(TestChecksum, ManifestVerificationIsResumable)
+{
+    const long long chunkSize = 4 * 1024 * 1024;
+    writeLargeVideo(TEST_FILE_SRC, TEST_FILE, 5 * chunkSize);
+    {
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+        stream.addSchema(spSchema);
+        ASSERT_TRUE(stream.save());
+        stream.setChecksum(stream.computeChecksum(MetadataStream::ChecksumTreeHash));
+        ASSERT_TRUE(stream.save());
+        stream.close();
+    }
+    patchFile(TEST_FILE, 5 * chunkSize + 10000, false);
+
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    std::vector<size_t> corrupt, reported;
+    size_t next = stream.verifyChecksumChunks(0, 6, corrupt, 1, [&](size_t chunk)
+    {
+        reported.push_back(chunk);
+        return false;
+    });
+    ASSERT_EQ(4u, next);
+    ASSERT_EQ(std::vector<size_t>(1, 4), reported);
+    ASSERT_TRUE(corrupt.empty());
+
+    ASSERT_EQ(6u, stream.verifyChecksumChunks(next, 6 - next, corrupt, 1));
+    ASSERT_EQ(std::vector<size_t>(1, 5), corrupt);
+    std::vector<size_t> parallel;
+    ASSERT_EQ(6u, stream.verifyChecksumChunks(0, 6, parallel, 2));
+    ASSERT_EQ(std::vector<size_t>(1, 5), parallel);
+    ASSERT_THROW(stream.verifyChecksumChunks(5, 2, corrupt), OutOfRangeException);
+    stream.close();
+}
+
+TEST_F(TestChecksum, ManifestIsOptional)
+{
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+    stream.setChecksumManifest(false);
+    stream.setChecksum(stream.computeChecksum());
+    ASSERT_TRUE(stream.save());
+    size_t chunkCount;
+    long long size;
+    ASSERT_FALSE(stream.getChecksumManifest(chunkCount, size));
+    std::vector<size_t> corrupt;
+    ASSERT_THROW(stream.verifyChecksumChunks(0, 1, corrupt), DataStorageException);
+    ASSERT_TRUE(stream.verifyChecksum());
+
+    stream.setChecksumManifest(true);
+    stream.setChecksum(stream.computeChecksum());
+    ASSERT_TRUE(stream.save());
+    ASSERT_TRUE(stream.getChecksumManifest(chunkCount, size));
+    ASSERT_EQ(1u, chunkCount);
+    stream.close();
+}
+
+TEST_F(TestChecksum, ExcludedRegionIsSkipped)
+{
+    writeFile(TEST_RAW_FILE, "abc");
+    ASSERT_EQ("900150983CD24FB0D6963F7D28E17F72", computeFileChecksum(TEST_RAW_FILE, MetadataStream::ChecksumMD5));
+    writeFile(TEST_RAW_FILE, "a--bc");
+    ASSERT_EQ("900150983CD24FB0D6963F7D28E17F72", computeFileChecksum(TEST_RAW_FILE, MetadataStream::ChecksumMD5, 1, 2));
+
+    // several chunks of the tree hash with the excluded region crossing a chunk boundary
+    std::string content(10 * 1024 * 1024, '\0');
+    for (size_t i = 0; i < content.size(); i++)
+        content[i] = (char) (i * 7 + i / 4096);
+    const long long offset = 4 * 1024 * 1024 - 100, size = 1000;
+
+    writeFile(TEST_RAW_FILE, content);
+    std::string gold = computeFileChecksum(TEST_RAW_FILE, MetadataStream::ChecksumTreeHash, offset, size, 1);
+    ASSERT_EQ(gold, computeFileChecksum(TEST_RAW_FILE, MetadataStream::ChecksumTreeHash, offset, size, 3));
+
+    std::string changed = content;
+    changed[offset + 10] ^= 1;
+    writeFile(TEST_RAW_FILE, changed);
+    ASSERT_EQ(gold, computeFileChecksum(TEST_RAW_FILE, MetadataStream::ChecksumTreeHash, offset, size));
+
+    changed = content;
+    changed[offset + size] ^= 1;
+    writeFile(TEST_RAW_FILE, changed);
+    ASSERT_NE(gold, computeFileChecksum(TEST_RAW_FILE, MetadataStream::ChecksumTreeHash, offset, size));
+
+    ASSERT_THROW(computeFileChecksum("missing_file.bin", MetadataStream::ChecksumTreeHash), DataStorageException);
+}
+
+TEST_F(TestChecksum, InMemoryDataSourceSupportsMD5Only)
+{
+    vmf::terminate();
+    vmf::initialize(StorageMemory);
+    resetMemoryStorage();
+
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+    ASSERT_EQ("", stream.computeChecksum(MetadataStream::ChecksumMD5));
+    ASSERT_THROW(stream.computeChecksum(MetadataStream::ChecksumTreeHash), NotImplementedException);
+    stream.close();
+    resetMemoryStorage();
+}
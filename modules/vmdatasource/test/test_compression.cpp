@@ -0,0 +1,126 @@
+/* 
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <fstream>
+#include <vmf/vmf.hpp>
+#include "utils.hpp"
+
+#if TARGET_OS_IPHONE
+extern std::string tempPath;
+#define TEST_FILE (tempPath + "global_test.avi")
+#else
+#define TEST_FILE "global_test.avi"
+#endif /* TARGET_OS_IPHONE */
+
+#define TEST_FILE_SRC VIDEO_FILE
+
+using namespace vmf;
+
+class TestCompression : public TestWithVideoFile
+{
+protected:
+    TestCompression() : TestWithVideoFile(TEST_FILE) {}
+
+    void SetUp()
+    {
+        TestWithVideoFile::SetUp();
+
+        spSchema = std::make_shared<MetadataSchema>("schema");
+        std::vector<FieldDesc> vFields;
+        vFields.push_back(FieldDesc("buffer", Variant::type_rawbuffer));
+        vFields.push_back(FieldDesc("text", Variant::type_string));
+        vFields.push_back(FieldDesc("values", Variant::type_real_vector));
+        vFields.push_back(FieldDesc("small", Variant::type_string));
+        spDesc = std::make_shared<MetadataDesc>("desc", vFields);
+        spSchema->add(spDesc);
+
+        for (int i = 0; i < 4096; i++)
+            buffer.push_back((char) (i % 7));
+        for (int i = 0; i < 100; i++)
+            text += "Lorem ipsum dolor sit amet. ";
+        for (int i = 0; i < 100; i++)
+            values.push_back(i / 4.0);
+    }
+
+    long long saveAndGetSize(size_t threshold)
+    {
+        copyFile(TEST_FILE_SRC, TEST_FILE);
+        MetadataStream stream;
+        EXPECT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+        stream.setCompression(threshold, 9);
+        stream.addSchema(spSchema);
+
+        std::shared_ptr<Metadata> md(new Metadata(spDesc));
+        md->setFieldValue("buffer", buffer);
+        md->setFieldValue("text", text);
+        md->setFieldValue("values", values);
+        md->setFieldValue("small", "abc");
+        stream.add(md);
+        EXPECT_TRUE(stream.save());
+        stream.close();
+
+        std::ifstream file(TEST_FILE, std::ios::binary | std::ios::ate);
+        return (long long) file.tellg();
+    }
+
+    void loadAndCheck()
+    {
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+        ASSERT_TRUE(stream.load("schema"));
+        stream.close();
+
+        MetadataSet set = stream.queryByName("desc");
+        ASSERT_EQ(1u, set.size());
+        ASSERT_EQ(buffer, set[0]->getFieldValue("buffer").get_rawbuffer());
+        ASSERT_EQ(text, (vmf_string) set[0]->getFieldValue("text"));
+        ASSERT_EQ(values, set[0]->getFieldValue("values").get_real_vector());
+        ASSERT_EQ("abc", (vmf_string) set[0]->getFieldValue("small"));
+    }
+
+    std::shared_ptr<MetadataSchema> spSchema;
+    std::shared_ptr<MetadataDesc> spDesc;
+    vmf_rawbuffer buffer;
+    vmf_string text;
+    std::vector<vmf_real> values;
+};
+
+TEST_F(TestCompression, Disabled)
+{
+    saveAndGetSize(0);
+    loadAndCheck();
+}
+
+TEST_F(TestCompression, Enabled)
+{
+    long long plainSize = saveAndGetSize(0);
+    long long compressedSize = saveAndGetSize(64);
+    ASSERT_LT(compressedSize, plainSize);
+    loadAndCheck();
+}
+
+TEST_F(TestCompression, InvalidLevel)
+{
+    MetadataStream stream;
+    EXPECT_THROW(stream.setCompression(64, 10), IncorrectParamException);
+    EXPECT_THROW(stream.setCompression(64, -2), IncorrectParamException);
+    stream.setCompression(64);
+    ASSERT_EQ(64u, stream.getCompressionThreshold());
+    ASSERT_EQ(-1, stream.getCompressionLevel());
+}
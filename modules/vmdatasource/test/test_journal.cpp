@@ -0,0 +1,151 @@
+/*
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <fstream>
+#include <cstdio>
+#include <zlib.h>
+#include <vmf/vmf.hpp>
+#include "utils.hpp"
+
+#if TARGET_OS_IPHONE
+extern std::string tempPath;
+#define TEST_FILE (tempPath + "global_test.avi")
+#else
+#define TEST_FILE "global_test.avi"
+#endif /* TARGET_OS_IPHONE */
+
+#define TEST_JOURNAL (std::string(TEST_FILE) + ".vmf-journal")
+
+using namespace vmf;
+
+static bool fileExists(const std::string& path)
+{
+    return std::ifstream(path).is_open();
+}
+
+static void writeJournal(const std::string& packet, bool torn)
+{
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, (const Bytef*)packet.data(), (uInt)packet.size());
+    std::ofstream file(TEST_JOURNAL, std::ios::binary);
+    file << "VMF-JOURNAL 1\n" << packet.size() << " " << crc << "\n";
+    file << (torn ? packet.substr(0, packet.size() / 2) : packet);
+}
+
+static std::string checksumPacket(const std::string& checksum)
+{
+    return
+        "<x:xmpmeta xmlns:x=\"adobe:ns:meta/\">"
+        "<rdf:RDF xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\">"
+        "<rdf:Description rdf:about=\"\" xmlns:vmf=\"http://ns.intel.com/vmf/2.0\">"
+        "<vmf:media-checksum>" + checksum + "</vmf:media-checksum>"
+        "</rdf:Description></rdf:RDF></x:xmpmeta>";
+}
+
+class TestJournal : public TestWithVideoFile
+{
+protected:
+    TestJournal() : TestWithVideoFile(TEST_FILE) {}
+
+    void SetUp()
+    {
+        std::remove(TEST_JOURNAL.c_str());
+        TestWithVideoFile::SetUp();
+
+        spSchema = std::make_shared<MetadataSchema>("schema");
+        VMF_METADATA_BEGIN("desc");
+            VMF_FIELD_STR("name");
+        VMF_METADATA_END(spSchema);
+    }
+
+    void TearDown()
+    {
+        TestWithVideoFile::TearDown();
+        std::remove(TEST_JOURNAL.c_str());
+    }
+
+    std::shared_ptr<MetadataSchema> spSchema;
+};
+
+TEST_F(TestJournal, SaveRemovesJournal)
+{
+    {
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+        stream.addSchema(spSchema);
+        for (int i = 0; i < 10; i++)
+        {
+            std::shared_ptr<Metadata> md = std::make_shared<Metadata>(spSchema->findMetadataDesc("desc"));
+            md->setFieldValue("name", "item" + std::to_string(i));
+            stream.add(md);
+        }
+        ASSERT_TRUE(stream.save());
+        ASSERT_FALSE(fileExists(TEST_JOURNAL));
+        stream.remove(stream.queryByName("desc")[0]->getId());
+        ASSERT_TRUE(stream.save());
+        ASSERT_FALSE(fileExists(TEST_JOURNAL));
+        stream.close();
+    }
+
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    ASSERT_TRUE(stream.load("schema"));
+    ASSERT_EQ(9u, stream.queryByName("desc").size());
+    stream.close();
+}
+
+TEST_F(TestJournal, CompleteJournalIsReplayed)
+{
+    writeJournal(checksumPacket("journaled"), false);
+    {
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+        ASSERT_EQ("journaled", stream.getChecksum());
+        stream.close();
+        ASSERT_TRUE(fileExists(TEST_JOURNAL));
+    }
+    {
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+        stream.close();
+        ASSERT_FALSE(fileExists(TEST_JOURNAL));
+    }
+
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    ASSERT_EQ("journaled", stream.getChecksum());
+    stream.close();
+}
+
+TEST_F(TestJournal, TornJournalIsDiscarded)
+{
+    writeJournal(checksumPacket("journaled"), true);
+    {
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+        ASSERT_EQ("", stream.getChecksum());
+        stream.close();
+        ASSERT_FALSE(fileExists(TEST_JOURNAL));
+    }
+
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    ASSERT_EQ("", stream.getChecksum());
+    stream.close();
+}
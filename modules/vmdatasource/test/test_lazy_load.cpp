@@ -0,0 +1,213 @@
+/*
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <cstdio>
+#include <algorithm>
+#include <vmf/vmf.hpp>
+#include <vmf/vmdatasource.hpp>
+#include "utils.hpp"
+
+#if TARGET_OS_IPHONE
+extern std::string tempPath;
+#define TEST_FILE (tempPath + "global_test.avi")
+#else
+#define TEST_FILE "global_test.avi"
+#endif /* TARGET_OS_IPHONE */
+
+#define FRAMES 100
+
+using namespace vmf;
+
+class TestLazyLoad : public TestWithVideoFile
+{
+protected:
+    TestLazyLoad() : TestWithVideoFile(TEST_FILE, false) {}
+
+    void SetUp()
+    {
+        TestWithVideoFile::SetUp();
+
+        spSchema = std::make_shared<MetadataSchema>("schema");
+        std::vector<FieldDesc> vFields;
+        vFields.push_back(FieldDesc("value", Variant::type_integer));
+        spFrameDesc = std::make_shared<MetadataDesc>("frame", vFields);
+        spSchema->add(spFrameDesc);
+
+        std::vector<std::shared_ptr<ReferenceDesc>> vRefs;
+        vRefs.push_back(std::make_shared<ReferenceDesc>("frame"));
+        spEventDesc = std::make_shared<MetadataDesc>("event", vFields, vRefs);
+        spSchema->add(spEventDesc);
+    }
+
+    void TearDown()
+    {
+        resetMemoryStorage();
+        TestWithVideoFile::TearDown();
+    }
+
+    // Frame items are one per frame, the event covers frames 10..29 and refers to frame 50
+    void writeFile(StorageKind kind)
+    {
+        vmf::initialize(kind);
+        resetMemoryStorage();
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+        stream.addSchema(spSchema);
+        std::shared_ptr<Metadata> target;
+        for (int i = 0; i < FRAMES; i++)
+        {
+            std::shared_ptr<Metadata> md = std::make_shared<Metadata>(spFrameDesc);
+            md->setFieldValue("value", (vmf_integer) i);
+            md->setFrameIndex(i);
+            md->setTimestamp(i * 40, 40);
+            stream.add(md);
+            if (i == 50)
+                target = md;
+        }
+        std::shared_ptr<Metadata> event = std::make_shared<Metadata>(spEventDesc);
+        event->setFieldValue("value", (vmf_integer) -1);
+        event->setFrameIndex(10, 20);
+        event->addReference(target, "frame");
+        stream.add(event);
+        ASSERT_TRUE(stream.save());
+        stream.close();
+    }
+
+    static size_t countCalls(const std::string& call)
+    {
+        std::vector<std::string> calls = getMemoryStorageCalls();
+        return (size_t) std::count(calls.begin(), calls.end(), call);
+    }
+
+    std::shared_ptr<MetadataSchema> spSchema;
+    std::shared_ptr<MetadataDesc> spFrameDesc;
+    std::shared_ptr<MetadataDesc> spEventDesc;
+};
+
+TEST_F(TestLazyLoad, IndexHasNoPayload)
+{
+    writeFile(StorageEmbedded);
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    ASSERT_TRUE(stream.loadIndex("schema"));
+    ASSERT_EQ((size_t) FRAMES + 1, stream.getIndex().size());
+    ASSERT_TRUE(stream.getAll().empty());
+
+    auto event = std::find_if(stream.getIndex().begin(), stream.getIndex().end(), [](const MetadataStream::IndexEntry& entry)
+    {
+        return entry.name == "event";
+    });
+    ASSERT_TRUE(event != stream.getIndex().end());
+    ASSERT_EQ(10, event->frameIndex);
+    ASSERT_EQ(20, event->numOfFrames);
+    stream.close();
+}
+
+TEST_F(TestLazyLoad, LoadByFrameIndex)
+{
+    writeFile(StorageEmbedded);
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    ASSERT_TRUE(stream.loadByFrameIndex(20, 5));
+
+    // frames 20..24, the event covering them and the frame referenced by the event
+    ASSERT_EQ(7u, stream.getAll().size());
+    ASSERT_EQ(6u, stream.queryByName("frame").size());
+    ASSERT_EQ(22, stream.queryByFrameIndex(22).queryByName("frame")[0]->getFieldValue("value").get_integer());
+    ASSERT_EQ(1u, stream.queryByName("event")[0]->getReferencesByMetadata("frame").size());
+    ASSERT_TRUE(stream.queryByFrameIndex(25).queryByName("frame").empty());
+    stream.close();
+}
+
+TEST_F(TestLazyLoad, LoadByTime)
+{
+    writeFile(StorageSidecar);
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    ASSERT_TRUE(stream.loadIndex());
+    ASSERT_EQ((size_t) FRAMES + 1, stream.getIndex().size());
+    ASSERT_TRUE(stream.loadByTime(400, 79));
+
+    // items ending at 400 and starting at 440 are inside the range like for queryByTime()
+    MetadataSet set = stream.getAll();
+    ASSERT_EQ(3u, set.size());
+    ASSERT_EQ(3u, stream.queryByTime(400, 479).size());
+    stream.close();
+}
+
+TEST_F(TestLazyLoad, ReadAheadOnSequentialAccess)
+{
+    writeFile(StorageMemory);
+    for (size_t readAhead = 0; readAhead < 2; readAhead++)
+    {
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+        stream.setReadAhead(readAhead);
+        size_t before = countCalls("loadItems");
+        for (long long frame = 0; frame < 50; frame += 10)
+        {
+            ASSERT_TRUE(stream.loadByFrameIndex(frame, 10));
+            ASSERT_EQ(1u, stream.queryByFrameIndex((size_t) frame + 9).queryByName("frame").size());
+        }
+        // the second range is read along with the third one, the fourth one along with the fifth one
+        ASSERT_EQ(readAhead ? 3u : 5u, countCalls("loadItems") - before);
+        stream.close();
+    }
+}
+
+TEST_F(TestLazyLoad, SaveKeepsItemsNotLoaded)
+{
+    writeFile(StorageEmbedded);
+    {
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+        ASSERT_TRUE(stream.loadByFrameIndex(60, 2));
+        stream.queryByFrameIndex(60)[0]->setFieldValue("value", (vmf_integer) 1000);
+        ASSERT_TRUE(stream.save());
+        stream.close();
+    }
+
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    ASSERT_TRUE(stream.load("schema"));
+    ASSERT_EQ((size_t) FRAMES + 1, stream.getAll().size());
+    ASSERT_EQ(1000, stream.queryByFrameIndex(60)[0]->getFieldValue("value").get_integer());
+    ASSERT_EQ(61, stream.queryByFrameIndex(61)[0]->getFieldValue("value").get_integer());
+    stream.close();
+}
+
+TEST_F(TestLazyLoad, LoadedItemsAreOrderedById)
+{
+    writeFile(StorageSidecar);
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    ASSERT_TRUE(stream.loadByFrameIndex(70, 10));
+    ASSERT_TRUE(stream.loadByFrameIndex(5, 10));
+    ASSERT_TRUE(stream.load("schema"));
+
+    MetadataSet set = stream.getAll();
+    ASSERT_EQ((size_t) FRAMES + 1, set.size());
+    ASSERT_TRUE(std::is_sorted(set.begin(), set.end(), [](const std::shared_ptr<Metadata>& a, const std::shared_ptr<Metadata>& b)
+    {
+        return a->getId() < b->getId();
+    }));
+    for (auto it = set.begin(); it != set.end(); ++it)
+        ASSERT_EQ(*it, stream.getById((*it)->getId()));
+    stream.close();
+}
@@ -0,0 +1,263 @@
+/*
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vmf/vmf.hpp>
+#include <vmf/vmdatasource.hpp>
+
+#define TEST_FILE "memory_test.avi"
+
+using namespace vmf;
+
+class TestMemoryStorage : public ::testing::Test
+{
+protected:
+    void SetUp()
+    {
+        vmf::initialize(StorageMemory);
+        resetMemoryStorage();
+
+        spSchema = std::make_shared<MetadataSchema>("schema");
+        std::vector<FieldDesc> vFields;
+        vFields.push_back(FieldDesc("name", Variant::type_string));
+        vFields.push_back(FieldDesc("value", Variant::type_integer));
+        std::vector<std::shared_ptr<ReferenceDesc>> vRefs;
+        vRefs.push_back(std::make_shared<ReferenceDesc>("parent"));
+        spDesc = std::make_shared<MetadataDesc>("desc", vFields, vRefs);
+        spSchema->add(spDesc);
+    }
+
+    void TearDown()
+    {
+        resetMemoryStorage();
+        vmf::terminate();
+    }
+
+    std::shared_ptr<Metadata> addItem(MetadataStream& stream, int value)
+    {
+        std::shared_ptr<Metadata> md = std::make_shared<Metadata>(spDesc);
+        md->setFieldValue("name", "item" + std::to_string(value));
+        md->setFieldValue("value", (vmf_integer) value);
+        md->setFrameIndex(value);
+        stream.add(md);
+        return md;
+    }
+
+    static bool called(const std::string& call)
+    {
+        std::vector<std::string> calls = getMemoryStorageCalls();
+        return std::find(calls.begin(), calls.end(), call) != calls.end();
+    }
+
+    std::shared_ptr<MetadataSchema> spSchema;
+    std::shared_ptr<MetadataDesc> spDesc;
+};
+
+TEST_F(TestMemoryStorage, SaveLoad)
+{
+    {
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+        stream.addSchema(spSchema);
+        std::shared_ptr<Metadata> parent = addItem(stream, 0);
+        for (int i = 1; i < 10; i++)
+            addItem(stream, i)->addReference(parent, "parent");
+        stream.addVideoSegment(std::make_shared<MetadataStream::VideoSegment>("segment", 25, 0));
+        ASSERT_TRUE(stream.save());
+        stream.close();
+    }
+    ASSERT_TRUE(called("saveSchema"));
+    ASSERT_TRUE(called("commitTransaction"));
+
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    ASSERT_TRUE(stream.load("schema"));
+    ASSERT_EQ(10u, stream.getAll().size());
+    ASSERT_EQ(9u, stream.queryByReference("desc").size());
+    ASSERT_EQ(1u, stream.getAllVideoSegments().size());
+    ASSERT_EQ(7, stream.queryByFrameIndex(7)[0]->getFieldValue("value").get_integer());
+    stream.close();
+}
+
+TEST_F(TestMemoryStorage, MultiValues)
+{
+    std::shared_ptr<MetadataSchema> spValues = std::make_shared<MetadataSchema>("values");
+    std::shared_ptr<MetadataDesc> spList = std::make_shared<MetadataDesc>("list", Variant::type_integer);
+    spValues->add(spList);
+    {
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+        stream.addSchema(spValues);
+        std::shared_ptr<Metadata> md = std::make_shared<Metadata>(spList);
+        for (int i = 0; i < 3; i++)
+            md->addValue((vmf_integer) i);
+        stream.add(md);
+        ASSERT_TRUE(stream.save());
+        stream.close();
+    }
+
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    ASSERT_TRUE(stream.load("values"));
+    std::shared_ptr<Metadata> md = stream.getAll()[0];
+    ASSERT_EQ(3u, md->size());
+    for (int i = 0; i < 3; i++)
+        ASSERT_EQ(i, md->at(i).get_integer());
+    stream.close();
+}
+
+TEST_F(TestMemoryStorage, RemoveAllSchemas)
+{
+    {
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+        stream.addSchema(spSchema);
+        addItem(stream, 0);
+        ASSERT_TRUE(stream.save());
+        stream.remove();
+        ASSERT_TRUE(stream.save());
+        stream.close();
+    }
+
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    ASSERT_TRUE(stream.load());
+    ASSERT_TRUE(stream.getAllSchemaNames().empty());
+    ASSERT_TRUE(stream.getAll().empty());
+    stream.close();
+}
+
+TEST_F(TestMemoryStorage, MissingFile)
+{
+    MetadataStream stream;
+    ASSERT_FALSE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+}
+
+TEST_F(TestMemoryStorage, FaultRollsBackSave)
+{
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+    stream.addSchema(spSchema);
+    for (int i = 0; i < 5; i++)
+        addItem(stream, i);
+    ASSERT_TRUE(stream.save());
+
+    stream.remove(stream.getAll()[0]->getId());
+    addItem(stream, 5);
+    injectMemoryStorageFault("save(id)");
+    ASSERT_FALSE(stream.save());
+    stream.close();
+
+    {
+        MetadataStream reader;
+        ASSERT_TRUE(reader.open(TEST_FILE, MetadataStream::ReadOnly));
+        ASSERT_TRUE(reader.load("schema"));
+        ASSERT_EQ(5u, reader.getAll().size());
+        ASSERT_EQ(1u, reader.queryByFrameIndex(0).size());
+        ASSERT_EQ(0u, reader.queryByFrameIndex(5).size());
+        reader.close();
+    }
+}
+
+TEST_F(TestMemoryStorage, FaultAfterSkippedCalls)
+{
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+    stream.addSchema(spSchema);
+    addItem(stream, 0);
+    injectMemoryStorageFault("save(id)", 1);
+    ASSERT_TRUE(stream.save());
+    addItem(stream, 1);
+    ASSERT_FALSE(stream.save());
+    ASSERT_TRUE(stream.save());
+    stream.close();
+}
+
+TEST_F(TestMemoryStorage, Latency)
+{
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+    stream.addSchema(spSchema);
+    addItem(stream, 0);
+
+    size_t before = getMemoryStorageCalls().size();
+    ASSERT_TRUE(stream.save());
+    size_t calls = getMemoryStorageCalls().size() - before;
+    ASSERT_GT(calls, 0u);
+
+    setMemoryStorageLatency(2000);
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(stream.save());
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    ASSERT_GE(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count(), (long long) (calls * 2000));
+    stream.close();
+}
+
+TEST_F(TestMemoryStorage, StreamsShareFile)
+{
+    {
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+        stream.addSchema(spSchema);
+        addItem(stream, 0);
+        ASSERT_TRUE(stream.save());
+        stream.close();
+    }
+
+    const int count = 50;
+    std::atomic<bool> written(false);
+    std::thread writer([&]()
+    {
+        for (int i = 1; i < count; i++)
+        {
+            MetadataStream stream;
+            EXPECT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+            EXPECT_TRUE(stream.load("schema"));
+            addItem(stream, i);
+            EXPECT_TRUE(stream.save());
+            stream.close();
+        }
+        written = true;
+    });
+
+    // every load sees the items of a whole number of saves
+    size_t loaded = 1;
+    while (!written)
+    {
+        // the writer is joined before the test fails
+        MetadataStream stream;
+        bool opened = stream.open(TEST_FILE, MetadataStream::ReadOnly) && stream.load("schema");
+        EXPECT_TRUE(opened);
+        if (!opened)
+            break;
+        EXPECT_LE(loaded, stream.getAll().size());
+        loaded = stream.getAll().size();
+        stream.close();
+    }
+    writer.join();
+
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    ASSERT_TRUE(stream.load("schema"));
+    ASSERT_EQ((size_t) count, stream.getAll().size());
+    stream.close();
+}
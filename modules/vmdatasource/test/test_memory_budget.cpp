@@ -0,0 +1,333 @@
+/*
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <cstdio>
+#include <sstream>
+#include <algorithm>
+#include <thread>
+#include <vmf/vmf.hpp>
+#include <vmf/vmdatasource.hpp>
+#include "utils.hpp"
+
+#if TARGET_OS_IPHONE
+extern std::string tempPath;
+#define TEST_FILE (tempPath + "global_test.avi")
+#else
+#define TEST_FILE "global_test.avi"
+#endif /* TARGET_OS_IPHONE */
+
+#define TEST_FILE_SRC VIDEO_FILE
+#define ITEMS 50
+#define PAYLOAD 1000
+
+using namespace vmf;
+
+class TestMemoryBudget : public TestWithVideoFile
+{
+protected:
+    TestMemoryBudget() : TestWithVideoFile(TEST_FILE, false) {}
+
+    void SetUp()
+    {
+        TestWithVideoFile::SetUp();
+
+        spSchema = std::make_shared<MetadataSchema>("schema");
+        std::vector<FieldDesc> vFields;
+        vFields.push_back(FieldDesc("value", Variant::type_integer));
+        vFields.push_back(FieldDesc("payload", Variant::type_string));
+        std::vector<std::shared_ptr<ReferenceDesc>> vRefs;
+        vRefs.push_back(std::make_shared<ReferenceDesc>("next"));
+        spDesc = std::make_shared<MetadataDesc>("desc", vFields, vRefs);
+        spSchema->add(spDesc);
+    }
+
+    void TearDown()
+    {
+        resetMemoryStorage();
+        TestWithVideoFile::TearDown();
+    }
+
+    // Every item refers to the next one
+    void writeFile(StorageKind kind)
+    {
+        vmf::initialize(kind);
+        resetMemoryStorage();
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+        stream.addSchema(spSchema);
+        std::shared_ptr<Metadata> next;
+        for (int i = ITEMS - 1; i >= 0; i--)
+        {
+            std::shared_ptr<Metadata> md = std::make_shared<Metadata>(spDesc);
+            md->setFieldValue("value", (vmf_integer) i);
+            md->setFieldValue("payload", std::string(PAYLOAD, (char) ('a' + i % 26)));
+            md->setFrameIndex(i);
+            stream.add(md);
+            if (next)
+                md->addReference(next, "next");
+            next = md;
+        }
+        ASSERT_TRUE(stream.save());
+        stream.close();
+    }
+
+    static std::shared_ptr<Metadata> item(const MetadataStream& stream, size_t frame)
+    {
+        return stream.queryByFrameIndex(frame)[0];
+    }
+
+    static size_t countEvicted(const MetadataStream& stream)
+    {
+        MetadataSet set = stream.getAll();
+        return (size_t) std::count_if(set.begin(), set.end(), [](const std::shared_ptr<Metadata>& md)
+        {
+            return md->isEvicted();
+        });
+    }
+
+    std::shared_ptr<MetadataSchema> spSchema;
+    std::shared_ptr<MetadataDesc> spDesc;
+};
+
+TEST_F(TestMemoryBudget, EvictsAndReloads)
+{
+    writeFile(StorageMemory);
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    stream.setMemoryBudget(10 * PAYLOAD);
+    ASSERT_TRUE(stream.load("schema"));
+
+    ASSERT_EQ((size_t) ITEMS, stream.getAll().size());
+    ASSERT_LE(stream.getMemoryUsage(), stream.getMemoryBudget());
+    ASSERT_GT(countEvicted(stream), 0u);
+    ASSERT_EQ(countEvicted(stream), stream.getCacheStatistics().evictions);
+
+    for (size_t i = 0; i < ITEMS; i++)
+    {
+        std::shared_ptr<Metadata> md = item(stream, i);
+        ASSERT_EQ((vmf_integer) i, md->getFieldValue("value").get_integer());
+        ASSERT_EQ((size_t) PAYLOAD, md->getFieldValue("payload").get_string().size());
+        if (i + 1 < ITEMS)
+        {
+            ASSERT_EQ((vmf_integer) i + 1, md->getFirstReference("desc")->getFieldValue("value").get_integer());
+        }
+        ASSERT_LE(stream.getMemoryUsage(), stream.getMemoryBudget());
+    }
+    MetadataStream::CacheStatistics statistics = stream.getCacheStatistics();
+    ASSERT_GT(statistics.misses, 0u);
+    ASSERT_GT(statistics.hits, 0u);
+    stream.close();
+}
+
+TEST_F(TestMemoryBudget, RecentlyUsedItemsAreKept)
+{
+    writeFile(StorageMemory);
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    ASSERT_TRUE(stream.load("schema"));
+    stream.setMemoryBudget(10 * PAYLOAD);
+
+    std::shared_ptr<Metadata> hot = item(stream, 0);
+    for (size_t i = 1; i < ITEMS; i++)
+    {
+        hot->getFieldValue("value");
+        item(stream, i)->getFieldValue("value");
+    }
+    ASSERT_FALSE(hot->isEvicted());
+
+    size_t misses = stream.getCacheStatistics().misses;
+    hot->getFieldValue("payload");
+    ASSERT_EQ(misses, stream.getCacheStatistics().misses);
+    stream.close();
+}
+
+TEST_F(TestMemoryBudget, ModifiedItemsArePinned)
+{
+    writeFile(StorageEmbedded);
+    {
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+        stream.setMemoryBudget(10 * PAYLOAD);
+        ASSERT_TRUE(stream.load("schema"));
+
+        std::shared_ptr<Metadata> modified = item(stream, 0);
+        modified->setFieldValue("value", (vmf_integer) 1000);
+        for (size_t i = 1; i < ITEMS; i++)
+            item(stream, i)->getFieldValue("payload");
+        ASSERT_FALSE(modified->isEvicted());
+        ASSERT_GT(countEvicted(stream), 0u);
+
+        ASSERT_TRUE(stream.save());
+        for (size_t i = 1; i < ITEMS; i++)
+            item(stream, i)->getFieldValue("payload");
+        ASSERT_TRUE(modified->isEvicted());
+        stream.close();
+    }
+
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    ASSERT_TRUE(stream.load("schema"));
+    ASSERT_EQ((size_t) ITEMS, stream.getAll().size());
+    ASSERT_EQ(1000, item(stream, 0)->getFieldValue("value").get_integer());
+    ASSERT_EQ(1u, item(stream, 0)->getAllReferences().size());
+    ASSERT_EQ((size_t) PAYLOAD, item(stream, ITEMS - 1)->getFieldValue("payload").get_string().size());
+    stream.close();
+}
+
+TEST_F(TestMemoryBudget, RemovingBudgetReloadsValues)
+{
+    writeFile(StorageSidecar);
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    stream.setMemoryBudget(10 * PAYLOAD);
+    ASSERT_TRUE(stream.load("schema"));
+    ASSERT_GT(countEvicted(stream), 0u);
+
+    stream.setMemoryBudget(0);
+    ASSERT_EQ(0u, countEvicted(stream));
+    stream.close();
+    ASSERT_EQ((size_t) PAYLOAD, item(stream, ITEMS / 2)->getFieldValue("payload").get_string().size());
+}
+
+TEST_F(TestMemoryBudget, QueriesReloadEvictedItems)
+{
+    writeFile(StorageMemory);
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    stream.setMemoryBudget(10 * PAYLOAD);
+    ASSERT_TRUE(stream.load("schema"));
+    // items are scanned by id, so the last frames are evicted again after every query
+    ASSERT_TRUE(item(stream, ITEMS - 1)->isEvicted());
+    FieldValue value("value", (vmf_integer) ITEMS - 1);
+    ASSERT_EQ(1u, stream.queryByNameAndValue("desc", value).size());
+    ASSERT_TRUE(item(stream, ITEMS - 1)->isEvicted());
+    ASSERT_EQ(1u, stream.queryByNameAndFields("desc", std::vector<FieldValue>(1, value)).size());
+
+    ASSERT_TRUE(item(stream, ITEMS - 1)->isEvicted());
+    ASSERT_EQ(1u, stream.queryByReference("desc", value).size());
+    ASSERT_TRUE(item(stream, ITEMS - 1)->isEvicted());
+    ASSERT_EQ(1u, stream.queryByReference("desc", std::vector<FieldValue>(1, value)).size());
+    ASSERT_EQ((size_t) ITEMS - 1, stream.queryByReference([](const std::shared_ptr<Metadata>&, const std::shared_ptr<Metadata>&)
+    {
+        return true;
+    }).size());
+    ASSERT_LE(stream.getMemoryUsage(), stream.getMemoryBudget());
+    stream.close();
+}
+
+TEST_F(TestMemoryBudget, ReadsDontPinItems)
+{
+    writeFile(StorageMemory);
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    ASSERT_TRUE(stream.load("schema"));
+    stream.setMemoryBudget(10 * PAYLOAD);
+
+    std::shared_ptr<Metadata> read = item(stream, 0);
+    ASSERT_NE(read->end(), read->findField("payload"));
+    for (size_t i = 1; i < ITEMS; i++)
+        item(stream, i)->getFieldValue("payload");
+    ASSERT_TRUE(read->isEvicted());
+    stream.close();
+}
+
+TEST_F(TestMemoryBudget, ConcurrentReadsAreCounted)
+{
+    writeFile(StorageMemory);
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    ASSERT_TRUE(stream.load("schema"));
+    stream.setMemoryBudget(10 * ITEMS * PAYLOAD);
+
+    const size_t reads = 1000;
+    std::vector<std::thread> readers;
+    for (size_t t = 0; t < 4; t++)
+    {
+        readers.push_back(std::thread([&, t]()
+        {
+            for (size_t i = 0; i < reads; i++)
+            {
+                const Metadata& md = *item(stream, (t + i) % ITEMS);
+                md.getFieldValue("value");
+            }
+        }));
+    }
+    for (auto& reader : readers)
+        reader.join();
+    ASSERT_EQ(4 * reads, stream.getCacheStatistics().hits);
+    ASSERT_EQ(0u, stream.getCacheStatistics().misses);
+    stream.close();
+}
+
+TEST_F(TestMemoryBudget, EvictedValuesAreSavedToAnotherFile)
+{
+    const std::string copyPath = "memory_budget_copy.avi";
+    writeFile(StorageEmbedded);
+    copyFile(TEST_FILE_SRC, copyPath);
+    {
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+        stream.setMemoryBudget(10 * PAYLOAD);
+        ASSERT_TRUE(stream.load("schema"));
+        ASSERT_GT(countEvicted(stream), 0u);
+        stream.close();
+        ASSERT_EQ(0u, countEvicted(stream));
+        ASSERT_TRUE(stream.saveTo(copyPath));
+    }
+
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(copyPath, MetadataStream::ReadOnly));
+    ASSERT_TRUE(stream.load("schema"));
+    ASSERT_EQ((size_t) ITEMS, stream.getAll().size());
+    ASSERT_EQ((size_t) PAYLOAD, item(stream, ITEMS - 1)->getFieldValue("payload").get_string().size());
+    stream.close();
+    std::remove(copyPath.c_str());
+}
+
+TEST_F(TestMemoryBudget, ParallelSerialization)
+{
+    writeFile(StorageMemory);
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    stream.setMemoryBudget(10 * PAYLOAD);
+    ASSERT_TRUE(stream.load("schema"));
+    ASSERT_GT(countEvicted(stream), 0u);
+
+    XMLWriter writer;
+    std::string parallel = stream.serialize(writer, 4);
+    ASSERT_EQ(10 * PAYLOAD, stream.getMemoryBudget());
+    ASSERT_LE(stream.getMemoryUsage(), stream.getMemoryBudget());
+    ASSERT_EQ(parallel, stream.serialize(writer, 1));
+
+    ASSERT_EQ(parallel, stream.serialize(writer));
+    ASSERT_LE(stream.getMemoryUsage(), stream.getMemoryBudget());
+    std::ostringstream output;
+    stream.serialize(output, writer);
+    ASSERT_EQ(parallel, output.str());
+    ASSERT_LE(stream.getMemoryUsage(), stream.getMemoryBudget());
+    std::string chunks;
+    stream.serialize([&chunks](const char* data, size_t size) { chunks.append(data, size); }, writer);
+    ASSERT_EQ(parallel, chunks);
+    ASSERT_LE(stream.getMemoryUsage(), stream.getMemoryBudget());
+    ASSERT_GT(countEvicted(stream), 0u);
+
+    stream.setMemoryBudget(0);
+    ASSERT_EQ(parallel, stream.serialize(writer));
+    stream.close();
+}
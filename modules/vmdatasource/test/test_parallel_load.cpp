@@ -0,0 +1,133 @@
+/*
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vmf/vmf.hpp>
+#include "utils.hpp"
+
+#if TARGET_OS_IPHONE
+extern std::string tempPath;
+#define TEST_FILE (tempPath + "global_test.avi")
+#else
+#define TEST_FILE "global_test.avi"
+#endif /* TARGET_OS_IPHONE */
+
+#define ITEMS 1000
+
+using namespace vmf;
+
+class TestParallelLoad : public TestWithVideoFile
+{
+protected:
+    TestParallelLoad() : TestWithVideoFile(TEST_FILE) {}
+
+    void SetUp()
+    {
+        TestWithVideoFile::SetUp();
+
+        spSchema = std::make_shared<MetadataSchema>("schema");
+        std::vector<FieldDesc> vFields;
+        vFields.push_back(FieldDesc("value", Variant::type_integer));
+        vFields.push_back(FieldDesc("name", Variant::type_string));
+        vFields.push_back(FieldDesc("position", Variant::type_vec2d));
+        std::vector<std::shared_ptr<ReferenceDesc>> vRefs;
+        vRefs.push_back(std::make_shared<ReferenceDesc>("previous"));
+        for (int i = 0; i < 3; i++)
+        {
+            std::shared_ptr<MetadataDesc> spDesc = std::make_shared<MetadataDesc>("desc" + std::to_string(i), vFields, vRefs);
+            spSchema->add(spDesc);
+        }
+
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+        stream.addSchema(spSchema);
+        // long names are compressed
+        stream.setCompression(100);
+        std::shared_ptr<Metadata> previous;
+        for (int i = 0; i < ITEMS; i++)
+        {
+            std::shared_ptr<Metadata> md = std::make_shared<Metadata>(spSchema->findMetadataDesc("desc" + std::to_string(i % 3)));
+            md->setFieldValue("value", (vmf_integer) i);
+            md->setFieldValue("name", std::string(i % 2 ? 200 : 10, (char) ('a' + i % 26)));
+            md->setFieldValue("position", vmf_vec2d(i, -i));
+            md->setFrameIndex(i);
+            stream.add(md);
+            if (previous)
+                md->addReference(previous, "previous");
+            previous = md;
+        }
+        ASSERT_TRUE(stream.save());
+        stream.close();
+    }
+
+    void checkItems(const MetadataStream& stream, size_t count = ITEMS)
+    {
+        MetadataSet set = stream.getAll();
+        ASSERT_EQ(count, set.size());
+        for (size_t i = 0; i < count; i++)
+        {
+            std::shared_ptr<Metadata> md = stream.queryByFrameIndex(i)[0];
+            ASSERT_EQ("desc" + std::to_string(i % 3), md->getName());
+            ASSERT_EQ((vmf_integer) i, md->getFieldValue("value").get_integer());
+            ASSERT_EQ(std::string(i % 2 ? 200 : 10, (char) ('a' + i % 26)), md->getFieldValue("name").get_string());
+            ASSERT_EQ(vmf_vec2d((double) i, -(double) i), md->getFieldValue("position").get_vec2d());
+            ASSERT_EQ(i ? 1u : 0u, md->getAllReferences().size());
+            if (i)
+            {
+                ASSERT_EQ((vmf_integer) i - 1, md->getFirstReference("desc" + std::to_string((i - 1) % 3))->getFieldValue("value").get_integer());
+            }
+        }
+    }
+
+    std::shared_ptr<MetadataSchema> spSchema;
+};
+
+TEST_F(TestParallelLoad, SameAsSequential)
+{
+    for (unsigned int threads = 1; threads <= 4; threads *= 2)
+    {
+        MetadataStream stream;
+        stream.setLoadThreads(threads);
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+        ASSERT_TRUE(stream.load("schema"));
+        checkItems(stream);
+        stream.close();
+    }
+}
+
+TEST_F(TestParallelLoad, LoadItemsOnDemand)
+{
+    MetadataStream stream;
+    stream.setLoadThreads(4);
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    ASSERT_TRUE(stream.loadByFrameIndex(ITEMS / 2, ITEMS / 2));
+    // the rest is loaded by references
+    checkItems(stream);
+    stream.close();
+}
+
+TEST_F(TestParallelLoad, LoadProperty)
+{
+    MetadataStream stream;
+    stream.setLoadThreads(0);
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    ASSERT_TRUE(stream.load("schema", "desc1"));
+    // items following the last item of the property aren't referenced
+    checkItems(stream, ITEMS - 2);
+    stream.close();
+}
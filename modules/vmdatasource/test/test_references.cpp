@@ -390,6 +390,51 @@ TEST_F(TestSaveLoadReference, RecursiveReference)
     }
 }
 
+TEST_F(TestSaveLoadReference, LongReferenceChain)
+{
+    const int chain = 2000;
+    {
+        vmf::MetadataStream stream;
+        stream.open(TEST_FILE, vmf::MetadataStream::ReadWrite);
+        stream.addSchema(schema[0]);
+        stream.addSchema(schema[1]);
+        std::shared_ptr<vmf::Metadata> previous;
+        for (int i = 0; i < chain; i++)
+        {
+            std::shared_ptr<vmf::Metadata> metadata(new vmf::Metadata(desc[1]));
+            metadata->addValue((vmf::vmf_integer) i);
+            stream.add(metadata);
+            if (previous)
+                metadata->addReference(previous);
+            previous = metadata;
+        }
+        std::shared_ptr<vmf::Metadata> head(new vmf::Metadata(desc[0]));
+        head->addValue(TEST_STRING_VAL);
+        stream.add(head);
+        head->addReference(previous);
+        stream.save();
+        stream.close();
+    }
+
+    {
+        vmf::MetadataStream stream;
+        stream.open(TEST_FILE, vmf::MetadataStream::ReadOnly);
+        ASSERT_TRUE(stream.load(TEST_SCHEMA_NAME_0));
+        stream.close();
+
+        ASSERT_EQ((size_t) chain + 1, stream.getAll().size());
+        std::shared_ptr<vmf::Metadata> item = stream.queryBySchema(TEST_SCHEMA_NAME_0).at(0);
+        for (int i = chain - 1; i >= 0; i--)
+        {
+            vmf::MetadataSet next = item->getReferencesByMetadata(TEST_DESC_NAME_1);
+            ASSERT_EQ(1u, next.size());
+            item = next[0];
+            ASSERT_EQ(i, (vmf::vmf_integer) item->at(0));
+        }
+        ASSERT_TRUE(item->getAllReferences().empty());
+    }
+}
+
 TEST_F(TestSaveLoadReference, ToItselfReference)
 {
     {
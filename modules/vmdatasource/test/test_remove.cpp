@@ -144,6 +144,36 @@ TEST_F(TestRemoving, RemoveOne)
 }
 
 
+TEST_F(TestRemoving, RemoveAndUpdateInOneSave)
+{
+    {
+        vmf::MetadataStream newStream;
+        newStream.open(TEST_FILE, vmf::MetadataStream::ReadWrite);
+        newStream.load(TEST_SCHEMA_NAME);
+        auto set = newStream.queryByName(TEST_PROPERTY_NAME1);
+        // stored paths of items following the removed one are shifted
+        newStream.remove(set[0]->getId());
+        set[n - 1]->setFieldValue(TEST_FIELD_NAME, 100);
+        std::shared_ptr<vmf::Metadata> md(new vmf::Metadata(descr1));
+        md->setFieldValue(TEST_FIELD_NAME, 200);
+        newStream.add(md);
+        newStream.save();
+        newStream.close();
+    }
+    {
+        vmf::MetadataStream newStream;
+        newStream.open(TEST_FILE, vmf::MetadataStream::ReadOnly);
+        newStream.load(TEST_SCHEMA_NAME);
+        auto set = newStream.queryByName(TEST_PROPERTY_NAME1);
+        ASSERT_EQ(n, set.size());
+        ASSERT_EQ(1, (vmf::vmf_integer) set[0]->getFieldValue(TEST_FIELD_NAME));
+        ASSERT_EQ(100, (vmf::vmf_integer) set[n - 2]->getFieldValue(TEST_FIELD_NAME));
+        ASSERT_EQ(200, (vmf::vmf_integer) set[n - 1]->getFieldValue(TEST_FIELD_NAME));
+        ASSERT_EQ(n, newStream.queryByName(TEST_PROPERTY_NAME2).size());
+        newStream.close();
+    }
+}
+
 TEST_F(TestRemoving, RemoveSet)
 {
     {
@@ -0,0 +1,199 @@
+/*
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vmf/vmf.hpp>
+#include "utils.hpp"
+
+#if TARGET_OS_IPHONE
+extern std::string tempPath;
+#define TEST_FILE (tempPath + "global_test.avi")
+#else
+#define TEST_FILE "global_test.avi"
+#endif /* TARGET_OS_IPHONE */
+
+#define ITEMS 100
+
+using namespace vmf;
+
+class TestSaveAsync : public TestWithVideoFile
+{
+protected:
+    TestSaveAsync() : TestWithVideoFile(TEST_FILE) {}
+
+    void SetUp()
+    {
+        TestWithVideoFile::SetUp();
+
+        spSchema = std::make_shared<MetadataSchema>("schema");
+        std::vector<FieldDesc> vFields;
+        vFields.push_back(FieldDesc("value", Variant::type_integer));
+        vFields.push_back(FieldDesc("name", Variant::type_string));
+        std::vector<std::shared_ptr<ReferenceDesc>> vRefs;
+        vRefs.push_back(std::make_shared<ReferenceDesc>("previous"));
+        spDesc = std::make_shared<MetadataDesc>("desc", vFields, vRefs);
+        spSchema->add(spDesc);
+    }
+
+    // Every item refers to the previous one
+    void addItems(MetadataStream& stream, size_t first, size_t count)
+    {
+        std::shared_ptr<Metadata> previous = first ? stream.queryByFrameIndex(first - 1)[0] : nullptr;
+        for (size_t i = first; i < first + count; i++)
+        {
+            std::shared_ptr<Metadata> md = std::make_shared<Metadata>(spDesc);
+            md->setFieldValue("value", (vmf_integer) i);
+            md->setFieldValue("name", "item" + std::to_string(i));
+            md->setFrameIndex(i);
+            stream.add(md);
+            if (previous)
+                md->addReference(previous, "previous");
+            previous = md;
+        }
+    }
+
+    static void checkFile(size_t count, vmf_integer firstValue = 0)
+    {
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+        ASSERT_TRUE(stream.load("schema"));
+        ASSERT_EQ(count, stream.getAll().size());
+        for (size_t i = 0; i < count; i++)
+        {
+            std::shared_ptr<Metadata> md = stream.queryByFrameIndex(i)[0];
+            ASSERT_EQ(i ? (vmf_integer) i : firstValue, md->getFieldValue("value").get_integer());
+            ASSERT_EQ("item" + std::to_string(i), md->getFieldValue("name").get_string());
+            if (i)
+            {
+                ASSERT_EQ((vmf_integer) i - 1, md->getFirstReference("desc")->getFrameIndex());
+            }
+        }
+        stream.close();
+    }
+
+    std::shared_ptr<MetadataSchema> spSchema;
+    std::shared_ptr<MetadataDesc> spDesc;
+};
+
+TEST_F(TestSaveAsync, StoresSnapshot)
+{
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+    stream.addSchema(spSchema);
+    addItems(stream, 0, ITEMS);
+
+    std::future<bool> saved = stream.saveAsync();
+    // changes made while the snapshot is stored aren't saved
+    addItems(stream, ITEMS, ITEMS);
+    stream.queryByFrameIndex(0)[0]->setFieldValue("value", (vmf_integer) -1);
+    ASSERT_EQ((size_t) 2 * ITEMS, stream.queryBySchema("schema").size());
+    ASSERT_TRUE(saved.get());
+    checkFile(ITEMS);
+
+    ASSERT_TRUE(stream.save());
+    stream.close();
+    checkFile(2 * ITEMS, -1);
+}
+
+TEST_F(TestSaveAsync, StoresOnlyChanges)
+{
+    {
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+        stream.addSchema(spSchema);
+        addItems(stream, 0, ITEMS);
+        ASSERT_TRUE(stream.save());
+        stream.close();
+    }
+
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+    ASSERT_TRUE(stream.load("schema"));
+    stream.queryByFrameIndex(0)[0]->setFieldValue("value", (vmf_integer) -1);
+    stream.remove(stream.queryByFrameIndex(ITEMS - 1));
+    ASSERT_TRUE(stream.saveAsync().get());
+    stream.close();
+    checkFile(ITEMS - 1, -1);
+}
+
+TEST_F(TestSaveAsync, ReferencesDontDependOnStream)
+{
+    {
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+        stream.addSchema(spSchema);
+        addItems(stream, 0, ITEMS);
+        ASSERT_TRUE(stream.save());
+        stream.close();
+    }
+
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+    ASSERT_TRUE(stream.load("schema"));
+    stream.queryByFrameIndex(ITEMS - 1)[0]->setFieldValue("value", (vmf_integer) ITEMS - 1);
+    std::future<bool> saved = stream.saveAsync();
+    // the referenced item is removed while the snapshot is stored
+    stream.remove(stream.queryByFrameIndex(ITEMS - 2));
+    ASSERT_TRUE(saved.get());
+    checkFile(ITEMS);
+    stream.close();
+}
+
+TEST_F(TestSaveAsync, CancelledChangesAreSavedLater)
+{
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+    stream.addSchema(spSchema);
+    addItems(stream, 0, ITEMS);
+
+    std::future<bool> saved = stream.saveAsync();
+    stream.cancelSave();
+    if (!saved.get())
+    {
+        // the file is unchanged
+        MetadataStream check;
+        ASSERT_TRUE(check.open(TEST_FILE, MetadataStream::ReadOnly));
+        ASSERT_TRUE(check.load());
+        ASSERT_TRUE(check.getAll().empty());
+        check.close();
+    }
+
+    ASSERT_TRUE(stream.save());
+    stream.close();
+    checkFile(ITEMS);
+}
+
+TEST_F(TestSaveAsync, NotOpenedForWriting)
+{
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    ASSERT_FALSE(stream.saveAsync().get());
+    stream.close();
+}
+
+TEST_F(TestSaveAsync, CloseWaitsForSave)
+{
+    {
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+        stream.addSchema(spSchema);
+        addItems(stream, 0, ITEMS);
+        stream.saveAsync();
+    }
+    checkFile(ITEMS);
+}
@@ -0,0 +1,307 @@
+/* 
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <fstream>
+#include <cstdio>
+#include <zlib.h>
+#include <vmf/vmf.hpp>
+#include <vmf/vmdatasource.hpp>
+#include "utils.hpp"
+
+#if TARGET_OS_IPHONE
+extern std::string tempPath;
+#define TEST_FILE (tempPath + "global_test.avi")
+#else
+#define TEST_FILE "global_test.avi"
+#endif /* TARGET_OS_IPHONE */
+
+
+using namespace vmf;
+
+static long long fileSize(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    return file.is_open() ? (long long) file.tellg() : -1;
+}
+
+static std::string readFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::string& path, const std::string& content)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << content;
+}
+
+// Header line of a sidecar record as written by the data source
+static std::string recordHeader(const std::string& tag, size_t size, unsigned long payloadCrc)
+{
+    std::string header = tag + " " + std::to_string(size) + " " + std::to_string(payloadCrc);
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, (const Bytef*)header.data(), (uInt)header.size());
+    return header + " " + std::to_string(crc) + "\n";
+}
+
+class TestSidecar : public TestWithVideoFile
+{
+protected:
+    TestSidecar() : TestWithVideoFile(TEST_FILE, false) {}
+
+    void SetUp()
+    {
+        TestWithVideoFile::SetUp();
+
+        spSchema = std::make_shared<MetadataSchema>("schema");
+        std::vector<FieldDesc> vFields;
+        vFields.push_back(FieldDesc("name", Variant::type_string));
+        vFields.push_back(FieldDesc("value", Variant::type_integer));
+        std::vector<std::shared_ptr<ReferenceDesc>> vRefs;
+        vRefs.push_back(std::make_shared<ReferenceDesc>("parent"));
+        spDesc = std::make_shared<MetadataDesc>("desc", vFields, vRefs);
+        spSchema->add(spDesc);
+    }
+
+    void saveItems(int from, int to)
+    {
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+        if (stream.getSchema("schema"))
+            ASSERT_TRUE(stream.load());
+        else
+            stream.addSchema(spSchema);
+        for (int i = from; i < to; i++)
+        {
+            std::shared_ptr<Metadata> md(new Metadata(stream.getSchema("schema")->findMetadataDesc("desc")));
+            md->setFieldValue("name", "item" + std::to_string(i));
+            md->setFieldValue("value", i);
+            md->setFrameIndex(i);
+            MetadataSet prev = stream.queryByFrameIndex(i - 1);
+            if (!prev.empty())
+                md->addReference(prev[0], "parent");
+            stream.add(md);
+        }
+        ASSERT_TRUE(stream.save());
+        stream.close();
+    }
+
+    void checkItems(int count)
+    {
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+        ASSERT_TRUE(stream.load());
+        stream.close();
+
+        MetadataSet set = stream.queryByName("desc");
+        ASSERT_EQ((size_t) count, set.size());
+        for (int i = 0; i < count; i++)
+        {
+            MetadataSet item = stream.queryByFrameIndex(i);
+            ASSERT_EQ(1u, item.size());
+            ASSERT_EQ("item" + std::to_string(i), (vmf_string) item[0]->getFieldValue("name"));
+            ASSERT_EQ(i, (vmf_integer) item[0]->getFieldValue("value"));
+            if (i > 0)
+            {
+                MetadataSet parent = item[0]->getReferencesByName("parent");
+                ASSERT_EQ(1u, parent.size());
+                ASSERT_EQ(i - 1, parent[0]->getFrameIndex());
+            }
+        }
+    }
+
+    std::shared_ptr<MetadataSchema> spSchema;
+    std::shared_ptr<MetadataDesc> spDesc;
+};
+
+TEST_F(TestSidecar, SaveLoad)
+{
+    vmf::initialize(StorageSidecar);
+    long long mediaSize = fileSize(TEST_FILE);
+
+    saveItems(0, 10);
+
+    ASSERT_EQ(mediaSize, fileSize(TEST_FILE));
+    ASSERT_GT(fileSize(vmf::getSidecarPath(TEST_FILE)), 0);
+    checkItems(10);
+}
+
+TEST_F(TestSidecar, AppendOnly)
+{
+    vmf::initialize(StorageSidecar);
+
+    saveItems(0, 10);
+    long long logSize = fileSize(vmf::getSidecarPath(TEST_FILE));
+    saveItems(10, 11);
+    long long appended = fileSize(vmf::getSidecarPath(TEST_FILE)) - logSize;
+
+    ASSERT_GT(appended, 0);
+    ASSERT_LT(appended, logSize / 5);
+    checkItems(11);
+}
+
+TEST_F(TestSidecar, SavesOnlyChangedItems)
+{
+    vmf::initialize(StorageSidecar);
+    saveItems(0, 10);
+    std::string sidecarPath = vmf::getSidecarPath(TEST_FILE);
+    long long logSize = fileSize(sidecarPath);
+
+    for (int change = 0; change < 2; change++)
+    {
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+        ASSERT_TRUE(stream.load());
+        if (change)
+            stream.queryByFrameIndex(3)[0]->setFieldValue("value", 3);
+        ASSERT_TRUE(stream.save());
+        stream.close();
+        if (!change)
+        {
+            ASSERT_EQ(logSize, fileSize(sidecarPath));
+        }
+    }
+    long long appended = fileSize(sidecarPath) - logSize;
+    ASSERT_GT(appended, 0);
+    ASSERT_LT(appended, logSize / 5);
+    checkItems(10);
+}
+
+TEST_F(TestSidecar, RemoveAndVideoSegments)
+{
+    vmf::initialize(StorageSidecar);
+    saveItems(0, 3);
+
+    {
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+        ASSERT_TRUE(stream.load());
+        stream.remove(stream.queryByFrameIndex(2));
+        stream.addVideoSegment(std::make_shared<MetadataStream::VideoSegment>("segment", 25, 0, 1000));
+        stream.setChecksum("checksum");
+        ASSERT_TRUE(stream.save());
+        stream.close();
+    }
+
+    checkItems(2);
+
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    ASSERT_EQ(1u, stream.getAllVideoSegments().size());
+    ASSERT_EQ("segment", stream.getAllVideoSegments()[0]->getTitle());
+    ASSERT_EQ("checksum", stream.getChecksum());
+    stream.close();
+}
+
+TEST_F(TestSidecar, InterruptedRecord)
+{
+    vmf::initialize(StorageSidecar);
+    saveItems(0, 5);
+
+    {
+        std::ofstream log(vmf::getSidecarPath(TEST_FILE), std::ios::binary | std::ios::app);
+        log << recordHeader("item", 1000, 0) << "3:sch";
+    }
+
+    checkItems(5);
+    saveItems(5, 6);
+    checkItems(6);
+
+    {
+        std::ofstream log(vmf::getSidecarPath(TEST_FILE), std::ios::binary | std::ios::app);
+        log << "item 10";
+    }
+
+    checkItems(6);
+    saveItems(6, 7);
+    checkItems(7);
+}
+
+TEST_F(TestSidecar, CorruptedRecord)
+{
+    vmf::initialize(StorageSidecar);
+    saveItems(0, 5);
+    std::string sidecarPath = vmf::getSidecarPath(TEST_FILE);
+    std::string original = readFile(sidecarPath);
+    size_t header = original.find("\nitem ") + 1;
+    size_t payload = original.find('\n', header) + 1;
+    ASSERT_LT(payload, original.size() / 2);
+
+    // a damaged size or payload in the middle of the log fails the open and leaves the log unchanged
+    std::string damagedSize = original;
+    damagedSize[header + 5] ^= 1;
+    std::string damagedPayload = original;
+    damagedPayload[payload + 2] ^= 1;
+    std::string damaged[] = { damagedSize, damagedPayload };
+    for (auto& content : damaged)
+    {
+        writeFile(sidecarPath, content);
+        MetadataStream stream;
+        ASSERT_FALSE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+        ASSERT_EQ(content, readFile(sidecarPath));
+    }
+
+    writeFile(sidecarPath, original);
+    checkItems(5);
+}
+
+TEST_F(TestSidecar, Compaction)
+{
+    vmf::initialize(StorageSidecar);
+    saveItems(0, 1);
+    for (int i = 0; i < 1500; i++)
+    {
+        MetadataStream stream;
+        ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadWrite));
+        ASSERT_TRUE(stream.load());
+        stream.getAll()[0]->setFieldValue("value", i);
+        ASSERT_TRUE(stream.save());
+        stream.close();
+    }
+    ASSERT_LT(fileSize(vmf::getSidecarPath(TEST_FILE)), 64 * 1024);
+
+    MetadataStream stream;
+    ASSERT_TRUE(stream.open(TEST_FILE, MetadataStream::ReadOnly));
+    ASSERT_TRUE(stream.load());
+    ASSERT_EQ(1499, (vmf_integer) stream.getAll()[0]->getFieldValue("value"));
+    stream.close();
+}
+
+TEST_F(TestSidecar, EmbedOnClose)
+{
+    vmf::initialize(StorageEmbeddedAndSidecar);
+    saveItems(0, 5);
+    vmf::terminate();
+
+    std::remove(vmf::getSidecarPath(TEST_FILE).c_str());
+    vmf::initialize();
+    checkItems(5);
+}
+
+TEST_F(TestSidecar, Embed)
+{
+    vmf::initialize(StorageSidecar);
+    saveItems(0, 5);
+    vmf::embedSidecar(TEST_FILE);
+    vmf::terminate();
+
+    vmf::initialize();
+    checkItems(5);
+}
@@ -15,7 +15,9 @@
  *
  */
 #include <fstream>
+#include <cstdio>
 #include "test_precomp.hpp"
+#include "vmf/vmdatasource.hpp"
 
 using namespace std;
 using namespace vmf;
@@ -33,3 +35,22 @@ void copyFile(const string& src, const string& dest)
     destination.close();
     source.close();
 }
+
+TestWithVideoFile::TestWithVideoFile(const string& file, bool initialize)
+    : testFile(file), initializeLibrary(initialize)
+{
+}
+
+void TestWithVideoFile::SetUp()
+{
+    copyFile(VIDEO_FILE, testFile);
+    std::remove(getSidecarPath(testFile).c_str());
+    if (initializeLibrary)
+        vmf::initialize();
+}
+
+void TestWithVideoFile::TearDown()
+{
+    vmf::terminate();
+    std::remove(getSidecarPath(testFile).c_str());
+}
@@ -18,6 +18,7 @@
 #define __TEST_UTILS_HPP__
 
 #include <string>
+#include "gtest/gtest.h"
 
 extern std::string workingPath;
 #define VIDEO_FILE (workingPath + "/BlueSquare.avi")
@@ -26,4 +27,19 @@ extern std::string workingPath;
 
 void copyFile(const std::string& src, const std::string& dest);
 
+// Copies the test video to the file used by the test and initializes the library,
+// the library is terminated and the sidecar file of the copy is removed after the test
+class TestWithVideoFile : public ::testing::Test
+{
+protected:
+    // tests selecting the storage call vmf::initialize() themselves
+    explicit TestWithVideoFile(const std::string& file, bool initialize = true);
+
+    virtual void SetUp();
+    virtual void TearDown();
+
+    std::string testFile;
+    bool initializeLibrary;
+};
+
 #endif // __TEST_UTILS_HPP__
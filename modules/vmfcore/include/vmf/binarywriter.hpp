@@ -0,0 +1,77 @@
+/* 
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*!
+* \file binarywriter.hpp
+* \brief %BinaryWriter class header file
+*/
+
+#ifndef __VMF_BINARYWRITER_H__
+#define __VMF_BINARYWRITER_H__
+
+#include "metadataset.hpp"
+#include "metadataschema.hpp"
+#include "iwriter.hpp"
+#include <ostream>
+
+namespace vmf
+{
+/*!
+* class BinaryWriter
+* \brief BinaryWriter class is a %IWriter interface implementation for compact binary format representation
+* \details The format is intended for transport between processes rather than for storage.
+* Integers are written as varints (signed ones are zigzag encoded, ids as deltas), reals as 8 byte IEEE 754 numbers,
+* strings and buffers are prefixed by their length. Field values are written in their own types without text conversion.
+* Descriptions used by metadata items are put to a dictionary on first use and referred by their index.
+* The text returned by store() is binary data that may contain zero bytes.
+*/
+class VMF_EXPORT BinaryWriter : public IWriter
+{
+public:
+    /*!
+    * \brief Default class constructor
+    */
+    BinaryWriter();
+
+    /*!
+    * \brief Class destructor
+    */
+    ~BinaryWriter();
+
+    // IWriter implementation
+    virtual std::string store(const std::vector<std::shared_ptr<MetadataSchema>>& schemas);
+    virtual std::string store(const MetadataSet& set);
+    virtual std::string store(const IdType& nextId,
+                              const std::string& filepath,
+                              const std::string& checksum,
+                              const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments,
+                              const std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+                              const MetadataSet& set);
+    virtual std::string store(const std::shared_ptr<MetadataStream::VideoSegment>& spSegment);
+    virtual std::string store(const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments);
+    virtual void store(std::ostream& output, const IdType& nextId,
+                       const std::string& filepath,
+                       const std::string& checksum,
+                       const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments,
+                       const std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+                       const MetadataSet& set);
+    using IWriter::store;
+};
+
+}//vmf
+
+#endif //__VMF_BINARYWRITER_H__
@@ -134,6 +134,19 @@ typedef int64_t IdType;
 
 static const IdType INVALID_ID = -1;
 
+/*!
+* \typedef ChunkSink
+* \brief Receives serialized text by chunks, the data is valid only during the call
+*/
+typedef std::function<void(const char* data, size_t size)> ChunkSink;
+
+/*!
+* \typedef ChunkSource
+* \brief Provides text to be deserialized by chunks: fills the buffer of the specified size
+* and returns the number of bytes put there, 0 at the end of the text
+*/
+typedef std::function<size_t(char* buffer, size_t size)> ChunkSource;
+
 template<typename P> struct select1st
 {
     typename P::first_type const& operator()( P const& p ) const
@@ -28,6 +28,8 @@
 
 #include "metadatainternal.hpp"
 #include "metadatastream.hpp"
+#include "readfilter.hpp"
+#include <istream>
 
 namespace vmf
 {
@@ -64,6 +66,43 @@ public:
         std::vector<std::shared_ptr<MetadataInternal>>& metadata ) = 0;
 
     virtual bool parseVideoSegments(const std::string& text, std::vector<std::shared_ptr<MetadataStream::VideoSegment> >& segments) = 0;
+
+    /*!
+    * \brief Deserialize the input to the stream. Used for "stream.deserialize(input)" implementation.
+    * \details Streaming readers parse the input by parts and add items to the stream as soon as they are parsed,
+    * so the whole text is never kept in memory and items parsed before an error are kept in the stream.
+    * The default implementation reads the whole input and passes it to parseText().
+    * \return false if the input can't be parsed
+    */
+    virtual bool parseStream(std::istream& input, MetadataStream& stream);
+
+    /*!
+    * \brief Deserialize the text to the stream using parseAll(). Used for "stream.deserialize(text)" implementation.
+    * \details Nothing is added to the stream if the text can't be parsed.
+    * \return false if the text can't be parsed
+    */
+    bool parseText(const std::string& text, MetadataStream& stream);
+
+    /*!
+    * \brief Deserialize the text provided by chunks to the stream
+    * \details Works as the overload reading std::istream. An exception thrown by the source is passed to the caller.
+    */
+    bool parseStream(const ChunkSource& source, MetadataStream& stream);
+
+    /*!
+    * \brief Set the filter of schemas and metadata items kept by the parse methods
+    * \details Metadata items that don't pass the filter are skipped while the input is parsed,
+    * references to them aren't wired. Video segments are always kept.
+    */
+    void setFilter(const ReadFilter& filter);
+
+    /*!
+    * \brief Get the filter of schemas and metadata items kept by the parse methods
+    */
+    const ReadFilter& getFilter() const;
+
+protected:
+    ReadFilter filter;
 };
 
 }//vmf
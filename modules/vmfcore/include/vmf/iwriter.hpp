@@ -27,6 +27,7 @@
 #define __VMF_IWRITER_H__
 
 #include "metadatastream.hpp"
+#include <ostream>
 
 namespace vmf
 {
@@ -67,6 +68,47 @@ public:
     */
     virtual std::string store(const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments) = 0;
 
+    /*!
+    * \brief Export all the stream metadata including schemas to the output. Used for "stream.serialize(output)" implementation.
+    * \details The text is the same as returned by store() for these arguments. Streaming writers write it by parts,
+    * so the whole text is never kept in memory. The default implementation writes the text returned by store().
+    * \throw InternalErrorException if the output fails
+    */
+    virtual void store(std::ostream& output,
+                       const IdType& nextId,
+                       const std::string& filepath,
+                       const std::string& checksum,
+                       const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments,
+                       const std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+                       const MetadataSet& set );
+
+    /*!
+    * \brief Export all the stream metadata including schemas to the output formatting metadata items on several threads
+    * \details Items are split into chunks formatted on worker threads and the chunk texts are written in order,
+    * so the output is the same as written by the sequential overload. The default implementation stores items sequentially.
+    * \param threads [in] number of threads, zero selects the number of cores
+    * \throw InternalErrorException if the output fails
+    */
+    virtual void store(std::ostream& output,
+                       const IdType& nextId,
+                       const std::string& filepath,
+                       const std::string& checksum,
+                       const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments,
+                       const std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+                       const MetadataSet& set,
+                       unsigned int threads);
+
+    /*!
+    * \brief Export all the stream metadata including schemas by chunks passed to the sink
+    * \details Works as the overload writing to std::ostream. An exception thrown by the sink is passed to the caller.
+    */
+    void store(const ChunkSink& sink,
+               const IdType& nextId,
+               const std::string& filepath,
+               const std::string& checksum,
+               const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments,
+               const std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+               const MetadataSet& set );
 };
 
 }//vmf
@@ -33,6 +33,7 @@
 #include "metadataschema.hpp"
 #include "metadatastream.hpp"
 #include "ireader.hpp"
+#include <istream>
 
 namespace vmf
 {
@@ -66,6 +67,25 @@ public:
         std::vector<std::shared_ptr<MetadataInternal>>& metadata);
 
     virtual bool parseVideoSegments(const std::string& text, std::vector<std::shared_ptr<MetadataStream::VideoSegment> >& segments);
+
+    /*!
+    * \brief Deserialize JSON document from the input to the stream without building the node tree
+    * \details The input is read by blocks and tokenized by a pull parser, video segments, schemas and metadata items
+    * are added to the stream one by one as soon as they are parsed, so memory used by the parser doesn't depend on the document size.
+    * Schemas have to precede metadata items using them, as in documents produced by %JSONWriter.
+    * Items parsed before an error are kept in the stream.
+    * \param input [in] input providing JSON document
+    * \param stream [in,out] stream to be filled
+    * \return false if the document can't be parsed
+    */
+    virtual bool parseStream(std::istream& input, MetadataStream& stream);
+    using IReader::parseStream;
+
+    /*!
+    * \brief Deserialize JSON document from the file to the stream without building the node tree
+    * \details Works as parseStream().
+    */
+    bool parseFile(const std::string& fileName, MetadataStream& stream);
 };
 
 }//vmf
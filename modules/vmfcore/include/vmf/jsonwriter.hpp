@@ -26,6 +26,7 @@
 #include "metadataset.hpp"
 #include "metadataschema.hpp"
 #include "iwriter.hpp"
+#include <ostream>
 
 namespace vmf
 {
@@ -58,6 +59,35 @@ public:
     virtual std::string store(const std::shared_ptr<MetadataStream::VideoSegment>& spSegment);
     virtual std::string store(const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments);
 
+    /*!
+    * \brief Export all the stream metadata including schemas to the output without building the node tree
+    * \details Items are formatted one by one as the set is iterated and written to the output by blocks,
+    * so memory used by the writer doesn't depend on the number of items. The output is the same as the text returned by store().
+    * \throw InternalErrorException if the output fails
+    */
+    virtual void store(std::ostream& output, const IdType& nextId,
+                       const std::string& filepath,
+                       const std::string& checksum,
+                       const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments,
+                       const std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+                       const MetadataSet& set);
+
+    /*!
+    * \brief Export all the stream metadata including schemas to the output formatting metadata items on several threads
+    * \details Each chunk of items is formatted into its own buffer on a worker thread,
+    * the buffers are written in order and the output is the same as written by the sequential overload.
+    * \param threads [in] number of threads, zero selects the number of cores
+    * \throw InternalErrorException if the output fails
+    */
+    virtual void store(std::ostream& output, const IdType& nextId,
+                       const std::string& filepath,
+                       const std::string& checksum,
+                       const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments,
+                       const std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+                       const MetadataSet& set,
+                       unsigned int threads);
+    using IWriter::store;
+
 private:
     // hiding API that may be removed soon
     virtual std::string store(const std::shared_ptr<MetadataSchema>& spSchema);
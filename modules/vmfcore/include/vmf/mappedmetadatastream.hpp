@@ -0,0 +1,190 @@
+/*
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+/*!
+* \file mappedmetadatastream.hpp
+* \brief %MappedMetadataStream class header file
+*/
+
+#ifndef __VMF_MAPPED_METADATA_STREAM_H__
+#define __VMF_MAPPED_METADATA_STREAM_H__
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable: 4251)
+#endif
+
+#include "metadatastream.hpp"
+#include <map>
+
+namespace vmf
+{
+class MappedMetadataStream;
+
+/*!
+* \class MappedMetadataItem
+* \brief %MappedMetadataItem is a light-weight view of a metadata item stored in a mapped file
+* \details The view points directly into the file mapping and stays valid while
+* the owning %MappedMetadataStream is opened.
+*/
+class VMF_EXPORT MappedMetadataItem
+{
+public:
+    IdType getId() const;
+    long long getFrameIndex() const;
+    long long getNumOfFrames() const;
+    long long getTime() const;
+    long long getDuration() const;
+    std::string getName() const;
+    std::string getSchemaName() const;
+
+    size_t getFieldCount() const;
+    std::string getFieldName(size_t index) const;
+    Variant getFieldValue(size_t index) const;
+
+    /*!
+    * \brief Get value of the field by name
+    * \return empty value if the item has no such field
+    */
+    Variant getFieldValue(const std::string& sName) const;
+
+    size_t getReferenceCount() const;
+    IdType getReferenceId(size_t index) const;
+    std::string getReferenceName(size_t index) const;
+
+private:
+    friend class MappedMetadataStream;
+    MappedMetadataItem(const MappedMetadataStream* stream, const void* record);
+
+    const MappedMetadataStream* m_pStream;
+    const void* m_pRecord;
+};
+
+/*!
+* \class MappedMetadataStream
+* \brief %MappedMetadataStream provides read-only access to metadata
+* exported to the immutable memory-mapped format
+* \details The file contains fixed-size item records sorted by id, typed field records,
+* a string table and prebuilt frame, time and name indexes, so opening the file
+* doesn't parse or allocate anything per item. Queries are answered against the mapping;
+* %Metadata objects are created only for the matched items and are cached.
+* Data are stored in the native byte order of the machine that exported them.
+*/
+class VMF_EXPORT MappedMetadataStream : public IQuery
+{
+public:
+    MappedMetadataStream();
+
+    virtual ~MappedMetadataStream();
+
+    /*!
+    * \brief Export all metadata of the stream to the mapped format
+    * \param stream [in] stream with loaded metadata
+    * \param sFilePath [in] path of the file to write
+    * \throw DataStorageException if the file can't be written
+    */
+    static void exportStream(const MetadataStream& stream, const std::string& sFilePath);
+
+    /*!
+    * \brief Map the file written by exportStream()
+    * \details The sections, item records and indices are checked against the file size once,
+    * so the item views never read outside the mapping.
+    * \param sFilePath [in] path to the file
+    * \return true on success, false if the file can't be mapped or is corrupt
+    */
+    bool open(const std::string& sFilePath);
+
+    /*!
+    * \brief Unmap the file and release all created metadata objects
+    */
+    void close();
+
+    /*!
+    * \brief Get number of metadata items in the file
+    */
+    size_t size() const;
+
+    /*!
+    * \brief Get view of the item by its position in the id order
+    */
+    MappedMetadataItem getItem(size_t index) const;
+
+    /*!
+    * \brief Find item view by id
+    * \return false if there is no such item
+    */
+    bool findById(const IdType& id, MappedMetadataItem& item) const;
+
+    std::vector<MappedMetadataItem> findByName(const std::string& sName) const;
+    std::vector<MappedMetadataItem> findByFrameIndex(size_t index) const;
+    std::vector<MappedMetadataItem> findByTime(long long startTime, long long endTime) const;
+
+    /*!
+    * \brief Get metadata object by id
+    * \return nullptr if there is no such item
+    */
+    std::shared_ptr<Metadata> getById(const IdType& id) const;
+
+    std::vector<std::string> getAllSchemaNames() const;
+    std::shared_ptr<MetadataSchema> getSchema(const std::string& sSchemaName) const;
+
+    MetadataSet getAll() const;
+
+    // IQuery implementation
+    MetadataSet query( std::function< bool( const std::shared_ptr<Metadata>& spMetadata )> filter ) const;
+    MetadataSet queryByReference( std::function< bool( const std::shared_ptr<Metadata>& spMetadata, const std::shared_ptr<Metadata>& spReference )> filter ) const;
+    MetadataSet queryByFrameIndex( size_t index ) const;
+    MetadataSet queryBySchema( const std::string& sSchemaName ) const;
+    MetadataSet queryByName( const std::string& sName ) const;
+    MetadataSet queryByNameAndValue( const std::string& sMetadataName, const vmf::FieldValue& value ) const;
+    MetadataSet queryByNameAndFields( const std::string& sMetadataName, const std::vector< vmf::FieldValue>& vFields ) const;
+    MetadataSet queryByReference( const std::string& sReferenceName ) const;
+    MetadataSet queryByReference( const std::string& sReferenceName, const vmf::FieldValue& value ) const;
+    MetadataSet queryByReference( const std::string& sReferenceName, const std::vector< vmf::FieldValue>& vFields ) const;
+
+    MetadataSet queryByTime( long long startTime, long long endTime ) const;
+
+private:
+    friend class MappedMetadataItem;
+
+    MappedMetadataStream(const MappedMetadataStream&);
+    MappedMetadataStream& operator = (const MappedMetadataStream&);
+
+    const char* getString(uint32_t offset, size_t& size) const;
+    std::string getStdString(uint32_t offset) const;
+    MetadataSet materialize(const std::vector<MappedMetadataItem>& items) const;
+    MetadataSet referencingItems(const std::string& sReferenceName) const;
+    std::shared_ptr<Metadata> createItem(const MappedMetadataItem& item) const;
+    void loadSchemas() const;
+
+    std::string m_sFilePath;
+    const char* m_pData;
+    size_t m_nSize;
+#ifdef _WIN32
+    void* m_hFile;
+    void* m_hMapping;
+#endif
+    mutable std::map< std::string, std::shared_ptr< MetadataSchema > > m_mapSchemas;
+    mutable std::map< IdType, std::shared_ptr< Metadata > > m_mapMetadata;
+};
+
+}
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+#endif /* __VMF_MAPPED_METADATA_STREAM_H__ */
@@ -152,6 +152,7 @@ public:
     * \brief Find field by name
     * \param sFieldName [in] field name
     * \return Iterator to the specified field
+    * \details Values changed through the iterator aren't tracked as modifications, use setFieldValue() instead
     */
     iterator findField( const std::string& sFieldName );
 
@@ -166,7 +167,8 @@ public:
     */
     bool hasField(const std::string& sFieldName) const
     {
-        return this->end() != findField(sFieldName);
+        const_iterator it = findField(sFieldName);
+        return it != this->end();
     }
 
     /*!
@@ -266,6 +268,20 @@ public:
     */
     bool isValid() const;
 
+    /*!
+    * \brief Check that field values and references were evicted from memory by the stream
+    * \details Named accessors reload evicted values from the data source, direct access
+    * to the vector of field values doesn't.
+    * \sa MetadataStream::setMemoryBudget()
+    */
+    bool isEvicted() const;
+
+    /*!
+    * \brief Check that the item was changed since it was loaded or saved by the stream
+    * \details Data sources use it to store only the changed items.
+    */
+    bool isModified() const;
+
     enum {
         UNDEFINED_FRAME_INDEX = -1, UNDEFINED_FRAMES_NUMBER = 0,
         UNDEFINED_TIMESTAMP = -1, UNDEFINED_DURATION = 0,
@@ -280,6 +296,8 @@ protected:
     void removeAllReferences();
     void setDescriptor( const std::shared_ptr< MetadataDesc >& spDescriptor );
     void setStreamRef(const MetadataStream* streamPtr);
+    void accessPayload() const;
+    void evictPayload();
 
 private:
     IdType			m_Id;
@@ -293,6 +311,8 @@ private:
     std::vector<Reference> m_vReferences;
     std::shared_ptr< MetadataDesc >	m_spDesc;
     const MetadataStream *m_pStream;
+    bool m_bEvicted;
+    bool m_bModified;
 };
 }
 
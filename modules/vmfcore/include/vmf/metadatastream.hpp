@@ -32,8 +32,15 @@
 #include "metadataset.hpp"
 #include "metadataschema.hpp"
 #include "iquery.hpp"
+#include <future>
+#include <istream>
+#include <list>
 #include <map>
+#include <set>
 #include <memory>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
 #include <vector>
 
 #include <algorithm>
@@ -51,6 +58,7 @@ class IWriter;
 */
 class VMF_EXPORT MetadataStream : public IQuery
 {
+    friend class Metadata;
 public:
     /*!
     * \brief File open mode enumeration
@@ -63,6 +71,15 @@ public:
 
     };
 
+    /*!
+    * \brief Media checksum algorithm enumeration
+    */
+    enum ChecksumAlgorithm
+    {
+        ChecksumMD5, /**< MD5 of the whole media part, computed sequentially */
+        ChecksumTreeHash, /**< 64-bit xxHash of fixed-size chunks combined into a root digest, chunks are hashed in parallel */
+    };
+
     class VMF_EXPORT VideoSegment
     {
     public:
@@ -97,6 +114,34 @@ public:
         long height;
     };
 
+    /*!
+    * \brief Lightweight description of a stored metadata item, no field values and references
+    */
+    struct IndexEntry
+    {
+        IndexEntry() : id(INVALID_ID), frameIndex(-1), numOfFrames(0), time(-1), duration(0) {}
+
+        IdType id;
+        std::string schema;
+        std::string name;
+        long long frameIndex;
+        long long numOfFrames;
+        long long time;
+        long long duration;
+    };
+
+    /*!
+    * \brief Counters of accesses to field values and references of loaded metadata
+    */
+    struct CacheStatistics
+    {
+        CacheStatistics() : hits(0), misses(0), evictions(0) {}
+
+        size_t hits; /**< accesses to values kept in memory */
+        size_t misses; /**< accesses to evicted values reloaded from the data source */
+        size_t evictions; /**< evictions of values from memory */
+    };
+
     /*!
     * \brief Default class constructor
     * \throw NotInitializedException if Video metadata framework library is no initialized
@@ -139,12 +184,81 @@ public:
     */
     bool load( const std::string& sSchemaName, const std::string& sMetadataName );
 
+    /*!
+    * \brief Load index of stored metadata with specified scheme
+    * \param sSchemaName [in] schema name, all schemas are indexed if it is empty string
+    * \details The index holds identifiers, names, frame and time ranges of items only.
+    * Field values are fetched on demand by loadByFrameIndex() and loadByTime().
+    */
+    bool loadIndex( const std::string& sSchemaName = "" );
+
+    /*!
+    * \brief Get index loaded by loadIndex()
+    */
+    const std::vector<IndexEntry>& getIndex() const;
+
+    /*!
+    * \brief Load indexed metadata associated with a range of frames
+    * \param nFrameIndex [in] first frame of the range
+    * \param nNumOfFrames [in] number of frames in the range
+    * \details Index of all schemas is loaded if there is no index. Referenced items are loaded too.
+    * When the range starts inside or right after the previous one, following ranges are read ahead.
+    */
+    bool loadByFrameIndex( long long nFrameIndex, long long nNumOfFrames = 1 );
+
+    /*!
+    * \brief Load indexed metadata associated with a time range
+    * \param nTime [in] start of the range
+    * \param nDuration [in] duration of the range
+    * \details Works as loadByFrameIndex() for timestamps.
+    */
+    bool loadByTime( long long nTime, long long nDuration = 0 );
+
+    /*!
+    * \brief Set number of ranges read ahead on sequential access, zero disables read-ahead
+    */
+    void setReadAhead(size_t nRanges);
+
+    /*!
+    * \brief Get number of ranges read ahead on sequential access
+    */
+    size_t getReadAhead() const;
+
+    /*!
+    * \brief Set number of threads decoding field values of loaded metadata
+    * \param nThreads [in] number of threads, zero selects number of cores
+    * \details Items are inserted into the stream and their references are resolved by the calling thread.
+    */
+    void setLoadThreads(unsigned int nThreads);
+
+    /*!
+    * \brief Get number of threads decoding field values of loaded metadata
+    */
+    unsigned int getLoadThreads() const;
+
     /*!
     * \brief Save loaded data to media file
     * \return Save operation result
     */
     bool save();
 
+    /*!
+    * \brief Save loaded data to media file on a background thread
+    * \return future holding true when the data is saved, false if the stream isn't opened for writing,
+    * the save was cancelled by cancelSave() or failed, as returned by save()
+    * \details Added, modified and removed items are copied to a snapshot, so the stream can be changed
+    * and queried while the snapshot is stored. Unmodified items are already stored and aren't copied.
+    * Calls using the data source, e.g. loading, saving, reloading of evicted values and close(),
+    * wait for the pending save first. Changes of a failed or cancelled save are stored by the next save.
+    */
+    std::future<bool> saveAsync();
+
+    /*!
+    * \brief Request cancellation of the save started by saveAsync()
+    * \details The file is left unchanged if the request comes before the changes are committed.
+    */
+    void cancelSave();
+
 
     /*!
     * \brief Save the in-memory metadata to a different video file.
@@ -183,6 +297,28 @@ public:
     */
     IdType add( std::shared_ptr< MetadataInternal >& spMetadataInternal);
 
+    /*!
+    * \brief Add parsed metadata items
+    * \details Works as add() called for each item in order, but the schema of each description is checked once
+    * and references are wired after all the items are added, so the time is linear in the number of items.
+    * References to items that aren't in the stream yet are wired when these items are added.
+    * Items added before an invalid one are kept in the stream.
+    * \param items [in] pointers to metadataInternal objects
+    * \throw ValidateException if metadata is not valid to selected scheme or description
+    * \throw IncorrectParamException if metadata with such id is already exists
+    */
+    void add( std::vector< std::shared_ptr< MetadataInternal > >& items );
+
+    /*!
+    * \brief Merge attributes of a deserialized stream into the stream
+    * \details Used by readers after the items are added: the next id isn't decreased, the file path
+    * is taken only if the stream has none and an empty checksum is ignored.
+    * \param nextIdValue [in] next id of the deserialized stream
+    * \param filePath [in] file path of the deserialized stream
+    * \param checksum [in] checksum of the deserialized stream
+    */
+    void mergeDeserializedAttributes( IdType nextIdValue, const std::string& filePath, const std::string& checksum );
+
     /*!
     * \brief Remove metadata by their id
     * \param id [in] metadata identifier
@@ -283,9 +419,48 @@ public:
 
     /*
     * \brief deserialized stream from std::string in selected format
+    * \details Nothing is added to the stream if the text can't be parsed.
+    * \throw IncorrectParamException if the text can't be parsed
     */
     void deserialize(const std::string& text, IReader& formater);
 
+    /*!
+    * \brief Serialize the stream to the output in selected format without building the whole text in memory
+    * \throw InternalErrorException if the output fails
+    */
+    void serialize(std::ostream& output, IWriter& formater);
+
+    /*!
+    * \brief Serialize the stream in selected format by chunks passed to the sink
+    */
+    void serialize(const ChunkSink& sink, IWriter& formater);
+
+    /*!
+    * \brief Serialize the stream to the output formatting metadata items on several threads
+    * \details The output is the same as written by the sequential overload.
+    * \param threads [in] number of threads, zero selects the number of cores
+    * \throw InternalErrorException if the output fails
+    */
+    void serialize(std::ostream& output, IWriter& formater, unsigned int threads);
+
+    /*!
+    * \brief Serialize the stream in std::string formatting metadata items on several threads
+    */
+    std::string serialize(IWriter& formater, unsigned int threads);
+
+    /*!
+    * \brief Deserialize the stream from the input in selected format without reading the whole text to memory
+    * \details Items parsed before an error are kept in the stream.
+    * \throw IncorrectParamException if the input can't be parsed
+    */
+    void deserialize(std::istream& input, IReader& formater);
+
+    /*!
+    * \brief Deserialize the stream in selected format from the text provided by chunks
+    * \throw IncorrectParamException if the text can't be parsed
+    */
+    void deserialize(const ChunkSource& source, IReader& formater);
+
     /*!
     * \brief Compute MD5 digest of media part of the opened file
     * \return MD5 checksum in std::string format
@@ -300,6 +475,71 @@ public:
     */
     std::string computeChecksum(long long& XMPPacketSize, long long& XMPPacketOffset);
 
+    /*!
+    * \brief Compute digest of media part of the opened file using the selected algorithm
+    * \param algorithm [in] checksum algorithm
+    * \param threads [in] number of threads reading and hashing the file, zero selects number of cores
+    * \return digest in std::string format, tree hash digests are prefixed by algorithm name
+    * while MD5 digests are stored without a prefix for compatibility
+    */
+    std::string computeChecksum(ChecksumAlgorithm algorithm, unsigned int threads = 0);
+
+    /*!
+    * \brief Recompute digest of media part of the opened file and compare it with the stored one
+    * \details The algorithm is detected by the stored digest, so existing MD5 digests remain verifiable.
+    * Data sources store a fingerprint of the media file along with the digest computed by computeChecksum(),
+    * so the file isn't hashed again if its size, modification time and packet location weren't changed.
+    * \param threads [in] number of threads reading and hashing the file, zero selects number of cores
+    * \return false if there is no stored digest or it doesn't match the media data
+    */
+    bool verifyChecksum(unsigned int threads = 0);
+
+    /*!
+    * \brief Get algorithm used to compute the digest
+    * \param checksum [in] digest returned by computeChecksum()
+    */
+    static ChecksumAlgorithm getChecksumAlgorithm(const std::string& checksum);
+
+    /*!
+    * \brief Enable storing of the chunk manifest along with the digest on save
+    * \details The manifest keeps digests of fixed-size chunks of the media part and their root digest,
+    * so corrupt regions can be located and a part of the file can be verified. It's stored only for
+    * digests computed by computeChecksum() and takes 16 bytes of the packet per chunk. Enabled by default.
+    */
+    void setChecksumManifest(bool enabled);
+
+    /*!
+    * \brief Get size and number of chunks in the manifest of the stored digest
+    * \return false if there is no manifest for the stored digest
+    */
+    bool getChecksumManifest(size_t& chunkCount, long long& chunkSize);
+
+    /*!
+    * \brief Verify chunks of media part of the opened file against the manifest of the stored digest
+    * \details Chunks are verified in batches hashed in parallel. The verification can be interrupted by the
+    * progress callback and resumed later by the call starting from the returned chunk index.
+    * \param firstChunk [in] index of the first chunk to verify
+    * \param count [in] number of chunks to verify
+    * \param corruptChunks [out] indices of chunks that don't match the manifest are appended here
+    * \param threads [in] number of threads reading and hashing the file, zero selects number of cores
+    * \param progress [in] optional callback called with index of the next chunk after every batch,
+    * the verification stops if it returns false
+    * \return index of the chunk following the last verified one
+    * \throw DataStorageException if there is no manifest for the stored digest
+    */
+    size_t verifyChecksumChunks(size_t firstChunk, size_t count, std::vector<size_t>& corruptChunks,
+                                unsigned int threads = 0, std::function<bool(size_t)> progress = nullptr);
+
+    /*!
+    * \brief Verify a byte range of media part of the opened file against the manifest of the stored digest
+    * \param offset [in] offset of the range in media part, i.e. in the file without the metadata packet
+    * \param size [in] size of the range in bytes
+    * \param threads [in] number of threads reading and hashing the file, zero selects number of cores
+    * \return indices of chunks of the range that don't match the manifest
+    * \throw DataStorageException if there is no manifest for the stored digest
+    */
+    std::vector<size_t> verifyChecksumRange(long long offset, long long size, unsigned int threads = 0);
+
     /*!
     * \brief Get MD5 digest of media part of opened file
     * \return MD5 digest of opened file.
@@ -312,6 +552,53 @@ public:
     */
     void setChecksum(const std::string& checksum);
 
+    /*!
+    * \brief Set compression of field values stored to media file
+    * \param threshold [in] minimal size (in bytes) of a stored field value to be compressed,
+    * zero disables the compression
+    * \param level [in] zlib compression level in range [0, 9], -1 selects the default level
+    * \throw IncorrectParamException if compression level is out of range
+    * \details Compression is applied to each stored field value separately on save,
+    * compressed values are recognized and decompressed on load regardless of these settings.
+    */
+    void setCompression(size_t threshold, int level = -1);
+
+    /*!
+    * \brief Get minimal size of field value to be compressed on save
+    * \return compression threshold in bytes, zero means compression is disabled
+    */
+    size_t getCompressionThreshold() const;
+
+    /*!
+    * \brief Get zlib compression level used on save
+    */
+    int getCompressionLevel() const;
+
+    /*!
+    * \brief Set limit of memory used by field values and references of metadata in the stream
+    * \param nBytes [in] memory budget in bytes, zero disables the limit
+    * \details When the budget is exceeded, values of least recently used unmodified items are evicted
+    * from memory and reloaded from the data source on access. Modified and added items are kept
+    * until they are saved. All evicted values are reloaded on close().
+    * The budget is applied to estimated sizes of values, not to the exact heap usage.
+    */
+    void setMemoryBudget(size_t nBytes);
+
+    /*!
+    * \brief Get limit of memory used by field values and references, zero if there is no limit
+    */
+    size_t getMemoryBudget() const;
+
+    /*!
+    * \brief Get estimated size of field values and references kept in memory while the budget is set
+    */
+    size_t getMemoryUsage() const;
+
+    /*!
+    * \brief Get counters of accesses to field values and references since the stream was opened
+    */
+    CacheStatistics getCacheStatistics() const;
+
     /*!
     * \brief Add new video segment
     * \throw IncorrectParamException when input segment intersected with anyone of already created segments.
@@ -338,15 +625,52 @@ public:
         long long& timestamp, long long& duration );
 
 protected:
+    struct PendingSave;
+
     void dataSourceCheck();
+    bool persist(IDataSource& source, const PendingSave* pending) const;
+    void finishPendingSave();
     std::shared_ptr<Metadata> import( MetadataStream& srcStream, std::shared_ptr< Metadata >& spMetadata, std::map< IdType, IdType >& mapIds, 
         long long nTarFrameIndex, long long nSrcFrameIndex, long long nNumOfFrames = FRAME_COUNT_ALL );
     void internalAdd(const std::shared_ptr< Metadata >& spMetadata);
 
+    struct IndexRange
+    {
+        IndexRange() : start(-1), end(-1), fetchedStart(-1), fetchedEnd(-1), maxLength(0) {}
+
+        std::vector<size_t> order;
+        long long start;
+        long long end;
+        long long fetchedStart;
+        long long fetchedEnd;
+        long long maxLength;
+    };
+
+    void buildIndexRange(IndexRange& range, bool byTime);
+    bool loadIndexed(IndexRange& range, bool byTime, long long start, long long end);
+
+    struct CacheEntry
+    {
+        std::list<Metadata*>::iterator position;
+        size_t size;
+    };
+
+    void addToSet(const std::shared_ptr< Metadata >& spMetadata);
+    void wireReferences(const std::vector< std::shared_ptr< MetadataInternal > >& items, size_t count);
+    void accessPayload(const Metadata& md) const;
+    void reloadPayload(Metadata& md);
+    void reloadPayloads();
+    void finishLoad();
+    void trackPayload(Metadata& md);
+    void untrackPayload(const Metadata& md);
+    void evictPayloads();
+    static size_t getPayloadSize(const Metadata& md);
+
 private:
     OpenMode m_eMode;
     std::string m_sFilePath;
     MetadataSet m_oMetadataSet;
+    std::unordered_map<IdType, std::shared_ptr<Metadata>> m_idIndex;
 
     std::map<IdType, std::vector<std::pair<IdType, std::string>>> m_pendingReferences;
     std::map< std::string, std::shared_ptr< MetadataSchema > > m_mapSchemas;
@@ -357,6 +681,24 @@ private:
     std::shared_ptr<IDataSource> dataSource;
     vmf::IdType nextId;
     std::string m_sChecksumMedia;
+    bool m_bChecksumManifest;
+    std::vector<IndexEntry> m_index;
+    std::set<IdType> m_fetchedIds;
+    IndexRange m_framesRange;
+    IndexRange m_timesRange;
+    size_t m_nReadAhead;
+    unsigned int m_nLoadThreads;
+    std::vector<std::shared_ptr<Metadata>> m_loadedItems;
+    // const reads update the cache state, so it's guarded for concurrent readers
+    mutable std::recursive_mutex m_cacheLock;
+    mutable std::list<Metadata*> m_cacheOrder;
+    mutable std::unordered_map<const Metadata*, CacheEntry> m_cacheEntries;
+    mutable size_t m_nMemoryUsage;
+    mutable CacheStatistics m_cacheStatistics;
+    size_t m_nMemoryBudget;
+    size_t m_nCompressionThreshold;
+    int m_nCompressionLevel;
+    std::shared_ptr<PendingSave> m_pendingSave;
 };
 
 }
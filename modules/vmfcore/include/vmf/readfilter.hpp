@@ -0,0 +1,113 @@
+/* 
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+/*!
+* \file readfilter.hpp
+* \brief %ReadFilter class header file
+*/
+
+#ifndef __VMF_READFILTER_H__
+#define __VMF_READFILTER_H__
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable: 4251)
+#endif
+
+#include "config.hpp"
+#include <map>
+#include <set>
+#include <string>
+
+namespace vmf
+{
+/*!
+* \class ReadFilter
+* \brief %ReadFilter selects schemas and metadata items kept by readers
+* \details An empty filter accepts everything. When schemas or descriptions are added, only items of them
+* and their schemas are kept. A frame window or a time window keeps only items that overlap it,
+* the windows are compared the same way as by MetadataSet::queryByFrameIndex() and MetadataSet::queryByTime().
+*/
+class VMF_EXPORT ReadFilter
+{
+public:
+    /*!
+    * \brief Default constructor, the filter accepts everything
+    */
+    ReadFilter();
+
+    /*!
+    * \brief Accept the schema and all its descriptions
+    */
+    void addSchema(const std::string& schemaName);
+
+    /*!
+    * \brief Accept the description and its schema
+    */
+    void addDescription(const std::string& schemaName, const std::string& descName);
+
+    /*!
+    * \brief Accept only items with frames overlapping the window
+    * \param firstFrame [in] index of the first frame of the window
+    * \param numOfFrames [in] number of frames in the window
+    * \throw IncorrectParamException if the index or the number is negative
+    */
+    void setFrameWindow(long long firstFrame, long long numOfFrames);
+
+    /*!
+    * \brief Accept only items with timestamps overlapping the window
+    * \param startTime [in] start of the window
+    * \param endTime [in] end of the window, it's included in the window
+    * \throw IncorrectParamException if the end precedes the start
+    */
+    void setTimeWindow(long long startTime, long long endTime);
+
+    /*!
+    * \brief Check if the filter accepts everything
+    */
+    bool isEmpty() const;
+
+    /*!
+    * \brief Check if the schema is kept
+    */
+    bool acceptsSchema(const std::string& schemaName) const;
+
+    /*!
+    * \brief Check if items of the description are kept
+    */
+    bool acceptsDescription(const std::string& schemaName, const std::string& descName) const;
+
+    /*!
+    * \brief Check if items with these frames and timestamp are kept
+    * \details The arguments have the values returned by Metadata getters, undefined values are allowed.
+    */
+    bool acceptsPosition(long long frameIndex, long long numOfFrames, long long time, long long duration) const;
+
+private:
+    std::set<std::string> schemas;
+    std::map<std::string, std::set<std::string>> descriptions;
+    bool hasFrameWindow, hasTimeWindow;
+    long long firstFrame, numOfFrames;
+    long long startTime, endTime;
+};
+
+}//vmf
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+#endif /* __VMF_READFILTER_H__ */
@@ -77,4 +77,22 @@
 #define ATTR_METADATA_DURATION_HI "duration-hi"
 #define ATTR_METADATA_DURATION_LO "duration-lo"
 
+#define BINARY_SIGNATURE "VMFB"
+#define BINARY_VERSION 1
+
+#define BINARY_RECORD_END 0
+#define BINARY_RECORD_HEADER 1
+#define BINARY_RECORD_SEGMENT 2
+#define BINARY_RECORD_SCHEMA 3
+#define BINARY_RECORD_DESCRIPTION 4
+#define BINARY_RECORD_METADATA 5
+
+#define BINARY_HAS_FRAME_IDX 0x01
+#define BINARY_HAS_NFRAMES 0x02
+#define BINARY_HAS_TIMESTAMP 0x04
+#define BINARY_HAS_DURATION 0x08
+
+#define BINARY_REFERENCE_UNIQUE 0x01
+#define BINARY_REFERENCE_CUSTOM 0x02
+
 #endif /* __VMF_RWCONST_H__ */
@@ -26,9 +26,13 @@
 #define __VMF_H__
 
 #include "vmf/metadatastream.hpp"
+#include "vmf/readfilter.hpp"
 #include "vmf/xmlreader.hpp"
 #include "vmf/xmlwriter.hpp"
 #include "vmf/jsonreader.hpp"
 #include "vmf/jsonwriter.hpp"
+#include "vmf/binaryreader.hpp"
+#include "vmf/binarywriter.hpp"
+#include "vmf/mappedmetadatastream.hpp"
 
 #endif /* __VMF_H__ */
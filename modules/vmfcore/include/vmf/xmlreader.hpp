@@ -32,6 +32,7 @@
 #include "metadataschema.hpp"
 #include "metadatastream.hpp"
 #include "ireader.hpp"
+#include <istream>
 
 namespace vmf
 {
@@ -66,6 +67,25 @@ public:
         std::vector<std::shared_ptr<MetadataInternal>>& metadata );
 
     virtual bool parseVideoSegments(const std::string& text, std::vector<std::shared_ptr<MetadataStream::VideoSegment> >& segments);
+
+    /*!
+    * \brief Deserialize XML document from the input to the stream without building the document tree
+    * \details The document is read by a pull parser, video segments, schemas and metadata items are added
+    * to the stream one by one as soon as they are parsed, so memory used by the parser doesn't depend on the document size.
+    * Schemas have to precede metadata items using them, as in documents produced by %XMLWriter.
+    * Items parsed before an error are kept in the stream.
+    * \param input [in] input providing XML document
+    * \param stream [in,out] stream to be filled
+    * \return false if the document can't be parsed
+    */
+    virtual bool parseStream(std::istream& input, MetadataStream& stream);
+    using IReader::parseStream;
+
+    /*!
+    * \brief Deserialize XML document from the file to the stream without building the document tree
+    * \details Works as parseStream().
+    */
+    bool parseFile(const std::string& fileName, MetadataStream& stream);
 };
 
 }//vmf
@@ -0,0 +1,752 @@
+/* 
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "vmf/binaryreader.hpp"
+#include "vmf/rwconst.hpp"
+#include "parseditems.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace vmf
+{
+
+namespace
+{
+
+// Decodes values from the data in memory or from the input read by blocks
+class BinaryInput
+{
+public:
+    BinaryInput(const char* data, size_t size) : input(NULL), data(data), pos(0), len(size) {}
+    explicit BinaryInput(std::istream& input) : input(&input), buffer(64 * 1024), data(&buffer[0]), pos(0), len(0) {}
+
+    unsigned char byte()
+    {
+        if(pos == len && !fill())
+            fail("Unexpected end of binary data");
+        return (unsigned char) data[pos++];
+    }
+
+    unsigned long long varint()
+    {
+        unsigned long long value = 0;
+        for(int shift = 0; shift < 64; shift += 7)
+        {
+            unsigned char b = byte();
+            value |= (unsigned long long) (b & 0x7f) << shift;
+            if(!(b & 0x80))
+                return value;
+        }
+        fail("Invalid varint in binary data");
+        return 0;
+    }
+
+    long long integer()
+    {
+        unsigned long long value = varint();
+        return (long long) (value >> 1) ^ -(long long) (value & 1);
+    }
+
+    double real()
+    {
+        unsigned char data[8];
+        read((char*) data, sizeof(data));
+        unsigned long long bits = 0;
+        for(int i = 0; i < 8; i++)
+            bits |= (unsigned long long) data[i] << (8 * i);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    std::string string()
+    {
+        std::string value;
+        bytes(value);
+        return value;
+    }
+
+    vmf_rawbuffer rawbuffer()
+    {
+        vmf_rawbuffer value;
+        bytes(value);
+        return value;
+    }
+
+    // Data is appended by blocks available, so a corrupted length doesn't cause a huge allocation
+    template <typename Bytes>
+    void bytes(Bytes& value)
+    {
+        unsigned long long size = varint();
+        while(size > 0)
+        {
+            if(pos == len && !fill())
+                fail("Unexpected end of binary data");
+            size_t part = (size_t) std::min<unsigned long long>(size, len - pos);
+            value.insert(value.end(), data + pos, data + pos + part);
+            pos += part;
+            size -= part;
+        }
+    }
+
+    void skip(unsigned long long size)
+    {
+        while(size > 0)
+        {
+            if(pos == len && !fill())
+                fail("Unexpected end of binary data");
+            size_t part = (size_t) std::min<unsigned long long>(size, len - pos);
+            pos += part;
+            size -= part;
+        }
+    }
+
+    void read(char* value, size_t size)
+    {
+        while(size > 0)
+        {
+            if(pos == len && !fill())
+                fail("Unexpected end of binary data");
+            size_t part = std::min(size, len - pos);
+            memcpy(value, data + pos, part);
+            pos += part;
+            value += part;
+            size -= part;
+        }
+    }
+
+    static void fail(const char* message)
+    {
+        VMF_EXCEPTION(vmf::IncorrectParamException, message);
+    }
+
+private:
+    bool fill()
+    {
+        if(input == NULL)
+            return false;
+        input->read(&buffer[0], buffer.size());
+        if(input->bad())
+            fail("Can't read binary input");
+        pos = 0;
+        len = (size_t) input->gcount();
+        return len > 0;
+    }
+
+    std::istream* input;
+    std::vector<char> buffer;
+    const char* data;
+    size_t pos, len;
+};
+
+// Receives parts of the data in order they are decoded
+class BinarySink
+{
+public:
+    virtual ~BinarySink() {}
+    virtual void header(const IdType& nextId, const std::string& filepath, const std::string& checksum) = 0;
+    virtual void segment(const std::shared_ptr<MetadataStream::VideoSegment>& spSegment) = 0;
+    virtual void schema(const std::shared_ptr<MetadataSchema>& spSchema) = 0;
+    virtual void metadata(const std::shared_ptr<MetadataInternal>& spMetadata) = 0;
+    // called when the data is over or fails
+    virtual void finish() = 0;
+};
+
+class StreamSink : public BinarySink
+{
+public:
+    explicit StreamSink(MetadataStream& stream) : hasHeader(false), nextId(0), stream(stream), items(stream) {}
+
+    void header(const IdType& id, const std::string& path, const std::string& sum)
+    {
+        hasHeader = true;
+        nextId = id;
+        filepath = path;
+        checksum = sum;
+    }
+
+    void segment(const std::shared_ptr<MetadataStream::VideoSegment>& spSegment)
+    {
+        stream.addVideoSegment(spSegment);
+    }
+
+    void schema(const std::shared_ptr<MetadataSchema>& spSchema)
+    {
+        std::shared_ptr<MetadataSchema> added = spSchema;
+        stream.addSchema(added);
+    }
+
+    void metadata(const std::shared_ptr<MetadataInternal>& spMetadata)
+    {
+        items.add(spMetadata);
+    }
+
+    void finish()
+    {
+        items.flush();
+    }
+
+    bool hasHeader;
+    IdType nextId;
+    std::string filepath, checksum;
+
+private:
+    MetadataStream& stream;
+    ItemBatch items;
+};
+
+class CollectSink : public BinarySink
+{
+public:
+    CollectSink() : nextId(0) {}
+
+    void header(const IdType& id, const std::string& path, const std::string& sum)
+    {
+        nextId = id;
+        filepath = path;
+        checksum = sum;
+    }
+
+    void segment(const std::shared_ptr<MetadataStream::VideoSegment>& spSegment)
+    {
+        segments.push_back(spSegment);
+    }
+
+    void schema(const std::shared_ptr<MetadataSchema>& spSchema)
+    {
+        schemas.push_back(spSchema);
+    }
+
+    void metadata(const std::shared_ptr<MetadataInternal>& spMetadata)
+    {
+        metadata_.push_back(spMetadata);
+    }
+
+    void finish()
+    {
+    }
+
+    IdType nextId;
+    std::string filepath, checksum;
+    std::vector<std::shared_ptr<MetadataStream::VideoSegment>> segments;
+    std::vector<std::shared_ptr<MetadataSchema>> schemas;
+    std::vector<std::shared_ptr<MetadataInternal>> metadata_;
+};
+
+/*
+ * Reads records, descriptions are looked up once when the dictionary record is read.
+ * Schemas rejected by the filter are kept aside to decode descriptions, values of rejected items
+ * are skipped without being decoded.
+ */
+class BinaryDecoder
+{
+public:
+    BinaryDecoder(BinaryInput& input, BinarySink& sink, std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+                  const ReadFilter& filter)
+        : input(input), sink(sink), schemas(schemas), filter(filter), lastId(0) {}
+
+    void decode()
+    {
+        char signature[sizeof(BINARY_SIGNATURE) - 1];
+        input.read(signature, sizeof(signature));
+        if(memcmp(signature, BINARY_SIGNATURE, sizeof(signature)) != 0)
+            BinaryInput::fail("Data isn't in VMF binary format");
+        if(input.varint() != BINARY_VERSION)
+            BinaryInput::fail("Unsupported version of VMF binary format");
+
+        for(;;)
+        {
+            switch(input.byte())
+            {
+            case BINARY_RECORD_END:
+                return;
+            case BINARY_RECORD_HEADER:
+            {
+                IdType nextId = input.integer();
+                std::string filepath = input.string();
+                std::string checksum = input.string();
+                sink.header(nextId, filepath, checksum);
+                break;
+            }
+            case BINARY_RECORD_SEGMENT:
+                sink.segment(readSegment());
+                break;
+            case BINARY_RECORD_SCHEMA:
+            {
+                std::shared_ptr<MetadataSchema> spSchema = readSchema();
+                if(filter.acceptsSchema(spSchema->getName()))
+                {
+                    schemas.push_back(spSchema);
+                    sink.schema(spSchema);
+                }
+                else
+                    skippedSchemas.push_back(spSchema);
+                break;
+            }
+            case BINARY_RECORD_DESCRIPTION:
+                readDescription();
+                break;
+            case BINARY_RECORD_METADATA:
+            {
+                std::shared_ptr<MetadataInternal> spMetadata = readMetadata();
+                if(spMetadata)
+                    sink.metadata(spMetadata);
+                break;
+            }
+            default:
+                BinaryInput::fail("Unknown record in binary data");
+            }
+        }
+    }
+
+private:
+    struct Description
+    {
+        std::shared_ptr<MetadataDesc> spDesc;
+        std::vector<FieldDesc> fields;
+        bool accepted;
+    };
+
+    std::shared_ptr<MetadataStream::VideoSegment> readSegment()
+    {
+        std::string title = input.string();
+        double fps = input.real();
+        long long time = input.integer();
+        long long duration = input.integer();
+        long width = (long) input.integer();
+        long height = (long) input.integer();
+
+        if(title.empty())
+            VMF_EXCEPTION(vmf::InternalErrorException, "Video segment has invalid title");
+        if(fps <= 0)
+            VMF_EXCEPTION(vmf::InternalErrorException, "Video segment has invalid fps value");
+        if(time < 0)
+            VMF_EXCEPTION(vmf::InternalErrorException, "Video segment has invalid time value");
+
+        std::shared_ptr<MetadataStream::VideoSegment> spSegment(new MetadataStream::VideoSegment(title, fps, time));
+        if(duration > 0)
+            spSegment->setDuration(duration);
+        if(width > 0 && height > 0)
+            spSegment->setResolution(width, height);
+        return spSegment;
+    }
+
+    std::shared_ptr<MetadataSchema> readSchema()
+    {
+        std::string name = input.string();
+        std::string author = input.string();
+        if(name.empty())
+            VMF_EXCEPTION(IncorrectParamException, "Schema has no name");
+        std::shared_ptr<MetadataSchema> spSchema = std::make_shared<MetadataSchema>(name, author);
+
+        for(unsigned long long descCount = input.varint(); descCount > 0; descCount--)
+        {
+            std::string descName = input.string();
+
+            std::vector<FieldDesc> vFields;
+            for(unsigned long long count = input.varint(); count > 0; count--)
+            {
+                std::string fieldName = input.string();
+                unsigned char type = input.byte();
+                if(type <= Variant::type_unknown || type > Variant::type_vec4d_vector)
+                    VMF_EXCEPTION(IncorrectParamException, "Unknown field type");
+                bool optional = input.byte() != 0;
+                vFields.push_back(FieldDesc(fieldName, (Variant::Type) type, optional));
+            }
+
+            std::vector<std::shared_ptr<ReferenceDesc>> vReferences;
+            for(unsigned long long count = input.varint(); count > 0; count--)
+            {
+                std::string refName = input.string();
+                unsigned char flags = input.byte();
+                vReferences.emplace_back(std::make_shared<ReferenceDesc>(refName,
+                    (flags & BINARY_REFERENCE_UNIQUE) != 0, (flags & BINARY_REFERENCE_CUSTOM) != 0));
+            }
+
+            std::shared_ptr<MetadataDesc> spDesc = std::make_shared<MetadataDesc>(descName, vFields, vReferences);
+            spSchema->add(spDesc);
+        }
+        return spSchema;
+    }
+
+    void readDescription()
+    {
+        std::string schemaName = input.string();
+        std::string descName = input.string();
+
+        auto hasName = [&](const std::shared_ptr<MetadataSchema>& spSchema) { return spSchema->getName() == schemaName; };
+        auto schema = std::find_if(schemas.begin(), schemas.end(), hasName);
+        if(schema == schemas.end())
+        {
+            schema = std::find_if(skippedSchemas.begin(), skippedSchemas.end(), hasName);
+            if(schema == skippedSchemas.end())
+                VMF_EXCEPTION(vmf::IncorrectParamException, "Unknown schema for metadata item");
+        }
+
+        Description desc;
+        if((desc.spDesc = (*schema)->findMetadataDesc(descName)) == nullptr)
+            VMF_EXCEPTION(vmf::IncorrectParamException, "Unknown description for metadata item");
+        desc.fields = desc.spDesc->getFields();
+        desc.accepted = filter.acceptsDescription(schemaName, descName);
+        descriptions.push_back(desc);
+    }
+
+    // Returns nullptr if the item doesn't pass the filter
+    std::shared_ptr<MetadataInternal> readMetadata()
+    {
+        unsigned long long index = input.varint();
+        if(index >= descriptions.size())
+            BinaryInput::fail("Invalid description index in binary data");
+        const Description& desc = descriptions[(size_t) index];
+
+        IdType id = lastId + input.integer();
+        lastId = id;
+
+        unsigned char flags = input.byte();
+        long long frameIndex = Metadata::UNDEFINED_FRAME_INDEX, numOfFrames = Metadata::UNDEFINED_FRAMES_NUMBER;
+        long long timestamp = Metadata::UNDEFINED_TIMESTAMP, duration = Metadata::UNDEFINED_DURATION;
+        if(flags & BINARY_HAS_FRAME_IDX)
+            frameIndex = input.integer();
+        if(flags & BINARY_HAS_NFRAMES)
+            numOfFrames = input.integer();
+        if(flags & BINARY_HAS_TIMESTAMP)
+            timestamp = input.integer();
+        if(flags & BINARY_HAS_DURATION)
+            duration = input.integer();
+
+        if(!desc.accepted || !filter.acceptsPosition(frameIndex, numOfFrames, timestamp, duration))
+        {
+            skipItemData(desc);
+            return nullptr;
+        }
+
+        std::shared_ptr<MetadataInternal> spMetadataInternal(new MetadataInternal(desc.spDesc));
+        spMetadataInternal->setId(id);
+        if(flags & BINARY_HAS_FRAME_IDX)
+        {
+            if(flags & BINARY_HAS_NFRAMES)
+                spMetadataInternal->setFrameIndex(frameIndex, numOfFrames);
+            else
+                spMetadataInternal->setFrameIndex(frameIndex);
+        }
+        if(flags & BINARY_HAS_TIMESTAMP)
+        {
+            if(flags & BINARY_HAS_DURATION)
+                spMetadataInternal->setTimestamp(timestamp, duration);
+            else
+                spMetadataInternal->setTimestamp(timestamp);
+        }
+
+        for(unsigned long long count = input.varint(); count > 0; count--)
+        {
+            unsigned long long field = input.varint();
+            if(field >= desc.fields.size())
+                BinaryInput::fail("Invalid field index in binary data");
+            const FieldDesc& fieldDesc = desc.fields[(size_t) field];
+            spMetadataInternal->setFieldValue(fieldDesc.name, readValue(fieldDesc.type));
+        }
+
+        for(unsigned long long count = input.varint(); count > 0; count--)
+        {
+            std::string name = input.string();
+            IdType refId = id + input.integer();
+            spMetadataInternal->vRefs.push_back(std::make_pair(refId, name));
+        }
+        return spMetadataInternal;
+    }
+
+    void skipItemData(const Description& desc)
+    {
+        for(unsigned long long count = input.varint(); count > 0; count--)
+        {
+            unsigned long long field = input.varint();
+            if(field >= desc.fields.size())
+                BinaryInput::fail("Invalid field index in binary data");
+            skipValue(desc.fields[(size_t) field].type);
+        }
+
+        for(unsigned long long count = input.varint(); count > 0; count--)
+        {
+            input.skip(input.varint());
+            input.integer();
+        }
+    }
+
+    void skipValue(Variant::Type type)
+    {
+        switch(type)
+        {
+        case Variant::type_integer:
+            input.integer();
+            break;
+        case Variant::type_real:
+            input.skip(8);
+            break;
+        case Variant::type_string:
+        case Variant::type_rawbuffer:
+            input.skip(input.varint());
+            break;
+        case Variant::type_vec2d:
+            input.skip(2 * 8);
+            break;
+        case Variant::type_vec3d:
+            input.skip(3 * 8);
+            break;
+        case Variant::type_vec4d:
+            input.skip(4 * 8);
+            break;
+        case Variant::type_integer_vector:
+            for(unsigned long long count = input.varint(); count > 0; count--)
+                input.integer();
+            break;
+        case Variant::type_real_vector:
+            input.skip(8 * input.varint());
+            break;
+        case Variant::type_string_vector:
+            for(unsigned long long count = input.varint(); count > 0; count--)
+                input.skip(input.varint());
+            break;
+        case Variant::type_vec2d_vector:
+            input.skip(2 * 8 * input.varint());
+            break;
+        case Variant::type_vec3d_vector:
+            input.skip(3 * 8 * input.varint());
+            break;
+        case Variant::type_vec4d_vector:
+            input.skip(4 * 8 * input.varint());
+            break;
+        default:
+            VMF_EXCEPTION(IncorrectParamException, "Unknown field value type");
+        }
+    }
+
+    template <typename T, typename Read>
+    Variant readVector(Read readValue)
+    {
+        std::vector<T> values;
+        // the count isn't trusted for reservation
+        for(unsigned long long count = input.varint(); count > 0; count--)
+            values.push_back(readValue());
+        return Variant(values);
+    }
+
+    vmf_vec2d vec2d()
+    {
+        double x = input.real();
+        double y = input.real();
+        return vmf_vec2d(x, y);
+    }
+
+    vmf_vec3d vec3d()
+    {
+        double x = input.real();
+        double y = input.real();
+        double z = input.real();
+        return vmf_vec3d(x, y, z);
+    }
+
+    vmf_vec4d vec4d()
+    {
+        double x = input.real();
+        double y = input.real();
+        double z = input.real();
+        double w = input.real();
+        return vmf_vec4d(x, y, z, w);
+    }
+
+    Variant readValue(Variant::Type type)
+    {
+        switch(type)
+        {
+        case Variant::type_integer:
+            return Variant((vmf_integer) input.integer());
+        case Variant::type_real:
+            return Variant((vmf_real) input.real());
+        case Variant::type_string:
+            return Variant(input.string());
+        case Variant::type_vec2d:
+            return Variant(vec2d());
+        case Variant::type_vec3d:
+            return Variant(vec3d());
+        case Variant::type_vec4d:
+            return Variant(vec4d());
+        case Variant::type_rawbuffer:
+            return Variant(input.rawbuffer());
+        case Variant::type_integer_vector:
+            return readVector<vmf_integer>([this]() { return (vmf_integer) input.integer(); });
+        case Variant::type_real_vector:
+            return readVector<vmf_real>([this]() { return input.real(); });
+        case Variant::type_string_vector:
+            return readVector<vmf_string>([this]() { return input.string(); });
+        case Variant::type_vec2d_vector:
+            return readVector<vmf_vec2d>([this]() { return vec2d(); });
+        case Variant::type_vec3d_vector:
+            return readVector<vmf_vec3d>([this]() { return vec3d(); });
+        case Variant::type_vec4d_vector:
+            return readVector<vmf_vec4d>([this]() { return vec4d(); });
+        default:
+            VMF_EXCEPTION(IncorrectParamException, "Unknown field value type");
+        }
+    }
+
+    BinaryInput& input;
+    BinarySink& sink;
+    std::vector<std::shared_ptr<MetadataSchema>>& schemas;
+    std::vector<std::shared_ptr<MetadataSchema>> skippedSchemas;
+    const ReadFilter& filter;
+    std::vector<Description> descriptions;
+    IdType lastId;
+};
+
+bool decode(BinaryInput& input, BinarySink& sink, std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+            const ReadFilter& filter)
+{
+    bool result = true;
+    try
+    {
+        BinaryDecoder(input, sink, schemas, filter).decode();
+    }
+    catch(Exception& e)
+    {
+        VMF_LOG_ERROR("Exception: %s", e.what());
+        result = false;
+    }
+
+    // items decoded before an error are kept
+    try
+    {
+        sink.finish();
+    }
+    catch(Exception& e)
+    {
+        VMF_LOG_ERROR("Exception: %s", e.what());
+        result = false;
+    }
+    return result;
+}
+
+}
+
+BinaryReader::BinaryReader() {}
+BinaryReader::~BinaryReader() {}
+
+bool BinaryReader::parseAll(const std::string& text, IdType& nextId, std::string& filepath, std::string& checksum,
+    std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments,
+    std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+    std::vector<std::shared_ptr<MetadataInternal>>& metadata)
+{
+    if(text.empty())
+    {
+        VMF_LOG_ERROR("Empty input binary data");
+        return false;
+    }
+
+    segments.clear();
+    schemas.clear();
+    metadata.clear();
+
+    BinaryInput input(text.data(), text.size());
+    CollectSink sink;
+    std::vector<std::shared_ptr<MetadataSchema>> known;
+    if(!decode(input, sink, known, filter))
+        return false;
+
+    nextId = sink.nextId;
+    filepath = sink.filepath;
+    checksum = sink.checksum;
+    segments.swap(sink.segments);
+    schemas.swap(sink.schemas);
+    metadata.swap(sink.metadata_);
+    return true;
+}
+
+bool BinaryReader::parseSchemas(const std::string& text, std::vector<std::shared_ptr<MetadataSchema>>& schemas)
+{
+    if(text.empty())
+    {
+        VMF_LOG_ERROR("Empty input binary data");
+        return false;
+    }
+
+    schemas.clear();
+
+    BinaryInput input(text.data(), text.size());
+    CollectSink sink;
+    std::vector<std::shared_ptr<MetadataSchema>> known;
+    if(!decode(input, sink, known, filter))
+        return false;
+    schemas.swap(sink.schemas);
+    return true;
+}
+
+bool BinaryReader::parseMetadata(const std::string& text,
+    const std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+    std::vector<std::shared_ptr<MetadataInternal>>& metadata)
+{
+    if(text.empty())
+    {
+        VMF_LOG_ERROR("Empty input binary data");
+        return false;
+    }
+
+    metadata.clear();
+
+    BinaryInput input(text.data(), text.size());
+    CollectSink sink;
+    std::vector<std::shared_ptr<MetadataSchema>> known(schemas);
+    if(!decode(input, sink, known, filter))
+        return false;
+    metadata.swap(sink.metadata_);
+    return true;
+}
+
+bool BinaryReader::parseVideoSegments(const std::string& text, std::vector<std::shared_ptr<MetadataStream::VideoSegment> >& segments)
+{
+    if(text.empty())
+    {
+        VMF_LOG_ERROR("Empty input binary data");
+        return false;
+    }
+
+    segments.clear();
+
+    BinaryInput input(text.data(), text.size());
+    CollectSink sink;
+    std::vector<std::shared_ptr<MetadataSchema>> known;
+    if(!decode(input, sink, known, filter))
+        return false;
+    segments.swap(sink.segments);
+    return true;
+}
+
+bool BinaryReader::parseStream(std::istream& input, MetadataStream& stream)
+{
+    std::vector<std::shared_ptr<MetadataSchema>> schemas;
+    std::vector<std::string> names = stream.getAllSchemaNames();
+    for (auto name = names.begin(); name != names.end(); ++name)
+        schemas.push_back(stream.getSchema(*name));
+
+    BinaryInput binaryInput(input);
+    StreamSink sink(stream);
+    bool result = decode(binaryInput, sink, schemas, filter);
+
+    if(sink.hasHeader)
+        stream.mergeDeserializedAttributes(sink.nextId, sink.filepath, sink.checksum);
+    return result;
+}
+
+}//vmf
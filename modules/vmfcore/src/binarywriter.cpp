@@ -0,0 +1,456 @@
+/* 
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "vmf/binarywriter.hpp"
+#include "vmf/rwconst.hpp"
+#include "streamcheck.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace vmf
+{
+
+namespace
+{
+
+/*
+ * Encodes values to the buffer. If the output is set, the buffer is written to it by blocks
+ * between records, otherwise the buffer keeps the whole encoded data.
+ */
+class BinaryOutput
+{
+public:
+    BinaryOutput(std::string& buffer, std::ostream* output = NULL) : buffer(buffer), output(output) {}
+
+    void byte(unsigned char value)
+    {
+        buffer += (char) value;
+    }
+
+    void varint(unsigned long long value)
+    {
+        char data[10];
+        size_t size = 0;
+        while(value >= 0x80)
+        {
+            data[size++] = (char) (value | 0x80);
+            value >>= 7;
+        }
+        data[size++] = (char) value;
+        buffer.append(data, size);
+    }
+
+    void integer(long long value)
+    {
+        varint(((unsigned long long) value << 1) ^ (unsigned long long) (value >> 63));
+    }
+
+    void real(double value)
+    {
+        unsigned long long bits;
+        memcpy(&bits, &value, sizeof(bits));
+        char data[8];
+        for(int i = 0; i < 8; i++)
+            data[i] = (char) (bits >> (8 * i));
+        buffer.append(data, sizeof(data));
+    }
+
+    void raw(const char* data, size_t size)
+    {
+        buffer.append(data, size);
+    }
+
+    void bytes(const char* data, size_t size)
+    {
+        varint(size);
+        buffer.append(data, size);
+    }
+
+    void string(const std::string& value)
+    {
+        bytes(value.data(), value.size());
+    }
+
+    void endRecord()
+    {
+        if(output != NULL && buffer.size() >= blockSize)
+            flush();
+    }
+
+    void flush()
+    {
+        if(output == NULL)
+            return;
+        output->write(buffer.data(), buffer.size());
+        if(output->fail())
+            VMF_EXCEPTION(vmf::InternalErrorException, "Can't write binary data to the output");
+        buffer.clear();
+    }
+
+private:
+    static const size_t blockSize = 64 * 1024;
+
+    std::string& buffer;
+    std::ostream* output;
+};
+
+// Writes records, descriptions used by metadata items are numbered in order of their first use
+class BinaryEncoder
+{
+public:
+    explicit BinaryEncoder(BinaryOutput& output) : output(output), lastId(0)
+    {
+        output.raw(BINARY_SIGNATURE, strlen(BINARY_SIGNATURE));
+        output.varint(BINARY_VERSION);
+    }
+
+    void header(const IdType& nextId, const std::string& filepath, const std::string& checksum)
+    {
+        output.byte(BINARY_RECORD_HEADER);
+        output.integer(nextId);
+        output.string(filepath);
+        output.string(checksum);
+        output.endRecord();
+    }
+
+    void write(const std::shared_ptr<MetadataStream::VideoSegment>& spSegment)
+    {
+        if(spSegment == nullptr)
+            VMF_EXCEPTION(vmf::IncorrectParamException, "Video segment pointer is null");
+        if(spSegment->getTitle() == "" || spSegment->getFPS() <= 0 || spSegment->getTime() < 0)
+            VMF_EXCEPTION(IncorrectParamException, "Invalid video segment: title, fps or timestamp value(s) is/are invalid!");
+
+        long width, height;
+        spSegment->getResolution(width, height);
+        output.byte(BINARY_RECORD_SEGMENT);
+        output.string(spSegment->getTitle());
+        output.real(spSegment->getFPS());
+        output.integer(spSegment->getTime());
+        output.integer(spSegment->getDuration());
+        output.integer(width);
+        output.integer(height);
+        output.endRecord();
+    }
+
+    void write(const std::shared_ptr<MetadataSchema>& spSchema)
+    {
+        if(spSchema == nullptr)
+            VMF_EXCEPTION(vmf::IncorrectParamException, "Schema pointer is null");
+
+        output.byte(BINARY_RECORD_SCHEMA);
+        output.string(spSchema->getName());
+        output.string(spSchema->getAuthor());
+        auto vDescs = spSchema->getAll();
+        output.varint(vDescs.size());
+        for(auto spDesc = vDescs.begin(); spDesc != vDescs.end(); spDesc++)
+        {
+            output.string((*spDesc)->getMetadataName());
+
+            auto vFields = (*spDesc)->getFields();
+            output.varint(vFields.size());
+            for(auto fieldDesc = vFields.begin(); fieldDesc != vFields.end(); fieldDesc++)
+            {
+                output.string(fieldDesc->name);
+                output.byte((unsigned char) fieldDesc->type);
+                output.byte(fieldDesc->optional ? 1 : 0);
+            }
+
+            auto& vReferences = (*spDesc)->getAllReferenceDescs();
+            size_t count = std::count_if(vReferences.begin(), vReferences.end(),
+                [](const std::shared_ptr<ReferenceDesc>& refDesc) { return !refDesc->name.empty(); });
+            output.varint(count);
+            for(auto refDesc = vReferences.begin(); refDesc != vReferences.end(); refDesc++)
+            {
+                if((*refDesc)->name.empty())
+                    continue;
+                output.string((*refDesc)->name);
+                output.byte(((*refDesc)->isUnique ? BINARY_REFERENCE_UNIQUE : 0) | ((*refDesc)->isCustom ? BINARY_REFERENCE_CUSTOM : 0));
+            }
+        }
+        output.endRecord();
+    }
+
+    void write(const std::shared_ptr<Metadata>& spMetadata)
+    {
+        if(spMetadata == nullptr)
+            VMF_EXCEPTION(vmf::IncorrectParamException, "Metadata pointer is null");
+
+        const Description& desc = description(spMetadata->getDesc());
+        IdType id = spMetadata->getId();
+
+        output.byte(BINARY_RECORD_METADATA);
+        output.varint(desc.index);
+        output.integer(id - lastId);
+        lastId = id;
+
+        unsigned char flags = 0;
+        if(spMetadata->getFrameIndex() != Metadata::UNDEFINED_FRAME_INDEX)
+            flags |= BINARY_HAS_FRAME_IDX;
+        if(spMetadata->getNumOfFrames() != Metadata::UNDEFINED_FRAMES_NUMBER)
+            flags |= BINARY_HAS_NFRAMES;
+        if(spMetadata->getTime() != Metadata::UNDEFINED_TIMESTAMP)
+            flags |= BINARY_HAS_TIMESTAMP;
+        if(spMetadata->getDuration() != Metadata::UNDEFINED_DURATION)
+            flags |= BINARY_HAS_DURATION;
+        output.byte(flags);
+        if(flags & BINARY_HAS_FRAME_IDX)
+            output.integer(spMetadata->getFrameIndex());
+        if(flags & BINARY_HAS_NFRAMES)
+            output.integer(spMetadata->getNumOfFrames());
+        if(flags & BINARY_HAS_TIMESTAMP)
+            output.integer(spMetadata->getTime());
+        if(flags & BINARY_HAS_DURATION)
+            output.integer(spMetadata->getDuration());
+
+        const Metadata& fields = *spMetadata;
+        size_t count = std::count_if(fields.begin(), fields.end(), [](const FieldValue& value) { return !value.isEmpty(); });
+        output.varint(count);
+        for(auto value = fields.begin(); value != fields.end(); value++)
+        {
+            if(value->isEmpty())
+                continue;
+            size_t index = std::find(desc.fieldNames.begin(), desc.fieldNames.end(), value->getName()) - desc.fieldNames.begin();
+            if(index == desc.fieldNames.size())
+                VMF_EXCEPTION(IncorrectParamException, "Metadata field not found in metadata description");
+            output.varint(index);
+            write(*value);
+        }
+
+        auto& refs = spMetadata->getAllReferences();
+        output.varint(refs.size());
+        for(auto reference = refs.begin(); reference != refs.end(); reference++)
+        {
+            output.string(reference->getReferenceDescription()->name);
+            output.integer(reference->getReferenceMetadata().lock()->getId() - id);
+        }
+        output.endRecord();
+    }
+
+    void end()
+    {
+        output.byte(BINARY_RECORD_END);
+        output.flush();
+    }
+
+private:
+    struct Description
+    {
+        size_t index;
+        std::vector<std::string> fieldNames;
+    };
+
+    const Description& description(const std::shared_ptr<MetadataDesc>& spDesc)
+    {
+        auto found = descriptions.find(spDesc.get());
+        if(found != descriptions.end())
+            return found->second;
+
+        Description& desc = descriptions[spDesc.get()];
+        desc.index = descriptions.size() - 1;
+        auto vFields = spDesc->getFields();
+        for(auto fieldDesc = vFields.begin(); fieldDesc != vFields.end(); fieldDesc++)
+            desc.fieldNames.push_back(fieldDesc->name);
+
+        output.byte(BINARY_RECORD_DESCRIPTION);
+        output.string(spDesc->getSchemaName());
+        output.string(spDesc->getMetadataName());
+        return desc;
+    }
+
+    template <typename T, typename Write>
+    void writeVector(const std::vector<T>& values, Write writeValue)
+    {
+        output.varint(values.size());
+        for(auto value = values.begin(); value != values.end(); value++)
+            writeValue(*value);
+    }
+
+    void write(const vmf_vec2d& value)
+    {
+        output.real(value.x);
+        output.real(value.y);
+    }
+
+    void write(const vmf_vec3d& value)
+    {
+        write((const vmf_vec2d&) value);
+        output.real(value.z);
+    }
+
+    void write(const vmf_vec4d& value)
+    {
+        write((const vmf_vec3d&) value);
+        output.real(value.w);
+    }
+
+    void write(const Variant& value)
+    {
+        switch(value.getType())
+        {
+        case Variant::type_integer:
+            output.integer(value.get_integer());
+            break;
+        case Variant::type_real:
+            output.real(value.get_real());
+            break;
+        case Variant::type_string:
+            output.string(value.get_string());
+            break;
+        case Variant::type_vec2d:
+            write(value.get_vec2d());
+            break;
+        case Variant::type_vec3d:
+            write(value.get_vec3d());
+            break;
+        case Variant::type_vec4d:
+            write(value.get_vec4d());
+            break;
+        case Variant::type_rawbuffer:
+            output.bytes(value.get_rawbuffer().data(), value.get_rawbuffer().size());
+            break;
+        case Variant::type_integer_vector:
+            writeVector(value.get_integer_vector(), [this](const vmf_integer& v) { output.integer(v); });
+            break;
+        case Variant::type_real_vector:
+            writeVector(value.get_real_vector(), [this](const vmf_real& v) { output.real(v); });
+            break;
+        case Variant::type_string_vector:
+            writeVector(value.get_string_vector(), [this](const vmf_string& v) { output.string(v); });
+            break;
+        case Variant::type_vec2d_vector:
+            writeVector(value.get_vec2d_vector(), [this](const vmf_vec2d& v) { write(v); });
+            break;
+        case Variant::type_vec3d_vector:
+            writeVector(value.get_vec3d_vector(), [this](const vmf_vec3d& v) { write(v); });
+            break;
+        case Variant::type_vec4d_vector:
+            writeVector(value.get_vec4d_vector(), [this](const vmf_vec4d& v) { write(v); });
+            break;
+        default:
+            VMF_EXCEPTION(IncorrectParamException, "Unknown field value type");
+        }
+    }
+
+    BinaryOutput& output;
+    std::unordered_map<const MetadataDesc*, Description> descriptions;
+    IdType lastId;
+};
+
+void storeStream(BinaryOutput& output, const IdType& nextId,
+                 const std::string& filepath,
+                 const std::string& checksum,
+                 const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments,
+                 const std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+                 const MetadataSet& set)
+{
+    checkStream(schemas, set);
+
+    BinaryEncoder encoder(output);
+    encoder.header(nextId, filepath, checksum);
+    for(auto spSegment = segments.begin(); spSegment != segments.end(); spSegment++)
+        encoder.write(*spSegment);
+    for(auto spSchema = schemas.begin(); spSchema != schemas.end(); spSchema++)
+        encoder.write(*spSchema);
+    for(auto spMetadata = set.begin(); spMetadata != set.end(); spMetadata++)
+        encoder.write(*spMetadata);
+    encoder.end();
+}
+
+}
+
+BinaryWriter::BinaryWriter() {}
+BinaryWriter::~BinaryWriter() {}
+
+std::string BinaryWriter::store(const std::vector<std::shared_ptr<MetadataSchema>>& schemas)
+{
+    if(schemas.empty())
+        VMF_EXCEPTION(vmf::IncorrectParamException, "Input schemas vector is empty");
+
+    std::string result;
+    BinaryOutput output(result);
+    BinaryEncoder encoder(output);
+    for(auto spSchema = schemas.begin(); spSchema != schemas.end(); spSchema++)
+        encoder.write(*spSchema);
+    encoder.end();
+    return result;
+}
+
+std::string BinaryWriter::store(const MetadataSet& set)
+{
+    if(set.empty())
+        VMF_EXCEPTION(vmf::IncorrectParamException, "Input MetadataSet is empty");
+
+    std::string result;
+    BinaryOutput output(result);
+    BinaryEncoder encoder(output);
+    for(auto spMetadata = set.begin(); spMetadata != set.end(); spMetadata++)
+        encoder.write(*spMetadata);
+    encoder.end();
+    return result;
+}
+
+std::string BinaryWriter::store(const IdType& nextId,
+    const std::string& filepath,
+    const std::string& checksum,
+    const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments,
+    const std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+    const MetadataSet& set)
+{
+    std::string result;
+    BinaryOutput output(result);
+    storeStream(output, nextId, filepath, checksum, segments, schemas, set);
+    return result;
+}
+
+std::string BinaryWriter::store(const std::shared_ptr<MetadataStream::VideoSegment>& spSegment)
+{
+    std::string result;
+    BinaryOutput output(result);
+    BinaryEncoder encoder(output);
+    encoder.write(spSegment);
+    encoder.end();
+    return result;
+}
+
+std::string BinaryWriter::store(const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments)
+{
+    if(segments.empty())
+        VMF_EXCEPTION(vmf::IncorrectParamException, "Input video segments vector is empty");
+
+    std::string result;
+    BinaryOutput output(result);
+    BinaryEncoder encoder(output);
+    for(auto spSegment = segments.begin(); spSegment != segments.end(); spSegment++)
+        encoder.write(*spSegment);
+    encoder.end();
+    return result;
+}
+
+void BinaryWriter::store(std::ostream& output, const IdType& nextId,
+    const std::string& filepath,
+    const std::string& checksum,
+    const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments,
+    const std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+    const MetadataSet& set)
+{
+    std::string buffer;
+    BinaryOutput binaryOutput(buffer, &output);
+    storeStream(binaryOutput, nextId, filepath, checksum, segments, schemas, set);
+}
+
+}//vmf
@@ -0,0 +1,341 @@
+/* 
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "base64.hpp"
+#include "vmf/exceptions.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define VMF_BASE64_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define VMF_TARGET(features)
+#else
+#define VMF_TARGET(features) __attribute__((target(features)))
+#endif
+#endif
+
+namespace vmf
+{
+
+namespace
+{
+
+const char encodeTable[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+const signed char decodeTable[256] =
+{
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, 63,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1,
+    -1,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1,
+    -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+/*
+ * Vectorized kernels process whole blocks from the start of the data and return the number of
+ * consumed bytes or characters, the rest is handled by the scalar code.
+ * Decoding stops before a block with an invalid character, so the scalar code reports it.
+ */
+typedef size_t (*EncodeBlocks)(const unsigned char* data, size_t size, char* text);
+typedef size_t (*DecodeBlocks)(const char* text, size_t size, unsigned char* data);
+
+size_t encodeNone(const unsigned char*, size_t, char*)
+{
+    return 0;
+}
+
+size_t decodeNone(const char*, size_t, unsigned char*)
+{
+    return 0;
+}
+
+#ifdef VMF_BASE64_X86
+
+// 12 bytes are loaded by 16 byte reads, so the last 4 bytes of the data are left to the scalar code
+VMF_TARGET("ssse3")
+size_t encodeSsse3(const unsigned char* data, size_t size, char* text)
+{
+    const __m128i shuffle = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m128i offsets = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+    size_t done = 0;
+    for(; size - done >= 16; done += 12, text += 16)
+    {
+        // splits 3 bytes to 4 sextets in each 32 bit lane
+        __m128i in = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (data + done)), shuffle);
+        __m128i hi = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+        __m128i lo = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+        __m128i sextets = _mm_or_si128(hi, lo);
+
+        // maps sextet ranges to offsets of the alphabet characters
+        __m128i index = _mm_subs_epu8(sextets, _mm_set1_epi8(51));
+        index = _mm_sub_epi8(index, _mm_cmpgt_epi8(sextets, _mm_set1_epi8(25)));
+        _mm_storeu_si128((__m128i*) text, _mm_add_epi8(sextets, _mm_shuffle_epi8(offsets, index)));
+    }
+    return done;
+}
+
+// 12 bytes are written by 16 byte stores, so at least 8 characters are left to the scalar code
+VMF_TARGET("ssse3")
+size_t decodeSsse3(const char* text, size_t size, unsigned char* data)
+{
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    size_t done = 0;
+    for(; size - done >= 24; done += 16, data += 12)
+    {
+        __m128i in = _mm_loadu_si128((const __m128i*) (text + done));
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(in, _mm_set1_epi8('Z' + 1)));
+        __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(in, _mm_set1_epi8('z' + 1)));
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(in, _mm_set1_epi8('9' + 1)));
+        __m128i plus = _mm_cmpeq_epi8(in, _mm_set1_epi8('+'));
+        __m128i slash = _mm_cmpeq_epi8(in, _mm_set1_epi8('/'));
+        __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(_mm_or_si128(digit, plus), slash));
+        if(_mm_movemask_epi8(valid) != 0xffff)
+            break;
+
+        __m128i shift = _mm_and_si128(upper, _mm_set1_epi8(-'A'));
+        shift = _mm_or_si128(shift, _mm_and_si128(lower, _mm_set1_epi8(26 - 'a')));
+        shift = _mm_or_si128(shift, _mm_and_si128(digit, _mm_set1_epi8(52 - '0')));
+        shift = _mm_or_si128(shift, _mm_and_si128(plus, _mm_set1_epi8(62 - '+')));
+        shift = _mm_or_si128(shift, _mm_and_si128(slash, _mm_set1_epi8(63 - '/')));
+        __m128i sextets = _mm_add_epi8(in, shift);
+
+        // joins 4 sextets to 3 bytes in each 32 bit lane
+        __m128i pairs = _mm_maddubs_epi16(sextets, _mm_set1_epi32(0x01400140));
+        __m128i words = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+        _mm_storeu_si128((__m128i*) data, _mm_shuffle_epi8(words, pack));
+    }
+    return done;
+}
+
+// The same as SSSE3 code on two 128 bit lanes, 24 bytes are loaded by two 16 byte reads
+VMF_TARGET("avx2")
+size_t encodeAvx2(const unsigned char* data, size_t size, char* text)
+{
+    const __m256i shuffle = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                             1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m256i offsets = _mm256_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0,
+                                             65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+    size_t done = 0;
+    for(; size - done >= 28; done += 24, text += 32)
+    {
+        __m256i in = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*) (data + done)));
+        in = _mm256_inserti128_si256(in, _mm_loadu_si128((const __m128i*) (data + done + 12)), 1);
+        in = _mm256_shuffle_epi8(in, shuffle);
+        __m256i hi = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+        __m256i lo = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+        __m256i sextets = _mm256_or_si256(hi, lo);
+
+        __m256i index = _mm256_subs_epu8(sextets, _mm256_set1_epi8(51));
+        index = _mm256_sub_epi8(index, _mm256_cmpgt_epi8(sextets, _mm256_set1_epi8(25)));
+        _mm256_storeu_si256((__m256i*) text, _mm256_add_epi8(sextets, _mm256_shuffle_epi8(offsets, index)));
+    }
+    return done;
+}
+
+// 24 bytes are written by 32 byte stores, so at least 16 characters are left to the scalar code
+VMF_TARGET("avx2")
+size_t decodeAvx2(const char* text, size_t size, unsigned char* data)
+{
+    const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                          2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+    size_t done = 0;
+    for(; size - done >= 48; done += 32, data += 24)
+    {
+        __m256i in = _mm256_loadu_si256((const __m256i*) (text + done));
+        __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(in, _mm256_set1_epi8('A' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), in));
+        __m256i lower = _mm256_and_si256(_mm256_cmpgt_epi8(in, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), in));
+        __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(in, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), in));
+        __m256i plus = _mm256_cmpeq_epi8(in, _mm256_set1_epi8('+'));
+        __m256i slash = _mm256_cmpeq_epi8(in, _mm256_set1_epi8('/'));
+        __m256i valid = _mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(_mm256_or_si256(digit, plus), slash));
+        if(_mm256_movemask_epi8(valid) != -1)
+            break;
+
+        __m256i shift = _mm256_and_si256(upper, _mm256_set1_epi8(-'A'));
+        shift = _mm256_or_si256(shift, _mm256_and_si256(lower, _mm256_set1_epi8(26 - 'a')));
+        shift = _mm256_or_si256(shift, _mm256_and_si256(digit, _mm256_set1_epi8(52 - '0')));
+        shift = _mm256_or_si256(shift, _mm256_and_si256(plus, _mm256_set1_epi8(62 - '+')));
+        shift = _mm256_or_si256(shift, _mm256_and_si256(slash, _mm256_set1_epi8(63 - '/')));
+        __m256i sextets = _mm256_add_epi8(in, shift);
+
+        __m256i pairs = _mm256_maddubs_epi16(sextets, _mm256_set1_epi32(0x01400140));
+        __m256i words = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+        words = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(words, pack), lanes);
+        _mm256_storeu_si256((__m256i*) data, words);
+    }
+    return done;
+}
+
+#ifdef _MSC_VER
+
+bool cpuSupports(bool avx2)
+{
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    if(maxLeaf < 1)
+        return false;
+    __cpuid(info, 1);
+    if(!avx2)
+        return (info[2] & (1 << 9)) != 0;
+
+    // AVX state has to be enabled by the OS
+    if((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6 || maxLeaf < 7)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+}
+
+#else
+
+bool cpuSupports(bool avx2)
+{
+    __builtin_cpu_init();
+    return avx2 ? __builtin_cpu_supports("avx2") != 0 : __builtin_cpu_supports("ssse3") != 0;
+}
+
+#endif
+
+#endif /* VMF_BASE64_X86 */
+
+struct Kernels
+{
+    EncodeBlocks encode;
+    DecodeBlocks decode;
+    Base64Kernels level;
+};
+
+Kernels selectKernels(Base64Kernels limit)
+{
+    Kernels kernels = { encodeNone, decodeNone, Base64Scalar };
+#ifdef VMF_BASE64_X86
+    if(limit >= Base64Avx2 && cpuSupports(true))
+    {
+        kernels.encode = encodeAvx2;
+        kernels.decode = decodeAvx2;
+        kernels.level = Base64Avx2;
+    }
+    else if(limit >= Base64Ssse3 && cpuSupports(false))
+    {
+        kernels.encode = encodeSsse3;
+        kernels.decode = decodeSsse3;
+        kernels.level = Base64Ssse3;
+    }
+#else
+    (void) limit;
+#endif
+    return kernels;
+}
+
+Kernels& kernels()
+{
+    static Kernels selected = selectKernels(Base64Avx2);
+    return selected;
+}
+
+}
+
+Base64Kernels base64UseKernels(Base64Kernels limit)
+{
+    kernels() = selectKernels(limit);
+    return kernels().level;
+}
+
+void base64Encode(const char* data, size_t size, std::string& text)
+{
+    if(size == 0)
+        return;
+
+    size_t offset = text.size();
+    text.resize(offset + (size + 2) / 3 * 4);
+    char* out = &text[offset];
+    const unsigned char* in = (const unsigned char*) data;
+
+    size_t done = kernels().encode(in, size, out);
+    in += done;
+    out += done / 3 * 4;
+    size -= done;
+
+    for(; size >= 3; size -= 3, in += 3, out += 4)
+    {
+        out[0] = encodeTable[in[0] >> 2];
+        out[1] = encodeTable[((in[0] & 0x03) << 4) | (in[1] >> 4)];
+        out[2] = encodeTable[((in[1] & 0x0f) << 2) | (in[2] >> 6)];
+        out[3] = encodeTable[in[2] & 0x3f];
+    }
+    if(size > 0)
+    {
+        unsigned char second = size > 1 ? in[1] : 0;
+        out[0] = encodeTable[in[0] >> 2];
+        out[1] = encodeTable[((in[0] & 0x03) << 4) | (second >> 4)];
+        out[2] = size > 1 ? encodeTable[(second & 0x0f) << 2] : '=';
+        out[3] = '=';
+    }
+}
+
+void base64Decode(const char* text, size_t size, std::vector<char>& data)
+{
+    data.clear();
+    if(size == 0)
+        return;
+
+    if(size % 4 != 0)
+        VMF_EXCEPTION(vmf::IncorrectParamException, "Invalid base64 string size (isn't multiple of 4)");
+
+    size_t padding = 0;
+    while(padding < size && text[size - 1 - padding] == '=')
+        padding++;
+    if(padding > 2)
+        VMF_EXCEPTION(vmf::IncorrectParamException, "Invalid base64 string: more than 2 trailing '=' symbols");
+
+    data.resize(size / 4 * 3 - padding);
+    unsigned char* out = (unsigned char*) &data[0];
+    size_t done = kernels().decode(text, size, out);
+    out += done / 4 * 3;
+
+    const unsigned char* in = (const unsigned char*) text + done;
+    const unsigned char* end = (const unsigned char*) text + size;
+    for(; in != end; in += 4)
+    {
+        // padding characters of the last quad are zero sextets
+        size_t count = in + 4 == end ? 4 - padding : 4;
+        int sextets[4] = { 0, 0, 0, 0 };
+        for(size_t i = 0; i < count; i++)
+            if((sextets[i] = decodeTable[in[i]]) < 0)
+                VMF_EXCEPTION(vmf::IncorrectParamException, "Input base64 string contains invalid symbol");
+
+        *out++ = (unsigned char) ((sextets[0] << 2) | (sextets[1] >> 4));
+        if(count > 2)
+            *out++ = (unsigned char) ((sextets[1] << 4) | (sextets[2] >> 2));
+        if(count > 3)
+            *out++ = (unsigned char) ((sextets[2] << 6) | sextets[3]);
+    }
+}
+
+}
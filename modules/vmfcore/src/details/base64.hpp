@@ -0,0 +1,57 @@
+/* 
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __VMF_BASE64_HPP__
+#define __VMF_BASE64_HPP__
+
+#include <string>
+#include <vector>
+#include "vmf/global.hpp"
+
+namespace vmf
+{
+
+/*!
+* \brief Appends base64 encoding of the data to the text
+*/
+void base64Encode(const char* data, size_t size, std::string& text);
+
+/*!
+* \brief Replaces the data with the decoded base64 text, throws IncorrectParamException on invalid text
+*/
+void base64Decode(const char* text, size_t size, std::vector<char>& data);
+
+/*!
+* \brief Vectorized code paths of base64 encoding and decoding
+*/
+enum Base64Kernels
+{
+    Base64Scalar,
+    Base64Ssse3,
+    Base64Avx2
+};
+
+/*!
+* \brief Switches to the fastest code path supported by the CPU up to the given one and returns it.
+* The best supported path is used by default, other ones are selected by tests.
+* Must not be called while other threads encode or decode.
+*/
+VMF_EXPORT Base64Kernels base64UseKernels(Base64Kernels limit);
+
+}
+
+#endif /* __VMF_BASE64_HPP__ */
@@ -0,0 +1,90 @@
+/* 
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "chunks.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vmf
+{
+
+// Chunks are big enough to make the threads worth it and small enough to balance the load
+static const size_t MIN_ITEMS_PER_CHUNK = 256;
+static const size_t MAX_ITEMS_PER_CHUNK = 4096;
+static const size_t CHUNKS_PER_THREAD = 4;
+
+void formatChunks(size_t count, unsigned int threads,
+                  const std::function<void(size_t begin, size_t end, std::string& text)>& format,
+                  const std::function<void(const std::string& text)>& output)
+{
+    if(threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    size_t chunkSize = count / (threads * CHUNKS_PER_THREAD);
+    chunkSize = std::min(std::max(chunkSize, MIN_ITEMS_PER_CHUNK), MAX_ITEMS_PER_CHUNK);
+    size_t chunks = (count + chunkSize - 1) / chunkSize;
+    size_t roundSize = std::min<size_t>(chunks, threads * CHUNKS_PER_THREAD);
+    unsigned int workers = (unsigned int) std::min<size_t>(threads, roundSize);
+
+    std::vector<std::string> texts(roundSize);
+    for(size_t first = 0; first < chunks; first += roundSize)
+    {
+        size_t last = std::min(first + roundSize, chunks);
+        std::atomic<size_t> nextChunk(first);
+        std::exception_ptr error;
+        std::mutex errorLock;
+
+        auto worker = [&]()
+        {
+            try
+            {
+                for(size_t chunk = nextChunk++; chunk < last; chunk = nextChunk++)
+                {
+                    std::string& text = texts[chunk - first];
+                    text.clear();
+                    format(chunk * chunkSize, std::min((chunk + 1) * chunkSize, count), text);
+                }
+            }
+            catch(...)
+            {
+                std::lock_guard<std::mutex> guard(errorLock);
+                if(!error)
+                    error = std::current_exception();
+                nextChunk = last;
+            }
+        };
+
+        std::vector<std::thread> pool;
+        for(unsigned int i = 1; i < workers && first + i < last; i++)
+            pool.push_back(std::thread(worker));
+        worker();
+        for(auto& t : pool)
+            t.join();
+
+        if(error)
+            std::rethrow_exception(error);
+
+        for(size_t chunk = first; chunk < last; chunk++)
+            output(texts[chunk - first]);
+    }
+}
+
+}
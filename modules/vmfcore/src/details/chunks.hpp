@@ -0,0 +1,40 @@
+/* 
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __VMF_CHUNKS_HPP__
+#define __VMF_CHUNKS_HPP__
+
+#include <functional>
+#include <string>
+
+namespace vmf
+{
+
+/*!
+* \brief Formats items [0, count) by chunks on several threads and passes the chunk texts to the output in order
+* \details Chunks are formatted by rounds, so only the texts of one round are kept in memory.
+* The first exception thrown by the format or the output stops the work and is passed to the caller.
+* \param threads [in] number of threads, zero selects the number of cores
+* \param format [in] appends the text of items [begin, end) to the string
+* \param output [in] consumes the text of the next chunk
+*/
+void formatChunks(size_t count, unsigned int threads,
+                  const std::function<void(size_t begin, size_t end, std::string& text)>& format,
+                  const std::function<void(const std::string& text)>& output);
+
+}
+
+#endif /* __VMF_CHUNKS_HPP__ */
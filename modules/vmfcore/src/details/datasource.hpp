@@ -24,6 +24,9 @@
 */
 
 #include <vector>
+#include <functional>
+#include <algorithm>
+#include <cctype>
 #include "vmf/global.hpp"
 #include "vmf/metadataschema.hpp"
 #include "vmf/metadatastream.hpp"
@@ -70,8 +73,49 @@ public:
      */
     virtual void loadProperty(const vmf::MetaString& schemaName, const vmf::MetaString& propertyName, vmf::MetadataStream& stream) = 0;
 
+    /*!
+     * \brief Loads index entries of all metadata belonging to the specified schema
+     * \param [in] schemaName name of the specified schema
+     * \param [out] index vector to append entries to
+     * \throw DataStorageException
+     * \throw NotImplementedException if the data source can't load metadata on demand
+     */
+    virtual void loadIndex(const vmf::MetaString& schemaName, std::vector<MetadataStream::IndexEntry>& index)
+    {
+        (void) schemaName; (void) index;
+        VMF_EXCEPTION(NotImplementedException, "Loading metadata on demand isn't supported by the data source");
+    }
+
+    /*!
+     * \brief Loads metadata with specified identifiers and all metadata referenced by them
+     * \param [in] ids identifiers of metadata, items already present in the stream are skipped
+     * \param [out] stream stream to be filled by loaded metadata
+     * \throw DataStorageException
+     * \throw NotImplementedException if the data source can't load metadata on demand
+     */
+    virtual void loadItems(const std::vector<IdType>& ids, vmf::MetadataStream& stream)
+    {
+        (void) ids; (void) stream;
+        VMF_EXCEPTION(NotImplementedException, "Loading metadata on demand isn't supported by the data source");
+    }
+
+    /*!
+     * \brief Loads field values and references of stored metadata without adding it to the stream
+     * \param [in] id identifier of metadata
+     * \param [in] stream stream providing schemas
+     * \return detached item with unresolved references
+     * \throw DataStorageException
+     * \throw NotImplementedException if the data source can't load metadata on demand
+     */
+    virtual std::shared_ptr<MetadataInternal> loadPayload(const IdType& id, const vmf::MetadataStream& stream)
+    {
+        (void) id; (void) stream;
+        VMF_EXCEPTION(NotImplementedException, "Loading metadata on demand isn't supported by the data source");
+    }
+
     /*!
      * \brief Saves all metadata belonging to the specified schema
+     * \details Items with evicted values are unchanged since they were loaded and may be skipped.
      * \param [in] schemaName name of the specified schema
      * \param [in] stream stream with metadata
      * \throw DataStorageException
@@ -131,11 +175,76 @@ public:
      */
     virtual void saveChecksum(const MetaString& checksum) = 0;
 
+    /*!
+     * \brief Saves media checksum with optional chunk manifest
+     * \details Data sources without media data ignore the manifest.
+     */
+    virtual void saveChecksum(const MetaString& checksum, bool manifest)
+    {
+        (void) manifest;
+        saveChecksum(checksum);
+    }
+
+    /*!
+     * \brief Loads size and number of chunks of the manifest stored for the checksum
+     * \return false if there is no manifest for the checksum
+     */
+    virtual bool loadChecksumManifest(const std::string& checksum, size_t& chunkCount, long long& chunkSize)
+    {
+        (void) checksum;
+        chunkCount = 0;
+        chunkSize = 0;
+        return false;
+    }
+
+    /*!
+     * \brief Verifies chunks of current media data against the manifest stored for the checksum
+     * \details Chunks are verified by batches, progress is called with index of the next chunk after every batch
+     * but the last one and stops the verification if it returns false.
+     * \return index of the chunk following the last verified one
+     * \throw DataStorageException if there is no manifest
+     */
+    virtual size_t verifyChecksumChunks(const std::string& checksum, size_t first, size_t count, unsigned int threads,
+                                        std::vector<size_t>& corruptChunks, const std::function<bool(size_t)>& progress)
+    {
+        (void) checksum; (void) first; (void) count; (void) threads; (void) corruptChunks; (void) progress;
+        VMF_EXCEPTION(NotImplementedException, "Checksum manifest isn't supported by the data source");
+    }
+
     /*!
     * \brief Computes chechsum for current media data in opened file
     */
     virtual std::string computeChecksum(long long& XMPPacketSize, long long& XMPPacketOffset) = 0;
 
+    /*!
+    * \brief Computes chechsum for current media data in opened file using the selected algorithm
+    * \details Data sources without media data support MD5 only.
+    * \throw NotImplementedException if the algorithm isn't supported
+    */
+    virtual std::string computeChecksum(MetadataStream::ChecksumAlgorithm algorithm, unsigned int threads)
+    {
+        (void) threads;
+        if (algorithm != MetadataStream::ChecksumMD5)
+            VMF_EXCEPTION(NotImplementedException, "Checksum algorithm isn't supported by the data source");
+        long long size, offset;
+        return computeChecksum(size, offset);
+    }
+
+    /*!
+    * \brief Checks that the digest matches current media data in opened file
+    * \details Data sources may skip hashing if they can prove the media data wasn't changed.
+    */
+    virtual bool verifyChecksum(const std::string& checksum, unsigned int threads)
+    {
+        std::string actual = computeChecksum(MetadataStream::getChecksumAlgorithm(checksum), threads);
+        // hex digits of MD5 digests may be stored in any case
+        return actual.size() == checksum.size() &&
+            std::equal(actual.begin(), actual.end(), checksum.begin(), [](char a, char b)
+            {
+                return ::toupper((unsigned char) a) == ::toupper((unsigned char) b);
+            });
+    }
+
     /*
     * \brief Saves all video segments
     */
@@ -145,6 +254,25 @@ public:
     * \brief Loads stored video segments
     */
     virtual void loadVideoSegments(std::vector<std::shared_ptr<MetadataStream::VideoSegment>> &videoSegments) = 0;
+
+    /*!
+     * \brief Starts a group of changes that should be stored atomically
+     * \details Data sources that don't support transactions store every change immediately.
+     */
+    virtual void beginTransaction() {}
+
+    /*!
+     * \brief Stores all changes made since the transaction was started
+     * \throw DataStorageException
+     */
+    virtual void commitTransaction() {}
+
+    /*!
+     * \brief Discards all changes made since the transaction was started
+     */
+    virtual void rollbackTransaction() {}
+
+    virtual ~IDataSource() {}
 };
 
 } /* vmf */
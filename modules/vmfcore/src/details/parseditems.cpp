@@ -0,0 +1,85 @@
+/* 
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "parseditems.hpp"
+#include "vmf/rwconst.hpp"
+
+namespace vmf
+{
+
+static const size_t ITEMS_PER_BATCH = 4096;
+
+DescTable::DescTable(const std::vector<std::shared_ptr<MetadataSchema>>& schemas) : schemas(schemas)
+{
+}
+
+const std::shared_ptr<MetadataDesc>& DescTable::find(const std::string& schemaName, const std::string& descName)
+{
+    DescMap& schemaDescs = descs[schemaName];
+    auto desc = schemaDescs.find(descName);
+    if(desc != schemaDescs.end())
+        return desc->second;
+
+    auto schema = schemas.begin();
+    for(; schema != schemas.end(); schema++)
+        if((*schema)->getName() == schemaName)
+            break;
+    if(schema == schemas.end())
+        VMF_EXCEPTION(vmf::IncorrectParamException, "Unknown schema for metadata item");
+
+    std::shared_ptr<MetadataDesc> spDesc = (*schema)->findMetadataDesc(descName);
+    if(spDesc == nullptr)
+        VMF_EXCEPTION(vmf::IncorrectParamException, "Unknown description for metadata item");
+    return schemaDescs[descName] = spDesc;
+}
+
+ItemBatch::ItemBatch(MetadataStream& stream) : stream(stream)
+{
+}
+
+void ItemBatch::add(const std::shared_ptr<MetadataInternal>& spMetadata)
+{
+    items.push_back(spMetadata);
+    if(items.size() >= ITEMS_PER_BATCH)
+        flush();
+}
+
+void ItemBatch::flush()
+{
+    // the items are taken first, so a failed batch isn't added again
+    std::vector<std::shared_ptr<MetadataInternal>> batch;
+    batch.swap(items);
+    if(!batch.empty())
+        stream.add(batch);
+}
+
+void applyRootAttributes(const std::map<std::string, std::string>& rootAttributes, MetadataStream& stream)
+{
+    IdType nextId = 0;
+    std::string filePath, checksum;
+    auto attribute = rootAttributes.find(ATTR_VMF_NEXTID);
+    if (attribute != rootAttributes.end())
+        nextId = (IdType) ATOLL(attribute->second.c_str());
+    attribute = rootAttributes.find(ATTR_VMF_FILEPATH);
+    if (attribute != rootAttributes.end())
+        filePath = attribute->second;
+    attribute = rootAttributes.find(ATTR_VMF_CHECKSUM);
+    if (attribute != rootAttributes.end())
+        checksum = attribute->second;
+    stream.mergeDeserializedAttributes(nextId, filePath, checksum);
+}
+
+}
@@ -0,0 +1,85 @@
+/* 
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __VMF_PARSEDITEMS_HPP__
+#define __VMF_PARSEDITEMS_HPP__
+
+#include "vmf/metadatastream.hpp"
+#include "vmf/metadatainternal.hpp"
+
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined _MSC_VER && _MSC_VER < 1800
+    #define ATOLL(x) _atoi64(x)
+#else
+    #define ATOLL(x) atoll(x)
+#endif
+
+namespace vmf
+{
+
+/*!
+* \brief Resolves schema and description names of parsed metadata items
+* \details Each pair of names is searched in the schemas once, the next items with these names
+* get the description from a hash table. Schemas appended to the vector later are found as well.
+*/
+class DescTable
+{
+public:
+    explicit DescTable(const std::vector<std::shared_ptr<MetadataSchema>>& schemas);
+
+    /*!
+    * \throw IncorrectParamException if there is no such schema or description
+    */
+    const std::shared_ptr<MetadataDesc>& find(const std::string& schemaName, const std::string& descName);
+
+private:
+    typedef std::unordered_map<std::string, std::shared_ptr<MetadataDesc>> DescMap;
+
+    const std::vector<std::shared_ptr<MetadataSchema>>& schemas;
+    std::unordered_map<std::string, DescMap> descs;
+};
+
+/*!
+* \brief Collects parsed metadata items and adds them to the stream by batches
+* \details Items are added by MetadataStream::add() for vectors, so references between items
+* of a batch are wired at once. flush() has to be called when the input is over or fails.
+*/
+class ItemBatch
+{
+public:
+    explicit ItemBatch(MetadataStream& stream);
+
+    void add(const std::shared_ptr<MetadataInternal>& spMetadata);
+    void flush();
+
+private:
+    MetadataStream& stream;
+    std::vector<std::shared_ptr<MetadataInternal>> items;
+};
+
+/*!
+* \brief Merges next id, file path and checksum from attributes of the root element into the stream
+*/
+void applyRootAttributes(const std::map<std::string, std::string>& rootAttributes, MetadataStream& stream);
+
+}
+
+#endif /* __VMF_PARSEDITEMS_HPP__ */
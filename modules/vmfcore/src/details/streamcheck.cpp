@@ -0,0 +1,44 @@
+/* 
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "streamcheck.hpp"
+
+#include <algorithm>
+#include <set>
+#include <string>
+
+namespace vmf
+{
+
+void checkStream(const std::vector<std::shared_ptr<MetadataSchema>>& schemas, const MetadataSet& set)
+{
+    if(schemas.empty())
+        VMF_EXCEPTION(vmf::IncorrectParamException, "Input schemas vector is empty");
+
+    std::set<std::string> names;
+    std::for_each(schemas.begin(), schemas.end(), [&](const std::shared_ptr<MetadataSchema>& spSchema)
+    {
+        if( spSchema != nullptr )
+            names.insert(spSchema->getName());
+    });
+    std::for_each(set.begin(), set.end(), [&](const std::shared_ptr<Metadata>& spMetadata)
+    {
+        if(spMetadata != nullptr && names.find(spMetadata->getSchemaName()) == names.end())
+            VMF_EXCEPTION(vmf::IncorrectParamException, "MetadataSet item references unknown schema");
+    });
+}
+
+}
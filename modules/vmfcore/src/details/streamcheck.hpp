@@ -0,0 +1,37 @@
+/* 
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __VMF_STREAMCHECK_HPP__
+#define __VMF_STREAMCHECK_HPP__
+
+#include "vmf/metadataschema.hpp"
+#include "vmf/metadataset.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace vmf
+{
+
+/*!
+* \brief Checks that there are schemas to store and every item of the set belongs to one of them
+* \throw IncorrectParamException if there are no schemas or an item references an unknown schema
+*/
+void checkStream(const std::vector<std::shared_ptr<MetadataSchema>>& schemas, const MetadataSet& set);
+
+}
+
+#endif /* __VMF_STREAMCHECK_HPP__ */
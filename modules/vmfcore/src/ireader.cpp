@@ -0,0 +1,124 @@
+/* 
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "vmf/ireader.hpp"
+
+#include <exception>
+#include <iterator>
+#include <streambuf>
+
+namespace vmf
+{
+
+namespace
+{
+
+// Reads the text from the source by blocks, an exception thrown by the source is kept to be rethrown later
+class ChunkSourceBuffer : public std::streambuf
+{
+public:
+    explicit ChunkSourceBuffer(const ChunkSource& source) : source(source), buffer(64 * 1024) {}
+
+    void rethrow()
+    {
+        if(error)
+            std::rethrow_exception(error);
+    }
+
+protected:
+    virtual int_type underflow()
+    {
+        if(gptr() < egptr())
+            return traits_type::to_int_type(*gptr());
+        if(error)
+            return traits_type::eof();
+
+        size_t size = 0;
+        try
+        {
+            size = source(&buffer[0], buffer.size());
+            if(size > buffer.size())
+                VMF_EXCEPTION(IncorrectParamException, "Chunk source returned more data than requested");
+        }
+        catch(...)
+        {
+            error = std::current_exception();
+            return traits_type::eof();
+        }
+        if(size == 0)
+            return traits_type::eof();
+        setg(&buffer[0], &buffer[0], &buffer[0] + size);
+        return traits_type::to_int_type(*gptr());
+    }
+
+private:
+    const ChunkSource& source;
+    std::vector<char> buffer;
+    std::exception_ptr error;
+};
+
+}
+
+bool IReader::parseStream(std::istream& input, MetadataStream& stream)
+{
+    std::string text((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    if(input.bad())
+        return false;
+    return parseText(text, stream);
+}
+
+bool IReader::parseText(const std::string& text, MetadataStream& stream)
+{
+    IdType nextId = 0;
+    std::string filepath, checksum;
+    std::vector<std::shared_ptr<MetadataStream::VideoSegment>> segments;
+    std::vector<std::shared_ptr<MetadataSchema>> schemas;
+    std::vector<std::shared_ptr<MetadataInternal>> metadata;
+    if(!parseAll(text, nextId, filepath, checksum, segments, schemas, metadata))
+        return false;
+
+    for(auto& spSegment : segments)
+        stream.addVideoSegment(spSegment);
+    for(auto& spSchema : schemas)
+        stream.addSchema(spSchema);
+    stream.add(metadata);
+    stream.mergeDeserializedAttributes(nextId, filepath, checksum);
+    return true;
+}
+
+bool IReader::parseStream(const ChunkSource& source, MetadataStream& stream)
+{
+    if(!source)
+        VMF_EXCEPTION(IncorrectParamException, "Chunk source is empty");
+
+    ChunkSourceBuffer buffer(source);
+    std::istream input(&buffer);
+    bool result = parseStream(input, stream);
+    buffer.rethrow();
+    return result;
+}
+
+void IReader::setFilter(const ReadFilter& newFilter)
+{
+    filter = newFilter;
+}
+
+const ReadFilter& IReader::getFilter() const
+{
+    return filter;
+}
+
+}//vmf
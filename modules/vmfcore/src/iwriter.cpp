@@ -0,0 +1,140 @@
+/* 
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "vmf/iwriter.hpp"
+
+#include <exception>
+#include <streambuf>
+
+namespace vmf
+{
+
+namespace
+{
+
+// Passes the written text to the sink by blocks, an exception thrown by the sink is kept to be rethrown later
+class ChunkSinkBuffer : public std::streambuf
+{
+public:
+    explicit ChunkSinkBuffer(const ChunkSink& sink) : sink(sink), buffer(64 * 1024)
+    {
+        setp(&buffer[0], &buffer[0] + buffer.size());
+    }
+
+    void rethrow()
+    {
+        if(error)
+            std::rethrow_exception(error);
+    }
+
+protected:
+    virtual int_type overflow(int_type c)
+    {
+        if(!flushBuffer())
+            return traits_type::eof();
+        if(!traits_type::eq_int_type(c, traits_type::eof()))
+        {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    virtual int sync()
+    {
+        return flushBuffer() ? 0 : -1;
+    }
+
+private:
+    bool flushBuffer()
+    {
+        if(error)
+            return false;
+        try
+        {
+            if(pptr() > pbase())
+                sink(pbase(), pptr() - pbase());
+        }
+        catch(...)
+        {
+            error = std::current_exception();
+            return false;
+        }
+        setp(&buffer[0], &buffer[0] + buffer.size());
+        return true;
+    }
+
+    const ChunkSink& sink;
+    std::vector<char> buffer;
+    std::exception_ptr error;
+};
+
+}
+
+void IWriter::store(std::ostream& output,
+                    const IdType& nextId,
+                    const std::string& filepath,
+                    const std::string& checksum,
+                    const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments,
+                    const std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+                    const MetadataSet& set)
+{
+    output << store(nextId, filepath, checksum, segments, schemas, set);
+    if(output.fail())
+        VMF_EXCEPTION(InternalErrorException, "Can't write the output");
+}
+
+void IWriter::store(std::ostream& output,
+                    const IdType& nextId,
+                    const std::string& filepath,
+                    const std::string& checksum,
+                    const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments,
+                    const std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+                    const MetadataSet& set,
+                    unsigned int)
+{
+    store(output, nextId, filepath, checksum, segments, schemas, set);
+}
+
+void IWriter::store(const ChunkSink& sink,
+                    const IdType& nextId,
+                    const std::string& filepath,
+                    const std::string& checksum,
+                    const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments,
+                    const std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+                    const MetadataSet& set)
+{
+    if(!sink)
+        VMF_EXCEPTION(IncorrectParamException, "Chunk sink is empty");
+
+    ChunkSinkBuffer buffer(sink);
+    std::ostream output(&buffer);
+    try
+    {
+        store(output, nextId, filepath, checksum, segments, schemas, set);
+        output.flush();
+    }
+    catch(...)
+    {
+        buffer.rethrow();
+        throw;
+    }
+    buffer.rethrow();
+    if(output.fail())
+        VMF_EXCEPTION(InternalErrorException, "Can't write the output");
+}
+
+}//vmf
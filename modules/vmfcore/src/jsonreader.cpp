@@ -16,9 +16,15 @@
  */
 #include "vmf/jsonreader.hpp"
 #include "vmf/rwconst.hpp"
+#include "parseditems.hpp"
 
 #include "libjson.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+
 namespace vmf
 {
 
@@ -119,7 +125,8 @@ static std::shared_ptr<MetadataSchema> parseSchemaFromNode(JSONNode& schemaNode)
     return spSchema;
 }
 
-static std::shared_ptr<MetadataInternal> parseMetadataFromNode(JSONNode& metadataNode, const std::vector<std::shared_ptr<MetadataSchema>>& schemas)
+// Returns nullptr if the item doesn't pass the filter
+static std::shared_ptr<MetadataInternal> parseMetadataFromNode(JSONNode& metadataNode, DescTable& descs, const ReadFilter& filter)
 {
     auto schemaIter = metadataNode.find(ATTR_METADATA_SCHEMA);
     auto descIter = metadataNode.find(ATTR_METADATA_DESCRIPTION);
@@ -127,20 +134,8 @@ static std::shared_ptr<MetadataInternal> parseMetadataFromNode(JSONNode& metadat
     if(schemaIter == metadataNode.end() || descIter == metadataNode.end() || idIter == metadataNode.end())
         VMF_EXCEPTION(vmf::IncorrectParamException, "Metadata item has no schema name, description name or id");
 
-    auto schema = schemas.begin();
-    for(; schema != schemas.end(); schema++)
-        if((*schema)->getName() == schemaIter->as_string())
-            break;
-
-    if(schema == schemas.end())
-        VMF_EXCEPTION(vmf::IncorrectParamException, "Unknown schema for metadata item");
-
-    std::shared_ptr<MetadataDesc> spDesc;
-    if( (spDesc = (*schema)->findMetadataDesc(descIter->as_string())) == nullptr)
-        VMF_EXCEPTION(vmf::IncorrectParamException, "Unknown description for metadata item");
-
-    std::shared_ptr<MetadataInternal> spMetadataInternal(new MetadataInternal(spDesc));
-    spMetadataInternal->setId(idIter->as_int());
+    if(!filter.acceptsDescription(schemaIter->as_string(), descIter->as_string()))
+        return nullptr;
 
     auto frameIdxLoIter = metadataNode.find(ATTR_METADATA_FRAME_IDX_LO);
     auto frameIdxHiIter = metadataNode.find(ATTR_METADATA_FRAME_IDX_HI);
@@ -151,35 +146,59 @@ static std::shared_ptr<MetadataInternal> parseMetadataFromNode(JSONNode& metadat
     auto durationLoIter = metadataNode.find(ATTR_METADATA_DURATION_LO);
     auto durationHiIter = metadataNode.find(ATTR_METADATA_DURATION_HI);
 
+    long long frmIdx = vmf::Metadata::UNDEFINED_FRAME_INDEX, numFrm = vmf::Metadata::UNDEFINED_FRAMES_NUMBER,
+        time = vmf::Metadata::UNDEFINED_TIMESTAMP, dur = vmf::Metadata::UNDEFINED_DURATION;
+    bool hasFrameIndex = false, hasNumOfFrames = false, hasTime = false, hasDuration = false;
     if (frameIdxLoIter != metadataNode.end() && frameIdxHiIter != metadataNode.end())
     {
         unsigned long lo = frameIdxLoIter->as_int();
         unsigned long hi = frameIdxHiIter->as_int();
-        long long frmIdx = ((long long)hi << 32) | lo;
+        frmIdx = ((long long)hi << 32) | lo;
+        hasFrameIndex = true;
 
         if (nFramesLoIter != metadataNode.end() && nFramesHiIter != metadataNode.end())
         {
             unsigned long lo = nFramesLoIter->as_int();
             unsigned long hi = nFramesHiIter->as_int();
-            long long numFrm = ((long long)hi << 32) | lo;
-            spMetadataInternal->setFrameIndex(frmIdx, numFrm);
+            numFrm = ((long long)hi << 32) | lo;
+            hasNumOfFrames = true;
         }
-        else
-            spMetadataInternal->setFrameIndex(frmIdx);
     }
     if (timeLoIter != metadataNode.end() && timeHiIter != metadataNode.end())
     {
         unsigned long lo = timeLoIter->as_int();
         unsigned long hi = timeHiIter->as_int();
-        long long time = ((long long)hi << 32) | lo;
+        time = ((long long)hi << 32) | lo;
+        hasTime = true;
 
         if (durationLoIter != metadataNode.end() && durationHiIter != metadataNode.end())
         {
             unsigned long lo = durationLoIter->as_int();
             unsigned long hi = durationHiIter->as_int();
-            long long dur = ((long long)hi << 32) | lo;
-            spMetadataInternal->setTimestamp(time, dur);
+            dur = ((long long)hi << 32) | lo;
+            hasDuration = true;
         }
+    }
+
+    if(!filter.acceptsPosition(frmIdx, numFrm, time, dur))
+        return nullptr;
+
+    const std::shared_ptr<MetadataDesc>& spDesc = descs.find(schemaIter->as_string(), descIter->as_string());
+
+    std::shared_ptr<MetadataInternal> spMetadataInternal(new MetadataInternal(spDesc));
+    spMetadataInternal->setId(idIter->as_int());
+
+    if (hasFrameIndex)
+    {
+        if (hasNumOfFrames)
+            spMetadataInternal->setFrameIndex(frmIdx, numFrm);
+        else
+            spMetadataInternal->setFrameIndex(frmIdx);
+    }
+    if (hasTime)
+    {
+        if (hasDuration)
+            spMetadataInternal->setTimestamp(time, dur);
         else
             spMetadataInternal->setTimestamp(time);
     }
@@ -303,7 +322,8 @@ bool JSONReader::parseSchemas(const std::string& text, std::vector<std::shared_p
         try
         {
 	    std::shared_ptr<MetadataSchema> spSchema = parseSchemaFromNode(localRootNode);
-            schemas.push_back(spSchema);
+            if(filter.acceptsSchema(spSchema->getName()))
+                schemas.push_back(spSchema);
         }
         catch(Exception& e)
         {
@@ -317,7 +337,8 @@ bool JSONReader::parseSchemas(const std::string& text, std::vector<std::shared_p
         try
         {
 	    std::shared_ptr<MetadataSchema> spSchema = parseSchemaFromNode(*node);
-            schemas.push_back(spSchema);
+            if(filter.acceptsSchema(spSchema->getName()))
+                schemas.push_back(spSchema);
         }
         catch(Exception& e)
         {
@@ -333,7 +354,8 @@ bool JSONReader::parseSchemas(const std::string& text, std::vector<std::shared_p
                 try
                 {
 		    std::shared_ptr<MetadataSchema> spSchema = parseSchemaFromNode(*node);
-                    schemas.push_back(spSchema);
+                    if(filter.acceptsSchema(spSchema->getName()))
+                        schemas.push_back(spSchema);
                 }
                 catch(Exception& e)
                 {
@@ -355,6 +377,7 @@ bool JSONReader::parseMetadata(const std::string& text,
     }
 
     metadata.clear();
+    DescTable descs(schemas);
 
     JSONNode root;
     try
@@ -379,8 +402,9 @@ bool JSONReader::parseMetadata(const std::string& text,
     {
         try
         {
-            std::shared_ptr<MetadataInternal> spMetadata = parseMetadataFromNode(localRootNode, schemas);
-            metadata.push_back(spMetadata);
+            std::shared_ptr<MetadataInternal> spMetadata = parseMetadataFromNode(localRootNode, descs, filter);
+            if(spMetadata)
+                metadata.push_back(spMetadata);
         }
         catch(Exception& e)
         {
@@ -393,8 +417,9 @@ bool JSONReader::parseMetadata(const std::string& text,
         for(auto node = localRootNode.begin(); node != localRootNode.end(); node++)
         try
         {
-            std::shared_ptr<MetadataInternal> spMetadata = parseMetadataFromNode(*node, schemas);
-            metadata.push_back(spMetadata);
+            std::shared_ptr<MetadataInternal> spMetadata = parseMetadataFromNode(*node, descs, filter);
+            if(spMetadata)
+                metadata.push_back(spMetadata);
         }
         catch(Exception& e)
         {
@@ -409,8 +434,9 @@ bool JSONReader::parseMetadata(const std::string& text,
                 for(auto node = rootChildNode->begin(); node != rootChildNode->end(); node++)
                 try
                 {
-                    std::shared_ptr<MetadataInternal> spMetadata = parseMetadataFromNode(*node, schemas);
-                    metadata.push_back(spMetadata);
+                    std::shared_ptr<MetadataInternal> spMetadata = parseMetadataFromNode(*node, descs, filter);
+                    if(spMetadata)
+                        metadata.push_back(spMetadata);
                 }
                 catch(Exception& e)
                 {
@@ -558,4 +584,781 @@ bool JSONReader::parseVideoSegments(const std::string& text, std::vector<std::sh
     return true;
 }
 
+namespace
+{
+
+/*
+ * Pull parser reading JSON text from the input by blocks.
+ * Objects and arrays are walked by nextMember() and nextElement() until they return false,
+ * values that aren't needed are skipped, so no part of the document is kept after it has been read.
+ */
+class JSONTokenizer
+{
+public:
+    explicit JSONTokenizer(std::istream& input) : input(input), buffer(64 * 1024), pos(0), len(0) {}
+
+    void beginObject()
+    {
+        expect('{');
+        first.push_back(true);
+    }
+
+    bool nextMember(std::string& name)
+    {
+        if(!nextItem('}'))
+            return false;
+        name = string();
+        expect(':');
+        return true;
+    }
+
+    void beginArray()
+    {
+        expect('[');
+        first.push_back(true);
+    }
+
+    bool nextElement()
+    {
+        return nextItem(']');
+    }
+
+    bool isObject() { return peek() == '{'; }
+    bool isArray() { return peek() == '['; }
+
+    // String, number or literal as text
+    std::string scalar()
+    {
+        if(peek() == '"')
+            return string();
+        return literal();
+    }
+
+    std::string text()
+    {
+        if(peek() != '"')
+            fail("JSON string is expected");
+        return string();
+    }
+
+    std::string number()
+    {
+        if(peek() == '"')
+            fail("JSON number is expected");
+        std::string text = literal();
+        if(!isNumber(text))
+            fail("JSON number is expected");
+        return text;
+    }
+
+    // Nested containers are tracked by a stack, so deep input doesn't exhaust the call stack
+    void skipValue()
+    {
+        std::vector<char> closers;
+        std::string name;
+        for(;;)
+        {
+            if(isObject())
+            {
+                beginObject();
+                closers.push_back('}');
+            }
+            else if(isArray())
+            {
+                beginArray();
+                closers.push_back(']');
+            }
+            else
+                scalar();
+
+            for(;;)
+            {
+                if(closers.empty())
+                    return;
+                if(closers.back() == '}' ? nextMember(name) : nextElement())
+                    break;
+                closers.pop_back();
+            }
+        }
+    }
+
+    void end()
+    {
+        if(peek() != EOF)
+            fail("Unexpected data after JSON root");
+    }
+
+private:
+    static bool isDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    // Number grammar of JSON
+    static bool isNumber(const std::string& text)
+    {
+        size_t i = 0, n = text.size();
+        if(i < n && text[i] == '-')
+            i++;
+        if(i < n && text[i] == '0')
+            i++;
+        else if(i < n && isDigit(text[i]))
+            while(i < n && isDigit(text[i]))
+                i++;
+        else
+            return false;
+        if(i < n && text[i] == '.')
+        {
+            if(++i == n || !isDigit(text[i]))
+                return false;
+            while(i < n && isDigit(text[i]))
+                i++;
+        }
+        if(i < n && (text[i] == 'e' || text[i] == 'E'))
+        {
+            if(++i < n && (text[i] == '+' || text[i] == '-'))
+                i++;
+            if(i == n || !isDigit(text[i]))
+                return false;
+            while(i < n && isDigit(text[i]))
+                i++;
+        }
+        return i == n;
+    }
+
+    // Number, true, false or null
+    std::string literal()
+    {
+        std::string text;
+        while(fill() && !isDelimiter(buffer[pos]))
+            text += buffer[pos++];
+        if(text.empty())
+            fail("JSON value is expected");
+        if(text != "true" && text != "false" && text != "null" && !isNumber(text))
+            fail("Invalid JSON literal");
+        return text;
+    }
+
+    static bool isDelimiter(char c)
+    {
+        return c == ',' || c == ':' || c == '}' || c == ']' || c == '{' || c == '[' || c == '"' ||
+               c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    static void fail(const char* message)
+    {
+        VMF_EXCEPTION(vmf::IncorrectParamException, message);
+    }
+
+    bool fill()
+    {
+        if(pos < len)
+            return true;
+        input.read(&buffer[0], buffer.size());
+        if(input.bad())
+            fail("Can't read JSON input");
+        pos = 0;
+        len = (size_t) input.gcount();
+        return len > 0;
+    }
+
+    int peek()
+    {
+        while(fill())
+        {
+            char c = buffer[pos];
+            if(c != ' ' && c != '\t' && c != '\n' && c != '\r')
+                return c;
+            pos++;
+        }
+        return EOF;
+    }
+
+    char get()
+    {
+        if(!fill())
+            fail("Unexpected end of JSON input");
+        return buffer[pos++];
+    }
+
+    void expect(char c)
+    {
+        if(peek() != c)
+            fail("Unexpected JSON token");
+        pos++;
+    }
+
+    bool nextItem(char close)
+    {
+        if(peek() == close)
+        {
+            pos++;
+            first.pop_back();
+            return false;
+        }
+        if(!first.back())
+            expect(',');
+        first.back() = false;
+        return true;
+    }
+
+    unsigned int hex()
+    {
+        unsigned int code = 0;
+        for(int i = 0; i < 4; i++)
+        {
+            char c = get();
+            code <<= 4;
+            if(c >= '0' && c <= '9')
+                code |= c - '0';
+            else if(c >= 'a' && c <= 'f')
+                code |= c - 'a' + 10;
+            else if(c >= 'A' && c <= 'F')
+                code |= c - 'A' + 10;
+            else
+                fail("Invalid JSON escape sequence");
+        }
+        return code;
+    }
+
+    // Codes below 0x100 are taken as single bytes the way libjson writes and reads them
+    static void append(std::string& text, unsigned int code)
+    {
+        if(code < 0x100)
+            text += (char) code;
+        else if(code < 0x800)
+        {
+            text += (char) (0xc0 | (code >> 6));
+            text += (char) (0x80 | (code & 0x3f));
+        }
+        else if(code < 0x10000)
+        {
+            text += (char) (0xe0 | (code >> 12));
+            text += (char) (0x80 | ((code >> 6) & 0x3f));
+            text += (char) (0x80 | (code & 0x3f));
+        }
+        else
+        {
+            text += (char) (0xf0 | (code >> 18));
+            text += (char) (0x80 | ((code >> 12) & 0x3f));
+            text += (char) (0x80 | ((code >> 6) & 0x3f));
+            text += (char) (0x80 | (code & 0x3f));
+        }
+    }
+
+    std::string string()
+    {
+        expect('"');
+        std::string text;
+        for(;;)
+        {
+            char c = get();
+            if(c == '"')
+                return text;
+            if(c != '\\')
+            {
+                text += c;
+                continue;
+            }
+            switch(c = get())
+            {
+            case 'n': text += '\n'; break;
+            case 't': text += '\t'; break;
+            case 'r': text += '\r'; break;
+            case 'b': text += '\b'; break;
+            case 'f': text += '\f'; break;
+            case 'u':
+            {
+                // a high surrogate must be followed by a low one
+                unsigned int code = hex();
+                if(code >= 0xdc00 && code < 0xe000)
+                    fail("Invalid JSON escape sequence");
+                if(code >= 0xd800 && code < 0xdc00)
+                {
+                    if(get() != '\\' || get() != 'u')
+                        fail("Invalid JSON escape sequence");
+                    unsigned int low = hex();
+                    if(low < 0xdc00 || low >= 0xe000)
+                        fail("Invalid JSON escape sequence");
+                    code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                }
+                append(text, code);
+                break;
+            }
+            default: text += c; break;
+            }
+        }
+    }
+
+    std::istream& input;
+    std::vector<char> buffer;
+    size_t pos, len;
+    std::vector<bool> first;
+};
+
+bool toBool(const std::string& value, const char* message)
+{
+    if(value == "true")
+        return true;
+    else if(value == "false")
+        return false;
+    VMF_EXCEPTION(vmf::IncorrectParamException, message);
+}
+
+// Joins the value split to the *_lo and *_hi members
+struct SplitValue
+{
+    SplitValue() : hasLo(false), hasHi(false), lo(0), hi(0) {}
+
+    bool defined() const { return hasLo && hasHi; }
+    long long value() const { return ((long long)hi << 32) | lo; }
+
+    bool hasLo, hasHi;
+    unsigned long lo, hi;
+};
+
+void setSplit(SplitValue& split, bool isHi, const std::string& value)
+{
+    unsigned long number = strtoul(value.c_str(), NULL, 10);
+    if(isHi)
+    {
+        split.hi = number;
+        split.hasHi = true;
+    }
+    else
+    {
+        split.lo = number;
+        split.hasLo = true;
+    }
+}
+
+}
+
+static FieldDesc readFieldDesc(JSONTokenizer& json)
+{
+    std::string member, name, type;
+    bool hasName = false, hasType = false, optional = false;
+    json.beginObject();
+    while(json.nextMember(member))
+    {
+        if(member == ATTR_NAME)
+        {
+            name = json.text();
+            hasName = true;
+        }
+        else if(member == ATTR_FIELD_TYPE)
+        {
+            type = json.text();
+            hasType = true;
+        }
+        else if(member == ATTR_FIELD_OPTIONAL)
+            optional = toBool(json.scalar(), "Invalid value of boolean attribute 'optional'");
+        else
+            json.skipValue();
+    }
+    if(!hasName || !hasType)
+        VMF_EXCEPTION(IncorrectParamException, "Field has no 'name' or 'type' attribute");
+    return FieldDesc(name, Variant::typeFromString(type), optional);
+}
+
+static std::shared_ptr<ReferenceDesc> readReferenceDesc(JSONTokenizer& json)
+{
+    std::string member, name;
+    bool hasName = false, isUnique = false, isCustom = false;
+    json.beginObject();
+    while(json.nextMember(member))
+    {
+        if(member == ATTR_NAME)
+        {
+            name = json.text();
+            hasName = true;
+        }
+        else if(member == ATTR_REFERENCE_UNIQUE)
+            isUnique = toBool(json.scalar(), "Invalid value of boolean attribute 'isUnique'");
+        else if(member == ATTR_REFERENCE_CUSTOM)
+            isCustom = toBool(json.scalar(), "Invalid value of boolean attribute 'isCustom'");
+        else
+            json.skipValue();
+    }
+    if(!hasName)
+        VMF_EXCEPTION(IncorrectParamException, "Field has no 'name' attribute");
+    return std::make_shared<ReferenceDesc>(name, isUnique, isCustom);
+}
+
+static std::shared_ptr<MetadataDesc> readMetadataDesc(JSONTokenizer& json)
+{
+    std::string member, name;
+    bool hasName = false, hasFields = false, hasReferences = false;
+    std::vector<FieldDesc> vFields;
+    std::vector<std::shared_ptr<ReferenceDesc>> vReferences;
+    json.beginObject();
+    while(json.nextMember(member))
+    {
+        if(member == ATTR_NAME)
+        {
+            name = json.text();
+            hasName = true;
+        }
+        else if(member == TAG_FIELDS_ARRAY)
+        {
+            json.beginArray();
+            while(json.nextElement())
+                vFields.push_back(readFieldDesc(json));
+            hasFields = true;
+        }
+        else if(member == TAG_METADATA_REFERENCES_ARRAY)
+        {
+            json.beginArray();
+            while(json.nextElement())
+                vReferences.push_back(readReferenceDesc(json));
+            hasReferences = true;
+        }
+        else
+            json.skipValue();
+    }
+    if(!hasName)
+        VMF_EXCEPTION(IncorrectParamException, "Description has no name");
+    if(!hasFields)
+        VMF_EXCEPTION(IncorrectParamException, "Description has no fields array");
+    if(!hasReferences)
+        VMF_EXCEPTION(IncorrectParamException, "Description has no references array");
+    return std::make_shared<MetadataDesc>(name, vFields, vReferences);
+}
+
+static std::shared_ptr<MetadataSchema> readSchema(JSONTokenizer& json)
+{
+    std::string member, name, author;
+    bool hasName = false, hasDescs = false;
+    std::vector<std::shared_ptr<MetadataDesc>> vDescs;
+    json.beginObject();
+    while(json.nextMember(member))
+    {
+        if(member == ATTR_NAME)
+        {
+            name = json.text();
+            hasName = true;
+        }
+        else if(member == ATTR_SCHEMA_AUTHOR)
+            author = json.text();
+        else if(member == TAG_DESCRIPTIONS_ARRAY)
+        {
+            json.beginArray();
+            while(json.nextElement())
+                vDescs.push_back(readMetadataDesc(json));
+            hasDescs = true;
+        }
+        else
+            json.skipValue();
+    }
+    if(!hasName)
+        VMF_EXCEPTION(IncorrectParamException, "Schema has no name");
+    if(!hasDescs)
+        VMF_EXCEPTION(IncorrectParamException, "Can't find descriptions-array JSON node");
+
+    std::shared_ptr<MetadataSchema> spSchema = std::make_shared<MetadataSchema>(name, author);
+    for(auto spDesc = vDescs.begin(); spDesc != vDescs.end(); spDesc++)
+        spSchema->add(*spDesc);
+    return spSchema;
+}
+
+/*
+ * Returns nullptr if the item doesn't pass the filter. Fields and references of an item
+ * with a rejected description are skipped unparsed if the names precede them.
+ */
+static std::shared_ptr<MetadataInternal> readMetadata(JSONTokenizer& json, DescTable& descs, const ReadFilter& filter)
+{
+    std::string member, schemaName, descName, id;
+    SplitValue frameIndex, numOfFrames, timestamp, duration;
+    std::vector<std::pair<std::string, std::string>> fields;
+    std::vector<std::pair<IdType, std::string>> refs;
+    bool hasFields = false;
+    json.beginObject();
+    while(json.nextMember(member))
+    {
+        if(member == ATTR_METADATA_SCHEMA)
+            schemaName = json.text();
+        else if(member == ATTR_METADATA_DESCRIPTION)
+            descName = json.text();
+        else if(member == ATTR_ID)
+            id = json.number();
+        else if(member == ATTR_METADATA_FRAME_IDX_LO || member == ATTR_METADATA_FRAME_IDX_HI)
+            setSplit(frameIndex, member == ATTR_METADATA_FRAME_IDX_HI, json.number());
+        else if(member == ATTR_METADATA_NFRAMES_LO || member == ATTR_METADATA_NFRAMES_HI)
+            setSplit(numOfFrames, member == ATTR_METADATA_NFRAMES_HI, json.number());
+        else if(member == ATTR_METADATA_TIMESTAMP_LO || member == ATTR_METADATA_TIMESTAMP_HI)
+            setSplit(timestamp, member == ATTR_METADATA_TIMESTAMP_HI, json.number());
+        else if(member == ATTR_METADATA_DURATION_LO || member == ATTR_METADATA_DURATION_HI)
+            setSplit(duration, member == ATTR_METADATA_DURATION_HI, json.number());
+        else if((member == TAG_FIELDS_ARRAY || member == TAG_METADATA_REFERENCES_ARRAY) &&
+                !schemaName.empty() && !descName.empty() && !filter.acceptsDescription(schemaName, descName))
+        {
+            json.skipValue();
+            hasFields = hasFields || member == TAG_FIELDS_ARRAY;
+        }
+        else if(member == TAG_FIELDS_ARRAY)
+        {
+            json.beginArray();
+            while(json.nextElement())
+            {
+                std::string fieldMember, name, value;
+                bool hasName = false, hasValue = false;
+                json.beginObject();
+                while(json.nextMember(fieldMember))
+                {
+                    if(fieldMember == ATTR_NAME)
+                    {
+                        name = json.text();
+                        hasName = true;
+                    }
+                    else if(fieldMember == ATTR_VALUE)
+                    {
+                        value = json.scalar();
+                        hasValue = true;
+                    }
+                    else
+                        json.skipValue();
+                }
+                if(!hasName || !hasValue)
+                    VMF_EXCEPTION(vmf::IncorrectParamException, "Missing field name or field value");
+                fields.push_back(std::make_pair(name, value));
+            }
+            hasFields = true;
+        }
+        else if(member == TAG_METADATA_REFERENCES_ARRAY)
+        {
+            json.beginArray();
+            while(json.nextElement())
+            {
+                std::string refMember, name, refId;
+                bool hasName = false;
+                json.beginObject();
+                while(json.nextMember(refMember))
+                {
+                    if(refMember == ATTR_ID)
+                        refId = json.number();
+                    else if(refMember == ATTR_NAME)
+                    {
+                        name = json.text();
+                        hasName = true;
+                    }
+                    else
+                        json.skipValue();
+                }
+                if(refId.empty()) VMF_EXCEPTION(vmf::IncorrectParamException, "Missing reference 'id'");
+                if(!hasName) VMF_EXCEPTION(vmf::IncorrectParamException, "Missing reference 'name'");
+                refs.push_back(std::make_pair(IdType(ATOLL(refId.c_str())), name));
+            }
+        }
+        else
+            json.skipValue();
+    }
+
+    if(schemaName.empty() || descName.empty() || id.empty())
+        VMF_EXCEPTION(vmf::IncorrectParamException, "Metadata item has no schema name, description name or id");
+
+    if(!filter.acceptsDescription(schemaName, descName) ||
+       !filter.acceptsPosition(frameIndex.defined() ? frameIndex.value() : vmf::Metadata::UNDEFINED_FRAME_INDEX,
+                               numOfFrames.defined() ? numOfFrames.value() : vmf::Metadata::UNDEFINED_FRAMES_NUMBER,
+                               timestamp.defined() ? timestamp.value() : vmf::Metadata::UNDEFINED_TIMESTAMP,
+                               duration.defined() ? duration.value() : vmf::Metadata::UNDEFINED_DURATION))
+        return nullptr;
+
+    const std::shared_ptr<MetadataDesc>& spDesc = descs.find(schemaName, descName);
+    if(!hasFields)
+        VMF_EXCEPTION(vmf::IncorrectParamException, "No metadata fields array");
+
+    std::shared_ptr<MetadataInternal> spMetadataInternal(new MetadataInternal(spDesc));
+    spMetadataInternal->setId(ATOLL(id.c_str()));
+    if(frameIndex.defined())
+    {
+        if(numOfFrames.defined())
+            spMetadataInternal->setFrameIndex(frameIndex.value(), numOfFrames.value());
+        else
+            spMetadataInternal->setFrameIndex(frameIndex.value());
+    }
+    if(timestamp.defined())
+    {
+        if(duration.defined())
+            spMetadataInternal->setTimestamp(timestamp.value(), duration.value());
+        else
+            spMetadataInternal->setTimestamp(timestamp.value());
+    }
+    for(auto field = fields.begin(); field != fields.end(); field++)
+    {
+        FieldDesc fieldDesc;
+        vmf::Variant field_value;
+        spDesc->getFieldDesc(fieldDesc, field->first);
+        field_value.fromString(fieldDesc.type, field->second);
+        spMetadataInternal->setFieldValue(field->first, field_value);
+    }
+    spMetadataInternal->vRefs.swap(refs);
+
+    return spMetadataInternal;
+}
+
+static std::shared_ptr<MetadataStream::VideoSegment> readSegment(JSONTokenizer& json)
+{
+    std::string member, title, fps, time, duration, width, height;
+    json.beginObject();
+    while(json.nextMember(member))
+    {
+        if(member == ATTR_SEGMENT_TITLE)
+            title = json.text();
+        else if(member == ATTR_SEGMENT_FPS)
+            fps = json.number();
+        else if(member == ATTR_SEGMENT_TIME)
+            time = json.number();
+        else if(member == ATTR_SEGMENT_DURATION)
+            duration = json.number();
+        else if(member == ATTR_SEGMENT_WIDTH)
+            width = json.number();
+        else if(member == ATTR_SEGMENT_HEIGHT)
+            height = json.number();
+        else
+            json.skipValue();
+    }
+
+    if(fps.empty())
+        VMF_EXCEPTION(vmf::InternalErrorException, "JSON element has no fps value");
+    if(time.empty())
+        VMF_EXCEPTION(vmf::InternalErrorException, "JSON element has no time value");
+    if(title.empty())
+        VMF_EXCEPTION(vmf::InternalErrorException, "JSON element has invalid title");
+    if(atof(fps.c_str()) <= 0)
+        VMF_EXCEPTION(vmf::InternalErrorException, "JSON element has invalid fps value");
+    if(ATOLL(time.c_str()) < 0)
+        VMF_EXCEPTION(vmf::InternalErrorException, "JSON element has invalid time value");
+
+    std::shared_ptr<MetadataStream::VideoSegment> spSegment(new MetadataStream::VideoSegment(title, atof(fps.c_str()), ATOLL(time.c_str())));
+    if(!duration.empty() && ATOLL(duration.c_str()) > 0)
+        spSegment->setDuration(ATOLL(duration.c_str()));
+    if(!width.empty() && !height.empty())
+    {
+        long w = atol(width.c_str()), h = atol(height.c_str());
+        if(w > 0 && h > 0)
+            spSegment->setResolution(w, h);
+    }
+    return spSegment;
+}
+
+/*
+ * Reads a member of the root or 'vmf' object: a single item or an array of them is added to the stream,
+ * root attributes are collected from the 'vmf' object and other members are skipped.
+ */
+static void readMember(JSONTokenizer& json, const std::string& name, MetadataStream& stream,
+                       std::vector<std::shared_ptr<MetadataSchema>>& schemas, DescTable& descs, ItemBatch& items,
+                       std::map<std::string, std::string>& rootAttributes, const ReadFilter& filter)
+{
+    std::string member;
+    if(name == TAG_VMF)
+    {
+        json.beginObject();
+        while(json.nextMember(member))
+        {
+            if(member == ATTR_VMF_NEXTID)
+                rootAttributes[member] = json.number();
+            else if(member == ATTR_VMF_FILEPATH || member == ATTR_VMF_CHECKSUM)
+                rootAttributes[member] = json.text();
+            else
+                readMember(json, member, stream, schemas, descs, items, rootAttributes, filter);
+        }
+    }
+    else if(name == TAG_VIDEO_SEGMENTS_ARRAY)
+    {
+        json.beginArray();
+        while(json.nextElement())
+            stream.addVideoSegment(readSegment(json));
+    }
+    else if(name == TAG_VIDEO_SEGMENT)
+        stream.addVideoSegment(readSegment(json));
+    else if(name == TAG_SCHEMAS_ARRAY || name == TAG_SCHEMA)
+    {
+        bool isArray = name == TAG_SCHEMAS_ARRAY;
+        if(isArray)
+            json.beginArray();
+        while(!isArray || json.nextElement())
+        {
+            std::shared_ptr<MetadataSchema> spSchema = readSchema(json);
+            if(filter.acceptsSchema(spSchema->getName()))
+            {
+                schemas.push_back(spSchema);
+                stream.addSchema(spSchema);
+            }
+            if(!isArray)
+                break;
+        }
+    }
+    else if(name == TAG_METADATA_ARRAY)
+    {
+        json.beginArray();
+        while(json.nextElement())
+        {
+            std::shared_ptr<MetadataInternal> spMetadata = readMetadata(json, descs, filter);
+            if(spMetadata)
+                items.add(spMetadata);
+        }
+    }
+    else if(name == TAG_METADATA)
+    {
+        std::shared_ptr<MetadataInternal> spMetadata = readMetadata(json, descs, filter);
+        if(spMetadata)
+            items.add(spMetadata);
+    }
+    else
+        json.skipValue();
+}
+
+bool JSONReader::parseStream(std::istream& input, MetadataStream& stream)
+{
+    std::vector<std::shared_ptr<MetadataSchema>> schemas;
+    std::vector<std::string> names = stream.getAllSchemaNames();
+    for (auto name = names.begin(); name != names.end(); ++name)
+        schemas.push_back(stream.getSchema(*name));
+
+    std::map<std::string, std::string> rootAttributes;
+    DescTable descs(schemas);
+    ItemBatch items(stream);
+    bool result = true;
+    try
+    {
+        JSONTokenizer json(input);
+        std::string member;
+        json.beginObject();
+        while(json.nextMember(member))
+            readMember(json, member, stream, schemas, descs, items, rootAttributes, filter);
+        json.end();
+    }
+    catch(Exception& e)
+    {
+        VMF_LOG_ERROR("Exception: %s", e.what());
+        result = false;
+    }
+
+    // items parsed before an error are kept
+    try
+    {
+        items.flush();
+    }
+    catch(Exception& e)
+    {
+        VMF_LOG_ERROR("Exception: %s", e.what());
+        result = false;
+    }
+
+    applyRootAttributes(rootAttributes, stream);
+
+    return result;
+}
+
+bool JSONReader::parseFile(const std::string& fileName, MetadataStream& stream)
+{
+    std::ifstream input(fileName.c_str(), std::ios::in | std::ios::binary);
+    if (!input.is_open())
+    {
+        VMF_LOG_ERROR("Can't open JSON file %s", fileName.c_str());
+        return false;
+    }
+    return parseStream(input, stream);
+}
+
 }//vmf
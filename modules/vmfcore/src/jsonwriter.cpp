@@ -16,10 +16,14 @@
  */
 #include "vmf/jsonwriter.hpp"
 #include "vmf/rwconst.hpp"
+#include "chunks.hpp"
+#include "streamcheck.hpp"
 
 #include "libjson.h"
 
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
 
 namespace vmf
 {
@@ -257,20 +261,7 @@ std::string JSONWriter::store(const IdType& nextId,
     const std::vector<std::shared_ptr<MetadataSchema>>& schemas,
     const MetadataSet& set)
 {
-    if(schemas.empty())
-        VMF_EXCEPTION(vmf::IncorrectParamException, "Input schemas vector is empty");
-
-    std::for_each(set.begin(), set.end(), [&](const std::shared_ptr<Metadata>& spMetadata)
-    {
-        bool NoSchemaForMetadata = true;
-        std::for_each(schemas.begin(), schemas.end(), [&](const std::shared_ptr<MetadataSchema>& spSchema)
-        {
-            if(spMetadata->getSchemaName() == spSchema->getName())
-                NoSchemaForMetadata = false;
-        });
-        if(NoSchemaForMetadata)
-            VMF_EXCEPTION(IncorrectParamException, "MetadataSet item references unknown schema");
-    });
+    checkStream(schemas, set);
 
     JSONNode vmfRootNode(JSON_NODE);
     vmfRootNode.set_name(TAG_VMF);
@@ -369,4 +360,399 @@ std::string JSONWriter::store(const std::vector<std::shared_ptr<MetadataStream::
     return root.write_formatted();
 }
 
+namespace
+{
+
+/*
+ * Emits the same text as JSONNode::write_formatted() does for the equal node tree:
+ * members and elements are put on separate lines indented by tabs, strings are escaped
+ * and numbers are formatted by the libjson rules. The text is written to the output by blocks.
+ */
+class JSONEmitter
+{
+public:
+    explicit JSONEmitter(std::ostream& output) : output(&output) {}
+
+    // Emits elements of an array nested at the depth, they are kept in the buffer and taken by take()
+    JSONEmitter(size_t depth, bool continues) : output(NULL), hasChildren(depth, true)
+    {
+        hasChildren.back() = continues;
+    }
+
+    void beginObject(const char* name = NULL) { open(name, '{'); }
+    void endObject() { close('}'); }
+    void beginArray(const char* name = NULL) { open(name, '['); }
+    void endArray() { close(']'); }
+
+    void value(const char* name, const std::string& text)
+    {
+        member(name);
+        buffer += '"';
+        escape(text);
+        buffer += '"';
+    }
+
+    void number(const char* name, long long value)
+    {
+        member(name);
+        buffer += std::to_string(value);
+    }
+
+    void number(const char* name, unsigned long value)
+    {
+        member(name);
+        buffer += std::to_string(value);
+    }
+
+    void number(const char* name, double value)
+    {
+        member(name);
+        // integral values are written without a fractional part, the others as "%Lf" without trailing zeros
+        if(value >= 0.0 && equal(value, (double)(unsigned long long)value))
+            buffer += std::to_string((unsigned long)(unsigned long long)value);
+        else if(equal(value, (double)(long long)value))
+            buffer += std::to_string((long)(long long)value);
+        else
+        {
+            char text[64];
+            snprintf(text, sizeof(text) - 1, "%Lf", (long double)value);
+            char* end = strchr(text, '.');
+            if(end != NULL)
+            {
+                for(char* digit = end + 1; *digit; digit++)
+                    if(*digit != '0')
+                        end = digit + 1;
+                *end = '\0';
+            }
+            buffer += text;
+        }
+    }
+
+    // Writes elements emitted by the emitter created for the depth of the array open here
+    void elements(const std::string& text)
+    {
+        if(text.empty())
+            return;
+        flush();
+        write(text);
+        hasChildren.back() = true;
+    }
+
+    void take(std::string& text)
+    {
+        text.swap(buffer);
+        buffer.clear();
+    }
+
+    void flush()
+    {
+        write(buffer);
+        buffer.clear();
+    }
+
+    size_t depth() const
+    {
+        return hasChildren.size();
+    }
+
+private:
+    void write(const std::string& text)
+    {
+        output->write(text.data(), text.size());
+        if(output->fail())
+            VMF_EXCEPTION(vmf::InternalErrorException, "Can't write JSON to the output");
+    }
+
+    static bool equal(double a, double b)
+    {
+        return (a > b) ? (a - b) < 0.00001 : (a - b) > -0.00001;
+    }
+
+    void member(const char* name)
+    {
+        if(!hasChildren.empty())
+        {
+            if(hasChildren.back())
+                buffer += ',';
+            hasChildren.back() = true;
+            buffer += '\n';
+            buffer.append(hasChildren.size(), '\t');
+        }
+        if(name != NULL)
+        {
+            buffer += '"';
+            buffer += name;
+            buffer += "\" : ";
+        }
+    }
+
+    void open(const char* name, char bracket)
+    {
+        member(name);
+        buffer += bracket;
+        hasChildren.push_back(false);
+    }
+
+    void close(char bracket)
+    {
+        bool children = hasChildren.back();
+        hasChildren.pop_back();
+        if(children)
+        {
+            buffer += '\n';
+            buffer.append(hasChildren.size(), '\t');
+        }
+        buffer += bracket;
+        if(output != NULL && buffer.size() >= blockSize)
+            flush();
+    }
+
+    void escape(const std::string& text)
+    {
+        static const char digits[] = "0123456789ABCDEF";
+        for(auto c = text.begin(); c != text.end(); c++)
+        {
+            switch(*c)
+            {
+            case '"':  buffer += "\\\""; break;
+            case '\\': buffer += "\\\\"; break;
+            case '\t': buffer += "\\t"; break;
+            case '\n': buffer += "\\n"; break;
+            case '\r': buffer += "\\r"; break;
+            case '/':  buffer += "\\/"; break;
+            case '\b': buffer += "\\b"; break;
+            case '\f': buffer += "\\f"; break;
+            default:
+            {
+                unsigned char code = (unsigned char) *c;
+                if(code < 32 || code > 126)
+                {
+                    buffer += "\\u00";
+                    buffer += digits[code >> 4];
+                    buffer += digits[code & 0xf];
+                }
+                else
+                    buffer += *c;
+            }
+            }
+        }
+    }
+
+    static const size_t blockSize = 64 * 1024;
+
+    std::ostream* output;
+    std::string buffer;
+    std::vector<bool> hasChildren;
+};
+
+}
+
+static void write(JSONEmitter& emitter, const std::shared_ptr<MetadataSchema>& spSchema)
+{
+    emitter.value(ATTR_NAME, spSchema->getName());
+    emitter.value(ATTR_SCHEMA_AUTHOR, spSchema->getAuthor());
+
+    emitter.beginArray(TAG_DESCRIPTIONS_ARRAY);
+    auto vDescs = spSchema->getAll();
+    for( auto spDescriptor = vDescs.begin(); spDescriptor != vDescs.end(); spDescriptor++)
+    {
+        emitter.beginObject();
+        emitter.value(ATTR_NAME, (*spDescriptor)->getMetadataName());
+
+        emitter.beginArray(TAG_FIELDS_ARRAY);
+        auto vFields = spDescriptor->get()->getFields();
+        for( auto fieldDesc = vFields.begin(); fieldDesc != vFields.end(); fieldDesc++)
+        {
+            emitter.beginObject();
+            emitter.value(ATTR_NAME, fieldDesc->name);
+            emitter.value(ATTR_FIELD_TYPE, vmf::Variant::typeToString(fieldDesc->type));
+            if(fieldDesc->optional)
+                emitter.value(ATTR_FIELD_OPTIONAL, "true");
+            emitter.endObject();
+        }
+        emitter.endArray();
+
+        emitter.beginArray(TAG_METADATA_REFERENCES_ARRAY);
+        auto vReference = (*spDescriptor)->getAllReferenceDescs();
+        for (auto refDesc = vReference.begin(); refDesc != vReference.end(); refDesc++)
+        {
+            if ((*refDesc)->name.empty())
+                continue;
+
+            emitter.beginObject();
+            emitter.value(ATTR_NAME, (*refDesc)->name);
+            if ((*refDesc)->isUnique)
+                emitter.value(ATTR_REFERENCE_UNIQUE, "true");
+            if ((*refDesc)->isCustom)
+                emitter.value(ATTR_REFERENCE_CUSTOM, "true");
+            emitter.endObject();
+        }
+        emitter.endArray();
+
+        emitter.endObject();
+    }
+    emitter.endArray();
+}
+
+static void writeSplit(JSONEmitter& emitter, const char* nameLo, const char* nameHi, long long llVal)
+{
+    unsigned long lo = llVal & 0xffffffff;
+    unsigned long hi = llVal >> 32;
+    emitter.number(nameLo, lo);
+    emitter.number(nameHi, hi);
+}
+
+static void write(JSONEmitter& emitter, const std::shared_ptr<Metadata>& spMetadata)
+{
+    emitter.value(ATTR_METADATA_SCHEMA, spMetadata->getSchemaName());
+    emitter.value(ATTR_METADATA_DESCRIPTION, spMetadata->getName());
+    emitter.number(ATTR_ID, (long long)spMetadata->getId());
+    if (spMetadata->getFrameIndex() != Metadata::UNDEFINED_FRAME_INDEX)
+        writeSplit(emitter, ATTR_METADATA_FRAME_IDX_LO, ATTR_METADATA_FRAME_IDX_HI, spMetadata->getFrameIndex());
+    if (spMetadata->getNumOfFrames() != Metadata::UNDEFINED_FRAMES_NUMBER)
+        writeSplit(emitter, ATTR_METADATA_NFRAMES_LO, ATTR_METADATA_NFRAMES_HI, spMetadata->getNumOfFrames());
+    if (spMetadata->getTime() != Metadata::UNDEFINED_TIMESTAMP)
+        writeSplit(emitter, ATTR_METADATA_TIMESTAMP_LO, ATTR_METADATA_TIMESTAMP_HI, spMetadata->getTime());
+    if (spMetadata->getDuration() != Metadata::UNDEFINED_DURATION)
+        writeSplit(emitter, ATTR_METADATA_DURATION_LO, ATTR_METADATA_DURATION_HI, spMetadata->getDuration());
+
+    emitter.beginArray(TAG_FIELDS_ARRAY);
+    auto vFields = spMetadata->getDesc()->getFields();
+    for( auto fieldDesc = vFields.begin(); fieldDesc != vFields.end(); fieldDesc++)
+    {
+        Variant val = spMetadata->getFieldValue(fieldDesc->name);
+        if (!val.isEmpty())
+        {
+            emitter.beginObject();
+            emitter.value(ATTR_NAME, fieldDesc->name);
+            emitter.value(ATTR_VALUE, val.toString());
+            emitter.endObject();
+        }
+    }
+    emitter.endArray();
+
+    auto refs = spMetadata->getAllReferences();
+    if(!refs.empty())
+    {
+        emitter.beginArray(TAG_METADATA_REFERENCES_ARRAY);
+        for( auto reference = refs.begin(); reference != refs.end(); reference++)
+        {
+            emitter.beginObject();
+            emitter.value(ATTR_NAME, reference->getReferenceDescription()->name);
+            emitter.number(ATTR_ID, (long long)reference->getReferenceMetadata().lock()->getId());
+            emitter.endObject();
+        }
+        emitter.endArray();
+    }
+}
+
+static void write(JSONEmitter& emitter, const std::shared_ptr<MetadataStream::VideoSegment>& spSegment)
+{
+    if (spSegment->getTitle() == "" || spSegment->getFPS() <= 0 || spSegment->getTime() < 0)
+        VMF_EXCEPTION(IncorrectParamException, "Invalid video segment: title, fps or timestamp value(s) is/are invalid!");
+
+    emitter.value(ATTR_SEGMENT_TITLE, spSegment->getTitle());
+    emitter.number(ATTR_SEGMENT_FPS, spSegment->getFPS());
+    emitter.number(ATTR_SEGMENT_TIME, spSegment->getTime());
+
+    if (spSegment->getDuration() > 0)
+        emitter.number(ATTR_SEGMENT_DURATION, spSegment->getDuration());
+
+    long width, height;
+    spSegment->getResolution(width, height);
+    if (width > 0 && height > 0)
+    {
+        emitter.number(ATTR_SEGMENT_WIDTH, (long long)width);
+        emitter.number(ATTR_SEGMENT_HEIGHT, (long long)height);
+    }
+}
+
+template <typename Item>
+static void writeElement(JSONEmitter& emitter, const Item& item, const char* nullMessage)
+{
+    if( item == nullptr )
+        VMF_EXCEPTION(vmf::IncorrectParamException, nullMessage);
+    emitter.beginObject();
+    write(emitter, item);
+    emitter.endObject();
+}
+
+template <typename Items>
+static void writeArray(JSONEmitter& emitter, const char* arrayName, const Items& items, const char* nullMessage)
+{
+    emitter.beginArray(arrayName);
+    for(auto item = items.begin(); item != items.end(); item++)
+        writeElement(emitter, *item, nullMessage);
+    emitter.endArray();
+}
+
+static void writeMetadataArray(JSONEmitter& emitter, const MetadataSet& set, unsigned int threads)
+{
+    if(threads == 1)
+    {
+        writeArray(emitter, TAG_METADATA_ARRAY, set, "Metadata pointer is null");
+        return;
+    }
+
+    emitter.beginArray(TAG_METADATA_ARRAY);
+    size_t depth = emitter.depth();
+    formatChunks(set.size(), threads,
+        [&](size_t begin, size_t end, std::string& text)
+        {
+            // the first element of a chunk follows the last one of the previous chunk
+            JSONEmitter chunk(depth, begin > 0);
+            for(size_t i = begin; i < end; i++)
+                writeElement(chunk, set[i], "Metadata pointer is null");
+            chunk.take(text);
+        },
+        [&](const std::string& text) { emitter.elements(text); });
+    emitter.endArray();
+}
+
+static void storeStream(std::ostream& output, const IdType& nextId,
+    const std::string& filepath,
+    const std::string& checksum,
+    const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments,
+    const std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+    const MetadataSet& set,
+    unsigned int threads)
+{
+    checkStream(schemas, set);
+
+    JSONEmitter emitter(output);
+    emitter.beginObject();
+    emitter.beginObject(TAG_VMF);
+    emitter.number(ATTR_VMF_NEXTID, (long long)nextId);
+    emitter.value(ATTR_VMF_FILEPATH, filepath);
+    emitter.value(ATTR_VMF_CHECKSUM, checksum);
+    if(!segments.empty())
+        writeArray(emitter, TAG_VIDEO_SEGMENTS_ARRAY, segments, "Video segment pointer is null");
+    writeArray(emitter, TAG_SCHEMAS_ARRAY, schemas, "Schema pointer is null");
+    writeMetadataArray(emitter, set, threads);
+    emitter.endObject();
+    emitter.endObject();
+    emitter.flush();
+}
+
+void JSONWriter::store(std::ostream& output, const IdType& nextId,
+    const std::string& filepath,
+    const std::string& checksum,
+    const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments,
+    const std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+    const MetadataSet& set)
+{
+    storeStream(output, nextId, filepath, checksum, segments, schemas, set, 1);
+}
+
+void JSONWriter::store(std::ostream& output, const IdType& nextId,
+    const std::string& filepath,
+    const std::string& checksum,
+    const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments,
+    const std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+    const MetadataSet& set,
+    unsigned int threads)
+{
+    storeStream(output, nextId, filepath, checksum, segments, schemas, set, threads);
+}
+
 }//vmf
@@ -0,0 +1,903 @@
+/*
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "vmf/mappedmetadatastream.hpp"
+#include "vmf/xmlwriter.hpp"
+#include "vmf/xmlreader.hpp"
+
+#include <fstream>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace vmf
+{
+
+namespace
+{
+
+const char MAPPED_MAGIC[8] = { 'V', 'M', 'F', 'M', 'A', 'P', '\0', '\0' };
+const uint32_t MAPPED_VERSION = 1;
+const uint32_t MAPPED_BYTE_ORDER = 0x01020304;
+
+struct MappedHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t itemCount;
+    int64_t maxNumOfFrames;
+    int64_t maxDuration;
+    uint64_t itemsOffset;
+    uint64_t fieldsOffset;
+    uint64_t fieldCount;
+    uint64_t refsOffset;
+    uint64_t refCount;
+    uint64_t frameIndexOffset;
+    uint64_t timeIndexOffset;
+    uint64_t nameIndexOffset;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+    uint64_t schemasOffset;
+    uint64_t schemasSize;
+};
+
+// items are sorted by id, so the item table is the id index
+struct MappedItemRecord
+{
+    int64_t id;
+    int64_t frameIndex;
+    int64_t numOfFrames;
+    int64_t time;
+    int64_t duration;
+    uint32_t schemaName;
+    uint32_t name;
+    uint32_t firstField;
+    uint32_t fieldCount;
+    uint32_t firstRef;
+    uint32_t refCount;
+};
+
+// integer and real values are stored in place, other values are kept in the string table
+struct MappedFieldRecord
+{
+    uint32_t name;
+    uint32_t type;
+    uint64_t value;
+};
+
+struct MappedRefRecord
+{
+    int64_t id;
+    uint32_t name;
+    uint32_t reserved;
+};
+
+class StringTable
+{
+public:
+    uint32_t add(const char* data, size_t size)
+    {
+        uint32_t offset = (uint32_t)buffer.size();
+        uint32_t length = (uint32_t)size;
+        buffer.append((const char*)&length, sizeof(length));
+        buffer.append(data, size);
+        if (buffer.size() > UINT32_MAX)
+            VMF_EXCEPTION(DataStorageException, "String table of the mapped file is too large");
+        return offset;
+    }
+
+    uint32_t add(const std::string& str)
+    {
+        return add(str.data(), str.size());
+    }
+
+    uint32_t addName(const std::string& str)
+    {
+        auto it = names.find(str);
+        if (it != names.end())
+            return it->second;
+        uint32_t offset = add(str);
+        names[str] = offset;
+        return offset;
+    }
+
+    std::string buffer;
+
+private:
+    std::map<std::string, uint32_t> names;
+};
+
+uint64_t alignedSize(uint64_t size)
+{
+    return (size + 7) & ~(uint64_t)7;
+}
+
+template<typename T> void writeSection(std::ofstream& file, const std::vector<T>& section)
+{
+    static const char padding[8] = { 0 };
+    size_t size = section.size() * sizeof(T);
+    if (size > 0)
+        file.write((const char*)section.data(), size);
+    file.write(padding, alignedSize(size) - size);
+}
+
+void writeSection(std::ofstream& file, const std::string& section)
+{
+    writeSection(file, std::vector<char>(section.begin(), section.end()));
+}
+
+inline const MappedHeader* header(const char* data)
+{
+    return (const MappedHeader*)data;
+}
+
+inline const MappedItemRecord* itemRecords(const char* data)
+{
+    return (const MappedItemRecord*)(data + header(data)->itemsOffset);
+}
+
+inline const MappedFieldRecord* fieldRecords(const char* data)
+{
+    return (const MappedFieldRecord*)(data + header(data)->fieldsOffset);
+}
+
+inline const MappedRefRecord* refRecords(const char* data)
+{
+    return (const MappedRefRecord*)(data + header(data)->refsOffset);
+}
+
+inline const uint32_t* indexRecords(const char* data, uint64_t offset)
+{
+    return (const uint32_t*)(data + offset);
+}
+
+// the accessors don't check the records, so the fields and references of every item
+// and the positions of the indices are checked once the sections are known to fit the file
+bool recordsFit(const char* data)
+{
+    const MappedHeader* head = header(data);
+    const MappedItemRecord* records = itemRecords(data);
+    for (uint64_t i = 0; i < head->itemCount; i++)
+    {
+        const MappedItemRecord& record = records[i];
+        if ((uint64_t)record.firstField + record.fieldCount > head->fieldCount ||
+            (uint64_t)record.firstRef + record.refCount > head->refCount)
+            return false;
+    }
+    const uint64_t indexOffsets[] = { head->frameIndexOffset, head->timeIndexOffset, head->nameIndexOffset };
+    for (uint64_t offset : indexOffsets)
+    {
+        const uint32_t* positions = indexRecords(data, offset);
+        for (uint64_t i = 0; i < head->itemCount; i++)
+        {
+            if (positions[i] >= head->itemCount)
+                return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+IdType MappedMetadataItem::getId() const
+{
+    return ((const MappedItemRecord*)m_pRecord)->id;
+}
+
+long long MappedMetadataItem::getFrameIndex() const
+{
+    return ((const MappedItemRecord*)m_pRecord)->frameIndex;
+}
+
+long long MappedMetadataItem::getNumOfFrames() const
+{
+    return ((const MappedItemRecord*)m_pRecord)->numOfFrames;
+}
+
+long long MappedMetadataItem::getTime() const
+{
+    return ((const MappedItemRecord*)m_pRecord)->time;
+}
+
+long long MappedMetadataItem::getDuration() const
+{
+    return ((const MappedItemRecord*)m_pRecord)->duration;
+}
+
+std::string MappedMetadataItem::getName() const
+{
+    return m_pStream->getStdString(((const MappedItemRecord*)m_pRecord)->name);
+}
+
+std::string MappedMetadataItem::getSchemaName() const
+{
+    return m_pStream->getStdString(((const MappedItemRecord*)m_pRecord)->schemaName);
+}
+
+size_t MappedMetadataItem::getFieldCount() const
+{
+    return ((const MappedItemRecord*)m_pRecord)->fieldCount;
+}
+
+std::string MappedMetadataItem::getFieldName(size_t index) const
+{
+    if (index >= getFieldCount())
+        VMF_EXCEPTION(OutOfRangeException, "Field index is out of range");
+    const MappedFieldRecord& field = fieldRecords(m_pStream->m_pData)[((const MappedItemRecord*)m_pRecord)->firstField + index];
+    return m_pStream->getStdString(field.name);
+}
+
+Variant MappedMetadataItem::getFieldValue(size_t index) const
+{
+    if (index >= getFieldCount())
+        VMF_EXCEPTION(OutOfRangeException, "Field index is out of range");
+    const MappedFieldRecord& field = fieldRecords(m_pStream->m_pData)[((const MappedItemRecord*)m_pRecord)->firstField + index];
+
+    Variant value;
+    switch (field.type)
+    {
+    case Variant::type_unknown:
+        break;
+    case Variant::type_integer:
+        {
+            vmf_integer integer;
+            memcpy(&integer, &field.value, sizeof(integer));
+            value = integer;
+        }
+        break;
+    case Variant::type_real:
+        {
+            vmf_real real;
+            memcpy(&real, &field.value, sizeof(real));
+            value = real;
+        }
+        break;
+    case Variant::type_string:
+        value = m_pStream->getStdString((uint32_t)field.value);
+        break;
+    case Variant::type_rawbuffer:
+        {
+            size_t size;
+            const char* data = m_pStream->getString((uint32_t)field.value, size);
+            value = vmf_rawbuffer(data, size);
+        }
+        break;
+    default:
+        value.fromString((Variant::Type)field.type, m_pStream->getStdString((uint32_t)field.value));
+        break;
+    }
+    return value;
+}
+
+Variant MappedMetadataItem::getFieldValue(const std::string& sName) const
+{
+    size_t count = getFieldCount();
+    const MappedFieldRecord* fields = fieldRecords(m_pStream->m_pData) + ((const MappedItemRecord*)m_pRecord)->firstField;
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t size;
+        const char* name = m_pStream->getString(fields[i].name, size);
+        if (sName.compare(0, std::string::npos, name, size) == 0)
+            return getFieldValue(i);
+    }
+    return Variant();
+}
+
+size_t MappedMetadataItem::getReferenceCount() const
+{
+    return ((const MappedItemRecord*)m_pRecord)->refCount;
+}
+
+IdType MappedMetadataItem::getReferenceId(size_t index) const
+{
+    if (index >= getReferenceCount())
+        VMF_EXCEPTION(OutOfRangeException, "Reference index is out of range");
+    return refRecords(m_pStream->m_pData)[((const MappedItemRecord*)m_pRecord)->firstRef + index].id;
+}
+
+std::string MappedMetadataItem::getReferenceName(size_t index) const
+{
+    if (index >= getReferenceCount())
+        VMF_EXCEPTION(OutOfRangeException, "Reference index is out of range");
+    return m_pStream->getStdString(refRecords(m_pStream->m_pData)[((const MappedItemRecord*)m_pRecord)->firstRef + index].name);
+}
+
+MappedMetadataItem::MappedMetadataItem(const MappedMetadataStream* stream, const void* record)
+    : m_pStream(stream), m_pRecord(record)
+{
+}
+
+MappedMetadataStream::MappedMetadataStream()
+    : m_pData(nullptr), m_nSize(0)
+#ifdef _WIN32
+    , m_hFile(INVALID_HANDLE_VALUE), m_hMapping(nullptr)
+#endif
+{
+}
+
+MappedMetadataStream::~MappedMetadataStream()
+{
+    close();
+}
+
+void MappedMetadataStream::exportStream(const MetadataStream& stream, const std::string& sFilePath)
+{
+    MetadataSet items = stream.getAll();
+    std::sort(items.begin(), items.end(), [](const std::shared_ptr<Metadata>& a, const std::shared_ptr<Metadata>& b)
+    {
+        return a->getId() < b->getId();
+    });
+    if (items.size() > UINT32_MAX)
+        VMF_EXCEPTION(DataStorageException, "Too many metadata items for the mapped file");
+
+    MappedHeader head;
+    memset(&head, 0, sizeof(head));
+    memcpy(head.magic, MAPPED_MAGIC, sizeof(head.magic));
+    head.version = MAPPED_VERSION;
+    head.byteOrder = MAPPED_BYTE_ORDER;
+    head.itemCount = items.size();
+
+    StringTable strings;
+    std::vector<MappedItemRecord> itemSection;
+    std::vector<MappedFieldRecord> fieldSection;
+    std::vector<MappedRefRecord> refSection;
+    itemSection.reserve(items.size());
+
+    for (auto& spItem : items)
+    {
+        MappedItemRecord item;
+        item.id = spItem->getId();
+        item.frameIndex = spItem->getFrameIndex();
+        item.numOfFrames = spItem->getNumOfFrames();
+        item.time = spItem->getTime();
+        item.duration = spItem->getDuration();
+        item.schemaName = strings.addName(spItem->getSchemaName());
+        item.name = strings.addName(spItem->getName());
+        item.firstField = (uint32_t)fieldSection.size();
+        item.fieldCount = (uint32_t)spItem->size();
+        item.firstRef = (uint32_t)refSection.size();
+
+        for (auto& fieldValue : *spItem)
+        {
+            MappedFieldRecord field;
+            field.name = strings.addName(fieldValue.getName());
+            field.type = (uint32_t)fieldValue.getType();
+            field.value = 0;
+            switch (fieldValue.getType())
+            {
+            case Variant::type_unknown:
+                break;
+            case Variant::type_integer:
+                memcpy(&field.value, &fieldValue.get_integer(), sizeof(vmf_integer));
+                break;
+            case Variant::type_real:
+                memcpy(&field.value, &fieldValue.get_real(), sizeof(vmf_real));
+                break;
+            case Variant::type_string:
+                field.value = strings.add(fieldValue.get_string());
+                break;
+            case Variant::type_rawbuffer:
+                field.value = strings.add(fieldValue.get_rawbuffer().data(), fieldValue.get_rawbuffer().size());
+                break;
+            default:
+                field.value = strings.add(fieldValue.toString());
+                break;
+            }
+            fieldSection.push_back(field);
+        }
+
+        for (auto& reference : spItem->getAllReferences())
+        {
+            auto spTarget = reference.getReferenceMetadata().lock();
+            if (!spTarget)
+                continue;
+            MappedRefRecord ref;
+            ref.id = spTarget->getId();
+            ref.name = strings.addName(reference.getReferenceDescription()->name);
+            ref.reserved = 0;
+            refSection.push_back(ref);
+        }
+        item.refCount = (uint32_t)(refSection.size() - item.firstRef);
+
+        if (item.frameIndex >= 0)
+            head.maxNumOfFrames = std::max<int64_t>(head.maxNumOfFrames, item.numOfFrames);
+        if (item.time >= 0)
+            head.maxDuration = std::max<int64_t>(head.maxDuration, item.duration);
+        itemSection.push_back(item);
+    }
+
+    std::vector<uint32_t> frameIndex(items.size()), timeIndex(items.size()), nameIndex(items.size());
+    for (uint32_t i = 0; i < (uint32_t)items.size(); i++)
+        frameIndex[i] = timeIndex[i] = nameIndex[i] = i;
+    std::stable_sort(frameIndex.begin(), frameIndex.end(), [&](uint32_t a, uint32_t b)
+    {
+        return itemSection[a].frameIndex < itemSection[b].frameIndex;
+    });
+    std::stable_sort(timeIndex.begin(), timeIndex.end(), [&](uint32_t a, uint32_t b)
+    {
+        return itemSection[a].time < itemSection[b].time;
+    });
+    std::stable_sort(nameIndex.begin(), nameIndex.end(), [&](uint32_t a, uint32_t b)
+    {
+        return items[a]->getName() < items[b]->getName();
+    });
+
+    std::vector<std::shared_ptr<MetadataSchema>> schemas;
+    for (auto& name : stream.getAllSchemaNames())
+        schemas.push_back(stream.getSchema(name));
+    std::string schemasText = schemas.empty() ? std::string() : XMLWriter().store(schemas);
+
+    uint64_t offset = alignedSize(sizeof(MappedHeader));
+    head.itemsOffset = offset;
+    offset += alignedSize(itemSection.size() * sizeof(MappedItemRecord));
+    head.fieldsOffset = offset;
+    head.fieldCount = fieldSection.size();
+    offset += alignedSize(fieldSection.size() * sizeof(MappedFieldRecord));
+    head.refsOffset = offset;
+    head.refCount = refSection.size();
+    offset += alignedSize(refSection.size() * sizeof(MappedRefRecord));
+    head.frameIndexOffset = offset;
+    offset += alignedSize(frameIndex.size() * sizeof(uint32_t));
+    head.timeIndexOffset = offset;
+    offset += alignedSize(timeIndex.size() * sizeof(uint32_t));
+    head.nameIndexOffset = offset;
+    offset += alignedSize(nameIndex.size() * sizeof(uint32_t));
+    head.stringsOffset = offset;
+    head.stringsSize = strings.buffer.size();
+    offset += alignedSize(strings.buffer.size());
+    head.schemasOffset = offset;
+    head.schemasSize = schemasText.size();
+
+    std::ofstream file(sFilePath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        VMF_EXCEPTION(DataStorageException, "Could not create mapped metadata file: " + sFilePath);
+    writeSection(file, std::vector<MappedHeader>(1, head));
+    writeSection(file, itemSection);
+    writeSection(file, fieldSection);
+    writeSection(file, refSection);
+    writeSection(file, frameIndex);
+    writeSection(file, timeIndex);
+    writeSection(file, nameIndex);
+    writeSection(file, strings.buffer);
+    writeSection(file, schemasText);
+    file.close();
+    if (file.fail())
+        VMF_EXCEPTION(DataStorageException, "Could not write mapped metadata file: " + sFilePath);
+}
+
+bool MappedMetadataStream::open(const std::string& sFilePath)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE hFile = CreateFileA(sFilePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(MappedHeader))
+    {
+        CloseHandle(hFile);
+        return false;
+    }
+    HANDLE hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    const void* data = hMapping ? MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (data == nullptr)
+    {
+        if (hMapping)
+            CloseHandle(hMapping);
+        CloseHandle(hFile);
+        return false;
+    }
+    m_hFile = hFile;
+    m_hMapping = hMapping;
+    m_nSize = (size_t)fileSize.QuadPart;
+#else
+    int fd = ::open(sFilePath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(MappedHeader))
+    {
+        ::close(fd);
+        return false;
+    }
+    void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+        return false;
+    m_nSize = (size_t)st.st_size;
+#endif
+    m_pData = (const char*)data;
+    m_sFilePath = sFilePath;
+
+    const MappedHeader* head = header(m_pData);
+    auto sectionFits = [&](uint64_t offset, uint64_t count, uint64_t itemSize)
+    {
+        return offset % 8 == 0 && offset <= m_nSize && count <= (m_nSize - offset) / itemSize;
+    };
+    bool valid = memcmp(head->magic, MAPPED_MAGIC, sizeof(head->magic)) == 0 &&
+        head->version == MAPPED_VERSION && head->byteOrder == MAPPED_BYTE_ORDER &&
+        sectionFits(head->itemsOffset, head->itemCount, sizeof(MappedItemRecord)) &&
+        sectionFits(head->fieldsOffset, head->fieldCount, sizeof(MappedFieldRecord)) &&
+        sectionFits(head->refsOffset, head->refCount, sizeof(MappedRefRecord)) &&
+        sectionFits(head->frameIndexOffset, head->itemCount, sizeof(uint32_t)) &&
+        sectionFits(head->timeIndexOffset, head->itemCount, sizeof(uint32_t)) &&
+        sectionFits(head->nameIndexOffset, head->itemCount, sizeof(uint32_t)) &&
+        sectionFits(head->stringsOffset, head->stringsSize, 1) &&
+        sectionFits(head->schemasOffset, head->schemasSize, 1) &&
+        recordsFit(m_pData);
+    if (!valid)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedMetadataStream::close()
+{
+    m_mapMetadata.clear();
+    m_mapSchemas.clear();
+    if (m_pData == nullptr)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(m_pData);
+    CloseHandle((HANDLE)m_hMapping);
+    CloseHandle((HANDLE)m_hFile);
+    m_hMapping = nullptr;
+    m_hFile = INVALID_HANDLE_VALUE;
+#else
+    munmap((void*)m_pData, m_nSize);
+#endif
+    m_pData = nullptr;
+    m_nSize = 0;
+    m_sFilePath.clear();
+}
+
+size_t MappedMetadataStream::size() const
+{
+    return m_pData ? (size_t)header(m_pData)->itemCount : 0;
+}
+
+MappedMetadataItem MappedMetadataStream::getItem(size_t index) const
+{
+    if (index >= size())
+        VMF_EXCEPTION(OutOfRangeException, "Item index is out of range");
+    return MappedMetadataItem(this, itemRecords(m_pData) + index);
+}
+
+bool MappedMetadataStream::findById(const IdType& id, MappedMetadataItem& item) const
+{
+    if (m_pData == nullptr)
+        return false;
+    const MappedItemRecord* begin = itemRecords(m_pData);
+    const MappedItemRecord* end = begin + header(m_pData)->itemCount;
+    const MappedItemRecord* it = std::lower_bound(begin, end, id, [](const MappedItemRecord& record, const IdType& value)
+    {
+        return record.id < value;
+    });
+    if (it == end || it->id != id)
+        return false;
+    item = MappedMetadataItem(this, it);
+    return true;
+}
+
+std::vector<MappedMetadataItem> MappedMetadataStream::findByName(const std::string& sName) const
+{
+    std::vector<MappedMetadataItem> result;
+    if (m_pData == nullptr)
+        return result;
+    const MappedItemRecord* records = itemRecords(m_pData);
+    const uint32_t* begin = indexRecords(m_pData, header(m_pData)->nameIndexOffset);
+    const uint32_t* end = begin + header(m_pData)->itemCount;
+    auto compareName = [&](uint32_t position)
+    {
+        size_t size;
+        const char* name = getString(records[position].name, size);
+        return -sName.compare(0, std::string::npos, name, size);
+    };
+    const uint32_t* first = std::lower_bound(begin, end, 0, [&](uint32_t position, int)
+    {
+        return compareName(position) < 0;
+    });
+    for (const uint32_t* it = first; it != end && compareName(*it) == 0; ++it)
+        result.push_back(MappedMetadataItem(this, records + *it));
+    return result;
+}
+
+std::vector<MappedMetadataItem> MappedMetadataStream::findByFrameIndex(size_t index) const
+{
+    std::vector<MappedMetadataItem> result;
+    if (m_pData == nullptr)
+        return result;
+    const MappedHeader* head = header(m_pData);
+    const MappedItemRecord* records = itemRecords(m_pData);
+    const uint32_t* begin = indexRecords(m_pData, head->frameIndexOffset);
+    const uint32_t* end = begin + head->itemCount;
+    long long lowest = std::max<long long>(0, (long long)index - head->maxNumOfFrames + 1);
+    const uint32_t* first = std::lower_bound(begin, end, lowest, [&](uint32_t position, long long value)
+    {
+        return records[position].frameIndex < value;
+    });
+    for (const uint32_t* it = first; it != end && records[*it].frameIndex <= (long long)index; ++it)
+    {
+        const MappedItemRecord& record = records[*it];
+        if ((long long)index < record.frameIndex + record.numOfFrames)
+            result.push_back(MappedMetadataItem(this, &record));
+    }
+    return result;
+}
+
+std::vector<MappedMetadataItem> MappedMetadataStream::findByTime(long long startTime, long long endTime) const
+{
+    std::vector<MappedMetadataItem> result;
+    if (m_pData == nullptr)
+        return result;
+    const MappedHeader* head = header(m_pData);
+    const MappedItemRecord* records = itemRecords(m_pData);
+    const uint32_t* begin = indexRecords(m_pData, head->timeIndexOffset);
+    const uint32_t* end = begin + head->itemCount;
+    long long lowest = std::max<long long>(0, startTime - head->maxDuration);
+    const uint32_t* first = std::lower_bound(begin, end, lowest, [&](uint32_t position, long long value)
+    {
+        return records[position].time < value;
+    });
+    for (const uint32_t* it = first; it != end && records[*it].time <= endTime; ++it)
+    {
+        const MappedItemRecord& record = records[*it];
+        if (record.time + record.duration >= startTime)
+            result.push_back(MappedMetadataItem(this, &record));
+    }
+    return result;
+}
+
+std::shared_ptr<Metadata> MappedMetadataStream::getById(const IdType& id) const
+{
+    auto cached = m_mapMetadata.find(id);
+    if (cached != m_mapMetadata.end())
+        return cached->second;
+
+    MappedMetadataItem item(this, nullptr);
+    if (!findById(id, item))
+        return nullptr;
+
+    // referenced items are created breadth first and cached before they are wired,
+    // so long chains of references don't recurse and cycles stop on the cache
+    std::shared_ptr<Metadata> spRoot = createItem(item);
+    std::vector<std::pair<std::shared_ptr<Metadata>, MappedMetadataItem>> created(1, std::make_pair(spRoot, item));
+    for (size_t next = 0; next < created.size(); next++)
+    {
+        std::shared_ptr<Metadata> spItem = created[next].first;
+        MappedMetadataItem source = created[next].second;
+        for (size_t i = 0; i < source.getReferenceCount(); i++)
+        {
+            std::shared_ptr<Metadata> spTarget;
+            IdType targetId = source.getReferenceId(i);
+            auto target = m_mapMetadata.find(targetId);
+            if (target != m_mapMetadata.end())
+                spTarget = target->second;
+            else if (findById(targetId, item))
+            {
+                spTarget = createItem(item);
+                created.push_back(std::make_pair(spTarget, item));
+            }
+            if (spTarget)
+                spItem->addReference(spTarget, source.getReferenceName(i));
+        }
+    }
+    return spRoot;
+}
+
+std::shared_ptr<Metadata> MappedMetadataStream::createItem(const MappedMetadataItem& item) const
+{
+    loadSchemas();
+    auto spSchema = m_mapSchemas.find(item.getSchemaName());
+    if (spSchema == m_mapSchemas.end())
+        VMF_EXCEPTION(DataStorageException, "Unknown schema of mapped metadata item: " + item.getSchemaName());
+    auto spDesc = spSchema->second->findMetadataDesc(item.getName());
+    if (!spDesc)
+        VMF_EXCEPTION(DataStorageException, "Unknown description of mapped metadata item: " + item.getName());
+
+    std::shared_ptr<MetadataInternal> spItem = std::make_shared<MetadataInternal>(spDesc);
+    spItem->setId(item.getId());
+    spItem->setFrameIndex(item.getFrameIndex(), item.getNumOfFrames());
+    spItem->setTimestamp(item.getTime(), item.getDuration());
+    for (size_t i = 0; i < item.getFieldCount(); i++)
+    {
+        // values of a description with a single unnamed field are kept in order
+        std::string name = item.getFieldName(i);
+        if (name.empty())
+            spItem->addValue(item.getFieldValue(i));
+        else
+            spItem->setFieldValue(name, item.getFieldValue(i));
+    }
+
+    m_mapMetadata[item.getId()] = spItem;
+    return spItem;
+}
+
+std::vector<std::string> MappedMetadataStream::getAllSchemaNames() const
+{
+    loadSchemas();
+    std::vector<std::string> names;
+    for (auto& p : m_mapSchemas)
+        names.push_back(p.first);
+    return names;
+}
+
+std::shared_ptr<MetadataSchema> MappedMetadataStream::getSchema(const std::string& sSchemaName) const
+{
+    loadSchemas();
+    auto it = m_mapSchemas.find(sSchemaName);
+    return it != m_mapSchemas.end() ? it->second : nullptr;
+}
+
+MetadataSet MappedMetadataStream::getAll() const
+{
+    MetadataSet set;
+    for (size_t i = 0; i < size(); i++)
+        set.push_back(getById(itemRecords(m_pData)[i].id));
+    return set;
+}
+
+MetadataSet MappedMetadataStream::query( std::function< bool( const std::shared_ptr<Metadata>& spMetadata )> filter ) const
+{
+    return getAll().query(filter);
+}
+
+MetadataSet MappedMetadataStream::queryByReference( std::function< bool( const std::shared_ptr<Metadata>& spMetadata, const std::shared_ptr<Metadata>& spReference )> filter ) const
+{
+    return getAll().queryByReference(filter);
+}
+
+MetadataSet MappedMetadataStream::queryByFrameIndex( size_t index ) const
+{
+    return materialize(findByFrameIndex(index));
+}
+
+MetadataSet MappedMetadataStream::queryByTime( long long startTime, long long endTime ) const
+{
+    return materialize(findByTime(startTime, endTime));
+}
+
+MetadataSet MappedMetadataStream::queryBySchema( const std::string& sSchemaName ) const
+{
+    std::vector<MappedMetadataItem> items;
+    for (size_t i = 0; i < size(); i++)
+    {
+        size_t nameSize;
+        const char* name = getString(itemRecords(m_pData)[i].schemaName, nameSize);
+        if (sSchemaName.compare(0, std::string::npos, name, nameSize) == 0)
+            items.push_back(MappedMetadataItem(this, itemRecords(m_pData) + i));
+    }
+    return materialize(items);
+}
+
+MetadataSet MappedMetadataStream::queryByName( const std::string& sName ) const
+{
+    return materialize(findByName(sName));
+}
+
+MetadataSet MappedMetadataStream::queryByNameAndValue( const std::string& sMetadataName, const vmf::FieldValue& value ) const
+{
+    return queryByNameAndFields(sMetadataName, std::vector<FieldValue>(1, value));
+}
+
+MetadataSet MappedMetadataStream::queryByNameAndFields( const std::string& sMetadataName, const std::vector< vmf::FieldValue>& vFields ) const
+{
+    std::vector<MappedMetadataItem> items;
+    for (auto& item : findByName(sMetadataName))
+    {
+        if (item.getFieldCount() == 0)
+            continue;
+        auto itFailed = std::find_if(vFields.begin(), vFields.end(), [&](const FieldValue& value)
+        {
+            Variant field = item.getFieldValue(value.getName());
+            return field.isEmpty() || field != value;
+        });
+        if (itFailed == vFields.end())
+            items.push_back(item);
+    }
+    return materialize(items);
+}
+
+MetadataSet MappedMetadataStream::queryByReference( const std::string& sReferenceName ) const
+{
+    return referencingItems(sReferenceName).queryByReference(sReferenceName);
+}
+
+MetadataSet MappedMetadataStream::queryByReference( const std::string& sReferenceName, const vmf::FieldValue& value ) const
+{
+    return referencingItems(sReferenceName).queryByReference(sReferenceName, value);
+}
+
+MetadataSet MappedMetadataStream::queryByReference( const std::string& sReferenceName, const std::vector< vmf::FieldValue>& vFields ) const
+{
+    return referencingItems(sReferenceName).queryByReference(sReferenceName, vFields);
+}
+
+const char* MappedMetadataStream::getString(uint32_t offset, size_t& size) const
+{
+    const MappedHeader* head = header(m_pData);
+    uint32_t length;
+    if ((uint64_t)offset + sizeof(length) > head->stringsSize)
+        VMF_EXCEPTION(DataStorageException, "Corrupted string table of mapped metadata file");
+    const char* data = m_pData + head->stringsOffset + offset;
+    memcpy(&length, data, sizeof(length));
+    if ((uint64_t)offset + sizeof(length) + length > head->stringsSize)
+        VMF_EXCEPTION(DataStorageException, "Corrupted string table of mapped metadata file");
+    size = length;
+    return data + sizeof(length);
+}
+
+std::string MappedMetadataStream::getStdString(uint32_t offset) const
+{
+    size_t size;
+    const char* data = getString(offset, size);
+    return std::string(data, size);
+}
+
+MetadataSet MappedMetadataStream::materialize(const std::vector<MappedMetadataItem>& items) const
+{
+    MetadataSet set;
+    set.reserve(items.size());
+    for (auto& item : items)
+        set.push_back(getById(item.getId()));
+    return set;
+}
+
+// items referencing at least one item with the given name, the final check is done by MetadataSet
+MetadataSet MappedMetadataStream::referencingItems(const std::string& sReferenceName) const
+{
+    std::vector<MappedMetadataItem> items;
+    MappedMetadataItem target(this, nullptr);
+    for (size_t i = 0; i < size(); i++)
+    {
+        MappedMetadataItem item(this, itemRecords(m_pData) + i);
+        for (size_t j = 0; j < item.getReferenceCount(); j++)
+        {
+            if (findById(item.getReferenceId(j), target) && target.getName() == sReferenceName)
+            {
+                items.push_back(item);
+                break;
+            }
+        }
+    }
+    return materialize(items);
+}
+
+void MappedMetadataStream::loadSchemas() const
+{
+    if (!m_mapSchemas.empty() || m_pData == nullptr)
+        return;
+    const MappedHeader* head = header(m_pData);
+    std::string text(m_pData + head->schemasOffset, (size_t)head->schemasSize);
+    std::vector<std::shared_ptr<MetadataSchema>> schemas;
+    if (!text.empty() && !XMLReader().parseSchemas(text, schemas))
+        VMF_EXCEPTION(DataStorageException, "Corrupted schemas of mapped metadata file");
+    for (auto& spSchema : schemas)
+        m_mapSchemas[spSchema->getName()] = spSchema;
+}
+
+}
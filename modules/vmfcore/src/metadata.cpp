@@ -30,6 +30,8 @@ Metadata::Metadata( const std::shared_ptr< MetadataDesc >& spDescription )
     , m_sSchemaName( "" )
     , m_spDesc( spDescription )
     , m_pStream(nullptr)
+    , m_bEvicted(false)
+    , m_bModified(true)
 {
     if (!m_spDesc)
     {
@@ -42,9 +44,12 @@ Metadata::Metadata( const std::shared_ptr< MetadataDesc >& spDescription )
 
 Metadata::Metadata( const Metadata& oMetadata )
 {
+    oMetadata.accessPayload();
     // Use default implementation of operator =.
     *this = oMetadata;
     m_pStream = nullptr;
+    m_bEvicted = false;
+    m_bModified = true;
 }
 
 Metadata::~Metadata(void)
@@ -68,6 +73,7 @@ long long Metadata::getNumOfFrames() const
 
 void Metadata::setFrameIndex( long long nFrameIndex, long long nNumOfFrames )
 {
+    accessPayload();
     if(nFrameIndex < 0 && nFrameIndex != UNDEFINED_FRAME_INDEX)
     {
         VMF_EXCEPTION(IncorrectParamException, "Can't set metadata frame index. Invalid frame index value");
@@ -80,10 +86,12 @@ void Metadata::setFrameIndex( long long nFrameIndex, long long nNumOfFrames )
 
     m_nFrameIndex = nFrameIndex;
     m_nNumOfFrames = nNumOfFrames;
+    m_bModified = true;
 }
 
 void Metadata::setTimestamp(long long timestamp, long long duration)
 {
+    accessPayload();
     if(timestamp < 0 && timestamp != UNDEFINED_TIMESTAMP)
     {
         VMF_EXCEPTION(IncorrectParamException, "Can't set metadata timestamp. Invalid timestamp value");
@@ -96,6 +104,7 @@ void Metadata::setTimestamp(long long timestamp, long long duration)
 
     m_nTimestamp = timestamp;
     m_nDuration = duration;
+    m_bModified = true;
 }
 
 long long Metadata::getTime() const
@@ -154,6 +163,7 @@ std::shared_ptr< MetadataDesc > Metadata::getDesc() const
 }
 std::vector< std::string > Metadata::getFieldNames() const
 {
+    accessPayload();
     std::vector< std::string > vNames;
 
     std::for_each( this->begin(), this->end(), [ &vNames ]( const vmf::FieldValue& v )
@@ -176,7 +186,7 @@ vmf::Variant Metadata::getFieldValue( const std::string& sName ) const
         VMF_EXCEPTION(IncorrectParamException, "Field name not specified!");
     }
 
-    const_iterator it = const_cast<vmf::Metadata*>(this)->findField( sName );
+    const_iterator it = findField( sName );
     if( it != this->end() )
         return *it;
 
@@ -194,6 +204,7 @@ vmf::Variant Metadata::getFieldValue( const std::string& sName ) const
 
 Metadata::iterator Metadata::findField( const std::string& sFieldName )
 {
+    accessPayload();
     return std::find_if( this->begin(), this->end(), [&]( vmf::FieldValue& value )->bool 
     {
         return sFieldName == value.getName();
@@ -202,6 +213,7 @@ Metadata::iterator Metadata::findField( const std::string& sFieldName )
 
 Metadata::const_iterator Metadata::findField(const std::string& sFieldName) const
 {
+    accessPayload();
     return std::find_if(this->begin(), this->end(), [&](const vmf::FieldValue& value)->bool
     {
         return sFieldName == value.getName();
@@ -230,6 +242,7 @@ bool Metadata::operator < ( const Metadata& oMetadata ) const
 
 std::shared_ptr<Metadata> Metadata::getFirstReference( const std::string& sMetadataName ) const
 {
+    accessPayload();
     for( auto it = m_vReferences.begin(); it != m_vReferences.end(); it ++ )
     {
         auto spReference = it->getReferenceMetadata().lock();
@@ -248,6 +261,7 @@ std::shared_ptr<Metadata> Metadata::getFirstReference( const std::string& sMetad
 
 MetadataSet Metadata::getReferencesByMetadata(const std::string& sMetadataName) const
 {
+    accessPayload();
     MetadataSet mdSet;
 
     if (sMetadataName.empty())
@@ -274,6 +288,7 @@ MetadataSet Metadata::getReferencesByMetadata(const std::string& sMetadataName)
 
 MetadataSet Metadata::getReferencesByName(const std::string& sRefName) const
 {
+    accessPayload();
     MetadataSet mdSet;
 
     std::for_each(m_vReferences.begin(), m_vReferences.end(), [&](const Reference& ref)
@@ -292,11 +307,13 @@ MetadataSet Metadata::getReferencesByName(const std::string& sRefName) const
 
 const std::vector<Reference>& Metadata::getAllReferences() const
 {
+    accessPayload();
     return m_vReferences;   
 }
 
 bool Metadata::isReference(const IdType& id, const std::string& refName) const
 {
+    accessPayload();
     for( auto it = m_vReferences.begin(); it != m_vReferences.end(); it ++ )
     {
         auto spMetadata = it->getReferenceMetadata().lock();
@@ -317,6 +334,7 @@ bool Metadata::isReference(const IdType& id, const std::string& refName) const
 
 bool Metadata::isReference(const std::shared_ptr<Metadata>& md, const std::string& refName) const
 {
+    accessPayload();
     for (auto it = m_vReferences.begin(); it != m_vReferences.end(); it++)
     {
         auto spDesc = it->getReferenceDescription();
@@ -351,6 +369,8 @@ void Metadata::addReference(const std::shared_ptr<Metadata>& md, const std::stri
     if (!spRefDesc)
         VMF_EXCEPTION(IncorrectParamException, "No such reference description.");
 
+    m_bModified = true;
+
     if (spRefDesc->isUnique)
     {
         auto mdSet = getReferencesByName(refName);
@@ -383,6 +403,7 @@ void Metadata::addReference(const std::shared_ptr<Metadata>& md, const std::stri
 
 void Metadata::removeReference(const IdType& id, const std::string& refName)
 {
+    accessPayload();
     for( auto it = m_vReferences.begin(); it != m_vReferences.end(); it ++ )
     {
         auto spDesc = it->getReferenceDescription();
@@ -394,6 +415,7 @@ void Metadata::removeReference(const IdType& id, const std::string& refName)
             {
                 // Found reference
                 m_vReferences.erase(it);
+                m_bModified = true;
                 break;
             }
         }
@@ -404,6 +426,7 @@ void Metadata::removeReference(const IdType& id, const std::string& refName)
 
 void Metadata::removeReference(const std::shared_ptr<Metadata>& md, const std::string& refName)
 {
+    accessPayload();
     for (auto it = m_vReferences.begin(); it != m_vReferences.end(); it++)
     {
         auto spDesc = it->getReferenceDescription();
@@ -414,6 +437,7 @@ void Metadata::removeReference(const std::shared_ptr<Metadata>& md, const std::s
             if ((spMetadata == md) && (spDesc->name == refName))
             {
                 m_vReferences.erase(it);
+                m_bModified = true;
                 break;
             }
         }
@@ -442,6 +466,8 @@ void Metadata::addValue( const vmf::Variant& value )
         VMF_EXCEPTION(TypeCastException, "Field type does not match!" );
     }
 
+    accessPayload();
+    m_bModified = true;
     this->emplace_back( FieldValue( "", value ) );
 }
 
@@ -460,6 +486,7 @@ void Metadata::setFieldValue( const std::string& sFieldName, const vmf::Variant&
     }
 
     iterator it = this->findField( sFieldName );
+    m_bModified = true;
 
     // Check field type
     if( fieldDesc.type == value.getType() )
@@ -493,6 +520,7 @@ void Metadata::setFieldValue( const std::string& sFieldName, const vmf::Variant&
 
 void Metadata::validate() const
 {
+    accessPayload();
     size_t nNumOfValues = this->size();
     if( nNumOfValues < 1 )
     {
@@ -547,8 +575,7 @@ void Metadata::validate() const
                     VMF_EXCEPTION(ValidateException, "Field specified[" + sFieldName + "] not found!" );
                 }
 
-                vmf::Variant varValue = this->getFieldValue( sFieldName );
-                if( field.type != varValue.getType() )
+                if( field.type != findField( sFieldName )->getType() )
                 {
                     VMF_EXCEPTION(ValidateException, "Field type does not match with file defined in descriptor!" );
                 }
@@ -636,4 +663,27 @@ void Metadata::setStreamRef(const MetadataStream* streamPtr)
     m_pStream = streamPtr;
 }
 
+bool Metadata::isEvicted() const
+{
+    return m_bEvicted;
+}
+
+bool Metadata::isModified() const
+{
+    return m_bModified;
+}
+
+void Metadata::accessPayload() const
+{
+    if (m_pStream != nullptr)
+        m_pStream->accessPayload(*this);
+}
+
+void Metadata::evictPayload()
+{
+    std::vector<FieldValue>().swap(*this);
+    std::vector<Reference>().swap(m_vReferences);
+    m_bEvicted = true;
+}
+
 } //namespace vmf
@@ -114,7 +114,7 @@ bool MetadataDesc::getFieldDesc( FieldDesc& field, const std::string& sFieldName
     }
     else
     {
-        auto it = std::find_if( m_vFields.begin(), m_vFields.end(), [&sFieldName]( FieldDesc fieldDesc )->bool
+        auto it = std::find_if( m_vFields.begin(), m_vFields.end(), [&sFieldName]( const FieldDesc& fieldDesc )->bool
         {
             return fieldDesc.name == sFieldName;
         });
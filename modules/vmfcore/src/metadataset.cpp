@@ -59,14 +59,16 @@ MetadataSet MetadataSet::queryByReference( std::function< bool( const std::share
     MetadataSet set;
     std::for_each( this->begin(), this->end(), [&]( const std::shared_ptr< Metadata >& spItem )
     {
-        auto it = std::find_if( spItem->m_vReferences.begin(), spItem->m_vReferences.end(), [&]( const Reference& wpItemRef )->bool
+        // references of an evicted item are reloaded by the accessor
+        const std::vector<Reference>& vReferences = spItem->getAllReferences();
+        auto it = std::find_if( vReferences.begin(), vReferences.end(), [&]( const Reference& wpItemRef )->bool
         {
             const std::shared_ptr<Metadata> spItemRef = wpItemRef.getReferenceMetadata().lock();
             if( spItemRef != nullptr )
                 return filter( spItem, spItemRef );
             return false;
         });
-        if( it != spItem->m_vReferences.end() )
+        if( it != vReferences.end() )
             set.push_back( spItem );
     });
     return set;
@@ -85,11 +87,16 @@ MetadataSet MetadataSet::queryByNameAndValue( const std::string& sMetadataName,
 {
     MetadataSet set = query([&](const std::shared_ptr< Metadata >& spItem)->bool
     {
-        if ((spItem->getName() != sMetadataName) || (spItem->size() == 0))
+        if (spItem->getName() != sMetadataName)
             return false;
 
-        auto it = spItem->findField(value.getName());
-        return ((it != spItem->end()) && (*it == value));
+        const Metadata& item = *spItem;
+        item.accessPayload();
+        if (item.size() == 0)
+            return false;
+
+        auto it = item.findField(value.getName());
+        return ((it != item.end()) && (*it == value));
     });
 
     return set;
@@ -99,13 +106,17 @@ MetadataSet MetadataSet::queryByNameAndFields( const std::string& sMetadataName,
 {
     MetadataSet set = query( [&]( const std::shared_ptr< Metadata >& spItem )->bool
     {
-        if( spItem->getName() == sMetadataName && spItem->size() > 0 )
+        const Metadata& item = *spItem;
+        if( item.getName() != sMetadataName )
+            return false;
+        item.accessPayload();
+        if( item.size() > 0 )
         {
             auto itFailed = std::find_if( vFields.begin(), vFields.end(), [&]( const vmf::FieldValue& value )->bool
             {
                 std::string sFieldName = value.getName();
-                auto it = spItem->findField( sFieldName );
-                if( it == spItem->end() || *it != value )
+                auto it = item.findField( sFieldName );
+                if( it == item.end() || *it != value )
                 {
                     // Found a field that does not exist, or the value is not the same
                     return true;
@@ -183,7 +194,9 @@ MetadataSet MetadataSet::queryByReference( const std::string& sReferenceName, co
                 auto itReference = std::find_if( referenceSet.begin(), referenceSet.end(), [&]( const std::shared_ptr< Metadata >& spReference )->bool
                 {
                     // Just compare the first field, since it has no field
-                    if( spReference->size() > 0 && spReference->at(0) == value )
+                    const Metadata& reference = *spReference;
+                    reference.accessPayload();
+                    if( reference.size() > 0 && reference.at(0) == value )
                     {
                         return true;
                     }
@@ -206,8 +219,9 @@ MetadataSet MetadataSet::queryByReference( const std::string& sReferenceName, co
             {
                 auto itReference = std::find_if( referenceSet.begin(), referenceSet.end(), [&]( const std::shared_ptr< Metadata >& spReference )->bool
                 {
-                    auto it = spReference->findField( sFieldName );
-                    if( it != spReference->end() && *it == value )
+                    const Metadata& reference = *spReference;
+                    auto it = reference.findField( sFieldName );
+                    if( it != reference.end() && *it == value )
                     {
                         return true;
                     }
@@ -239,8 +253,9 @@ MetadataSet MetadataSet::queryByReference( const std::string& sReferenceName, co
                     auto itFailed = std::find_if( vFields.begin(), vFields.end(), [&]( const vmf::FieldValue& value )->bool
                     {
                         std::string sFieldName = value.getName();
-                        auto it = spReference->findField( sFieldName );
-                        if( it == spReference->end() || *it != value )
+                        const Metadata& reference = *spReference;
+                        auto it = reference.findField( sFieldName );
+                        if( it == reference.end() || *it != value )
                         {
                             // Found a field that does not exist, or the value is not the same
                             return true;
@@ -20,14 +20,39 @@
 #include "datasource.hpp"
 #include "object_factory.hpp"
 #include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <sstream>
 #include <stdexcept>
+#include <thread>
+#include <unordered_set>
 
 #include <iostream>
 
 namespace vmf
 {
+struct MetadataStream::PendingSave
+{
+    PendingSave() : cancelled(false), saved(false) {}
+
+    // copies of changed items, schemas and removals to be stored
+    MetadataStream snapshot;
+    std::shared_ptr<IDataSource> source;
+    // changed items of the stream are kept in memory until the snapshot is stored
+    std::vector<std::shared_ptr<Metadata>> items;
+    std::unordered_set<const Metadata*> pinned;
+    // items holding the ids of unchanged referenced items, so the copies don't point to the stream
+    std::vector<std::shared_ptr<Metadata>> targets;
+    std::promise<bool> result;
+    std::atomic<bool> cancelled;
+    bool saved;
+    std::thread worker;
+};
+
 MetadataStream::MetadataStream(void)
-    : m_eMode( InMemory ), dataSource(nullptr), nextId(0), m_sChecksumMedia("")
+    : m_eMode( InMemory ), dataSource(nullptr), nextId(0), m_sChecksumMedia(""), m_bChecksumManifest(true)
+    , m_nReadAhead(1), m_nLoadThreads(0), m_nMemoryUsage(0), m_nMemoryBudget(0)
+    , m_nCompressionThreshold(0), m_nCompressionLevel(-1)
 {
 }
 
@@ -43,6 +68,7 @@ bool MetadataStream::open( const std::string& sFilePath, MetadataStream::OpenMod
     {
         if (m_eMode != InMemory)
             return false;
+        finishPendingSave();
         dataSource = ObjectFactory::getInstance()->getDataSource();
         if (!dataSource)
         {
@@ -76,16 +102,22 @@ bool MetadataStream::load( const std::string& sSchemaName )
             for (auto it = m_mapSchemas.begin(); it != m_mapSchemas.end(); ++it)
             {
                 dataSource->loadSchema(it->first, *this);
+                finishLoad();
             }
+            evictPayloads();
         }
         else
         {
             dataSource->loadSchema(sSchemaName, *this);
+            finishLoad();
+            evictPayloads();
         }
         return true;
     }
     catch(...)
     {
+        // items loaded before the failure are kept
+        finishLoad();
         return false;
     }
 }
@@ -96,10 +128,165 @@ bool MetadataStream::load(const std::string& sSchemaName, const std::string& sMe
     try
     {
         dataSource->loadProperty(sSchemaName, sMetadataName, *this);
+        finishLoad();
+        evictPayloads();
+        return true;
+    }
+    catch(...)
+    {
+        // items loaded before the failure are kept
+        finishLoad();
+        return false;
+    }
+}
+
+bool MetadataStream::loadIndex( const std::string& sSchemaName )
+{
+    dataSourceCheck();
+    try
+    {
+        std::vector<IndexEntry> index;
+        if (sSchemaName.empty())
+        {
+            for (auto it = m_mapSchemas.begin(); it != m_mapSchemas.end(); ++it)
+            {
+                dataSource->loadIndex(it->first, index);
+            }
+        }
+        else
+        {
+            // entries of other schemas are kept
+            std::copy_if(m_index.begin(), m_index.end(), std::back_inserter(index), [&sSchemaName](const IndexEntry& entry)
+            {
+                return entry.schema != sSchemaName;
+            });
+            dataSource->loadIndex(sSchemaName, index);
+        }
+        m_index.swap(index);
+        buildIndexRange(m_framesRange, false);
+        buildIndexRange(m_timesRange, true);
+        return true;
+    }
+    catch(...)
+    {
+        return false;
+    }
+}
+
+const std::vector<MetadataStream::IndexEntry>& MetadataStream::getIndex() const
+{
+    return m_index;
+}
+
+bool MetadataStream::loadByFrameIndex( long long nFrameIndex, long long nNumOfFrames )
+{
+    if (nFrameIndex < 0 || nNumOfFrames <= 0)
+        VMF_EXCEPTION(IncorrectParamException, "Invalid frame range");
+    return loadIndexed(m_framesRange, false, nFrameIndex, nFrameIndex + nNumOfFrames);
+}
+
+bool MetadataStream::loadByTime( long long nTime, long long nDuration )
+{
+    if (nTime < 0 || nDuration < 0)
+        VMF_EXCEPTION(IncorrectParamException, "Invalid time range");
+    return loadIndexed(m_timesRange, true, nTime, nTime + nDuration);
+}
+
+void MetadataStream::setReadAhead(size_t nRanges)
+{
+    m_nReadAhead = nRanges;
+}
+
+size_t MetadataStream::getReadAhead() const
+{
+    return m_nReadAhead;
+}
+
+void MetadataStream::setLoadThreads(unsigned int nThreads)
+{
+    m_nLoadThreads = nThreads;
+}
+
+unsigned int MetadataStream::getLoadThreads() const
+{
+    return m_nLoadThreads;
+}
+
+void MetadataStream::buildIndexRange(IndexRange& range, bool byTime)
+{
+    range = IndexRange();
+    for (size_t i = 0; i < m_index.size(); i++)
+    {
+        const IndexEntry& entry = m_index[i];
+        if ((byTime ? entry.time : entry.frameIndex) < 0)
+            continue;
+        range.order.push_back(i);
+        // an item without number of frames is associated with a single frame
+        range.maxLength = std::max(range.maxLength, byTime ? entry.duration : std::max(entry.numOfFrames, 1LL));
+    }
+    std::sort(range.order.begin(), range.order.end(), [this, byTime](size_t a, size_t b)
+    {
+        return byTime ? m_index[a].time < m_index[b].time : m_index[a].frameIndex < m_index[b].frameIndex;
+    });
+}
+
+bool MetadataStream::loadIndexed(IndexRange& range, bool byTime, long long start, long long end)
+{
+    dataSourceCheck();
+    if (m_index.empty() && !loadIndex())
+        return false;
+    try
+    {
+        // frame ranges exclude the end, time ranges include it like queryByTime() does
+        bool sequential = range.end >= 0 && start >= range.start && start <= range.end;
+        range.start = start;
+        range.end = end;
+        if (start >= range.fetchedStart && end <= range.fetchedEnd)
+            return true;
+
+        long long fetchEnd = end;
+        if (sequential)
+            fetchEnd += std::max(end - start, 1LL) * (long long) m_nReadAhead;
+
+        auto first = std::lower_bound(range.order.begin(), range.order.end(), start - range.maxLength, [this, byTime](size_t i, long long value)
+        {
+            return (byTime ? m_index[i].time : m_index[i].frameIndex) < value;
+        });
+        std::vector<IdType> ids;
+        for (auto it = first; it != range.order.end(); ++it)
+        {
+            const IndexEntry& entry = m_index[*it];
+            long long itemStart = byTime ? entry.time : entry.frameIndex;
+            long long itemEnd = itemStart + (byTime ? entry.duration : std::max(entry.numOfFrames, 1LL));
+            if (byTime ? itemStart > fetchEnd : itemStart >= fetchEnd)
+                break;
+            if (byTime ? itemEnd < start : itemEnd <= start)
+                continue;
+            if (m_fetchedIds.count(entry.id) || std::find(removedIds.begin(), removedIds.end(), entry.id) != removedIds.end())
+                continue;
+            ids.push_back(entry.id);
+        }
+        if (!ids.empty())
+        {
+            dataSource->loadItems(ids, *this);
+            m_fetchedIds.insert(ids.begin(), ids.end());
+            finishLoad();
+            evictPayloads();
+        }
+
+        if (sequential && start >= range.fetchedStart && start <= range.fetchedEnd)
+            range.fetchedEnd = fetchEnd;
+        else
+        {
+            range.fetchedStart = start;
+            range.fetchedEnd = fetchEnd;
+        }
         return true;
     }
     catch(...)
     {
+        // items loaded before the failure are kept
+        finishLoad();
         return false;
     }
 }
@@ -111,49 +298,209 @@ bool MetadataStream::save()
     {
         if( m_eMode == ReadWrite && !m_sFilePath.empty() )
         {
-            dataSource->remove(removedIds);
+            persist(*dataSource, nullptr);
+
             removedIds.clear();
+            removedSchemas.clear();
+            addedIds.clear();
 
-            for(auto& schemaPtr : removedSchemas)
+            // saved items aren't pinned in memory anymore
+            for (auto it = m_oMetadataSet.begin(); it != m_oMetadataSet.end(); ++it)
             {
-                dataSource->removeSchema(schemaPtr.first);
-                // Empty schema name is used to delete all schemas in the file
-                // That's why there's no need to continue the loop
-                if(schemaPtr.first == "")
+                if ((*it)->m_bModified)
                 {
-                    break;
+                    (*it)->m_bModified = false;
+                    trackPayload(**it);
                 }
             }
-            removedSchemas.clear();
+            evictPayloads();
 
-            for(auto& p : m_mapSchemas)
+            return true;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    catch (...)
+    {
+        return false;
+    }
+}
+
+std::future<bool> MetadataStream::saveAsync()
+{
+    dataSourceCheck();
+    std::shared_ptr<PendingSave> pending = std::make_shared<PendingSave>();
+    std::future<bool> result = pending->result.get_future();
+    if( m_eMode != ReadWrite || m_sFilePath.empty() )
+    {
+        pending->result.set_value(false);
+        return result;
+    }
+
+    MetadataStream& snapshot = pending->snapshot;
+    snapshot.m_mapSchemas = m_mapSchemas;
+    snapshot.removedSchemas = removedSchemas;
+    snapshot.removedIds = removedIds;
+    snapshot.addedIds = addedIds;
+    for (auto it = videoSegments.begin(); it != videoSegments.end(); ++it)
+        snapshot.videoSegments.push_back(std::make_shared<VideoSegment>(**it));
+    snapshot.nextId = nextId;
+    snapshot.m_sChecksumMedia = m_sChecksumMedia;
+    snapshot.m_bChecksumManifest = m_bChecksumManifest;
+    snapshot.m_nCompressionThreshold = m_nCompressionThreshold;
+    snapshot.m_nCompressionLevel = m_nCompressionLevel;
+    // unmodified items are already stored and are updated by data sources in place, so only changes are copied
+    for (auto it = m_oMetadataSet.begin(); it != m_oMetadataSet.end(); ++it)
+    {
+        if (!(*it)->m_bModified)
+            continue;
+        // the copy stays modified, so data sources storing only changes store it
+        std::shared_ptr<Metadata> copy = std::make_shared<Metadata>(**it);
+        snapshot.m_oMetadataSet.push_back(copy);
+        snapshot.m_idIndex[copy->getId()] = copy;
+        (*it)->m_bModified = false;
+        pending->items.push_back(*it);
+        pending->pinned.insert(it->get());
+    }
+    // references of the copies are moved to the snapshot, the worker never reads items of this stream
+    std::unordered_map<IdType, std::shared_ptr<Metadata>> targets;
+    for (auto it = snapshot.m_oMetadataSet.begin(); it != snapshot.m_oMetadataSet.end(); ++it)
+    {
+        for (auto ref = (*it)->m_vReferences.begin(); ref != (*it)->m_vReferences.end(); ++ref)
+        {
+            std::shared_ptr<Metadata> spReference = ref->getReferenceMetadata().lock();
+            if (!spReference)
+                continue;
+            std::shared_ptr<Metadata> spTarget = snapshot.getById(spReference->getId());
+            if (!spTarget)
             {
-                dataSource->saveSchema(p.first, *this);
-                dataSource->save(p.second);
+                std::shared_ptr<Metadata>& spId = targets[spReference->getId()];
+                if (!spId)
+                {
+                    spId = std::make_shared<Metadata>(spReference->getDesc());
+                    spId->m_Id = spReference->getId();
+                    pending->targets.push_back(spId);
+                }
+                spTarget = spId;
             }
+            ref->setReferenceMetadata(spTarget);
+        }
+    }
+    removedIds.clear();
+    removedSchemas.clear();
+    addedIds.clear();
 
-            dataSource->saveVideoSegments(videoSegments);
+    pending->source = dataSource;
+    m_pendingSave = pending;
+    pending->worker = std::thread([pending]()
+    {
+        try
+        {
+            pending->saved = pending->snapshot.persist(*pending->source, pending.get());
+        }
+        catch(...)
+        {
+            // failures are reported as by save()
+        }
+        pending->result.set_value(pending->saved);
+    });
+    return result;
+}
 
-            dataSource->save(nextId);
+void MetadataStream::cancelSave()
+{
+    if (m_pendingSave)
+        m_pendingSave->cancelled = true;
+}
 
-            if(!m_sChecksumMedia.empty())
-                dataSource->saveChecksum(m_sChecksumMedia);
+bool MetadataStream::persist(IDataSource& source, const PendingSave* pending) const
+{
+    auto cancelled = [pending]() { return pending != nullptr && pending->cancelled; };
+    source.beginTransaction();
+    try
+    {
+        source.remove(removedIds);
 
-            addedIds.clear();
+        for(auto& schemaPtr : removedSchemas)
+        {
+            source.removeSchema(schemaPtr.first);
+            // Empty schema name is used to delete all schemas in the file
+            // That's why there's no need to continue the loop
+            if(schemaPtr.first == "")
+            {
+                break;
+            }
+        }
 
-            return true;
+        for(auto& p : m_mapSchemas)
+        {
+            if (cancelled())
+            {
+                source.rollbackTransaction();
+                return false;
+            }
+            source.saveSchema(p.first, *this);
+            source.save(p.second);
         }
-        else
+
+        source.saveVideoSegments(videoSegments);
+
+        source.save(nextId);
+
+        if(!m_sChecksumMedia.empty())
+            source.saveChecksum(m_sChecksumMedia, m_bChecksumManifest);
+
+        if (cancelled())
         {
+            source.rollbackTransaction();
             return false;
         }
+        source.commitTransaction();
+        return true;
     }
     catch (...)
     {
-        return false;
+        try
+        {
+            source.rollbackTransaction();
+        }
+        catch (...)
+        {
+            // do nothing
+        }
+        throw;
     }
 }
 
+void MetadataStream::finishPendingSave()
+{
+    if (!m_pendingSave)
+        return;
+    std::shared_ptr<PendingSave> pending = m_pendingSave;
+    m_pendingSave.reset();
+    pending->worker.join();
+    if (!pending->saved)
+    {
+        // changes of the snapshot are stored by the next save
+        for (auto it = pending->items.begin(); it != pending->items.end(); ++it)
+        {
+            if ((*it)->m_pStream == this)
+                (*it)->m_bModified = true;
+        }
+        const MetadataStream& snapshot = pending->snapshot;
+        removedIds.insert(removedIds.begin(), snapshot.removedIds.begin(), snapshot.removedIds.end());
+        removedSchemas.insert(snapshot.removedSchemas.begin(), snapshot.removedSchemas.end());
+        for (auto id = snapshot.addedIds.begin(); id != snapshot.addedIds.end(); ++id)
+        {
+            if (getById(*id))
+                addedIds.push_back(*id);
+        }
+    }
+    evictPayloads();
+}
+
 bool MetadataStream::reopen( OpenMode eMode )
 {
     dataSourceCheck();
@@ -181,6 +528,16 @@ bool MetadataStream::saveTo( const std::string& sFilePath )
         throw std::runtime_error("The previous file has not been closed!");
     try
     {
+        finishPendingSave();
+        if( std::any_of(m_oMetadataSet.begin(), m_oMetadataSet.end(), [](const std::shared_ptr<Metadata>& spItem) { return spItem->m_bEvicted; }) )
+        {
+            // evicted values are brought back from the file they were loaded from
+            if( !this->reopen( ReadOnly ) )
+                return false;
+            reloadPayloads();
+            dataSource->closeFile();
+            m_eMode = InMemory;
+        }
         std::shared_ptr<IDataSource> oldDataSource = dataSource;
         dataSource = ObjectFactory::getInstance()->getDataSource();
         if (!dataSource)
@@ -215,6 +572,9 @@ void MetadataStream::close()
 {
     try
     {
+        finishPendingSave();
+        if (m_eMode != InMemory && dataSource)
+            reloadPayloads();
         m_eMode = InMemory;
         if (dataSource)
             dataSource->closeFile();
@@ -227,13 +587,9 @@ void MetadataStream::close()
 
 std::shared_ptr< Metadata > MetadataStream::getById( const IdType& id ) const
 {
-    MetadataSet::const_iterator it = std::find_if( m_oMetadataSet.begin(), m_oMetadataSet.end(), [id]( const std::shared_ptr< Metadata >& spItem )->bool 
-    {
-        return spItem->getId() == id; 
-    });
-
-    if( it != m_oMetadataSet.end() )
-        return *it;
+    auto it = m_idIndex.find( id );
+    if( it != m_idIndex.end() )
+        return it->second;
 
     return nullptr;
 }
@@ -245,7 +601,9 @@ IdType MetadataStream::add( std::shared_ptr< Metadata >& spMetadata )
 
     IdType id = nextId++;
     spMetadata->setId(id);
-    internalAdd(spMetadata);
+    addToSet(spMetadata);
+    spMetadata->m_bModified = true;
+    trackPayload(*spMetadata);
     addedIds.push_back(id);
     return id;
 }
@@ -260,7 +618,7 @@ IdType MetadataStream::add( std::shared_ptr< MetadataInternal >& spMetadataInter
     {
         if(this->getById(id) == nullptr)
         {
-            if(nextId < id)
+            if(nextId <= id)
                 nextId = id + 1;
         }
         else
@@ -271,7 +629,9 @@ IdType MetadataStream::add( std::shared_ptr< MetadataInternal >& spMetadataInter
         id = nextId++;
         spMetadataInternal->setId(id);
     }
-    internalAdd(spMetadataInternal);
+    addToSet(spMetadataInternal);
+    spMetadataInternal->m_bModified = true;
+    trackPayload(*spMetadataInternal);
     addedIds.push_back(id);
 
     if(!spMetadataInternal->vRefs.empty())
@@ -286,19 +646,118 @@ IdType MetadataStream::add( std::shared_ptr< MetadataInternal >& spMetadataInter
                 m_pendingReferences[ref->first].push_back(std::make_pair(id, ref->second));
         }
     }
-    auto pendingReferences = m_pendingReferences[id];
-    if(!pendingReferences.empty())
+    auto pendingReferences = m_pendingReferences.find(id);
+    if(pendingReferences != m_pendingReferences.end())
     {
-        for(auto pendingId = pendingReferences.begin(); pendingId != pendingReferences.end(); pendingId++)
+        for(auto pendingId = pendingReferences->second.begin(); pendingId != pendingReferences->second.end(); pendingId++)
             getById(pendingId->first)->addReference(spMetadataInternal, pendingId->second);
-        m_pendingReferences[id].clear();
-        m_pendingReferences.erase(id);
+        m_pendingReferences.erase(pendingReferences);
     }
 
     return id;
 }
 
+void MetadataStream::add(std::vector<std::shared_ptr<MetadataInternal>>& items)
+{
+    m_oMetadataSet.reserve(m_oMetadataSet.size() + items.size());
+    m_idIndex.reserve(m_idIndex.size() + items.size());
+
+    // descriptions whose schema is known to be in the stream
+    std::unordered_set<const MetadataDesc*> checkedDescs;
+    size_t added = 0;
+    try
+    {
+        for(; added < items.size(); added++)
+        {
+            std::shared_ptr<MetadataInternal>& spMetadataInternal = items[added];
+            const MetadataDesc* desc = spMetadataInternal->getDesc().get();
+            if(checkedDescs.find(desc) == checkedDescs.end())
+            {
+                if( !this->getSchema(desc->getSchemaName()) )
+                    VMF_EXCEPTION(vmf::NotFoundException, "Metadata schema is not in the stream");
+                checkedDescs.insert(desc);
+            }
+
+            IdType id = spMetadataInternal->getId();
+            if(id != INVALID_ID)
+            {
+                if(m_idIndex.find(id) != m_idIndex.end())
+                    VMF_EXCEPTION(IncorrectParamException, "Metadata with such id is already in the stream");
+                if(nextId <= id)
+                    nextId = id + 1;
+            }
+            else
+            {
+                id = nextId++;
+                spMetadataInternal->setId(id);
+            }
+            addToSet(spMetadataInternal);
+            spMetadataInternal->m_bModified = true;
+            trackPayload(*spMetadataInternal);
+            addedIds.push_back(id);
+        }
+    }
+    catch(...)
+    {
+        // the items added before the failed one keep their references, the first error is reported
+        try
+        {
+            wireReferences(items, added);
+        }
+        catch(...)
+        {
+        }
+        throw;
+    }
+    wireReferences(items, added);
+}
+
+void MetadataStream::mergeDeserializedAttributes(IdType nextIdValue, const std::string& filePath, const std::string& checksum)
+{
+    // ids of parsed items are already taken into account by the stream
+    nextId = std::max(nextId, nextIdValue);
+    if (m_sFilePath.empty())
+        m_sFilePath = filePath;
+    if (!checksum.empty())
+        m_sChecksumMedia = checksum;
+}
+
+void MetadataStream::wireReferences(const std::vector<std::shared_ptr<MetadataInternal>>& items, size_t count)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        const std::shared_ptr<MetadataInternal>& spItem = items[i];
+        for(auto ref = spItem->vRefs.begin(); ref != spItem->vRefs.end(); ref++)
+        {
+            auto referencedItem = m_idIndex.find(ref->first);
+            if(referencedItem != m_idIndex.end())
+                spItem->addReference(referencedItem->second, ref->second);
+            else
+                m_pendingReferences[ref->first].push_back(std::make_pair(spItem->getId(), ref->second));
+        }
+    }
+
+    if(m_pendingReferences.empty())
+        return;
+    for(size_t i = 0; i < count; i++)
+    {
+        auto pendingReferences = m_pendingReferences.find(items[i]->getId());
+        if(pendingReferences == m_pendingReferences.end())
+            continue;
+        for(auto pendingId = pendingReferences->second.begin(); pendingId != pendingReferences->second.end(); pendingId++)
+            getById(pendingId->first)->addReference(items[i], pendingId->second);
+        m_pendingReferences.erase(pendingReferences);
+    }
+}
+
 void MetadataStream::internalAdd(const std::shared_ptr<Metadata>& spMetadata)
+{
+    addToSet(spMetadata);
+    // loaded items are tracked as unmodified when the data source call is finished, see finishLoad()
+    m_loadedItems.push_back(spMetadata);
+}
+
+void MetadataStream::addToSet(const std::shared_ptr<Metadata>& spMetadata)
 {
     spMetadata->validate();
     spMetadata->setStreamRef(this);
@@ -313,6 +772,7 @@ void MetadataStream::internalAdd(const std::shared_ptr<Metadata>& spMetadata)
         }
     });
     m_oMetadataSet.push_back(spMetadata);
+    m_idIndex[spMetadata->getId()] = spMetadata;
 }
 
 bool MetadataStream::remove( const IdType& id )
@@ -328,8 +788,10 @@ bool MetadataStream::remove( const IdType& id )
     // Found it, let's remove it
     if( it != m_oMetadataSet.end() )
     {
+        untrackPayload(**it);
         (*it)->setStreamRef(nullptr);
         m_oMetadataSet.erase( it );
+        m_idIndex.erase( id );
 
         // Also remove any reference to it. There might be other shared pointers pointing to this object, so that
         // we cannot rely on weak_ptr being nullptr.
@@ -548,18 +1010,283 @@ bool MetadataStream::import( MetadataStream& srcStream, MetadataSet& srcSet, lon
 
 void MetadataStream::clear()
 {
+    finishPendingSave();
     m_eMode = InMemory;
     m_sFilePath = "";
+    // items may outlive the stream
+    for (auto it = m_oMetadataSet.begin(); it != m_oMetadataSet.end(); ++it)
+        (*it)->setStreamRef(nullptr);
     m_oMetadataSet.clear();
+    m_idIndex.clear();
     m_mapSchemas.clear();
     removedSchemas.clear();
     removedIds.clear();
     addedIds.clear();
     videoSegments.clear();
+    m_index.clear();
+    m_fetchedIds.clear();
+    m_framesRange = IndexRange();
+    m_timesRange = IndexRange();
+    m_loadedItems.clear();
+    std::lock_guard<std::recursive_mutex> guard(m_cacheLock);
+    m_cacheOrder.clear();
+    m_cacheEntries.clear();
+    m_nMemoryUsage = 0;
+    m_cacheStatistics = CacheStatistics();
+}
+
+void MetadataStream::setMemoryBudget(size_t nBytes)
+{
+    std::lock_guard<std::recursive_mutex> guard(m_cacheLock);
+    if (nBytes == 0)
+    {
+        reloadPayloads();
+        m_cacheOrder.clear();
+        m_cacheEntries.clear();
+        m_nMemoryUsage = 0;
+        m_nMemoryBudget = 0;
+        return;
+    }
+    bool tracked = m_nMemoryBudget != 0;
+    m_nMemoryBudget = nBytes;
+    if (!tracked)
+    {
+        for (auto it = m_oMetadataSet.begin(); it != m_oMetadataSet.end(); ++it)
+        {
+            if (!(*it)->m_bEvicted)
+                trackPayload(**it);
+        }
+    }
+    evictPayloads();
+}
+
+size_t MetadataStream::getMemoryBudget() const
+{
+    return m_nMemoryBudget;
+}
+
+size_t MetadataStream::getMemoryUsage() const
+{
+    std::lock_guard<std::recursive_mutex> guard(m_cacheLock);
+    return m_nMemoryUsage;
+}
+
+MetadataStream::CacheStatistics MetadataStream::getCacheStatistics() const
+{
+    std::lock_guard<std::recursive_mutex> guard(m_cacheLock);
+    return m_cacheStatistics;
+}
+
+void MetadataStream::accessPayload(const Metadata& md) const
+{
+    // items aren't evicted without a budget, reads don't touch the cache then
+    if (m_nMemoryBudget == 0 && !md.m_bEvicted)
+        return;
+    std::lock_guard<std::recursive_mutex> guard(m_cacheLock);
+    if (md.m_bEvicted)
+    {
+        m_cacheStatistics.misses++;
+        // the item is logically unchanged, its values are brought back from the data source
+        const_cast<MetadataStream*>(this)->reloadPayload(const_cast<Metadata&>(md));
+        return;
+    }
+    if (m_nMemoryBudget == 0)
+        return;
+    auto entry = m_cacheEntries.find(&md);
+    if (entry != m_cacheEntries.end())
+    {
+        m_cacheStatistics.hits++;
+        m_cacheOrder.splice(m_cacheOrder.begin(), m_cacheOrder, entry->second.position);
+    }
+}
+
+void MetadataStream::reloadPayload(Metadata& md)
+{
+    finishPendingSave();
+    if (m_eMode == InMemory || !dataSource)
+    {
+        VMF_EXCEPTION(DataStorageException, "Evicted metadata values can't be reloaded, the stream is closed");
+    }
+    std::shared_ptr<MetadataInternal> payload = dataSource->loadPayload(md.getId(), *this);
+    std::vector<FieldValue>& fields = md;
+    fields.assign(payload->begin(), payload->end());
+    md.m_bEvicted = false;
+
+    for (auto ref = payload->vRefs.begin(); ref != payload->vRefs.end(); ++ref)
+    {
+        if (std::find(removedIds.begin(), removedIds.end(), ref->first) != removedIds.end())
+            continue;
+        std::shared_ptr<Metadata> target = getById(ref->first);
+        if (!target)
+        {
+            // the referenced item isn't loaded yet by loadByFrameIndex() or loadByTime()
+            dataSource->loadItems(std::vector<IdType>(1, ref->first), *this);
+            target = getById(ref->first);
+        }
+        auto spRefDesc = md.m_spDesc->getReferenceDesc(ref->second);
+        if (target && spRefDesc)
+            md.m_vReferences.emplace_back(Reference(spRefDesc, target));
+    }
+    finishLoad();
+    // the reloaded item is the most recently used one and isn't evicted here
+    trackPayload(md);
+    evictPayloads();
+}
+
+void MetadataStream::reloadPayloads()
+{
+    std::lock_guard<std::recursive_mutex> guard(m_cacheLock);
+    size_t budget = m_nMemoryBudget;
+    m_nMemoryBudget = 0;
+    try
+    {
+        // reloading may load referenced items into the stream
+        std::vector<std::shared_ptr<Metadata>> evicted;
+        std::copy_if(m_oMetadataSet.begin(), m_oMetadataSet.end(), std::back_inserter(evicted),
+            [](const std::shared_ptr<Metadata>& spItem) { return spItem->m_bEvicted; });
+        for (auto it = evicted.begin(); it != evicted.end(); ++it)
+            reloadPayload(**it);
+    }
+    catch(...)
+    {
+        m_nMemoryBudget = budget;
+        throw;
+    }
+    m_nMemoryBudget = budget;
+    if (budget != 0)
+    {
+        m_cacheOrder.clear();
+        m_cacheEntries.clear();
+        m_nMemoryUsage = 0;
+        for (auto it = m_oMetadataSet.begin(); it != m_oMetadataSet.end(); ++it)
+            trackPayload(**it);
+    }
+}
+
+void MetadataStream::finishLoad()
+{
+    if (!m_loadedItems.empty())
+    {
+        // loaded items are appended in storage order, they are merged into the items sorted by id at once
+        auto byId = [](const std::shared_ptr<Metadata>& a, const std::shared_ptr<Metadata>& b) { return a->getId() < b->getId(); };
+        auto loaded = m_oMetadataSet.end() - (std::ptrdiff_t) m_loadedItems.size();
+        std::sort(loaded, m_oMetadataSet.end(), byId);
+        if (std::is_sorted(m_oMetadataSet.begin(), loaded, byId))
+            std::inplace_merge(m_oMetadataSet.begin(), loaded, m_oMetadataSet.end(), byId);
+        else
+            sortById();
+    }
+    for (auto it = m_loadedItems.begin(); it != m_loadedItems.end(); ++it)
+    {
+        (*it)->m_bModified = false;
+        trackPayload(**it);
+    }
+    m_loadedItems.clear();
+}
+
+void MetadataStream::trackPayload(Metadata& md)
+{
+    if (m_nMemoryBudget == 0)
+        return;
+    std::lock_guard<std::recursive_mutex> guard(m_cacheLock);
+    size_t size = getPayloadSize(md);
+    auto entry = m_cacheEntries.find(&md);
+    if (entry == m_cacheEntries.end())
+    {
+        m_cacheOrder.push_front(&md);
+        CacheEntry newEntry;
+        newEntry.position = m_cacheOrder.begin();
+        newEntry.size = size;
+        m_cacheEntries[&md] = newEntry;
+    }
+    else
+    {
+        m_cacheOrder.splice(m_cacheOrder.begin(), m_cacheOrder, entry->second.position);
+        m_nMemoryUsage -= entry->second.size;
+        entry->second.size = size;
+    }
+    m_nMemoryUsage += size;
+}
+
+void MetadataStream::untrackPayload(const Metadata& md)
+{
+    std::lock_guard<std::recursive_mutex> guard(m_cacheLock);
+    auto entry = m_cacheEntries.find(&md);
+    if (entry == m_cacheEntries.end())
+        return;
+    m_nMemoryUsage -= entry->second.size;
+    m_cacheOrder.erase(entry->second.position);
+    m_cacheEntries.erase(entry);
+}
+
+void MetadataStream::evictPayloads()
+{
+    if (m_nMemoryBudget == 0 || m_eMode == InMemory)
+        return;
+    std::lock_guard<std::recursive_mutex> guard(m_cacheLock);
+    auto it = m_cacheOrder.end();
+    while (m_nMemoryUsage > m_nMemoryBudget && it != m_cacheOrder.begin())
+    {
+        --it;
+        // the most recently used item may be accessed right now
+        if (it == m_cacheOrder.begin())
+            break;
+        Metadata* md = *it;
+        if (md->m_bModified || (m_pendingSave && m_pendingSave->pinned.count(md)))
+            continue;
+        auto entry = m_cacheEntries.find(md);
+        m_nMemoryUsage -= entry->second.size;
+        m_cacheEntries.erase(entry);
+        it = m_cacheOrder.erase(it);
+        md->evictPayload();
+        m_cacheStatistics.evictions++;
+    }
+}
+
+size_t MetadataStream::getPayloadSize(const Metadata& md)
+{
+    size_t size = md.capacity() * sizeof(FieldValue) + md.m_vReferences.capacity() * sizeof(Reference);
+    for (auto field = md.begin(); field != md.end(); ++field)
+    {
+        size += field->getName().capacity();
+        switch (field->getType())
+        {
+        case Variant::type_string:
+            size += field->get_string().capacity();
+            break;
+        case Variant::type_rawbuffer:
+            size += field->get_rawbuffer().size();
+            break;
+        case Variant::type_integer_vector:
+            size += field->get_integer_vector().capacity() * sizeof(vmf_integer);
+            break;
+        case Variant::type_real_vector:
+            size += field->get_real_vector().capacity() * sizeof(vmf_real);
+            break;
+        case Variant::type_string_vector:
+            for (auto str = field->get_string_vector().begin(); str != field->get_string_vector().end(); ++str)
+                size += sizeof(vmf_string) + str->capacity();
+            break;
+        case Variant::type_vec2d_vector:
+            size += field->get_vec2d_vector().capacity() * sizeof(vmf_vec2d);
+            break;
+        case Variant::type_vec3d_vector:
+            size += field->get_vec3d_vector().capacity() * sizeof(vmf_vec3d);
+            break;
+        case Variant::type_vec4d_vector:
+            size += field->get_vec4d_vector().capacity() * sizeof(vmf_vec4d);
+            break;
+        default:
+            break;
+        }
+    }
+    return size;
 }
 
 void MetadataStream::dataSourceCheck()
 {
+    // the data source is used by one thread at a time
+    finishPendingSave();
     if (!dataSource)
     {
         VMF_EXCEPTION(InternalErrorException, "No files has been assosiated with this stream");
@@ -627,39 +1354,88 @@ MetadataSet MetadataStream::queryByReference( const std::string& sReferenceName,
 
 std::string MetadataStream::serialize(IWriter& writer)
 {
+    // writers access field values directly
+    reloadPayloads();
     std::vector<std::shared_ptr<MetadataSchema>> schemas;
     for(auto spMetadataIter = m_mapSchemas.begin(); spMetadataIter != m_mapSchemas.end(); spMetadataIter++)
         schemas.push_back(spMetadataIter->second);
-    return writer.store(nextId, m_sFilePath, m_sChecksumMedia, videoSegments, schemas, m_oMetadataSet);
+    std::string result = writer.store(nextId, m_sFilePath, m_sChecksumMedia, videoSegments, schemas, m_oMetadataSet);
+    evictPayloads();
+    return result;
 }
 
-void MetadataStream::deserialize(const std::string& text, IReader& reader)
+void MetadataStream::serialize(std::ostream& output, IWriter& writer)
 {
-    std::vector<std::shared_ptr<VideoSegment>> segments;
+    reloadPayloads();
     std::vector<std::shared_ptr<MetadataSchema>> schemas;
-    std::vector<std::shared_ptr<MetadataInternal>> metadata;
-    std::string filePath;
-    reader.parseAll(text, nextId, filePath, m_sChecksumMedia, segments, schemas, metadata);
-    if(m_sFilePath.empty())
-        m_sFilePath = filePath;
-    std::for_each( segments.begin(), segments.end(), [&]( std::shared_ptr< VideoSegment >& spSegment )
-    {
-	addVideoSegment(spSegment);
-    });
-    std::for_each( schemas.begin(), schemas.end(), [&]( std::shared_ptr< MetadataSchema >& spSchema )
+    for(auto spMetadataIter = m_mapSchemas.begin(); spMetadataIter != m_mapSchemas.end(); spMetadataIter++)
+        schemas.push_back(spMetadataIter->second);
+    writer.store(output, nextId, m_sFilePath, m_sChecksumMedia, videoSegments, schemas, m_oMetadataSet);
+    evictPayloads();
+}
+
+void MetadataStream::serialize(const ChunkSink& sink, IWriter& writer)
+{
+    reloadPayloads();
+    std::vector<std::shared_ptr<MetadataSchema>> schemas;
+    for(auto spMetadataIter = m_mapSchemas.begin(); spMetadataIter != m_mapSchemas.end(); spMetadataIter++)
+        schemas.push_back(spMetadataIter->second);
+    writer.store(sink, nextId, m_sFilePath, m_sChecksumMedia, videoSegments, schemas, m_oMetadataSet);
+    evictPayloads();
+}
+
+void MetadataStream::serialize(std::ostream& output, IWriter& writer, unsigned int threads)
+{
+    // items are read by several threads, so the payloads are loaded before
+    reloadPayloads();
+    std::vector<std::shared_ptr<MetadataSchema>> schemas;
+    for(auto spMetadataIter = m_mapSchemas.begin(); spMetadataIter != m_mapSchemas.end(); spMetadataIter++)
+        schemas.push_back(spMetadataIter->second);
+
+    // nothing is evicted while the items are formatted, so the readers don't update the cache
+    size_t budget = m_nMemoryBudget;
+    m_nMemoryBudget = 0;
+    try
     {
-        addSchema(spSchema);
-    });
-    std::for_each( metadata.begin(), metadata.end(), [&]( std::shared_ptr< MetadataInternal >& spMetadata )
+        writer.store(output, nextId, m_sFilePath, m_sChecksumMedia, videoSegments, schemas, m_oMetadataSet, threads);
+    }
+    catch(...)
     {
-        add(spMetadata);
-    });
+        m_nMemoryBudget = budget;
+        throw;
+    }
+    m_nMemoryBudget = budget;
+    evictPayloads();
+}
+
+std::string MetadataStream::serialize(IWriter& writer, unsigned int threads)
+{
+    std::ostringstream output;
+    serialize(output, writer, threads);
+    return output.str();
+}
+
+void MetadataStream::deserialize(std::istream& input, IReader& reader)
+{
+    if(!reader.parseStream(input, *this))
+        VMF_EXCEPTION(IncorrectParamException, "Can't parse the serialized stream");
+}
+
+void MetadataStream::deserialize(const ChunkSource& source, IReader& reader)
+{
+    if(!reader.parseStream(source, *this))
+        VMF_EXCEPTION(IncorrectParamException, "Can't parse the serialized stream");
+}
+
+void MetadataStream::deserialize(const std::string& text, IReader& reader)
+{
+    if(!reader.parseText(text, *this))
+        VMF_EXCEPTION(IncorrectParamException, "Can't parse the serialized stream");
 }
 
 std::string MetadataStream::computeChecksum()
 {
-    long long size, offset;
-    return this->computeChecksum(size, offset);
+    return this->computeChecksum(ChecksumMD5);
 }
 
 std::string MetadataStream::computeChecksum(long long& XMPPacketSize, long long& XMPPacketOffset)
@@ -668,6 +1444,72 @@ std::string MetadataStream::computeChecksum(long long& XMPPacketSize, long long&
     return dataSource->computeChecksum(XMPPacketSize, XMPPacketOffset);
 }
 
+std::string MetadataStream::computeChecksum(ChecksumAlgorithm algorithm, unsigned int threads)
+{
+    dataSourceCheck();
+    return dataSource->computeChecksum(algorithm, threads);
+}
+
+bool MetadataStream::verifyChecksum(unsigned int threads)
+{
+    if (m_sChecksumMedia.empty())
+        return false;
+    dataSourceCheck();
+    return dataSource->verifyChecksum(m_sChecksumMedia, threads);
+}
+
+MetadataStream::ChecksumAlgorithm MetadataStream::getChecksumAlgorithm(const std::string& checksum)
+{
+    size_t prefix = checksum.find(':');
+    if (prefix == std::string::npos)
+        return ChecksumMD5;
+    if (checksum.compare(0, prefix, "xxh64tree") == 0)
+        return ChecksumTreeHash;
+    VMF_EXCEPTION(IncorrectParamException, "Unknown checksum algorithm: " + checksum.substr(0, prefix));
+}
+
+void MetadataStream::setChecksumManifest(bool enabled)
+{
+    m_bChecksumManifest = enabled;
+}
+
+bool MetadataStream::getChecksumManifest(size_t& chunkCount, long long& chunkSize)
+{
+    dataSourceCheck();
+    if (m_sChecksumMedia.empty())
+        return false;
+    return dataSource->loadChecksumManifest(m_sChecksumMedia, chunkCount, chunkSize);
+}
+
+size_t MetadataStream::verifyChecksumChunks(size_t firstChunk, size_t count, std::vector<size_t>& corruptChunks,
+                                            unsigned int threads, std::function<bool(size_t)> progress)
+{
+    dataSourceCheck();
+    if (m_sChecksumMedia.empty())
+        VMF_EXCEPTION(DataStorageException, "There is no checksum manifest for the stored digest");
+    return dataSource->verifyChecksumChunks(m_sChecksumMedia, firstChunk, count, threads, corruptChunks, progress);
+}
+
+std::vector<size_t> MetadataStream::verifyChecksumRange(long long offset, long long size, unsigned int threads)
+{
+    size_t chunkCount;
+    long long chunkSize;
+    if (!getChecksumManifest(chunkCount, chunkSize))
+        VMF_EXCEPTION(DataStorageException, "There is no checksum manifest for the stored digest");
+    if (offset < 0 || size < 0)
+        VMF_EXCEPTION(IncorrectParamException, "Invalid media range");
+
+    std::vector<size_t> corruptChunks;
+    if (size == 0)
+        return corruptChunks;
+    size_t first = (size_t) (offset / chunkSize);
+    size_t last = (size_t) ((offset + size - 1) / chunkSize);
+    if (last >= chunkCount)
+        VMF_EXCEPTION(OutOfRangeException, "Range is out of media part described by the checksum manifest");
+    verifyChecksumChunks(first, last - first + 1, corruptChunks, threads);
+    return corruptChunks;
+}
+
 std::string MetadataStream::getChecksum() const
 {
     return m_sChecksumMedia;
@@ -678,6 +1520,25 @@ void MetadataStream::setChecksum(const std::string &digestStr)
     m_sChecksumMedia = digestStr;
 }
 
+void MetadataStream::setCompression(size_t threshold, int level)
+{
+    if (level < -1 || level > 9)
+        VMF_EXCEPTION(IncorrectParamException, "Compression level should be in range [0, 9] or -1 for default level");
+
+    m_nCompressionThreshold = threshold;
+    m_nCompressionLevel = level;
+}
+
+size_t MetadataStream::getCompressionThreshold() const
+{
+    return m_nCompressionThreshold;
+}
+
+int MetadataStream::getCompressionLevel() const
+{
+    return m_nCompressionLevel;
+}
+
 void MetadataStream::addVideoSegment(const std::shared_ptr<VideoSegment>& newSegment)
 {
     if (!newSegment)
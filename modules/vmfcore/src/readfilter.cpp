@@ -0,0 +1,98 @@
+/* 
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "vmf/readfilter.hpp"
+#include "vmf/exceptions.hpp"
+
+#include <algorithm>
+
+namespace vmf
+{
+
+ReadFilter::ReadFilter()
+    : hasFrameWindow(false), hasTimeWindow(false), firstFrame(0), numOfFrames(0), startTime(0), endTime(0)
+{
+}
+
+void ReadFilter::addSchema(const std::string& schemaName)
+{
+    schemas.insert(schemaName);
+}
+
+void ReadFilter::addDescription(const std::string& schemaName, const std::string& descName)
+{
+    descriptions[schemaName].insert(descName);
+}
+
+void ReadFilter::setFrameWindow(long long first, long long count)
+{
+    if(first < 0 || count < 0)
+        VMF_EXCEPTION(IncorrectParamException, "Invalid frame window");
+    hasFrameWindow = true;
+    firstFrame = first;
+    numOfFrames = count;
+}
+
+void ReadFilter::setTimeWindow(long long start, long long end)
+{
+    if(end < start)
+        VMF_EXCEPTION(IncorrectParamException, "Invalid time window");
+    hasTimeWindow = true;
+    startTime = start;
+    endTime = end;
+}
+
+bool ReadFilter::isEmpty() const
+{
+    return schemas.empty() && descriptions.empty() && !hasFrameWindow && !hasTimeWindow;
+}
+
+bool ReadFilter::acceptsSchema(const std::string& schemaName) const
+{
+    if(schemas.empty() && descriptions.empty())
+        return true;
+    return schemas.find(schemaName) != schemas.end() || descriptions.find(schemaName) != descriptions.end();
+}
+
+bool ReadFilter::acceptsDescription(const std::string& schemaName, const std::string& descName) const
+{
+    if(schemas.empty() && descriptions.empty())
+        return true;
+    if(schemas.find(schemaName) != schemas.end())
+        return true;
+    auto descs = descriptions.find(schemaName);
+    return descs != descriptions.end() && descs->second.find(descName) != descs->second.end();
+}
+
+bool ReadFilter::acceptsPosition(long long frameIndex, long long frames, long long time, long long duration) const
+{
+    if(hasFrameWindow)
+    {
+        // an item with a frame index covers one frame at least
+        long long itemEnd = frameIndex + std::max(frames, 1LL);
+        if(frameIndex < 0 || frameIndex >= firstFrame + numOfFrames || itemEnd <= firstFrame)
+            return false;
+    }
+    if(hasTimeWindow)
+    {
+        long long itemEnd = time + duration;
+        if(time < 0 || itemEnd < startTime || time > endTime)
+            return false;
+    }
+    return true;
+}
+
+}//vmf
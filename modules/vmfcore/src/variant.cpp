@@ -15,13 +15,16 @@
  *
  */
 #include "vmf/variant.hpp"
+#include "base64.hpp"
 #include <cstring>
 #include <string>
 #include <memory>
-#include <sstream>
+#include <algorithm>
+#include <clocale>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <limits>
-#include <iomanip>
 
 
 namespace vmf
@@ -39,6 +42,7 @@ template<class T> class Data : public IData
 public:
     T content;
     Data(const T& value) : content(value) {}
+    Data(T&& value) : content(std::move(value)) {}
     ~Data() {}
     IData* clone() const
     {
@@ -50,9 +54,9 @@ public:
 
 Variant::Variant() : data(nullptr), m_type(type_unknown) {}
 
-Variant::Variant(const Variant& other) : data(other.data->clone()), m_type(other.getType()) {}
+Variant::Variant(const Variant& other) : data(other.data ? other.data->clone() : nullptr), m_type(other.getType()) {}
 
-Variant::Variant(Variant&& other)
+Variant::Variant(Variant&& other) : data(nullptr), m_type(type_unknown)
 {
     *this = std::move(other);
 }
@@ -292,257 +296,543 @@ bool Variant::operator != ( const Variant& other ) const
     return !( this->operator == ( other ));
 }
 
-#define SIMPLE_TYPE_TO_STRING( VAL ) \
-    ss << VAL;
+namespace
+{
 
-#define REAL_TYPE_TO_STRING( VAL ) \
-    ss << std::setprecision(std::numeric_limits<double>::digits10) << VAL;
+/*
+ * Numbers are written and parsed without streams. Reals get the shortest of 15, 16 or 17 significant
+ * digits that reads back to the same value, so values exact in 15 digits keep their former text.
+ * Parsers accept the syntax of the stream extraction and ignore the C locale.
+ */
 
-#define VEC2_TYPE_TO_STRING( VAL ) \
-    ss  << std::setprecision(std::numeric_limits<double>::digits10) << VAL.x << \
-    " " << std::setprecision(std::numeric_limits<double>::digits10) << VAL.y;
+const char digitPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
 
-#define VEC3_TYPE_TO_STRING(VAL) \
-    VEC2_TYPE_TO_STRING(VAL) \
-    ss << " " << std::setprecision(std::numeric_limits<double>::digits10) << VAL.z;
+const double powersOf10[] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
 
-#define VEC4_TYPE_TO_STRING( VAL ) \
-    VEC3_TYPE_TO_STRING(VAL) \
-    ss << " " << std::setprecision(std::numeric_limits<double>::digits10) << VAL.w;
+inline bool isSpace(char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
 
-#define VECTOR_TYPE_TO_STRING( T , OP ) \
-{ \
-    auto content = dynamic_cast<Data<std::vector<vmf_##T>>*>(data)->content; \
-    const char * separator = ""; \
-    for(auto it = content.begin(); it != content.end(); it++) \
-    { \
-        ss << separator; \
-        OP( (*it) ) \
-        separator = " ; "; \
-    } \
+inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+inline void skipSpace(const char*& p, const char* end)
+{
+    while(p != end && isSpace(*p))
+        p++;
+}
+
+inline bool skipWord(const char*& p, const char* end, const char* word)
+{
+    const char* s = p;
+    for(; *word; word++, s++)
+        if(s == end || (*s | 0x20) != *word)
+            return false;
+    p = s;
+    return true;
+}
+
+void appendInteger(std::string& text, vmf_integer value)
+{
+    char buffer[24];
+    char* end = buffer + sizeof(buffer);
+    char* p = end;
+    unsigned long long absValue = value < 0 ? 0ull - (unsigned long long) value : (unsigned long long) value;
+    while(absValue >= 100)
+    {
+        const char* pair = digitPairs + (absValue % 100) * 2;
+        absValue /= 100;
+        *--p = pair[1];
+        *--p = pair[0];
+    }
+    if(absValue >= 10)
+    {
+        const char* pair = digitPairs + absValue * 2;
+        *--p = pair[1];
+        *--p = pair[0];
+    }
+    else
+        *--p = (char) ('0' + absValue);
+    if(value < 0)
+        *--p = '-';
+    text.append(p, end - p);
+}
+
+// Replaces the decimal point of the C locale used by printf and strtod
+void replacePoint(char* text, size_t size, char from, char to)
+{
+    if(from == to)
+        return;
+    char* point = (char*) memchr(text, from, size);
+    if(point != NULL)
+        *point = to;
+}
+
+bool parseReal(const char*& p, const char* end, vmf_real& value)
+{
+    const char* s = p;
+    bool negative = false;
+    if(s != end && (*s == '+' || *s == '-'))
+        negative = *s++ == '-';
+
+    // up to 19 digits are kept in the mantissa, the rest only adjusts the exponent
+    unsigned long long mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool hasDigits = false;
+    for(; s != end && isDigit(*s); s++)
+    {
+        hasDigits = true;
+        if(digits < 19)
+        {
+            mantissa = mantissa * 10 + (*s - '0');
+            if(mantissa)
+                digits++;
+        }
+        else
+        {
+            digits++;
+            exponent++;
+        }
+    }
+    if(s != end && *s == '.')
+    {
+        for(s++; s != end && isDigit(*s); s++)
+        {
+            hasDigits = true;
+            if(digits < 19)
+            {
+                mantissa = mantissa * 10 + (*s - '0');
+                if(mantissa)
+                    digits++;
+                exponent--;
+            }
+            else
+                digits++;
+        }
+    }
+
+    if(!hasDigits)
+    {
+        if(skipWord(s, end, "inf"))
+        {
+            skipWord(s, end, "inity");
+            value = std::numeric_limits<vmf_real>::infinity();
+        }
+        else if(skipWord(s, end, "nan"))
+            value = std::numeric_limits<vmf_real>::quiet_NaN();
+        else
+            return false;
+        value = negative ? -value : value;
+        p = s;
+        return true;
+    }
+
+    if(s != end && (*s == 'e' || *s == 'E'))
+    {
+        const char* e = s + 1;
+        bool negativeExponent = false;
+        if(e != end && (*e == '+' || *e == '-'))
+            negativeExponent = *e++ == '-';
+        // the stream extraction fails on an exponent without digits too
+        if(e == end || !isDigit(*e))
+            return false;
+        int exponentValue = 0;
+        for(; e != end && isDigit(*e); e++)
+            if(exponentValue < 100000)
+                exponentValue = exponentValue * 10 + (*e - '0');
+        exponent += negativeExponent ? -exponentValue : exponentValue;
+        s = e;
+    }
+
+    if(mantissa == 0)
+        value = 0;
+    else if(digits <= 15 && exponent >= -22 && exponent <= 22)
+    {
+        // both operands are exact, so the result is correctly rounded
+        value = (vmf_real) mantissa;
+        value = exponent < 0 ? value / powersOf10[-exponent] : value * powersOf10[exponent];
+    }
+    else
+    {
+        // rare long tokens aren't copied to the stack buffer
+        char buffer[64];
+        std::string longToken;
+        size_t size = s - p;
+        char* token = buffer;
+        if(size >= sizeof(buffer))
+        {
+            longToken.assign(p, s);
+            token = &longToken[0];
+        }
+        else
+        {
+            memcpy(buffer, p, size);
+            buffer[size] = '\0';
+        }
+        replacePoint(token, size, '.', *localeconv()->decimal_point);
+        value = strtod(token, NULL);
+        // overflow is saturated like the stream extraction does
+        if(std::isinf(value))
+            value = value > 0 ? std::numeric_limits<vmf_real>::max() : -std::numeric_limits<vmf_real>::max();
+        p = s;
+        return true;
+    }
+    value = negative ? -value : value;
+    p = s;
+    return true;
+}
+
+/*
+ * Values with up to 15 significant digits in the fixed notation of "%.15g" are written without printf.
+ * The shortest decimal m / 10^k that divides back to the value exactly is the one printf would produce.
+ */
+bool appendShortReal(std::string& text, vmf_real value)
+{
+    vmf_real absValue = std::fabs(value);
+    if(!(absValue >= 1e-4 && absValue < 1e15))
+        return false;
+
+    for(int decimals = 0; decimals <= 19; decimals++)
+    {
+        vmf_real scaled = std::floor(absValue * powersOf10[decimals] + 0.5);
+        if(scaled >= 1e15)
+            return false;
+        if(scaled / powersOf10[decimals] != absValue)
+            continue;
+
+        char buffer[40];
+        char* end = buffer + sizeof(buffer);
+        char* p = end;
+        unsigned long long mantissa = (unsigned long long) scaled;
+        for(int i = 0; i < decimals; i++, mantissa /= 10)
+            if(p != end || mantissa % 10)
+                *--p = (char) ('0' + mantissa % 10);
+        if(p != end)
+            *--p = '.';
+        do
+        {
+            *--p = (char) ('0' + mantissa % 10);
+            mantissa /= 10;
+        }
+        while(mantissa);
+        if(value < 0)
+            *--p = '-';
+        text.append(p, end - p);
+        return true;
+    }
+    return false;
+}
+
+void appendReal(std::string& text, vmf_real value)
+{
+    if(appendShortReal(text, value))
+        return;
+
+    char buffer[32];
+    char point = *localeconv()->decimal_point;
+    int size = 0;
+    for(int precision = 15; precision <= 17; precision++)
+    {
+        size = snprintf(buffer, sizeof(buffer), "%.*g", precision, value);
+        replacePoint(buffer, size, point, '.');
+
+        vmf_real parsed;
+        const char* p = buffer;
+        if(!std::isfinite(value) || (parseReal(p, buffer + size, parsed) && parsed == value))
+            break;
+    }
+    text.append(buffer, size);
+}
+
+bool parseInteger(const char*& p, const char* end, vmf_integer& value)
+{
+    const char* s = p;
+    bool negative = false;
+    if(s != end && (*s == '+' || *s == '-'))
+        negative = *s++ == '-';
+    if(s == end || !isDigit(*s))
+        return false;
+
+    // out of range values are saturated like the stream extraction does
+    const unsigned long long limit = negative ? 0ull - (unsigned long long) std::numeric_limits<vmf_integer>::min()
+                                              : (unsigned long long) std::numeric_limits<vmf_integer>::max();
+    unsigned long long absValue = 0;
+    for(; s != end && isDigit(*s); s++)
+    {
+        unsigned digit = *s - '0';
+        absValue = absValue > (limit - digit) / 10 ? limit : absValue * 10 + digit;
+    }
+    value = negative ? (vmf_integer) (0ull - absValue) : (vmf_integer) absValue;
+    p = s;
+    return true;
 }
 
+bool parseItem(const char*& p, const char* end, vmf_integer& value)
+{
+    skipSpace(p, end);
+    return parseInteger(p, end, value);
+}
+
+bool parseItem(const char*& p, const char* end, vmf_real& value)
+{
+    skipSpace(p, end);
+    return parseReal(p, end, value);
+}
+
+bool parseItem(const char*& p, const char* end, vmf_vec2d& value)
+{
+    return parseItem(p, end, value.x) && parseItem(p, end, value.y);
+}
+
+bool parseItem(const char*& p, const char* end, vmf_vec3d& value)
+{
+    return parseItem(p, end, (vmf_vec2d&) value) && parseItem(p, end, value.z);
+}
+
+bool parseItem(const char*& p, const char* end, vmf_vec4d& value)
+{
+    return parseItem(p, end, (vmf_vec3d&) value) && parseItem(p, end, value.w);
+}
+
+// Strings of a vector are base64 encoded with the terminating zero
+bool parseItem(const char*& p, const char* end, vmf_string& value)
+{
+    skipSpace(p, end);
+    const char* s = p;
+    while(s != end && !isSpace(*s) && *s != ';')
+        s++;
+    if(s == p)
+        return false;
+    std::vector<char> decoded;
+    base64Decode(p, s - p, decoded);
+    value.assign(decoded.begin(), std::find(decoded.begin(), decoded.end(), '\0'));
+    p = s;
+    return true;
+}
+
+void appendItem(std::string& text, const vmf_integer& value)
+{
+    appendInteger(text, value);
+}
+
+void appendItem(std::string& text, const vmf_real& value)
+{
+    appendReal(text, value);
+}
+
+void appendItem(std::string& text, const vmf_vec2d& value)
+{
+    appendReal(text, value.x);
+    text += ' ';
+    appendReal(text, value.y);
+}
+
+void appendItem(std::string& text, const vmf_vec3d& value)
+{
+    appendItem(text, (const vmf_vec2d&) value);
+    text += ' ';
+    appendReal(text, value.z);
+}
+
+void appendItem(std::string& text, const vmf_vec4d& value)
+{
+    appendItem(text, (const vmf_vec3d&) value);
+    text += ' ';
+    appendReal(text, value.w);
+}
+
+void appendItem(std::string& text, const vmf_string& value)
+{
+    base64Encode(value.c_str(), value.size() + 1, text);
+}
+
+// Scalar values are parsed as far as possible and missing components are zero
+template <typename T>
+T parseValue(const std::string& text)
+{
+    T value = T();
+    const char* p = text.data();
+    parseItem(p, p + text.size(), value);
+    return value;
+}
+
+// An empty text is an empty vector, items are separated by ';'
+template <typename T>
+std::vector<T> parseVector(const std::string& text)
+{
+    const char* p = text.data(), *end = p + text.size();
+    std::vector<T> values;
+    skipSpace(p, end);
+    if(p == end)
+        return values;
+
+    values.reserve(std::count(p, end, ';') + 1);
+    for(;;)
+    {
+        T value = T();
+        if(!parseItem(p, end, value))
+            VMF_EXCEPTION(vmf::IncorrectParamException, "Invalid array item");
+        values.push_back(value);
+        skipSpace(p, end);
+        if(p == end)
+            break;
+        if(*p++ != ';')
+            VMF_EXCEPTION(vmf::IncorrectParamException, "Invalid array item separator");
+    }
+    return values;
+}
+
+template <typename T>
+void appendVector(std::string& text, const std::vector<T>& values)
+{
+    const char* separator = "";
+    for(auto value = values.begin(); value != values.end(); value++)
+    {
+        text += separator;
+        appendItem(text, *value);
+        separator = " ; ";
+    }
+}
+
+}
+
+#define VALUE_TO_STRING( T ) \
+    appendItem(text, dynamic_cast<Data<vmf_##T>*>(data)->content);
+
+#define VECTOR_TO_STRING( T ) \
+    appendVector(text, dynamic_cast<Data<std::vector<vmf_##T>>*>(data)->content);
+
 std::string Variant::toString() const
 {
-    std::stringstream ss;
+    std::string text;
     switch( m_type )
     {
     default:
     case type_unknown:
-        ss << "<Unknown type>";
+        text = "<Unknown type>";
         break;
     case type_integer:
-        SIMPLE_TYPE_TO_STRING(dynamic_cast<Data<vmf_integer>*>(data)->content)
+        VALUE_TO_STRING(integer)
         break;
     case type_real:
-        REAL_TYPE_TO_STRING(dynamic_cast<Data<vmf_real>*>(data)->content)
-            break;
+        VALUE_TO_STRING(real)
+        break;
     case type_string:
-        SIMPLE_TYPE_TO_STRING(dynamic_cast<Data<vmf_string>*>(data)->content.c_str())
+        text = dynamic_cast<Data<vmf_string>*>(data)->content.c_str();
         break;
     case type_vec2d:
-        VEC2_TYPE_TO_STRING(dynamic_cast<Data<vmf_vec2d>*>(data)->content)
+        VALUE_TO_STRING(vec2d)
         break;
     case type_vec3d:
-        VEC3_TYPE_TO_STRING(dynamic_cast<Data<vmf_vec3d>*>(data)->content)
+        VALUE_TO_STRING(vec3d)
         break;
     case type_vec4d:
-        VEC4_TYPE_TO_STRING(dynamic_cast<Data<vmf_vec4d>*>(data)->content)
+        VALUE_TO_STRING(vec4d)
         break;
     case type_rawbuffer:
-        ss << base64encode(dynamic_cast<Data<vmf_rawbuffer>*>(data)->content);
+        {
+            const vmf_rawbuffer& value = dynamic_cast<Data<vmf_rawbuffer>*>(data)->content;
+            base64Encode(value.data(), value.size(), text);
+        }
         break;
     case type_integer_vector:
-        VECTOR_TYPE_TO_STRING(integer, SIMPLE_TYPE_TO_STRING)
+        VECTOR_TO_STRING(integer)
         break;
     case type_real_vector:
-        VECTOR_TYPE_TO_STRING(real, REAL_TYPE_TO_STRING)
+        VECTOR_TO_STRING(real)
         break;
     case type_string_vector:
-        {
-            auto content = dynamic_cast<Data<std::vector<vmf_string>>*>(data)->content;
-            const char * separator = "";
-            for (auto it = content.begin(); it != content.end(); it++)
-            {
-                ss << separator;
-                SIMPLE_TYPE_TO_STRING(base64encode(vmf_rawbuffer(it->c_str(), it->size() + 1)))
-                separator = " ; ";
-            }
-        }
+        VECTOR_TO_STRING(string)
         break;
     case type_vec2d_vector:
-        VECTOR_TYPE_TO_STRING(vec2d, VEC2_TYPE_TO_STRING)
+        VECTOR_TO_STRING(vec2d)
         break;
     case type_vec3d_vector:
-        VECTOR_TYPE_TO_STRING(vec3d, VEC3_TYPE_TO_STRING)
+        VECTOR_TO_STRING(vec3d)
         break;
     case type_vec4d_vector:
-        VECTOR_TYPE_TO_STRING(vec4d, VEC4_TYPE_TO_STRING)
+        VECTOR_TO_STRING(vec4d)
         break;
     }
 
-    return ss.str();
+    return text;
 }
 
+#define VALUE_FROM_STRING( T ) \
+    data = new Data<vmf_##T>(parseValue<vmf_##T>(sValue));
+
+#define VECTOR_FROM_STRING( T ) \
+    data = new Data<std::vector<vmf_##T>>(parseVector<vmf_##T>(sValue));
+
 void Variant::fromString(Type eType, const std::string& sValue)
 {
     release();
 
     m_type = eType;
-    std::stringstream ss(sValue);
     switch (m_type)
     {
     case type_unknown:
         break;
     case type_integer:
-        {
-            vmf_integer temp_integer;
-            ss >> temp_integer;
-            data = new Data<vmf_integer>(temp_integer);
-        }
+        VALUE_FROM_STRING(integer)
         break;
     case type_real:
-        {
-            vmf_real temp_real;
-            ss >> temp_real;
-            data = new Data<vmf_real>(temp_real);
-        }
+        VALUE_FROM_STRING(real)
         break;
     case type_string:
         data = new Data<vmf_string>(sValue);
         break;
     case type_vec2d:
-        {
-            vmf_real x, y;
-            ss >> x >> y;
-            data = new Data<vmf_vec2d>(vmf_vec2d(x, y));
-        }
+        VALUE_FROM_STRING(vec2d)
         break;
     case type_vec3d:
-        {
-            vmf_real x, y, z;
-            ss >> x >> y >> z;
-            data = new Data<vmf_vec3d>(vmf_vec3d(x, y, z));
-        }
+        VALUE_FROM_STRING(vec3d)
         break;
     case type_vec4d:
-        {
-            vmf_real x, y, z, w;
-            ss >> x >> y >> z >> w;
-            data = new Data<vmf_vec4d>(vmf_vec4d(x, y, z, w));
-        }
+        VALUE_FROM_STRING(vec4d)
         break;
     case type_rawbuffer:
         {
-            std::string s;
-            ss >> s;
-            data = new Data<vmf_rawbuffer>(vmf_rawbuffer(base64decode(s)));
-            break;
+            const char* p = sValue.data(), *end = p + sValue.size();
+            skipSpace(p, end);
+            const char* s = p;
+            while(s != end && !isSpace(*s))
+                s++;
+            vmf_rawbuffer value;
+            base64Decode(p, s - p, value);
+            data = new Data<vmf_rawbuffer>(std::move(value));
         }
         break;
     case type_integer_vector:
-        {
-            std::vector<vmf_integer> vec;
-            while(ss)
-            {
-                vmf_integer temp;
-                vmf_char separator = ';';
-                ss >> temp;
-                vec.push_back(temp);
-                if(ss)
-                    ss >> separator;
-                if(separator != ';')
-                    VMF_EXCEPTION(vmf::IncorrectParamException, "Invalid array item separator");
-            }
-            data = new Data<std::vector<vmf_integer>>(vec);
-        }
+        VECTOR_FROM_STRING(integer)
         break;
     case type_real_vector:
-        {
-            std::vector<vmf_real> vec;
-            while(ss)
-            {
-                vmf_real temp;
-                vmf_char separator = ';';
-                ss >> temp;
-                vec.push_back(temp);
-                if(ss)
-                    ss >> separator;
-                if(separator != ';')
-                    VMF_EXCEPTION(vmf::IncorrectParamException, "Invalid array item separator");
-            }
-            data = new Data<std::vector<vmf_real>>(vec);
-        }
+        VECTOR_FROM_STRING(real)
         break;
     case type_string_vector:
-        {
-            std::vector<vmf_string> vec;
-            while(ss)
-            {
-                vmf_string temp;
-                vmf_char separator = ';';
-                ss >> temp;
-                vec.push_back( base64decode(temp).data() );
-                if(ss)
-                    ss >> separator;
-                if(separator != ';')
-                    VMF_EXCEPTION(vmf::IncorrectParamException, "Invalid array item separator");
-            }
-            data = new Data<std::vector<vmf_string>>(vec);
-        }
+        VECTOR_FROM_STRING(string)
         break;
     case type_vec2d_vector:
-        {
-            std::vector<vmf_vec2d> vec;
-            vmf_char separator = ';';
-            while(ss)
-            {
-                vmf_real x, y;
-                ss >> x >> y;
-                vec.push_back( vmf_vec2d(x,y) );
-                if(ss)
-                    ss >> separator;
-                if(separator != ';')
-                    VMF_EXCEPTION(vmf::IncorrectParamException, "Invalid array item separator");
-            }
-            data = new Data<std::vector<vmf_vec2d>>(vec);
-        }
+        VECTOR_FROM_STRING(vec2d)
         break;
     case type_vec3d_vector:
-        {
-            std::vector<vmf_vec3d> vec;
-            vmf_char separator = ';';
-            while(ss)
-            {
-                vmf_real x, y, z;
-                ss >> x >> y >> z;
-                vec.push_back( vmf_vec3d(x, y, z) );
-                if(ss)
-                    ss >> separator;
-                if(separator != ';')
-                    VMF_EXCEPTION(vmf::IncorrectParamException, "Invalid array item separator");
-            }
-            data = new Data<std::vector<vmf_vec3d>>(vec);
-        }
+        VECTOR_FROM_STRING(vec3d)
         break;
     case type_vec4d_vector:
-        {
-            std::vector<vmf_vec4d> vec;
-            vmf_char separator = ';';
-            while(ss)
-            {
-                vmf_real x, y, z, w;
-                ss >> x >> y >> z >> w;
-                vec.push_back( vmf_vec4d(x, y, z, w) );
-                if(ss)
-                    ss >> separator;
-                if(separator != ';')
-                    VMF_EXCEPTION(vmf::IncorrectParamException, "Invalid array item separator");
-            }
-            data = new Data<std::vector<vmf_vec4d>>(vec);
-        }
+        VECTOR_FROM_STRING(vec4d)
         break;
     default:
+        m_type = type_unknown;
         VMF_EXCEPTION(IncorrectParamException, "unexpected type");
     }
 }
@@ -576,9 +866,7 @@ void Variant::convertTo(Type type)
 
     // Convert value to double, and check to see if the value is out of range of what the new type can represent.
     std::string sValue = toString();
-    double fValue;
-    std::stringstream ss( sValue );
-    ss >> fValue;
+    double fValue = parseValue<vmf_real>(sValue);
 
     if (fValue < minLimit<double>(type) || fValue > maxLimit<double>(type))
     {
@@ -662,62 +950,16 @@ bool Variant::isConvertible(Type srcType, Type dstType)
 
 std::string Variant::base64encode(const vmf_rawbuffer& value)
 {
-    const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
     std::string result;
-    int size = (int)value.size();
-    const char * data = value.data();
-
-    while (size > 0)
-    {
-        const char *c0 = data++, *c1 = size > 1 ? data++ : "\0", *c2 = size > 2 ? data++ : "\0";
-
-        result += base64_chars[(*c0 & 0xfc) >> 2];
-        result += base64_chars[((*c0 & 0x03) << 4) | ((*c1 & 0xf0) >> 4)];
-        result += size > 1 ? base64_chars[((*c1 & 0x0f) << 2) | ((*c2 & 0xc0) >> 6)] : '=';
-        result += size > 2 ? base64_chars[*c2 & 0x3f] : '=';
-
-        size -= 3;
-    }
+    base64Encode(value.data(), value.size(), result);
     return result;
 }
 
 vmf_rawbuffer Variant::base64decode(const std::string& base64Str)
 {
-    const std::string base64_chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-
-    if (base64Str.empty())
-        return vmf_rawbuffer();
-
-    size_t size = base64Str.size();
-    if (base64Str.size() % 4 != 0)
-        VMF_EXCEPTION(vmf::IncorrectParamException, "Invalid base64 string size (isn't multiple of 4)");
-
-    size_t i = 0;
-    auto rit = base64Str.rbegin();
-    while (rit != base64Str.rend() && *rit++ == '=') ++i;
-    if (i > 2)
-        VMF_EXCEPTION(vmf::IncorrectParamException, "Invalid base64 string: more than 2 trailing '=' symbols");
-
-    size_t  res_size = size / 4 * 3 - i;
-    std::unique_ptr<char[]> result(new char[res_size]);
-
-    const char * in = base64Str.c_str();
-    i = 0;
-    while (i < res_size)
-    {
-        char c[4];
-        for (int j = 0; j < 4; j++)
-        {
-            c[j] = (char)base64_chars.find(*in++);
-            if (c[j] < 0 && i + j <= res_size)
-                VMF_EXCEPTION(vmf::IncorrectParamException, "Input base64 string contains invalid symbol");
-        }
-
-        result[i++] = (c[0] << 2) | (c[1] >> 4);
-        if (i < res_size) result[i++] = (c[1] << 4) | (c[2] >> 2);
-        if (i < res_size) result[i++] = ((c[2] & 0x3) << 6) | c[3];
-    }
-    return vmf_rawbuffer(result.get(), res_size);
+    vmf_rawbuffer result;
+    base64Decode(base64Str.data(), base64Str.size(), result);
+    return result;
 }
 
 void Variant::release()
@@ -16,12 +16,27 @@
  */
 #include "vmf/xmlreader.hpp"
 #include "vmf/rwconst.hpp"
+#include "parseditems.hpp"
 
 #include "libxml/tree.h"
+#include "libxml/xmlreader.h"
+
+#include <fstream>
+#include <map>
+#include <memory>
 
 namespace vmf
 {
 
+// strings returned by xmlGetProp() are allocated by libxml2
+static std::string getProperty(xmlNodePtr node, const xmlChar* name)
+{
+    xmlChar* value = xmlGetProp(node, name);
+    std::string result(value ? (const char*) value : "");
+    xmlFree(value);
+    return result;
+}
+
 static std::shared_ptr<MetadataSchema> parseSchemaFromNode(xmlNodePtr schemaNode)
 {
     std::shared_ptr<vmf::MetadataSchema> spSchema;
@@ -30,9 +45,9 @@ static std::shared_ptr<MetadataSchema> parseSchemaFromNode(xmlNodePtr schemaNode
     for(xmlAttrPtr cur_prop = schemaNode->properties; cur_prop; cur_prop = cur_prop->next)
     {
         if(std::string((char*)cur_prop->name) == std::string(ATTR_NAME))
-            schema_name = (char*)xmlGetProp(schemaNode, cur_prop->name);
+            schema_name = getProperty(schemaNode, cur_prop->name);
         else if(std::string((char*)cur_prop->name) == std::string(ATTR_SCHEMA_AUTHOR))
-            schema_author = (char*)xmlGetProp(schemaNode, cur_prop->name);
+            schema_author = getProperty(schemaNode, cur_prop->name);
     }
     spSchema = std::make_shared<vmf::MetadataSchema>(schema_name, schema_author);
 
@@ -43,7 +58,7 @@ static std::shared_ptr<MetadataSchema> parseSchemaFromNode(xmlNodePtr schemaNode
             std::string desc_name;
             for(xmlAttrPtr cur_prop = descNode->properties; cur_prop; cur_prop = cur_prop->next)
                 if(std::string((char*)cur_prop->name) == std::string(ATTR_NAME))
-                    desc_name = (char*)xmlGetProp(descNode, cur_prop->name);
+                    desc_name = getProperty(descNode, cur_prop->name);
 
             std::vector<FieldDesc> vFields;
             std::vector<std::shared_ptr<ReferenceDesc>> vReferences;
@@ -57,17 +72,17 @@ static std::shared_ptr<MetadataSchema> parseSchemaFromNode(xmlNodePtr schemaNode
                     for(xmlAttrPtr cur_prop = fieldNode->properties; cur_prop; cur_prop = cur_prop->next) //fill field's attributes
                     {
                         if(std::string((char*)cur_prop->name) == std::string(ATTR_NAME))
-                            field_name = (char*)xmlGetProp(fieldNode, cur_prop->name);
+                            field_name = getProperty(fieldNode, cur_prop->name);
                         if(std::string((char*)cur_prop->name) == std::string(ATTR_FIELD_TYPE))
                         {
-                            std::string sFieldType = (char*)xmlGetProp(fieldNode, cur_prop->name);
+                            std::string sFieldType = getProperty(fieldNode, cur_prop->name);
                             field_type = vmf::Variant::typeFromString(sFieldType);
                         }
                         if(std::string((char*)cur_prop->name) == std::string(ATTR_FIELD_OPTIONAL))
                         {
-                            if( std::string((char*)xmlGetProp(fieldNode, cur_prop->name)) == "true" )
+                            if( getProperty(fieldNode, cur_prop->name) == "true" )
                                 field_optional = true;
-                            else if( std::string((char*)xmlGetProp(fieldNode, cur_prop->name)) == "false" )
+                            else if( getProperty(fieldNode, cur_prop->name) == "false" )
                                 field_optional = false;
                             else
                                 VMF_EXCEPTION(vmf::IncorrectParamException, "Invalid value of boolean attribute 'optional'");
@@ -83,21 +98,21 @@ static std::shared_ptr<MetadataSchema> parseSchemaFromNode(xmlNodePtr schemaNode
                     for (xmlAttrPtr cur_ref = fieldNode->properties; cur_ref; cur_ref = cur_ref->next)
                     {
                         if (std::string((char*)cur_ref->name) == std::string(ATTR_NAME))
-                            reference_name = (char*)xmlGetProp(fieldNode, cur_ref->name);
+                            reference_name = getProperty(fieldNode, cur_ref->name);
                         if (std::string((char*)cur_ref->name) == std::string(ATTR_REFERENCE_UNIQUE))
                         {
-                            if (std::string((char*)xmlGetProp(fieldNode, cur_ref->name)) == "true")
+                            if (getProperty(fieldNode, cur_ref->name) == "true")
                                 isUnique = true;
-                            else if (std::string((char*)xmlGetProp(fieldNode, cur_ref->name)) == "false")
+                            else if (getProperty(fieldNode, cur_ref->name) == "false")
                                 isUnique = false;
                             else
                                 VMF_EXCEPTION(vmf::IncorrectParamException, "Invalid value of boolean attribute 'unique'");
                         }
                         if (std::string((char*)cur_ref->name) == std::string(ATTR_REFERENCE_CUSTOM))
                         {
-                            if (std::string((char*)xmlGetProp(fieldNode, cur_ref->name)) == "true")
+                            if (getProperty(fieldNode, cur_ref->name) == "true")
                                 isCustom = true;
-                            else if (std::string((char*)xmlGetProp(fieldNode, cur_ref->name)) == "false")
+                            else if (getProperty(fieldNode, cur_ref->name) == "false")
                                 isCustom = false;
                             else
                                 VMF_EXCEPTION(vmf::IncorrectParamException, "Invalid value of boolean attribute 'custom'");
@@ -115,13 +130,8 @@ static std::shared_ptr<MetadataSchema> parseSchemaFromNode(xmlNodePtr schemaNode
     return spSchema;
 }
 
-#if defined _MSC_VER && _MSC_VER < 1800
-    #define ATOLL(x) _atoi64(x)
-#else
-    #define ATOLL(x) atoll(x)
-#endif
-
-static std::shared_ptr<MetadataInternal> parseMetadataFromNode(xmlNodePtr metadataNode, const std::vector<std::shared_ptr<MetadataSchema>>& schemas)
+// Returns nullptr if the item doesn't pass the filter
+static std::shared_ptr<MetadataInternal> parseMetadataFromNode(xmlNodePtr metadataNode, DescTable& descs, const ReadFilter& filter)
 {
     std::string schema_name, desc_name;
     long long frameIndex = vmf::Metadata::UNDEFINED_FRAME_INDEX, nFrames = vmf::Metadata::UNDEFINED_FRAMES_NUMBER,
@@ -130,35 +140,28 @@ static std::shared_ptr<MetadataInternal> parseMetadataFromNode(xmlNodePtr metada
     for(xmlAttr* cur_prop = metadataNode->properties; cur_prop; cur_prop = cur_prop->next)
     {
         if(std::string((char*)cur_prop->name) == std::string(ATTR_METADATA_SCHEMA))
-            schema_name = (char*)xmlGetProp(metadataNode, cur_prop->name);
+            schema_name = getProperty(metadataNode, cur_prop->name);
         else if(std::string((char*)cur_prop->name) == std::string(ATTR_METADATA_DESCRIPTION))
-            desc_name = (char*)xmlGetProp(metadataNode, cur_prop->name);
+            desc_name = getProperty(metadataNode, cur_prop->name);
         else if(std::string((char*)cur_prop->name) == std::string(ATTR_METADATA_FRAME_IDX))
-            frameIndex = ATOLL((char*)xmlGetProp(metadataNode, cur_prop->name));
+            frameIndex = ATOLL(getProperty(metadataNode, cur_prop->name).c_str());
         else if(std::string((char*)cur_prop->name) == std::string(ATTR_METADATA_NFRAMES))
-            nFrames = ATOLL((char*)xmlGetProp(metadataNode, cur_prop->name));
+            nFrames = ATOLL(getProperty(metadataNode, cur_prop->name).c_str());
         else if(std::string((char*)cur_prop->name) == std::string(ATTR_METADATA_TIMESTAMP))
-            timestamp = ATOLL((char*)xmlGetProp(metadataNode, cur_prop->name));
+            timestamp = ATOLL(getProperty(metadataNode, cur_prop->name).c_str());
         else if(std::string((char*)cur_prop->name) == std::string(ATTR_METADATA_DURATION))
-            duration = ATOLL((char*)xmlGetProp(metadataNode, cur_prop->name));
+            duration = ATOLL(getProperty(metadataNode, cur_prop->name).c_str());
         else if(std::string((char*)cur_prop->name) == std::string(ATTR_ID))
-            id = ATOLL((char*)xmlGetProp(metadataNode, cur_prop->name));
+            id = ATOLL(getProperty(metadataNode, cur_prop->name).c_str());
     }
 
     if(id == INVALID_ID)
         VMF_EXCEPTION(vmf::InternalErrorException, "XML element has no id");
 
-    auto schema = schemas.begin();
-    for(; schema != schemas.end(); schema++)
-        if((*schema)->getName() == schema_name)
-            break;
-
-    if(schema == schemas.end())
-        VMF_EXCEPTION(vmf::IncorrectParamException, "Unknown metadata item schema");
+    if(!filter.acceptsDescription(schema_name, desc_name) || !filter.acceptsPosition(frameIndex, nFrames, timestamp, duration))
+        return nullptr;
 
-    std::shared_ptr<MetadataDesc> spDesc;
-    if( (spDesc = (*schema)->findMetadataDesc(desc_name)) == nullptr)
-        VMF_EXCEPTION(vmf::IncorrectParamException, "Unknown metadata item description");
+    const std::shared_ptr<MetadataDesc>& spDesc = descs.find(schema_name, desc_name);
 
     std::shared_ptr<MetadataInternal> spMetadataInternal(new MetadataInternal(spDesc));
     spMetadataInternal->setId(id);
@@ -187,12 +190,12 @@ static std::shared_ptr<MetadataInternal> parseMetadataFromNode(xmlNodePtr metada
             for(xmlAttr* cur_prop = fieldNode->properties; cur_prop; cur_prop = cur_prop->next)
             {
                 if(std::string((char*)cur_prop->name) == std::string(ATTR_NAME))
-                    field_name = (char*)xmlGetProp(fieldNode, cur_prop->name);
+                    field_name = getProperty(fieldNode, cur_prop->name);
                 else if(std::string((char*)cur_prop->name) == std::string(ATTR_VALUE))
                 {
                     FieldDesc fieldDesc;
                     spDesc->getFieldDesc(fieldDesc, field_name);
-                    field_value.fromString(fieldDesc.type, (char*)xmlGetProp(fieldNode, cur_prop->name));
+                    field_value.fromString(fieldDesc.type, getProperty(fieldNode, cur_prop->name));
                 }
             }
             spMetadataInternal->setFieldValue(field_name, field_value);
@@ -204,9 +207,9 @@ static std::shared_ptr<MetadataInternal> parseMetadataFromNode(xmlNodePtr metada
             for(xmlAttr* cur_prop = fieldNode->properties; cur_prop; cur_prop = cur_prop->next)
             {
                 if(std::string((char*)cur_prop->name) == std::string(ATTR_ID))
-                    refId = atol((char*)xmlGetProp(fieldNode, cur_prop->name));
+                    refId = atol(getProperty(fieldNode, cur_prop->name).c_str());
                 else if(std::string((char*)cur_prop->name) == std::string(ATTR_NAME))
-                    refName = (char*)xmlGetProp(fieldNode, cur_prop->name);
+                    refName = getProperty(fieldNode, cur_prop->name);
             }
             spMetadataInternal->vRefs.push_back(std::make_pair(IdType(refId), refName));
         }
@@ -223,17 +226,17 @@ static std::shared_ptr<MetadataStream::VideoSegment> parseSegmentFromNode(xmlNod
     for(xmlAttr* cur_prop = segmentNode->properties; cur_prop; cur_prop = cur_prop->next)
     {
 	if(std::string((char*)cur_prop->name) == std::string(ATTR_SEGMENT_TITLE))
-	    title = (char*)xmlGetProp(segmentNode, cur_prop->name);
+	    title = getProperty(segmentNode, cur_prop->name);
 	else if(std::string((char*)cur_prop->name) == std::string(ATTR_SEGMENT_FPS))
-	    fps = atof((char*)xmlGetProp(segmentNode, cur_prop->name));
+	    fps = atof(getProperty(segmentNode, cur_prop->name).c_str());
 	else if(std::string((char*)cur_prop->name) == std::string(ATTR_SEGMENT_TIME))
-	    timestamp = atol((char*)xmlGetProp(segmentNode, cur_prop->name));
+	    timestamp = atol(getProperty(segmentNode, cur_prop->name).c_str());
 	else if(std::string((char*)cur_prop->name) == std::string(ATTR_SEGMENT_DURATION))
-	    duration = atol((char*)xmlGetProp(segmentNode, cur_prop->name));
+	    duration = atol(getProperty(segmentNode, cur_prop->name).c_str());
 	else if(std::string((char*)cur_prop->name) == std::string(ATTR_SEGMENT_WIDTH))
-	    width = atol((char*)xmlGetProp(segmentNode, cur_prop->name));
+	    width = atol(getProperty(segmentNode, cur_prop->name).c_str());
 	else if(std::string((char*)cur_prop->name) == std::string(ATTR_SEGMENT_HEIGHT))
-	    height = atol((char*)xmlGetProp(segmentNode, cur_prop->name));
+	    height = atol(getProperty(segmentNode, cur_prop->name).c_str());
     }
 
     if(title.empty())
@@ -271,7 +274,7 @@ bool XMLReader::parseSchemas(const std::string& text, std::vector<std::shared_pt
         VMF_LOG_ERROR("Failed to allocate XML parser context");
         return false;
     }
-    xmlDocPtr doc = xmlCtxtReadMemory(ctxt, text.c_str(), (int)text.size(), NULL, NULL, 0);
+    xmlDocPtr doc = xmlCtxtReadMemory(ctxt, text.c_str(), (int)text.size(), NULL, NULL, XML_PARSE_HUGE);
 
     //xmlDocPtr doc = xmlParseMemory(text.c_str(), (int)text.size());
     if(doc == NULL)
@@ -292,7 +295,8 @@ bool XMLReader::parseSchemas(const std::string& text, std::vector<std::shared_pt
         try
         {
             std::shared_ptr<MetadataSchema> spSchema = parseSchemaFromNode(root);
-            schemas.push_back(spSchema);
+            if(filter.acceptsSchema(spSchema->getName()))
+                schemas.push_back(spSchema);
         }
         catch(Exception& e)
         {
@@ -308,7 +312,8 @@ bool XMLReader::parseSchemas(const std::string& text, std::vector<std::shared_pt
                 try
                 {
                     std::shared_ptr<MetadataSchema> spSchema = parseSchemaFromNode(node);
-                    schemas.push_back(spSchema);
+                    if(filter.acceptsSchema(spSchema->getName()))
+                        schemas.push_back(spSchema);
                 }
                 catch(Exception& e)
                 {
@@ -327,7 +332,8 @@ bool XMLReader::parseSchemas(const std::string& text, std::vector<std::shared_pt
                         try
                         {
                             std::shared_ptr<MetadataSchema> spSchema = parseSchemaFromNode(node);
-                            schemas.push_back(spSchema);
+                            if(filter.acceptsSchema(spSchema->getName()))
+                                schemas.push_back(spSchema);
                         }
                         catch(Exception& e)
                         {
@@ -356,6 +362,7 @@ bool XMLReader::parseMetadata(const std::string& text,
     }
 
     metadata.clear();
+    DescTable descs(schemas);
 
     xmlParserCtxtPtr ctxt = xmlNewParserCtxt();
     if (ctxt == NULL)
@@ -364,7 +371,7 @@ bool XMLReader::parseMetadata(const std::string& text,
         return false;
     }
 
-    xmlDocPtr doc = xmlCtxtReadMemory(ctxt, text.c_str(), (int)text.size(), NULL, NULL, 0);
+    xmlDocPtr doc = xmlCtxtReadMemory(ctxt, text.c_str(), (int)text.size(), NULL, NULL, XML_PARSE_HUGE);
     if(doc == NULL)
     {
         VMF_LOG_ERROR("Can't create XML document");
@@ -382,8 +389,9 @@ bool XMLReader::parseMetadata(const std::string& text,
     {
         try
         {
-            std::shared_ptr<MetadataInternal> spMetadata = parseMetadataFromNode(root, schemas);
-            metadata.push_back(spMetadata);
+            std::shared_ptr<MetadataInternal> spMetadata = parseMetadataFromNode(root, descs, filter);
+            if(spMetadata)
+                metadata.push_back(spMetadata);
         }
         catch(Exception& e)
         {
@@ -398,8 +406,9 @@ bool XMLReader::parseMetadata(const std::string& text,
             {
                 try
                 {
-                    std::shared_ptr<MetadataInternal> spMetadata = parseMetadataFromNode(node, schemas);
-                    metadata.push_back(spMetadata);
+                    std::shared_ptr<MetadataInternal> spMetadata = parseMetadataFromNode(node, descs, filter);
+                    if(spMetadata)
+                        metadata.push_back(spMetadata);
                 }
                 catch(Exception& e)
                 {
@@ -417,8 +426,9 @@ bool XMLReader::parseMetadata(const std::string& text,
                     {
                         try
                         {
-                            std::shared_ptr<MetadataInternal> spMetadata = parseMetadataFromNode(node, schemas);
-                            metadata.push_back(spMetadata);
+                            std::shared_ptr<MetadataInternal> spMetadata = parseMetadataFromNode(node, descs, filter);
+                            if(spMetadata)
+                                metadata.push_back(spMetadata);
                         }
                         catch(Exception& e)
                         {
@@ -457,7 +467,7 @@ bool XMLReader::parseAll(const std::string& text, IdType& nextId, std::string& f
         return false;
     }
 
-    xmlDocPtr doc = xmlCtxtReadMemory(ctxt, text.c_str(), (int)text.size(), NULL, NULL, 0);
+    xmlDocPtr doc = xmlCtxtReadMemory(ctxt, text.c_str(), (int)text.size(), NULL, NULL, XML_PARSE_HUGE);
     if(doc == NULL)
     {
         VMF_LOG_ERROR("Can't create XML document");
@@ -476,11 +486,11 @@ bool XMLReader::parseAll(const std::string& text, IdType& nextId, std::string& f
         for(xmlAttr* cur_prop = root->properties; cur_prop; cur_prop = cur_prop->next)
         {
             if(std::string((char*)cur_prop->name) == std::string(ATTR_VMF_NEXTID))
-                nextId = atol((char*)xmlGetProp(root, cur_prop->name));
+                nextId = atol(getProperty(root, cur_prop->name).c_str());
             else if(std::string((char*)cur_prop->name) == std::string(ATTR_VMF_FILEPATH))
-                filepath = (char*)xmlGetProp(root, cur_prop->name);
+                filepath = getProperty(root, cur_prop->name);
             else if(std::string((char*)cur_prop->name) == std::string(ATTR_VMF_CHECKSUM))
-                checksum = (char*)xmlGetProp(root, cur_prop->name);
+                checksum = getProperty(root, cur_prop->name);
         }
 	if(!parseVideoSegments(text, segments))
 	    return false;
@@ -520,7 +530,7 @@ bool XMLReader::parseVideoSegments(const std::string& text, std::vector<std::sha
 	VMF_LOG_ERROR("Failed to allocate XML parser context");
 	return false;
     }
-    xmlDocPtr doc = xmlCtxtReadMemory(ctxt, text.c_str(), (int)text.size(), NULL, NULL, 0);
+    xmlDocPtr doc = xmlCtxtReadMemory(ctxt, text.c_str(), (int)text.size(), NULL, NULL, XML_PARSE_HUGE);
 
     //xmlDocPtr doc = xmlParseMemory(text.c_str(), (int)text.size());
     if(doc == NULL)
@@ -594,4 +604,220 @@ bool XMLReader::parseVideoSegments(const std::string& text, std::vector<std::sha
     return true;
 }
 
+static int readInput(void* context, char* buffer, int len)
+{
+    std::istream& input = *static_cast<std::istream*>(context);
+    input.read(buffer, len);
+    if (input.bad())
+        return -1;
+    return (int) input.gcount();
+}
+
+static int closeInput(void* /* context */)
+{
+    return 0;
+}
+
+namespace
+{
+
+// Receives parts of the document in document order
+class XMLSink
+{
+public:
+    virtual ~XMLSink() {}
+    virtual void segment(const std::shared_ptr<MetadataStream::VideoSegment>& spSegment) = 0;
+    virtual void schema(const std::shared_ptr<MetadataSchema>& spSchema) = 0;
+    virtual void metadata(const std::shared_ptr<MetadataInternal>& spMetadata) = 0;
+    // called when the document is over or fails
+    virtual void finish() = 0;
+};
+
+class StreamSink : public XMLSink
+{
+public:
+    explicit StreamSink(MetadataStream& stream) : stream(stream), items(stream) {}
+
+    void segment(const std::shared_ptr<MetadataStream::VideoSegment>& spSegment)
+    {
+        stream.addVideoSegment(spSegment);
+    }
+
+    void schema(const std::shared_ptr<MetadataSchema>& spSchema)
+    {
+        std::shared_ptr<MetadataSchema> added = spSchema;
+        stream.addSchema(added);
+    }
+
+    void metadata(const std::shared_ptr<MetadataInternal>& spMetadata)
+    {
+        items.add(spMetadata);
+    }
+
+    void finish()
+    {
+        items.flush();
+    }
+
+private:
+    MetadataStream& stream;
+    ItemBatch items;
+};
+
+}
+
+// Checks the attributes of the current metadata element without expanding it
+static bool acceptsMetadataElement(xmlTextReaderPtr reader, const ReadFilter& filter)
+{
+    std::string schema_name, desc_name;
+    long long frameIndex = vmf::Metadata::UNDEFINED_FRAME_INDEX, nFrames = vmf::Metadata::UNDEFINED_FRAMES_NUMBER,
+        timestamp = vmf::Metadata::UNDEFINED_TIMESTAMP, duration = vmf::Metadata::UNDEFINED_DURATION;
+
+    while (xmlTextReaderMoveToNextAttribute(reader) == 1)
+    {
+        std::string name = (const char*) xmlTextReaderConstName(reader);
+        const char* value = (const char*) xmlTextReaderConstValue(reader);
+        if (name == ATTR_METADATA_SCHEMA)
+            schema_name = value;
+        else if (name == ATTR_METADATA_DESCRIPTION)
+            desc_name = value;
+        else if (name == ATTR_METADATA_FRAME_IDX)
+            frameIndex = ATOLL(value);
+        else if (name == ATTR_METADATA_NFRAMES)
+            nFrames = ATOLL(value);
+        else if (name == ATTR_METADATA_TIMESTAMP)
+            timestamp = ATOLL(value);
+        else if (name == ATTR_METADATA_DURATION)
+            duration = ATOLL(value);
+    }
+    xmlTextReaderMoveToElement(reader);
+
+    return filter.acceptsDescription(schema_name, desc_name) && filter.acceptsPosition(frameIndex, nFrames, timestamp, duration);
+}
+
+/*
+ * Walks the document by the pull parser. Elements of segments, schemas and metadata items are expanded
+ * one at a time and the reader releases them when it moves to the next sibling.
+ * Parsed schemas are appended to the schemas used to parse metadata items.
+ * Metadata elements rejected by the filter are skipped without being expanded.
+ */
+static bool parseDocument(xmlTextReaderPtr reader, XMLSink& sink, std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+                          std::map<std::string, std::string>& rootAttributes, const ReadFilter& filter)
+{
+    if (reader == NULL)
+    {
+        VMF_LOG_ERROR("Failed to allocate XML reader");
+        return false;
+    }
+    // the reader is freed whatever is thrown by the sink or the parser
+    std::unique_ptr<xmlTextReader, void (*)(xmlTextReaderPtr)> readerHolder(reader, xmlFreeTextReader);
+
+    DescTable descs(schemas);
+    bool result = true;
+    try
+    {
+        int ret = xmlTextReaderRead(reader);
+        while (ret == 1)
+        {
+            if (xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT)
+            {
+                ret = xmlTextReaderRead(reader);
+                continue;
+            }
+
+            std::string name = (const char*) xmlTextReaderConstName(reader);
+            if (name == TAG_VMF)
+            {
+                while (xmlTextReaderMoveToNextAttribute(reader) == 1)
+                    rootAttributes[(const char*) xmlTextReaderConstName(reader)] = (const char*) xmlTextReaderConstValue(reader);
+                xmlTextReaderMoveToElement(reader);
+            }
+            else if (name == TAG_METADATA && !filter.isEmpty() && !acceptsMetadataElement(reader, filter))
+            {
+                ret = xmlTextReaderNext(reader);
+                continue;
+            }
+            else if (name == TAG_VIDEO_SEGMENT || name == TAG_SCHEMA || name == TAG_METADATA)
+            {
+                xmlNodePtr node = xmlTextReaderExpand(reader);
+                if (node == NULL)
+                    break;
+
+                if (name == TAG_VIDEO_SEGMENT)
+                    sink.segment(parseSegmentFromNode(node));
+                else if (name == TAG_SCHEMA)
+                {
+                    std::shared_ptr<MetadataSchema> spSchema = parseSchemaFromNode(node);
+                    if (filter.acceptsSchema(spSchema->getName()))
+                    {
+                        schemas.push_back(spSchema);
+                        sink.schema(spSchema);
+                    }
+                }
+                else
+                {
+                    std::shared_ptr<MetadataInternal> spMetadata = parseMetadataFromNode(node, descs, filter);
+                    if (spMetadata)
+                        sink.metadata(spMetadata);
+                }
+
+                ret = xmlTextReaderNext(reader);
+                continue;
+            }
+            ret = xmlTextReaderRead(reader);
+        }
+
+        if (ret != 0)
+        {
+            VMF_LOG_ERROR("Can't parse XML document");
+            result = false;
+        }
+    }
+    catch(Exception& e)
+    {
+        VMF_LOG_ERROR("Exception: %s", e.what());
+        result = false;
+    }
+
+    // items parsed before an error are kept
+    try
+    {
+        sink.finish();
+    }
+    catch(Exception& e)
+    {
+        VMF_LOG_ERROR("Exception: %s", e.what());
+        result = false;
+    }
+
+    return result;
+}
+
+bool XMLReader::parseStream(std::istream& input, MetadataStream& stream)
+{
+    std::vector<std::shared_ptr<MetadataSchema>> schemas;
+    std::vector<std::string> names = stream.getAllSchemaNames();
+    for (auto name = names.begin(); name != names.end(); ++name)
+        schemas.push_back(stream.getSchema(*name));
+
+    std::map<std::string, std::string> rootAttributes;
+    StreamSink sink(stream);
+    bool result = parseDocument(xmlReaderForIO(readInput, closeInput, &input, NULL, NULL, XML_PARSE_HUGE), sink, schemas, rootAttributes, filter);
+
+    applyRootAttributes(rootAttributes, stream);
+
+    return result;
+}
+
+bool XMLReader::parseFile(const std::string& fileName, MetadataStream& stream)
+{
+    std::ifstream input(fileName.c_str(), std::ios::in | std::ios::binary);
+    if (!input.is_open())
+    {
+        VMF_LOG_ERROR("Can't open XML file %s", fileName.c_str());
+        return false;
+    }
+    return parseStream(input, stream);
+}
+
 }//vmf
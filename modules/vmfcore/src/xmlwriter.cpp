@@ -16,8 +16,11 @@
  */
 #include "vmf/xmlwriter.hpp"
 #include "vmf/rwconst.hpp"
+#include "chunks.hpp"
+#include "streamcheck.hpp"
 
 #include "libxml/tree.h"
+#include "libxml/xmlwriter.h"
 
 #include <algorithm>
 
@@ -186,6 +189,242 @@ static void add(xmlNodePtr segmentsNode, const std::shared_ptr<MetadataStream::V
     }
 }
 
+static void check(int result, const char* what)
+{
+    if(result < 0)
+        VMF_EXCEPTION(vmf::InternalErrorException, std::string("Can't write XML ") + what);
+}
+
+static void writeAttribute(xmlTextWriterPtr writer, const char* name, const std::string& value)
+{
+    check(xmlTextWriterWriteAttribute(writer, BAD_CAST name, BAD_CAST value.c_str()), name);
+}
+
+static void write(xmlTextWriterPtr writer, const std::shared_ptr<MetadataSchema>& spSchema)
+{
+    writeAttribute(writer, ATTR_NAME, spSchema->getName());
+    writeAttribute(writer, ATTR_SCHEMA_AUTHOR, spSchema->getAuthor());
+
+    auto vDescs = spSchema->getAll();
+    for( auto spDescriptor = vDescs.begin(); spDescriptor != vDescs.end(); spDescriptor++)
+    {
+        check(xmlTextWriterStartElement(writer, BAD_CAST TAG_DESCRIPTION), TAG_DESCRIPTION);
+        writeAttribute(writer, ATTR_NAME, (*spDescriptor)->getMetadataName());
+
+        auto vFields = (*spDescriptor)->getFields();
+        for( auto fieldDesc = vFields.begin(); fieldDesc != vFields.end(); fieldDesc++)
+        {
+            check(xmlTextWriterStartElement(writer, BAD_CAST TAG_FIELD), TAG_FIELD);
+            writeAttribute(writer, ATTR_NAME, fieldDesc->name);
+            writeAttribute(writer, ATTR_FIELD_TYPE, Variant::typeToString(fieldDesc->type));
+            if(fieldDesc->optional)
+                writeAttribute(writer, ATTR_FIELD_OPTIONAL, "true");
+            check(xmlTextWriterEndElement(writer), TAG_FIELD);
+        }
+
+        auto vRefs = (*spDescriptor)->getAllReferenceDescs();
+        for (auto refDesc = vRefs.begin(); refDesc != vRefs.end(); refDesc++)
+        {
+            if ((*refDesc)->name.empty())
+                continue;
+
+            check(xmlTextWriterStartElement(writer, BAD_CAST TAG_METADATA_REFERENCE), TAG_METADATA_REFERENCE);
+            writeAttribute(writer, ATTR_NAME, (*refDesc)->name);
+            if ((*refDesc)->isUnique)
+                writeAttribute(writer, ATTR_REFERENCE_UNIQUE, "true");
+            if ((*refDesc)->isCustom)
+                writeAttribute(writer, ATTR_REFERENCE_CUSTOM, "true");
+            check(xmlTextWriterEndElement(writer), TAG_METADATA_REFERENCE);
+        }
+        check(xmlTextWriterEndElement(writer), TAG_DESCRIPTION);
+    }
+}
+
+static void write(xmlTextWriterPtr writer, const std::shared_ptr<Metadata>& spMetadata)
+{
+    writeAttribute(writer, ATTR_METADATA_SCHEMA, spMetadata->getSchemaName());
+    writeAttribute(writer, ATTR_METADATA_DESCRIPTION, spMetadata->getName());
+    writeAttribute(writer, ATTR_ID, TYPE2STR(spMetadata->getId()));
+    if(spMetadata->getFrameIndex() != Metadata::UNDEFINED_FRAME_INDEX)
+        writeAttribute(writer, ATTR_METADATA_FRAME_IDX, TYPE2STR(spMetadata->getFrameIndex()));
+    if(spMetadata->getNumOfFrames() != Metadata::UNDEFINED_FRAMES_NUMBER)
+        writeAttribute(writer, ATTR_METADATA_NFRAMES, TYPE2STR(spMetadata->getNumOfFrames()));
+    if(spMetadata->getTime() != Metadata::UNDEFINED_TIMESTAMP)
+        writeAttribute(writer, ATTR_METADATA_TIMESTAMP, TYPE2STR(spMetadata->getTime()));
+    if(spMetadata->getDuration() != Metadata::UNDEFINED_DURATION)
+        writeAttribute(writer, ATTR_METADATA_DURATION, TYPE2STR(spMetadata->getDuration()));
+
+    auto vFields = spMetadata->getDesc()->getFields();
+    for( auto fieldDesc = vFields.begin(); fieldDesc != vFields.end(); fieldDesc++)
+    {
+        Variant val = spMetadata->getFieldValue(fieldDesc->name);
+        if (!val.isEmpty())
+        {
+            check(xmlTextWriterStartElement(writer, BAD_CAST TAG_FIELD), TAG_FIELD);
+            writeAttribute(writer, ATTR_NAME, fieldDesc->name);
+            writeAttribute(writer, ATTR_VALUE, val.toString());
+            check(xmlTextWriterEndElement(writer), TAG_FIELD);
+        }
+    }
+
+    auto refs = spMetadata->getAllReferences();
+    for( auto reference = refs.begin(); reference != refs.end(); reference++)
+    {
+        check(xmlTextWriterStartElement(writer, BAD_CAST TAG_METADATA_REFERENCE), TAG_METADATA_REFERENCE);
+        writeAttribute(writer, ATTR_NAME, reference->getReferenceDescription()->name);
+        writeAttribute(writer, ATTR_ID, TYPE2STR(reference->getReferenceMetadata().lock()->getId()));
+        check(xmlTextWriterEndElement(writer), TAG_METADATA_REFERENCE);
+    }
+}
+
+static void write(xmlTextWriterPtr writer, const std::shared_ptr<MetadataStream::VideoSegment>& spSegment)
+{
+    if(spSegment->getTitle() == "" || spSegment->getFPS() <= 0 || spSegment->getTime() < 0 )
+        VMF_EXCEPTION(IncorrectParamException, "Invalid segment. Segment must have not empty title, fps > 0 and start time >= 0");
+
+    writeAttribute(writer, ATTR_SEGMENT_TITLE, spSegment->getTitle());
+    writeAttribute(writer, ATTR_SEGMENT_FPS, TYPE2STR(spSegment->getFPS()));
+    writeAttribute(writer, ATTR_SEGMENT_TIME, TYPE2STR(spSegment->getTime()));
+    if(spSegment->getDuration() > 0)
+        writeAttribute(writer, ATTR_SEGMENT_DURATION, TYPE2STR(spSegment->getDuration()));
+
+    long width, height;
+    spSegment->getResolution(width, height);
+    if (width > 0 && height > 0)
+    {
+        writeAttribute(writer, ATTR_SEGMENT_WIDTH, TYPE2STR(width));
+        writeAttribute(writer, ATTR_SEGMENT_HEIGHT, TYPE2STR(height));
+    }
+}
+
+template <typename T>
+static void writeArray(xmlTextWriterPtr writer, const char* arrayTag, const char* tag, const T& items, const char* nullMessage)
+{
+    check(xmlTextWriterStartElement(writer, BAD_CAST arrayTag), arrayTag);
+    for (auto item = items.begin(); item != items.end(); ++item)
+    {
+        if (*item == nullptr)
+            VMF_EXCEPTION(vmf::IncorrectParamException, nullMessage);
+        check(xmlTextWriterStartElement(writer, BAD_CAST tag), tag);
+        write(writer, *item);
+        check(xmlTextWriterEndElement(writer), tag);
+    }
+    check(xmlTextWriterEndElement(writer), arrayTag);
+}
+
+static int appendText(void* context, const char* buffer, int len)
+{
+    static_cast<std::string*>(context)->append(buffer, len);
+    return len;
+}
+
+// Formats items [begin, end) as elements of the metadata array by a separate writer
+static void writeItems(const MetadataSet& set, size_t begin, size_t end, std::string& text)
+{
+    xmlOutputBufferPtr buffer = xmlOutputBufferCreateIO(appendText, NULL, &text, NULL);
+    if (buffer == NULL)
+        VMF_EXCEPTION(vmf::InternalErrorException, "Can't create XML output buffer");
+    xmlTextWriterPtr writer = xmlNewTextWriter(buffer);
+    if (writer == NULL)
+    {
+        xmlOutputBufferClose(buffer);
+        VMF_EXCEPTION(vmf::InternalErrorException, "Can't create XML writer");
+    }
+
+    try
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            if (set[i] == nullptr)
+                VMF_EXCEPTION(vmf::IncorrectParamException, "Metadata pointer is null");
+            check(xmlTextWriterStartElement(writer, BAD_CAST TAG_METADATA), TAG_METADATA);
+            write(writer, set[i]);
+            check(xmlTextWriterEndElement(writer), TAG_METADATA);
+        }
+        check(xmlTextWriterFlush(writer), TAG_METADATA_ARRAY);
+    }
+    catch(...)
+    {
+        xmlFreeTextWriter(writer);
+        throw;
+    }
+    xmlFreeTextWriter(writer);
+}
+
+static void writeMetadataArray(xmlTextWriterPtr writer, const MetadataSet& set, unsigned int threads)
+{
+    if (threads == 1)
+    {
+        writeArray(writer, TAG_METADATA_ARRAY, TAG_METADATA, set, "Metadata pointer is null");
+        return;
+    }
+
+    // the text of the chunks is inserted as is, the writer only closes the start tag of the array before it
+    check(xmlTextWriterStartElement(writer, BAD_CAST TAG_METADATA_ARRAY), TAG_METADATA_ARRAY);
+    formatChunks(set.size(), threads,
+        [&](size_t begin, size_t end, std::string& text) { writeItems(set, begin, end, text); },
+        [&](const std::string& text)
+        {
+            check(xmlTextWriterWriteRawLen(writer, BAD_CAST text.data(), (int) text.size()), TAG_METADATA_ARRAY);
+        });
+    check(xmlTextWriterEndElement(writer), TAG_METADATA_ARRAY);
+}
+
+// Elements are written in the order of the tree built by XMLWriter::store(), so the output is the same
+static void storeStream(xmlOutputBufferPtr buffer, const IdType& nextId,
+    const std::string& filepath,
+    const std::string& checksum,
+    const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments,
+    const std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+    const MetadataSet& set,
+    unsigned int threads = 1)
+{
+    if (buffer == NULL)
+        VMF_EXCEPTION(vmf::InternalErrorException, "Can't create XML output buffer");
+    // the writer owns the buffer
+    xmlTextWriterPtr writer = xmlNewTextWriter(buffer);
+    if (writer == NULL)
+    {
+        xmlOutputBufferClose(buffer);
+        VMF_EXCEPTION(vmf::InternalErrorException, "Can't create XML writer");
+    }
+
+    try
+    {
+        checkStream(schemas, set);
+        check(xmlTextWriterStartDocument(writer, NULL, NULL, NULL), "document");
+        check(xmlTextWriterStartElement(writer, BAD_CAST TAG_VMF), TAG_VMF);
+        writeAttribute(writer, ATTR_VMF_NEXTID, TYPE2STR(nextId));
+        writeAttribute(writer, ATTR_VMF_FILEPATH, filepath);
+        writeAttribute(writer, ATTR_VMF_CHECKSUM, checksum);
+        if (!segments.empty())
+            writeArray(writer, TAG_VIDEO_SEGMENTS_ARRAY, TAG_VIDEO_SEGMENT, segments, "Video segment pointer is null");
+        writeArray(writer, TAG_SCHEMAS_ARRAY, TAG_SCHEMA, schemas, "Schema pointer is null");
+        writeMetadataArray(writer, set, threads);
+        check(xmlTextWriterEndElement(writer), TAG_VMF);
+        check(xmlTextWriterEndDocument(writer), "document");
+        check(xmlTextWriterFlush(writer), "document");
+    }
+    catch(...)
+    {
+        xmlFreeTextWriter(writer);
+        throw;
+    }
+    xmlFreeTextWriter(writer);
+}
+
+static int writeOutput(void* context, const char* buffer, int len)
+{
+    std::ostream& output = *static_cast<std::ostream*>(context);
+    output.write(buffer, len);
+    return output ? len : -1;
+}
+
+static int closeOutput(void* /* context */)
+{
+    return 0;
+}
+
 XMLWriter::XMLWriter() {}
 XMLWriter::~XMLWriter() {}
 
@@ -332,20 +571,7 @@ std::string XMLWriter::store(const IdType& nextId,
     const std::vector<std::shared_ptr<MetadataSchema>>& schemas,
     const MetadataSet& set)
 {
-    if(schemas.empty())
-        VMF_EXCEPTION(vmf::IncorrectParamException, "Input schemas vector is empty");
-
-    std::for_each(set.begin(), set.end(), [&](const std::shared_ptr<Metadata>& spMetadata)
-    {
-        bool NoSchemaForMetadata = true;
-        std::for_each(schemas.begin(), schemas.end(), [&](const std::shared_ptr<MetadataSchema>& spSchema)
-        {
-            if(spMetadata->getSchemaName() == spSchema->getName())
-                NoSchemaForMetadata = false;
-        });
-        if(NoSchemaForMetadata)
-            VMF_EXCEPTION(vmf::IncorrectParamException, "MetadataSet item references unknown schema");
-    });
+    checkStream(schemas, set);
 
     xmlDocPtr doc = xmlNewDoc(NULL);
     xmlNodePtr vmfRootNode = xmlNewNode(NULL, BAD_CAST TAG_VMF);
@@ -486,4 +712,41 @@ std::string XMLWriter::store(const std::vector<std::shared_ptr<MetadataStream::V
     return outputString;
 }
 
+void XMLWriter::store(std::ostream& output, const IdType& nextId,
+    const std::string& filepath,
+    const std::string& checksum,
+    const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments,
+    const std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+    const MetadataSet& set)
+{
+    storeStream(xmlOutputBufferCreateIO(writeOutput, closeOutput, &output, NULL), nextId, filepath, checksum, segments, schemas, set);
+    if (!output)
+        VMF_EXCEPTION(vmf::InternalErrorException, "Can't write XML document to the output");
+}
+
+void XMLWriter::store(std::ostream& output, const IdType& nextId,
+    const std::string& filepath,
+    const std::string& checksum,
+    const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments,
+    const std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+    const MetadataSet& set,
+    unsigned int threads)
+{
+    storeStream(xmlOutputBufferCreateIO(writeOutput, closeOutput, &output, NULL), nextId, filepath, checksum, segments, schemas, set, threads);
+    if (!output)
+        VMF_EXCEPTION(vmf::InternalErrorException, "Can't write XML document to the output");
+}
+
+void XMLWriter::store(int fd, const IdType& nextId,
+    const std::string& filepath,
+    const std::string& checksum,
+    const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments,
+    const std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+    const MetadataSet& set)
+{
+    if (fd < 0)
+        VMF_EXCEPTION(vmf::IncorrectParamException, "Invalid file descriptor");
+    storeStream(xmlOutputBufferCreateFd(fd, NULL), nextId, filepath, checksum, segments, schemas, set);
+}
+
 }//vmf
@@ -0,0 +1,242 @@
+/*
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "test_precomp.hpp"
+#include <cstdio>
+#include <fstream>
+
+#define TEST_MAPPED_FILE "mapped_test.vmfmap"
+
+using namespace vmf;
+
+class TestMapped : public ::testing::Test
+{
+protected:
+    void SetUp()
+    {
+        spSchema = std::make_shared<MetadataSchema>("schema");
+        std::vector<FieldDesc> vFields;
+        vFields.push_back(FieldDesc("name", Variant::type_string));
+        vFields.push_back(FieldDesc("count", Variant::type_integer, true));
+        vFields.push_back(FieldDesc("score", Variant::type_real, true));
+        vFields.push_back(FieldDesc("point", Variant::type_vec2d, true));
+        vFields.push_back(FieldDesc("data", Variant::type_rawbuffer, true));
+        std::vector<std::shared_ptr<ReferenceDesc>> vRefs;
+        vRefs.push_back(std::make_shared<ReferenceDesc>("owner", true));
+        std::shared_ptr<MetadataDesc> spItemDesc = std::make_shared<MetadataDesc>("item", vFields, vRefs);
+        spSchema->add(spItemDesc);
+        std::vector<FieldDesc> vOwnerFields;
+        vOwnerFields.push_back(FieldDesc("name", Variant::type_string));
+        std::shared_ptr<MetadataDesc> spOwnerDesc = std::make_shared<MetadataDesc>("owner", vOwnerFields);
+        spSchema->add(spOwnerDesc);
+        stream.addSchema(spSchema);
+
+        std::shared_ptr<Metadata> owner = std::make_shared<Metadata>(spSchema->findMetadataDesc("owner"));
+        owner->setFieldValue("name", "Alice");
+        stream.add(owner);
+
+        for (int i = 0; i < 20; i++)
+        {
+            std::shared_ptr<Metadata> md = std::make_shared<Metadata>(spSchema->findMetadataDesc("item"));
+            md->setFieldValue("name", "item" + std::to_string(i % 5));
+            md->setFieldValue("count", (vmf_integer) i);
+            md->setFieldValue("score", i * 0.5);
+            md->setFieldValue("point", vmf_vec2d(i, -i));
+            md->setFieldValue("data", vmf_rawbuffer("\0\1\2", 3));
+            md->setFrameIndex(i * 10, 5);
+            md->setTimestamp(i * 1000, 500);
+            stream.add(md);
+            if (i % 3 == 0)
+                md->addReference(owner, "owner");
+        }
+
+        MappedMetadataStream::exportStream(stream, TEST_MAPPED_FILE);
+    }
+
+    void TearDown()
+    {
+        mapped.close();
+        std::remove(TEST_MAPPED_FILE);
+    }
+
+    static void compareSets(const MetadataSet& gold, const MetadataSet& test)
+    {
+        ASSERT_EQ(gold.size(), test.size());
+        for (size_t i = 0; i < gold.size(); i++)
+        {
+            ASSERT_EQ(gold[i]->getId(), test[i]->getId());
+            ASSERT_EQ(gold[i]->getName(), test[i]->getName());
+            ASSERT_EQ(gold[i]->getFrameIndex(), test[i]->getFrameIndex());
+            ASSERT_EQ(gold[i]->getTime(), test[i]->getTime());
+            for (auto& name : gold[i]->getFieldNames())
+                ASSERT_TRUE(gold[i]->getFieldValue(name) == test[i]->getFieldValue(name));
+            ASSERT_EQ(gold[i]->getAllReferences().size(), test[i]->getAllReferences().size());
+        }
+    }
+
+    std::shared_ptr<MetadataSchema> spSchema;
+    MetadataStream stream;
+    MappedMetadataStream mapped;
+};
+
+TEST_F(TestMapped, ItemViews)
+{
+    ASSERT_TRUE(mapped.open(TEST_MAPPED_FILE));
+    ASSERT_EQ(21u, mapped.size());
+
+    MappedMetadataItem item = mapped.getItem(0);
+    ASSERT_EQ("owner", item.getName());
+    ASSERT_EQ("schema", item.getSchemaName());
+    ASSERT_EQ("Alice", item.getFieldValue("name").get_string());
+
+    MappedMetadataItem found = mapped.getItem(0);
+    ASSERT_TRUE(mapped.findById(stream.queryByName("item")[3]->getId(), found));
+    ASSERT_EQ(3, found.getFieldValue("count").get_integer());
+    ASSERT_DOUBLE_EQ(1.5, found.getFieldValue("score").get_real());
+    ASSERT_EQ(vmf_vec2d(3, -3), found.getFieldValue("point").get_vec2d());
+    ASSERT_EQ(vmf_rawbuffer("\0\1\2", 3), found.getFieldValue("data").get_rawbuffer());
+    ASSERT_EQ(1u, found.getReferenceCount());
+    ASSERT_EQ(item.getId(), found.getReferenceId(0));
+    ASSERT_EQ("owner", found.getReferenceName(0));
+    ASSERT_TRUE(found.getFieldValue("missing").isEmpty());
+
+    ASSERT_FALSE(mapped.findById(1000, found));
+    ASSERT_EQ(4u, mapped.findByName("item").size() / 5);
+}
+
+TEST_F(TestMapped, Queries)
+{
+    ASSERT_TRUE(mapped.open(TEST_MAPPED_FILE));
+
+    compareSets(stream.getAll(), mapped.getAll());
+    compareSets(stream.queryByName("item"), mapped.queryByName("item"));
+    compareSets(stream.queryBySchema("schema"), mapped.queryBySchema("schema"));
+    compareSets(stream.queryByFrameIndex(42), mapped.queryByFrameIndex(42));
+    compareSets(stream.queryByFrameIndex(46), mapped.queryByFrameIndex(46));
+    compareSets(stream.getAll().queryByTime(2200, 5200), mapped.queryByTime(2200, 5200));
+    compareSets(stream.queryByNameAndValue("item", FieldValue("name", "item2")),
+                mapped.queryByNameAndValue("item", FieldValue("name", "item2")));
+    compareSets(stream.queryByReference("owner"), mapped.queryByReference("owner"));
+    compareSets(stream.queryByReference("owner", FieldValue("name", "Alice")),
+                mapped.queryByReference("owner", FieldValue("name", "Alice")));
+
+    auto filter = [](const std::shared_ptr<Metadata>& spItem)
+    {
+        return spItem->hasField("count") && spItem->getFieldValue("count").get_integer() > 15;
+    };
+    compareSets(stream.query(filter), mapped.query(filter));
+
+    ASSERT_EQ(0u, mapped.queryByName("unknown").size());
+    ASSERT_EQ(mapped.getById(1), mapped.getById(1));
+    ASSERT_EQ(1u, mapped.getAllSchemaNames().size());
+    ASSERT_TRUE(mapped.getSchema("schema") != nullptr);
+}
+
+TEST_F(TestMapped, MultiValuesAndReferenceChains)
+{
+    std::shared_ptr<MetadataSchema> spValues = std::make_shared<MetadataSchema>("values");
+    std::vector<std::shared_ptr<ReferenceDesc>> vRefs;
+    vRefs.push_back(std::make_shared<ReferenceDesc>("next", true));
+    std::shared_ptr<MetadataDesc> spList = std::make_shared<MetadataDesc>("list", std::vector<FieldDesc>(1, FieldDesc("", Variant::type_integer)), vRefs);
+    spValues->add(spList);
+    MetadataStream chain;
+    chain.addSchema(spValues);
+
+    // every item refers to the next one, the chain is longer than a recursion would handle
+    const int count = 100000;
+    std::shared_ptr<Metadata> next;
+    for (int i = count - 1; i >= 0; i--)
+    {
+        std::shared_ptr<Metadata> md = std::make_shared<Metadata>(spList);
+        md->addValue((vmf_integer) i);
+        md->addValue((vmf_integer) -i);
+        chain.add(md);
+        if (next)
+            md->addReference(next, "next");
+        next = md;
+    }
+    MappedMetadataStream::exportStream(chain, TEST_MAPPED_FILE);
+    ASSERT_TRUE(mapped.open(TEST_MAPPED_FILE));
+
+    std::shared_ptr<Metadata> md = mapped.getById(next->getId());
+    for (int i = 0; i < count; i++)
+    {
+        ASSERT_EQ(2u, md->size());
+        ASSERT_EQ(i, md->at(0).get_integer());
+        ASSERT_EQ(-i, md->at(1).get_integer());
+        std::shared_ptr<Metadata> spNext = md->getFirstReference("list");
+        ASSERT_EQ(i + 1 < count, spNext != nullptr);
+        md = spNext;
+    }
+}
+
+TEST_F(TestMapped, EmptyStream)
+{
+    MetadataStream empty;
+    MappedMetadataStream::exportStream(empty, TEST_MAPPED_FILE);
+    ASSERT_TRUE(mapped.open(TEST_MAPPED_FILE));
+    ASSERT_EQ(0u, mapped.size());
+    ASSERT_EQ(0u, mapped.queryByName("item").size());
+    ASSERT_EQ(0u, mapped.getAll().size());
+}
+
+TEST_F(TestMapped, InvalidFile)
+{
+    ASSERT_FALSE(mapped.open("missing_file.vmfmap"));
+
+    std::ofstream file(TEST_MAPPED_FILE, std::ios::binary | std::ios::trunc);
+    file << std::string(512, 'x');
+    file.close();
+    ASSERT_FALSE(mapped.open(TEST_MAPPED_FILE));
+    ASSERT_EQ(0u, mapped.size());
+}
+
+TEST_F(TestMapped, CorruptRecords)
+{
+    std::string original;
+    {
+        std::ifstream file(TEST_MAPPED_FILE, std::ios::binary);
+        original.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    auto readOffset = [&](size_t position)
+    {
+        uint64_t value;
+        memcpy(&value, original.data() + position, sizeof(value));
+        return (size_t) value;
+    };
+    // offsets of the header fields and of the item record fields written by exportStream()
+    const size_t itemCount = readOffset(16), itemsOffset = readOffset(40), frameIndexOffset = readOffset(80);
+    const size_t itemSize = 64, firstField = 48, fieldCount = 52, firstRef = 56;
+    auto openPatched = [&](size_t position, uint32_t value)
+    {
+        std::string data = original;
+        memcpy(&data[position], &value, sizeof(value));
+        std::ofstream file(TEST_MAPPED_FILE, std::ios::binary | std::ios::trunc);
+        file << data;
+        file.close();
+        return mapped.open(TEST_MAPPED_FILE);
+    };
+
+    size_t last = itemsOffset + (itemCount - 1) * itemSize;
+    ASSERT_FALSE(openPatched(last + fieldCount, 1000));
+    ASSERT_FALSE(openPatched(itemsOffset + firstField, UINT32_MAX));
+    ASSERT_FALSE(openPatched(last + firstRef, 1000));
+    ASSERT_FALSE(openPatched(frameIndexOffset, (uint32_t) itemCount));
+    ASSERT_EQ(0u, mapped.size());
+
+    ASSERT_TRUE(openPatched(frameIndexOffset, 0));
+    ASSERT_EQ(itemCount, mapped.size());
+}
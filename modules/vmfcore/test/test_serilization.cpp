@@ -16,11 +16,14 @@
  */
 #include "test_precomp.hpp"
 #include "fstream"
+#include "sstream"
+#include "cstdio"
 
 enum SerializerType
 {
     TypeXML = 0,
-    TypeJson = 1
+    TypeJson = 1,
+    TypeBinary = 2
 };
 
 using namespace vmf;
@@ -148,6 +151,26 @@ protected:
         }
     }
 
+    void createWriterAndReader()
+    {
+        SerializerType type = GetParam();
+        if (type == TypeXML)
+        {
+            writer.reset(new XMLWriter());
+            reader.reset(new XMLReader());
+        }
+        else if (type == TypeJson)
+        {
+            writer.reset(new JSONWriter());
+            reader.reset(new JSONReader());
+        }
+        else if (type == TypeBinary)
+        {
+            writer.reset(new BinaryWriter());
+            reader.reset(new BinaryReader());
+        }
+    }
+
     MetadataStream stream;
     MetadataSet set;
 
@@ -198,6 +221,11 @@ TEST_P(TestSerialization, Parse_schemasArray)
         writer.reset(new JSONWriter());
         reader.reset(new JSONReader());
     }
+    else if (type == TypeBinary)
+    {
+        writer.reset(new BinaryWriter());
+        reader.reset(new BinaryReader());
+    }
 
     std::vector<std::shared_ptr<MetadataSchema>> schemas;
     schemas.push_back(spSchemaPeople);
@@ -225,6 +253,11 @@ TEST_P(TestSerialization, Parse_schemasAll)
         writer.reset(new JSONWriter());
         reader.reset(new JSONReader());
     }
+    else if (type == TypeBinary)
+    {
+        writer.reset(new BinaryWriter());
+        reader.reset(new BinaryReader());
+    }
     std::vector<std::shared_ptr<MetadataSchema>> schemas;
     schemas.push_back(spSchemaPeople);
     schemas.push_back(spSchemaFrames);
@@ -251,6 +284,11 @@ TEST_P(TestSerialization, Parse_metadata)
         writer.reset(new JSONWriter());
         reader.reset(new JSONReader());
     }
+    else if (type == TypeBinary)
+    {
+        writer.reset(new BinaryWriter());
+        reader.reset(new BinaryReader());
+    }
 
     auto item = stream.getAll()[0];
     std::string result = writer->store(item);
@@ -279,6 +317,11 @@ TEST_P(TestSerialization, Parse_metadataArray)
         writer.reset(new JSONWriter());
         reader.reset(new JSONReader());
     }
+    else if (type == TypeBinary)
+    {
+        writer.reset(new BinaryWriter());
+        reader.reset(new BinaryReader());
+    }
 
     std::string result = writer->store(set);
 
@@ -315,6 +358,11 @@ TEST_P(TestSerialization, Parse_metadataAll)
         writer.reset(new JSONWriter());
         reader.reset(new JSONReader());
     }
+    else if (type == TypeBinary)
+    {
+        writer.reset(new BinaryWriter());
+        reader.reset(new BinaryReader());
+    }
 
     std::vector<std::shared_ptr<MetadataSchema>> schemas;
     schemas.push_back(spSchemaPeople);
@@ -351,6 +399,11 @@ TEST_P(TestSerialization, Parse_All)
         writer.reset(new JSONWriter());
         reader.reset(new JSONReader());
     }
+    else if (type == TypeBinary)
+    {
+        writer.reset(new BinaryWriter());
+        reader.reset(new BinaryReader());
+    }
 
     std::vector<std::shared_ptr<MetadataSchema>> schemas;
     schemas.push_back(spSchemaPeople);
@@ -371,4 +424,776 @@ TEST_P(TestSerialization, Parse_All)
     });
 }
 
-INSTANTIATE_TEST_CASE_P(UnitTest, TestSerialization, ::testing::Values(TypeXML, TypeJson) );
+TEST_P(TestSerialization, SerializeStreamAndChunks)
+{
+    createWriterAndReader();
+
+    std::string result = stream.serialize(*writer);
+
+    std::ostringstream output;
+    stream.serialize(output, *writer);
+    ASSERT_EQ(result, output.str());
+
+    std::string chunks;
+    size_t count = 0;
+    stream.serialize([&](const char* data, size_t size) { chunks.append(data, size); count++; }, *writer);
+    ASSERT_EQ(result, chunks);
+    ASSERT_LT(0u, count);
+
+    ASSERT_THROW(stream.serialize([](const char*, size_t) { throw std::runtime_error("sink"); }, *writer), std::runtime_error);
+
+    std::istringstream input(result);
+    MetadataStream testStream;
+    ASSERT_NO_THROW(testStream.deserialize(input, *reader));
+    ASSERT_EQ(set.size(), testStream.getAll().size());
+
+    // small chunks split names and values
+    size_t pos = 0;
+    MetadataStream chunkStream;
+    ASSERT_NO_THROW(chunkStream.deserialize([&](char* buffer, size_t size) -> size_t
+    {
+        size = std::min(std::min(size, (size_t) 7), result.size() - pos);
+        memcpy(buffer, result.data() + pos, size);
+        pos += size;
+        return size;
+    }, *reader));
+
+    ASSERT_EQ(2u, chunkStream.getAllSchemaNames().size());
+    compareSchemas(spSchemaPeople, chunkStream.getSchema(n_schemaPeople));
+    compareSchemas(spSchemaFrames, chunkStream.getSchema(n_schemaFrames));
+    ASSERT_EQ(set.size(), chunkStream.getAll().size());
+    std::for_each(set.begin(), set.end(), [&] (const std::shared_ptr<Metadata>& spItem)
+    {
+        compareMetadata(spItem, chunkStream.getById(spItem->getId()) );
+    });
+
+    MetadataStream failed;
+    ASSERT_THROW(failed.deserialize([](char*, size_t) -> size_t { throw std::runtime_error("source"); }, *reader), std::runtime_error);
+}
+
+TEST_P(TestSerialization, SerializeOnSeveralThreads)
+{
+    createWriterAndReader();
+
+    // enough items for several chunks of uneven size
+    std::shared_ptr<Metadata> previous = set[0];
+    for(int i = 0; i < 5000; i++)
+    {
+        std::shared_ptr<Metadata> md(new Metadata(spDescPeople));
+        md->setFieldValue("name", "Person \"" + std::to_string(i) + "\" <caf\xc3\xa9>");
+        if(i % 3)
+            md->setFieldValue("address", "street/" + std::to_string(i));
+        md->setTimestamp(getTimestamp() + i);
+        stream.add(md);
+        md->addReference(previous, "colleague");
+        previous = md;
+    }
+
+    std::string sequential = stream.serialize(*writer);
+    ASSERT_EQ(sequential, stream.serialize(*writer, 4));
+    ASSERT_EQ(sequential, stream.serialize(*writer, 0));
+    ASSERT_EQ(sequential, stream.serialize(*writer, 1));
+
+    std::ostringstream output;
+    stream.serialize(output, *writer, 3);
+    ASSERT_EQ(sequential, output.str());
+
+    MetadataStream empty;
+    empty.addSchema(spSchemaPeople);
+    ASSERT_EQ(empty.serialize(*writer), empty.serialize(*writer, 4));
+
+    // an item that can't be formatted fails the whole call
+    MetadataSet broken = stream.getAll();
+    broken[broken.size() / 2] = nullptr;
+    std::vector<std::shared_ptr<MetadataSchema>> schemas(1, spSchemaPeople);
+    schemas.push_back(spSchemaFrames);
+    std::ostringstream failed;
+    ASSERT_THROW(writer->store(failed, 0, "", "", std::vector<std::shared_ptr<MetadataStream::VideoSegment>>(), schemas, broken, 4), IncorrectParamException);
+}
+
+// Implements only the text methods of the interfaces, as the readers and writers written before the streaming ones
+class TextOnlyReader : public IReader
+{
+public:
+    explicit TextOnlyReader(IReader& reader) : reader(reader) {}
+
+    virtual bool parseAll(const std::string& text, IdType& nextId, std::string& filepath, std::string& checksum,
+                          std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments,
+                          std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+                          std::vector<std::shared_ptr<MetadataInternal>>& metadata)
+    {
+        return reader.parseAll(text, nextId, filepath, checksum, segments, schemas, metadata);
+    }
+
+    virtual bool parseSchemas(const std::string& text, std::vector<std::shared_ptr<MetadataSchema>>& schemas)
+    {
+        return reader.parseSchemas(text, schemas);
+    }
+
+    virtual bool parseMetadata(const std::string& text, const std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+                               std::vector<std::shared_ptr<MetadataInternal>>& metadata)
+    {
+        return reader.parseMetadata(text, schemas, metadata);
+    }
+
+    virtual bool parseVideoSegments(const std::string& text, std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments)
+    {
+        return reader.parseVideoSegments(text, segments);
+    }
+
+private:
+    IReader& reader;
+};
+
+class TextOnlyWriter : public IWriter
+{
+public:
+    explicit TextOnlyWriter(IWriter& writer) : writer(writer) {}
+
+    virtual std::string store(const std::vector<std::shared_ptr<MetadataSchema>>& schemas)
+    {
+        return writer.store(schemas);
+    }
+
+    virtual std::string store(const MetadataSet& set)
+    {
+        return writer.store(set);
+    }
+
+    virtual std::string store(const IdType& nextId, const std::string& filepath, const std::string& checksum,
+                              const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments,
+                              const std::vector<std::shared_ptr<MetadataSchema>>& schemas,
+                              const MetadataSet& set)
+    {
+        return writer.store(nextId, filepath, checksum, segments, schemas, set);
+    }
+
+    virtual std::string store(const std::shared_ptr<MetadataStream::VideoSegment>& spSegment)
+    {
+        return writer.store(spSegment);
+    }
+
+    virtual std::string store(const std::vector<std::shared_ptr<MetadataStream::VideoSegment>>& segments)
+    {
+        return writer.store(segments);
+    }
+
+private:
+    IWriter& writer;
+};
+
+TEST_P(TestSerialization, TextOnlyReaderAndWriter)
+{
+    createWriterAndReader();
+    TextOnlyWriter textWriter(*writer);
+    TextOnlyReader textReader(*reader);
+    std::string text = stream.serialize(*writer);
+
+    std::ostringstream output;
+    stream.serialize(output, textWriter);
+    ASSERT_EQ(text, output.str());
+    std::string chunks;
+    stream.serialize([&](const char* data, size_t size) { chunks.append(data, size); }, textWriter);
+    ASSERT_EQ(text, chunks);
+
+    std::istringstream input(text);
+    MetadataStream testStream;
+    testStream.deserialize(input, textReader);
+    ASSERT_EQ(text, testStream.serialize(*writer));
+}
+
+TEST_P(TestSerialization, MalformedInputThrows)
+{
+    createWriterAndReader();
+    std::string text = "<garbage";
+
+    MetadataStream fromText;
+    ASSERT_THROW(fromText.deserialize(text, *reader), IncorrectParamException);
+    ASSERT_TRUE(fromText.getAll().empty());
+
+    std::istringstream input(text);
+    MetadataStream fromInput;
+    ASSERT_THROW(fromInput.deserialize(input, *reader), IncorrectParamException);
+
+    size_t pos = 0;
+    MetadataStream fromChunks;
+    ASSERT_THROW(fromChunks.deserialize([&](char* buffer, size_t size) -> size_t
+    {
+        size = std::min(size, text.size() - pos);
+        memcpy(buffer, text.data() + pos, size);
+        pos += size;
+        return size;
+    }, *reader), IncorrectParamException);
+}
+
+INSTANTIATE_TEST_CASE_P(UnitTest, TestSerialization, ::testing::Values(TypeXML, TypeJson, TypeBinary) );
+
+class TestXMLStreaming : public TestSerialization
+{
+protected:
+    void compareStreams(MetadataStream& testStream)
+    {
+        ASSERT_EQ(2u, testStream.getAllSchemaNames().size());
+        compareSchemas(spSchemaPeople, testStream.getSchema(n_schemaPeople));
+        compareSchemas(spSchemaFrames, testStream.getSchema(n_schemaFrames));
+
+        ASSERT_EQ(set.size(), testStream.getAll().size());
+        std::for_each(set.begin(), set.end(), [&] (const std::shared_ptr<Metadata>& spItem)
+        {
+            compareMetadata(spItem, testStream.getById(spItem->getId()) );
+        });
+        ASSERT_EQ(stream.getChecksum(), testStream.getChecksum());
+    }
+};
+
+TEST_F(TestXMLStreaming, ParseStream)
+{
+    stream.setChecksum("0123456789abcdef0123456789abcdef");
+    XMLWriter writer;
+    std::istringstream input(stream.serialize(writer));
+
+    MetadataStream testStream;
+    ASSERT_TRUE(XMLReader().parseStream(input, testStream));
+    compareStreams(testStream);
+
+    // new items don't reuse ids of parsed ones
+    std::shared_ptr<Metadata> md(new Metadata(testStream.getSchema(n_schemaPeople)->findMetadataDesc("person")));
+    md->setFieldValue("name", "NewPersonName");
+    IdType id = testStream.add(md);
+    std::for_each(set.begin(), set.end(), [&] (const std::shared_ptr<Metadata>& spItem)
+    {
+        ASSERT_NE(spItem->getId(), id);
+    });
+}
+
+TEST_F(TestXMLStreaming, ParseFile)
+{
+    XMLWriter writer;
+    std::string fileName = "streaming_test.xml";
+    {
+        std::ofstream output(fileName.c_str(), std::ios::out | std::ios::binary);
+        output << stream.serialize(writer);
+    }
+
+    MetadataStream testStream;
+    ASSERT_TRUE(XMLReader().parseFile(fileName, testStream));
+    compareStreams(testStream);
+    std::remove(fileName.c_str());
+
+    MetadataStream missing;
+    ASSERT_FALSE(XMLReader().parseFile(fileName, missing));
+}
+
+TEST_F(TestXMLStreaming, ParsedItemsAreKeptOnError)
+{
+    XMLWriter writer;
+    std::string text = stream.serialize(writer);
+    // the document is cut in the middle of the last item
+    std::istringstream input(text.substr(0, text.rfind("<metadata ") + 20));
+
+    MetadataStream testStream;
+    ASSERT_FALSE(XMLReader().parseStream(input, testStream));
+    ASSERT_EQ(2u, testStream.getAllSchemaNames().size());
+    ASSERT_FALSE(testStream.getAll().empty());
+    ASSERT_LT(testStream.getAll().size(), set.size());
+}
+
+TEST_F(TestXMLStreaming, WriteStreamMatchesStore)
+{
+    set[0]->setFieldValue("address", "<\"Quoted\" & 'escaped'>\n\tstreet");
+    std::shared_ptr<MetadataStream::VideoSegment> segment(new MetadataStream::VideoSegment("segment", 25, 0, 1000, 640, 480));
+    stream.addVideoSegment(segment);
+    stream.setChecksum("0123456789abcdef0123456789abcdef");
+
+    std::vector<std::shared_ptr<MetadataSchema>> schemas;
+    schemas.push_back(spSchemaFrames);
+    schemas.push_back(spSchemaPeople);
+    XMLWriter writer;
+    std::string text = writer.store(123, "file.avi", stream.getChecksum(), stream.getAllVideoSegments(), schemas, stream.getAll());
+
+    std::ostringstream output;
+    writer.store(output, 123, "file.avi", stream.getChecksum(), stream.getAllVideoSegments(), schemas, stream.getAll());
+    ASSERT_EQ(text, output.str());
+
+    std::string fileName = "streaming_test.xml";
+    FILE* file = fopen(fileName.c_str(), "wb");
+    ASSERT_TRUE(file != NULL);
+    writer.store(fileno(file), 123, "file.avi", stream.getChecksum(), stream.getAllVideoSegments(), schemas, stream.getAll());
+    fclose(file);
+
+    MetadataStream testStream;
+    ASSERT_TRUE(XMLReader().parseFile(fileName, testStream));
+    std::remove(fileName.c_str());
+    compareStreams(testStream);
+    ASSERT_EQ(1u, testStream.getAllVideoSegments().size());
+}
+
+// shares the stream comparison with the XML tests
+class TestJSONStreaming : public TestXMLStreaming
+{
+};
+
+TEST_F(TestJSONStreaming, ParseStream)
+{
+    stream.setChecksum("0123456789abcdef0123456789abcdef");
+    JSONWriter writer;
+    std::istringstream input(stream.serialize(writer));
+
+    MetadataStream testStream;
+    ASSERT_TRUE(JSONReader().parseStream(input, testStream));
+    compareStreams(testStream);
+
+    // new items don't reuse ids of parsed ones
+    std::shared_ptr<Metadata> md(new Metadata(testStream.getSchema(n_schemaPeople)->findMetadataDesc("person")));
+    md->setFieldValue("name", "NewPersonName");
+    IdType id = testStream.add(md);
+    std::for_each(set.begin(), set.end(), [&] (const std::shared_ptr<Metadata>& spItem)
+    {
+        ASSERT_NE(spItem->getId(), id);
+    });
+}
+
+TEST_F(TestJSONStreaming, ParseFile)
+{
+    JSONWriter writer;
+    std::string fileName = "streaming_test.json";
+    {
+        std::ofstream output(fileName.c_str(), std::ios::out | std::ios::binary);
+        output << stream.serialize(writer);
+    }
+
+    MetadataStream testStream;
+    ASSERT_TRUE(JSONReader().parseFile(fileName, testStream));
+    compareStreams(testStream);
+    std::remove(fileName.c_str());
+
+    MetadataStream missing;
+    ASSERT_FALSE(JSONReader().parseFile(fileName, missing));
+}
+
+TEST_F(TestJSONStreaming, ParseCompactText)
+{
+    // members are accepted in any order and unknown ones are skipped
+    std::string text =
+        "{\"vmf\":{\"unknown\":[{\"a\":[1,2]},null],\"schemas-array\":[{\"descriptions-array\":[{\"references-array\":[],"
+        "\"fields-array\":[{\"type\":\"string\",\"name\":\"name\"}],\"name\":\"person\"}],\"name\":\"people\"}],"
+        "\"metadata-array\":[{\"fields-array\":[{\"value\":\"caf\\u00C3\\u00A9 \\\"\\/\\u00e9\",\"name\":\"name\"}],"
+        "\"timestamp-hi\":1,\"timestamp-lo\":2,\"id\":7,\"description\":\"person\",\"schema\":\"people\"}],\"nextId\":10}}";
+    std::istringstream input(text);
+
+    MetadataStream testStream;
+    ASSERT_TRUE(JSONReader().parseStream(input, testStream));
+    ASSERT_EQ(1u, testStream.getAll().size());
+    std::shared_ptr<Metadata> md = testStream.getById(7);
+    ASSERT_EQ("caf\xc3\xa9 \"/\xe9", md->getFieldValue("name").get_string());
+    ASSERT_EQ((1ll << 32) | 2, md->getTime());
+}
+
+TEST_F(TestJSONStreaming, SurrogatePairs)
+{
+    auto parse = [](const std::string& value, MetadataStream& testStream)
+    {
+        std::istringstream input(
+            "{\"vmf\":{\"schemas-array\":[{\"descriptions-array\":[{\"references-array\":[],"
+            "\"fields-array\":[{\"type\":\"string\",\"name\":\"name\"}],\"name\":\"person\"}],\"name\":\"people\"}],"
+            "\"metadata-array\":[{\"fields-array\":[{\"value\":\"" + value + "\",\"name\":\"name\"}],"
+            "\"id\":7,\"description\":\"person\",\"schema\":\"people\"}],\"nextId\":10}}");
+        return JSONReader().parseStream(input, testStream);
+    };
+
+    MetadataStream testStream;
+    ASSERT_TRUE(parse("\\ud83d\\ude00", testStream));
+    ASSERT_EQ("\xf0\x9f\x98\x80", testStream.getById(7)->getFieldValue("name").get_string());
+
+    const char* invalid[] = { "\\ud83d\\u0041", "\\ud83d\\ud83d", "\\ude00", "\\ud83dx" };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+    {
+        MetadataStream invalidStream;
+        ASSERT_FALSE(parse(invalid[i], invalidStream)) << invalid[i];
+    }
+}
+
+TEST_F(TestJSONStreaming, DeepUnknownMembersAreSkipped)
+{
+    const size_t depth = 1000000;
+    std::string text = "{\"vmf\":{\"unknown\":" + std::string(depth, '[') + std::string(depth, ']') + ",\"nextId\":10}}";
+    std::istringstream input(text);
+
+    MetadataStream testStream;
+    ASSERT_TRUE(JSONReader().parseStream(input, testStream));
+}
+
+TEST_F(TestJSONStreaming, MismatchedTypesAreRejected)
+{
+    const char* texts[] =
+    {
+        "{\"vmf\":{\"nextId\":\"10\"}}",
+        "{\"vmf\":{\"filepath\":10}}",
+        "{\"vmf\":{\"unknown\":nothing}}",
+        "{\"vmf\":{\"schemas-array\":[{\"descriptions-array\":[],\"name\":true}]}}"
+    };
+    for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); i++)
+    {
+        std::istringstream input(texts[i]);
+        MetadataStream testStream;
+        ASSERT_FALSE(JSONReader().parseStream(input, testStream)) << texts[i];
+    }
+}
+
+TEST_F(TestJSONStreaming, ParsedItemsAreKeptOnError)
+{
+    JSONWriter writer;
+    std::string text = stream.serialize(writer);
+    // the document is cut in the middle of the last item
+    std::istringstream input(text.substr(0, text.rfind("\"schema\" : ") + 20));
+
+    MetadataStream testStream;
+    ASSERT_FALSE(JSONReader().parseStream(input, testStream));
+    ASSERT_EQ(2u, testStream.getAllSchemaNames().size());
+    ASSERT_EQ(set.size() - 1, testStream.getAll().size());
+}
+
+TEST_F(TestJSONStreaming, WriteStreamMatchesStore)
+{
+    set[0]->setFieldValue("address", "<\"Quoted\" & 'escaped'>\n\tstreet/caf\xc3\xa9");
+    set[0]->setTimestamp(5ll << 40, 100);
+    std::shared_ptr<MetadataStream::VideoSegment> segment(new MetadataStream::VideoSegment("segment", 29.97, 0, 1000, 640, 480));
+    stream.addVideoSegment(segment);
+    stream.addVideoSegment(std::make_shared<MetadataStream::VideoSegment>("segment2", 25, 1000));
+    stream.setChecksum("0123456789abcdef0123456789abcdef");
+
+    std::vector<std::shared_ptr<MetadataSchema>> schemas;
+    schemas.push_back(spSchemaFrames);
+    schemas.push_back(spSchemaPeople);
+    JSONWriter writer;
+    std::string text = writer.store(123, "file.avi", stream.getChecksum(), stream.getAllVideoSegments(), schemas, stream.getAll());
+
+    std::ostringstream output;
+    writer.store(output, 123, "file.avi", stream.getChecksum(), stream.getAllVideoSegments(), schemas, stream.getAll());
+    ASSERT_EQ(text, output.str());
+
+    MetadataStream testStream;
+    std::istringstream input(output.str());
+    ASSERT_TRUE(JSONReader().parseStream(input, testStream));
+    compareStreams(testStream);
+    ASSERT_EQ(2u, testStream.getAllVideoSegments().size());
+    ASSERT_DOUBLE_EQ(29.97, testStream.getAllVideoSegments()[0]->getFPS());
+}
+
+class TestBinaryStreaming : public TestXMLStreaming
+{
+};
+
+TEST_F(TestBinaryStreaming, ParseStream)
+{
+    stream.setChecksum("0123456789abcdef0123456789abcdef");
+    BinaryWriter writer;
+    std::istringstream input(stream.serialize(writer));
+
+    MetadataStream testStream;
+    ASSERT_TRUE(BinaryReader().parseStream(input, testStream));
+    compareStreams(testStream);
+
+    // new items don't reuse ids of parsed ones
+    std::shared_ptr<Metadata> md(new Metadata(testStream.getSchema(n_schemaPeople)->findMetadataDesc("person")));
+    md->setFieldValue("name", "NewPersonName");
+    IdType id = testStream.add(md);
+    std::for_each(set.begin(), set.end(), [&] (const std::shared_ptr<Metadata>& spItem)
+    {
+        ASSERT_NE(spItem->getId(), id);
+    });
+}
+
+TEST_F(TestBinaryStreaming, AllFieldTypes)
+{
+    std::shared_ptr<MetadataSchema> spSchema = std::make_shared<MetadataSchema>("types", "author");
+    std::vector<FieldDesc> vFields;
+    for(int type = Variant::type_integer; type <= Variant::type_vec4d_vector; type++)
+        vFields.push_back(FieldDesc(Variant::typeToString((Variant::Type) type), (Variant::Type) type, true));
+    std::shared_ptr<MetadataDesc> spDesc = std::make_shared<MetadataDesc>("all", vFields);
+    spSchema->add(spDesc);
+    stream.addSchema(spSchema);
+
+    std::shared_ptr<Metadata> md(new Metadata(spDesc));
+    md->setFieldValue("integer", (vmf_integer) -1234567890123ll);
+    md->setFieldValue("real", -0.1);
+    md->setFieldValue("string", std::string("text\0with zero", 14));
+    md->setFieldValue("vec2d", vmf_vec2d(1, 2));
+    md->setFieldValue("vec3d", vmf_vec3d(1, 2, 3));
+    md->setFieldValue("vec4d", vmf_vec4d(1, 2, 3, 4.5));
+    md->setFieldValue("rawbuffer", vmf_rawbuffer("\x00\xff\x80", 3));
+    md->setFieldValue("integer[]", std::vector<vmf_integer>{0, -1, 1ll << 62});
+    md->setFieldValue("real[]", std::vector<vmf_real>{1e300, -1e-300});
+    md->setFieldValue("string[]", std::vector<vmf_string>{"", "a"});
+    md->setFieldValue("vec2d[]", std::vector<vmf_vec2d>{vmf_vec2d(1, 2), vmf_vec2d()});
+    md->setFieldValue("vec3d[]", std::vector<vmf_vec3d>{vmf_vec3d(1, 2, 3)});
+    md->setFieldValue("vec4d[]", std::vector<vmf_vec4d>{vmf_vec4d(1, 2, 3, 4), vmf_vec4d(-1, -2, -3, -4)});
+    md->setTimestamp(1ll << 40, 100);
+    md->setFrameIndex(5, 2);
+    stream.add(md);
+    md->addReference(set[0]);
+
+    BinaryWriter writer;
+    std::string result = stream.serialize(writer);
+
+    BinaryReader reader;
+    MetadataStream testStream;
+    testStream.deserialize(result, reader);
+    ASSERT_EQ(set.size() + 1, testStream.getAll().size());
+    compareSchemas(spSchema, testStream.getSchema("types"));
+    compareMetadata(md, testStream.getById(md->getId()));
+}
+
+TEST_F(TestBinaryStreaming, ParsedItemsAreKeptOnError)
+{
+    BinaryWriter writer;
+    std::string text = stream.serialize(writer);
+    // the data is cut in the middle of the last item
+    std::istringstream input(text.substr(0, text.size() - 3));
+
+    MetadataStream testStream;
+    ASSERT_FALSE(BinaryReader().parseStream(input, testStream));
+    ASSERT_EQ(2u, testStream.getAllSchemaNames().size());
+    ASSERT_EQ(set.size() - 1, testStream.getAll().size());
+
+    XMLWriter xmlWriter;
+    std::vector<std::shared_ptr<MetadataInternal>> metadata;
+    ASSERT_FALSE(BinaryReader().parseMetadata(stream.serialize(xmlWriter), std::vector<std::shared_ptr<MetadataSchema>>(), metadata));
+}
+
+TEST_F(TestBinaryStreaming, WriteStreamMatchesStore)
+{
+    set[0]->setFieldValue("address", "<\"Quoted\" & 'escaped'>\n\tstreet/caf\xc3\xa9");
+    std::shared_ptr<MetadataStream::VideoSegment> segment(new MetadataStream::VideoSegment("segment", 29.97, 0, 1000, 640, 480));
+    stream.addVideoSegment(segment);
+    stream.setChecksum("0123456789abcdef0123456789abcdef");
+
+    std::vector<std::shared_ptr<MetadataSchema>> schemas;
+    schemas.push_back(spSchemaFrames);
+    schemas.push_back(spSchemaPeople);
+    BinaryWriter writer;
+    std::string text = writer.store(123, "file.avi", stream.getChecksum(), stream.getAllVideoSegments(), schemas, stream.getAll());
+
+    std::ostringstream output;
+    writer.store(output, 123, "file.avi", stream.getChecksum(), stream.getAllVideoSegments(), schemas, stream.getAll());
+    ASSERT_EQ(text, output.str());
+    ASSERT_LT(text.size(), JSONWriter().store(123, "file.avi", stream.getChecksum(), stream.getAllVideoSegments(), schemas, stream.getAll()).size() / 4);
+
+    MetadataStream testStream;
+    std::istringstream input(output.str());
+    ASSERT_TRUE(BinaryReader().parseStream(input, testStream));
+    compareStreams(testStream);
+    ASSERT_EQ(1u, testStream.getAllVideoSegments().size());
+    ASSERT_DOUBLE_EQ(29.97, testStream.getAllVideoSegments()[0]->getFPS());
+    long width, height;
+    testStream.getAllVideoSegments()[0]->getResolution(width, height);
+    ASSERT_EQ(640, width);
+    ASSERT_EQ(480, height);
+}
+
+class TestBulkAdd : public TestXMLStreaming
+{
+protected:
+    std::shared_ptr<MetadataInternal> createPerson(IdType id, const std::vector<IdType>& colleagues)
+    {
+        std::shared_ptr<MetadataInternal> md(new MetadataInternal(spDescPeople));
+        md->setId(id);
+        md->setFieldValue("name", "Person" + std::to_string(id));
+        for(auto colleague = colleagues.begin(); colleague != colleagues.end(); colleague++)
+            md->vRefs.push_back(std::make_pair(*colleague, std::string("colleague")));
+        return md;
+    }
+
+    static bool refersTo(const std::shared_ptr<Metadata>& md, IdType id)
+    {
+        auto refs = md->getAllReferences();
+        return std::any_of(refs.begin(), refs.end(), [&](Reference& ref) { return ref.getReferenceMetadata().lock()->getId() == id; });
+    }
+};
+
+TEST_F(TestBulkAdd, WiresReferencesInAnyOrder)
+{
+    MetadataStream testStream;
+    testStream.addSchema(spSchemaPeople);
+
+    // 100 refers to the later 101 and to 200 that is added by the next call
+    std::vector<std::shared_ptr<MetadataInternal>> items;
+    items.push_back(createPerson(100, std::vector<IdType>(1, 101)));
+    items.push_back(createPerson(101, std::vector<IdType>(1, 100)));
+    items.back()->vRefs.push_back(std::make_pair(IdType(200), std::string("colleague")));
+    testStream.add(items);
+    ASSERT_EQ(2u, testStream.getAll().size());
+    ASSERT_TRUE(refersTo(testStream.getById(100), 101));
+    ASSERT_TRUE(refersTo(testStream.getById(101), 100));
+    ASSERT_EQ(1u, testStream.getById(101)->getAllReferences().size());
+
+    std::vector<std::shared_ptr<MetadataInternal>> more;
+    more.push_back(createPerson(200, std::vector<IdType>()));
+    more.push_back(createPerson(INVALID_ID, std::vector<IdType>(1, 200)));
+    testStream.add(more);
+    ASSERT_TRUE(refersTo(testStream.getById(101), 200));
+    ASSERT_EQ(201u, more[1]->getId());
+    ASSERT_TRUE(refersTo(testStream.getById(201), 200));
+
+    std::shared_ptr<Metadata> md(new Metadata(spDescPeople));
+    md->setFieldValue("name", "NewPersonName");
+    ASSERT_EQ(202u, testStream.add(md));
+}
+
+TEST_F(TestBulkAdd, ItemsBeforeInvalidOneAreKept)
+{
+    MetadataStream testStream;
+    testStream.addSchema(spSchemaPeople);
+
+    std::vector<std::shared_ptr<MetadataInternal>> items;
+    items.push_back(createPerson(1, std::vector<IdType>(1, 2)));
+    items.push_back(createPerson(2, std::vector<IdType>(1, 1)));
+    items.push_back(createPerson(1, std::vector<IdType>()));
+    items.push_back(createPerson(3, std::vector<IdType>()));
+    ASSERT_THROW(testStream.add(items), IncorrectParamException);
+    ASSERT_EQ(2u, testStream.getAll().size());
+    ASSERT_TRUE(refersTo(testStream.getById(1), 2));
+    ASSERT_TRUE(refersTo(testStream.getById(2), 1));
+    ASSERT_TRUE(testStream.getById(3) == nullptr);
+
+    std::vector<std::shared_ptr<MetadataInternal>> unknown;
+    unknown.push_back(std::make_shared<MetadataInternal>(spDescFrames));
+    unknown.back()->setFieldValue("frameIdx", 1);
+    ASSERT_THROW(testStream.add(unknown), NotFoundException);
+    ASSERT_EQ(2u, testStream.getAll().size());
+}
+
+TEST_F(TestBulkAdd, DeserializeLargeStream)
+{
+    // every item refers to the previous one, more items than a batch of the streaming readers
+    std::shared_ptr<Metadata> previous = set.back();
+    for(int i = 0; i < 5000; i++)
+    {
+        std::shared_ptr<Metadata> md(new Metadata(spDescPeople));
+        md->setFieldValue("name", "Person" + std::to_string(i));
+        stream.add(md);
+        md->addReference(previous, "colleague");
+        previous = md;
+    }
+
+    JSONWriter writer;
+    std::string text = stream.serialize(writer);
+    MetadataStream fromText;
+    JSONReader reader;
+    fromText.deserialize(text, reader);
+    std::istringstream input(text);
+    MetadataStream fromInput;
+    ASSERT_NO_THROW(fromInput.deserialize(input, reader));
+
+    MetadataStream* loaded[] = { &fromText, &fromInput };
+    for(auto testStream : loaded)
+    {
+        ASSERT_EQ(stream.getAll().size(), testStream->getAll().size());
+        ASSERT_EQ(text, testStream->serialize(writer));
+    }
+}
+
+class TestReadFilter : public TestSerialization
+{
+protected:
+    // Parses the serialized stream from the text and by the streaming reader, passes both results to the check
+    template <typename Check>
+    void parseFiltered(const ReadFilter& filter, Check check)
+    {
+        createWriterAndReader();
+        std::string text = stream.serialize(*writer);
+        reader->setFilter(filter);
+
+        MetadataStream fromText;
+        fromText.deserialize(text, *reader);
+        check(fromText);
+
+        std::istringstream input(text);
+        MetadataStream fromInput;
+        ASSERT_NO_THROW(fromInput.deserialize(input, *reader));
+        check(fromInput);
+    }
+};
+
+TEST_P(TestReadFilter, EmptyFilterKeepsAll)
+{
+    parseFiltered(ReadFilter(), [&](MetadataStream& testStream)
+    {
+        ASSERT_EQ(2u, testStream.getAllSchemaNames().size());
+        ASSERT_EQ(set.size(), testStream.getAll().size());
+        std::for_each(set.begin(), set.end(), [&] (const std::shared_ptr<Metadata>& spItem)
+        {
+            compareMetadata(spItem, testStream.getById(spItem->getId()));
+        });
+    });
+}
+
+TEST_P(TestReadFilter, SchemaAndFrameWindow)
+{
+    // frames 2, 3 and 4 overlap the window, references to the skipped person aren't wired
+    ReadFilter filter;
+    filter.addSchema(n_schemaFrames);
+    filter.setFrameWindow(2LL << 33, 3LL << 33);
+    parseFiltered(filter, [&](MetadataStream& testStream)
+    {
+        ASSERT_EQ(1u, testStream.getAllSchemaNames().size());
+        compareSchemas(spSchemaFrames, testStream.getSchema(n_schemaFrames));
+        ASSERT_EQ(3u, testStream.getAll().size());
+        for (long long i = 2; i <= 4; i++)
+        {
+            MetadataSet items = testStream.queryByFrameIndex(i << 33);
+            ASSERT_EQ(1u, items.size());
+            compareMetadata(set.queryByFrameIndex(i << 33)[0], items[0], false);
+            ASSERT_TRUE(items[0]->getAllReferences().empty());
+        }
+    });
+}
+
+TEST_P(TestReadFilter, DescriptionAndTimeWindow)
+{
+    std::shared_ptr<Metadata> person = stream.queryByName("person")[0];
+    ReadFilter filter;
+    filter.addDescription(n_schemaPeople, "person");
+    filter.setTimeWindow(person->getTime(), person->getTime());
+    parseFiltered(filter, [&](MetadataStream& testStream)
+    {
+        ASSERT_EQ(1u, testStream.getAllSchemaNames().size());
+        ASSERT_EQ(1u, testStream.getAll().size());
+        compareMetadata(person, testStream.getById(person->getId()), false);
+    });
+
+    filter.setTimeWindow(person->getTime() + 1, person->getTime() + 1000);
+    parseFiltered(filter, [&](MetadataStream& testStream)
+    {
+        ASSERT_EQ(1u, testStream.getAllSchemaNames().size());
+        ASSERT_TRUE(testStream.getAll().empty());
+    });
+}
+
+INSTANTIATE_TEST_CASE_P(UnitTest, TestReadFilter, ::testing::Values(TypeXML, TypeJson, TypeBinary) );
+
+TEST(ReadFilter, AcceptsItems)
+{
+    ReadFilter filter;
+    ASSERT_TRUE(filter.isEmpty());
+    ASSERT_TRUE(filter.acceptsDescription("schema", "desc"));
+    ASSERT_TRUE(filter.acceptsPosition(Metadata::UNDEFINED_FRAME_INDEX, Metadata::UNDEFINED_FRAMES_NUMBER,
+                                       Metadata::UNDEFINED_TIMESTAMP, Metadata::UNDEFINED_DURATION));
+
+    filter.addDescription("schema", "desc");
+    ASSERT_FALSE(filter.isEmpty());
+    ASSERT_TRUE(filter.acceptsSchema("schema"));
+    ASSERT_FALSE(filter.acceptsSchema("other"));
+    ASSERT_TRUE(filter.acceptsDescription("schema", "desc"));
+    ASSERT_FALSE(filter.acceptsDescription("schema", "other"));
+
+    filter.setFrameWindow(10, 5);
+    ASSERT_TRUE(filter.acceptsPosition(14, 1, Metadata::UNDEFINED_TIMESTAMP, Metadata::UNDEFINED_DURATION));
+    ASSERT_TRUE(filter.acceptsPosition(5, 6, Metadata::UNDEFINED_TIMESTAMP, Metadata::UNDEFINED_DURATION));
+    ASSERT_FALSE(filter.acceptsPosition(15, 1, Metadata::UNDEFINED_TIMESTAMP, Metadata::UNDEFINED_DURATION));
+    ASSERT_FALSE(filter.acceptsPosition(5, 5, Metadata::UNDEFINED_TIMESTAMP, Metadata::UNDEFINED_DURATION));
+    ASSERT_FALSE(filter.acceptsPosition(Metadata::UNDEFINED_FRAME_INDEX, Metadata::UNDEFINED_FRAMES_NUMBER, 0, 0));
+
+    ASSERT_THROW(filter.setFrameWindow(-1, 5), IncorrectParamException);
+    ASSERT_THROW(filter.setTimeWindow(10, 5), IncorrectParamException);
+}
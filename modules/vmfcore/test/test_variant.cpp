@@ -15,6 +15,7 @@
  *
  */
 #include "test_precomp.hpp"
+#include "base64.hpp"
 
 class TestVariant: public ::testing::Test
 {
@@ -410,6 +411,55 @@ TEST_F(TestVariant, ToStringFromStringVectorVec4d)
     ASSERT_TRUE(v == v2);
 }
 
+TEST_F(TestVariant, ToStringKeepsFormerText)
+{
+    ASSERT_EQ("42.42", vmf::Variant((vmf::vmf_real) 42.42).toString());
+    ASSERT_EQ("1e+20", vmf::Variant((vmf::vmf_real) 1e20).toString());
+    ASSERT_EQ("-0.001", vmf::Variant((vmf::vmf_real) -0.001).toString());
+    ASSERT_EQ("-9223372036854775808", vmf::Variant(std::numeric_limits<vmf::vmf_integer>::min()).toString());
+    ASSERT_EQ("1 2.5 -3", vmf::Variant(vmf::vmf_vec3d(1, 2.5, -3)).toString());
+    ASSERT_EQ("1 ; -2 ; 3", vmf::Variant(std::vector<vmf::vmf_integer>{1, -2, 3}).toString());
+    ASSERT_EQ("czAA ; AA==", vmf::Variant(std::vector<vmf::vmf_string>{"s0", ""}).toString());
+}
+
+TEST_F(TestVariant, ToStringFromStringRealIsExact)
+{
+    vmf::vmf_real values[] = { 0.1 + 0.2, 1.0 / 3, 37.387512345678912, -121.96374, 5e-324, 1.7976931348623157e308, 123456789012345678.0 };
+    for(auto value : values)
+    {
+        vmf::Variant v1(value), v2;
+        v2.fromString(vmf::Variant::type_real, v1.toString());
+        ASSERT_EQ(value, v2.get_real()) << v1.toString();
+        ASSERT_LE(v1.toString().size(), 24u);
+    }
+    ASSERT_EQ("0.30000000000000004", vmf::Variant(0.1 + 0.2).toString());
+}
+
+TEST_F(TestVariant, FromStringAcceptsStreamSyntax)
+{
+    v.fromString(vmf::Variant::type_integer, " +17abc");
+    ASSERT_EQ(17, v.get_integer());
+    v.fromString(vmf::Variant::type_integer, "99999999999999999999");
+    ASSERT_EQ(std::numeric_limits<vmf::vmf_integer>::max(), v.get_integer());
+    v.fromString(vmf::Variant::type_integer, "text");
+    ASSERT_EQ(0, v.get_integer());
+    v.fromString(vmf::Variant::type_real, "\t-.5E+2");
+    ASSERT_EQ(-50.0, v.get_real());
+    v.fromString(vmf::Variant::type_vec2d, "1.5");
+    ASSERT_TRUE(v.get_vec2d() == vmf::vmf_vec2d(1.5, 0));
+    v.fromString(vmf::Variant::type_real_vector, "1;2.5 ;\n3e1 ");
+    ASSERT_EQ(3u, v.get_real_vector().size());
+    ASSERT_EQ(30.0, v.get_real_vector()[2]);
+    v.fromString(vmf::Variant::type_vec2d_vector, "1 2 ; 3 4");
+    ASSERT_TRUE(v.get_vec2d_vector()[1] == vmf::vmf_vec2d(3, 4));
+    v.fromString(vmf::Variant::type_integer_vector, "");
+    ASSERT_TRUE(v.get_integer_vector().empty());
+
+    EXPECT_THROW(v.fromString(vmf::Variant::type_integer_vector, "1 , 2"), vmf::IncorrectParamException);
+    EXPECT_THROW(v.fromString(vmf::Variant::type_real_vector, "1 ; ; 2"), vmf::IncorrectParamException);
+    EXPECT_THROW(v.fromString(vmf::Variant::type_vec3d_vector, "1 2 ; 3 4 5"), vmf::IncorrectParamException);
+}
+
 TEST_F(TestVariant, ConvertInc)
 {
     v = vmf::Variant((vmf::vmf_real) 42.42);
@@ -620,3 +670,47 @@ TEST_P(TestVariantRawBuffer_Base64Decoding, TestDecode)
 
 INSTANTIATE_TEST_CASE_P(UnitTest, TestVariantRawBuffer_Base64Decoding, ::testing::Values( std::make_tuple("Zm9==vYgAA", 0), std::make_tuple("AA===", 1),
     std::make_tuple("Zm9vY-gA", 2), std::make_tuple("Zm9vYgAA", 3), std::make_tuple("", 4) ) );
+
+TEST(TestVariantBase64, LongDataRoundTrip)
+{
+    // every code path supported by the CPU gives the same text as the scalar one
+    std::vector<std::string> texts;
+    for(int limit = vmf::Base64Scalar; limit <= vmf::Base64Avx2; limit++)
+    {
+        if(vmf::base64UseKernels((vmf::Base64Kernels) limit) != limit)
+            continue;
+        SCOPED_TRACE(limit);
+
+        // sizes cover whole vectorized blocks and all tail lengths
+        std::string all;
+        for(size_t size = 0; size < 200; size++)
+        {
+            vmf::vmf_rawbuffer data(size);
+            for(size_t i = 0; i < size; i++)
+                data[i] = (char) (i * 37 + size);
+
+            std::string text = vmf::Variant::base64encode(data);
+            ASSERT_EQ((size + 2) / 3 * 4, text.size());
+            ASSERT_EQ(std::string::npos, text.find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/="));
+            ASSERT_TRUE(data == vmf::Variant::base64decode(text)) << size;
+            all += text;
+        }
+        ASSERT_EQ("QUJDREVGR0hJSktMTU5PUFFSU1RVVldYWVphYmNkZWZnaGlqa2xtbm9wcXJzdHV2d3h5eg==",
+            vmf::Variant::base64encode(vmf::vmf_rawbuffer("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz", 52)));
+        texts.push_back(all);
+        ASSERT_EQ(texts.front(), all);
+    }
+    vmf::base64UseKernels(vmf::Base64Avx2);
+    ASSERT_FALSE(texts.empty());
+}
+
+TEST(TestVariantBase64, InvalidSymbolInLongText)
+{
+    std::string text = vmf::Variant::base64encode(vmf::vmf_rawbuffer(std::vector<char>(120, 'x')));
+    for(size_t pos = 0; pos < text.size() - 1; pos += 7)
+    {
+        std::string invalid = text;
+        invalid[pos] = pos % 2 ? '-' : '\x80';
+        ASSERT_THROW(vmf::Variant::base64decode(invalid), vmf::IncorrectParamException) << pos;
+    }
+}
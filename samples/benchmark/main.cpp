@@ -0,0 +1,566 @@
+/* 
+ * Copyright 2015 Intel(r) Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http ://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+* This sample measures performance of VMF storage on synthetic GPS and face detection datasets.
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <cmath>
+#include "vmf/vmf.hpp"
+#include "vmf/vmdatasource.hpp"
+
+using namespace std;
+
+void copyFile(const string& srcPath, const string& dstPath)
+{
+    ifstream src(srcPath, ios_base::binary | ios_base::in);
+    ofstream dst(dstPath, ios_base::binary | ios_base::out);
+
+    if (!src.is_open() || !dst.is_open())
+        VMF_EXCEPTION(vmf::Exception, "Can't copy " + srcPath + " to " + dstPath);
+
+    dst << src.rdbuf();
+
+    dst.close();
+    src.close();
+}
+
+long long getFileSize(const string& path)
+{
+    ifstream file(path, ios::binary | ios::ate);
+    return (long long) file.tellg();
+}
+
+class Timer
+{
+public:
+    Timer() : start(chrono::steady_clock::now()) {}
+
+    double ms() const
+    {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    chrono::steady_clock::time_point start;
+};
+
+shared_ptr<vmf::MetadataSchema> createGpsSchema()
+{
+    shared_ptr<vmf::MetadataSchema> schema = make_shared<vmf::MetadataSchema>("gps-schema");
+    VMF_METADATA_BEGIN("location")
+        VMF_FIELD_REAL("latitude")
+        VMF_FIELD_REAL("longitude")
+        VMF_FIELD_REAL("altitude")
+        VMF_FIELD_REAL("speed")
+        VMF_FIELD_STR("nmea")
+    VMF_METADATA_END(schema);
+    return schema;
+}
+
+shared_ptr<vmf::MetadataSchema> createFaceSchema()
+{
+    shared_ptr<vmf::MetadataSchema> schema = make_shared<vmf::MetadataSchema>("face-schema");
+    vector<vmf::FieldDesc> fields;
+    fields.push_back(vmf::FieldDesc("x", vmf::Variant::type_integer));
+    fields.push_back(vmf::FieldDesc("y", vmf::Variant::type_integer));
+    fields.push_back(vmf::FieldDesc("width", vmf::Variant::type_integer));
+    fields.push_back(vmf::FieldDesc("height", vmf::Variant::type_integer));
+    fields.push_back(vmf::FieldDesc("confidence", vmf::Variant::type_real));
+    fields.push_back(vmf::FieldDesc("thumbnail", vmf::Variant::type_rawbuffer));
+    shared_ptr<vmf::MetadataDesc> desc = make_shared<vmf::MetadataDesc>("face", fields);
+    schema->add(desc);
+    return schema;
+}
+
+void fillGps(vmf::MetadataStream& stream, const shared_ptr<vmf::MetadataSchema>& schema, int count)
+{
+    shared_ptr<vmf::MetadataDesc> desc = schema->findMetadataDesc("location");
+    for (int i = 0; i < count; i++)
+    {
+        double lat = 37.3875 + 0.0001 * sin(i / 50.0), lng = -121.9637 + 0.0001 * i;
+        stringstream nmea;
+        nmea << fixed << setprecision(4) << "$GPGGA," << 120000 + i << ".00," << lat * 100 << ",N,"
+             << -lng * 100 << ",W,1,08,0.9," << 15.0 + i % 10 << ",M,-25.0,M,,*47";
+
+        shared_ptr<vmf::Metadata> md = make_shared<vmf::Metadata>(desc);
+        md->setFieldValue("latitude", lat);
+        md->setFieldValue("longitude", lng);
+        md->setFieldValue("altitude", 15.0 + i % 10);
+        md->setFieldValue("speed", 1.4);
+        md->setFieldValue("nmea", nmea.str());
+        md->setTimestamp(1000LL * i);
+        stream.add(md);
+    }
+}
+
+void fillFaces(vmf::MetadataStream& stream, const shared_ptr<vmf::MetadataSchema>& schema, int count)
+{
+    shared_ptr<vmf::MetadataDesc> desc = schema->findMetadataDesc("face");
+    for (int i = 0; i < count; i++)
+    {
+        // 32x32 grayscale thumbnail with smooth gradient as a typical face crop
+        vmf::vmf_rawbuffer thumbnail(32 * 32);
+        for (int p = 0; p < 32 * 32; p++)
+            thumbnail[p] = (char) ((p / 32 + p % 32 + i) & 0xff);
+
+        shared_ptr<vmf::Metadata> md = make_shared<vmf::Metadata>(desc);
+        md->setFieldValue("x", (vmf::vmf_integer) (100 + i % 50));
+        md->setFieldValue("y", (vmf::vmf_integer) (80 + i % 30));
+        md->setFieldValue("width", (vmf::vmf_integer) 64);
+        md->setFieldValue("height", (vmf::vmf_integer) 64);
+        md->setFieldValue("confidence", 0.75 + (i % 20) / 100.0);
+        md->setFieldValue("thumbnail", thumbnail);
+        md->setFrameIndex(i);
+        stream.add(md);
+    }
+}
+
+void benchmarkStorage(const string& srcFile, const string& workFile, int count, size_t threshold, int level)
+{
+    copyFile(srcFile, workFile);
+
+    Timer saveTimer;
+    {
+        vmf::MetadataStream stream;
+        if (!stream.open(workFile, vmf::MetadataStream::ReadWrite))
+            throw vmf::Exception("Can't open file by VMF stream");
+        stream.setCompression(threshold, level);
+
+        shared_ptr<vmf::MetadataSchema> gps = createGpsSchema(), faces = createFaceSchema();
+        stream.addSchema(gps);
+        stream.addSchema(faces);
+        fillGps(stream, gps, count);
+        fillFaces(stream, faces, count);
+
+        if (!stream.save())
+            throw vmf::Exception("Can't save metadata");
+        stream.close();
+    }
+    double saveTime = saveTimer.ms();
+
+    Timer loadTimer;
+    size_t loaded = 0;
+    {
+        vmf::MetadataStream stream;
+        if (!stream.open(workFile, vmf::MetadataStream::ReadOnly))
+            throw vmf::Exception("Can't open file by VMF stream");
+        if (!stream.load())
+            throw vmf::Exception("Can't load metadata");
+        loaded = stream.getAll().size();
+        stream.close();
+    }
+    double loadTime = loadTimer.ms();
+
+    cout << setw(10) << threshold << setw(7) << level << setw(10) << loaded
+         << setw(14) << getFileSize(workFile) - getFileSize(srcFile)
+         << setw(12) << fixed << setprecision(1) << saveTime
+         << setw(12) << loadTime << endl;
+}
+
+void benchmarkMemory(int count, unsigned int latency)
+{
+    vmf::resetMemoryStorage();
+    vmf::setMemoryStorageLatency(latency);
+    const string memoryFile = "memory.avi";
+
+    Timer saveTimer;
+    {
+        vmf::MetadataStream stream;
+        if (!stream.open(memoryFile, vmf::MetadataStream::ReadWrite))
+            throw vmf::Exception("Can't open memory file by VMF stream");
+        shared_ptr<vmf::MetadataSchema> gps = createGpsSchema(), faces = createFaceSchema();
+        stream.addSchema(gps);
+        stream.addSchema(faces);
+        fillGps(stream, gps, count);
+        fillFaces(stream, faces, count);
+        if (!stream.save())
+            throw vmf::Exception("Can't save metadata");
+        stream.close();
+    }
+    double saveTime = saveTimer.ms();
+    size_t calls = vmf::getMemoryStorageCalls().size();
+
+    Timer loadTimer;
+    size_t loaded = 0;
+    {
+        vmf::MetadataStream stream;
+        if (!stream.open(memoryFile, vmf::MetadataStream::ReadOnly))
+            throw vmf::Exception("Can't open memory file by VMF stream");
+        if (!stream.load())
+            throw vmf::Exception("Can't load metadata");
+        loaded = stream.getAll().size();
+        stream.close();
+    }
+    double loadTime = loadTimer.ms();
+
+    cout << setw(10) << latency << setw(10) << loaded << setw(8) << calls
+         << setw(12) << fixed << setprecision(1) << saveTime
+         << setw(12) << loadTime << endl;
+    vmf::resetMemoryStorage();
+}
+
+shared_ptr<vmf::MetadataSchema> createLoadSchema(int descriptors)
+{
+    shared_ptr<vmf::MetadataSchema> schema = make_shared<vmf::MetadataSchema>("load-schema");
+    vector<vmf::FieldDesc> fields;
+    fields.push_back(vmf::FieldDesc("value", vmf::Variant::type_integer));
+    fields.push_back(vmf::FieldDesc("label", vmf::Variant::type_string));
+    for (int i = 0; i < descriptors; i++)
+    {
+        shared_ptr<vmf::MetadataDesc> desc = make_shared<vmf::MetadataDesc>("desc" + to_string(i), fields);
+        schema->add(desc);
+    }
+    return schema;
+}
+
+void benchmarkLoad(const string& srcFile, const string& workFile, int count, int descriptors)
+{
+    if (!srcFile.empty())
+        copyFile(srcFile, workFile);
+    else
+        vmf::resetMemoryStorage();
+
+    {
+        vmf::MetadataStream stream;
+        if (!stream.open(workFile, vmf::MetadataStream::ReadWrite))
+            throw vmf::Exception("Can't open file by VMF stream");
+        shared_ptr<vmf::MetadataSchema> schema = createLoadSchema(descriptors);
+        stream.addSchema(schema);
+        vector<shared_ptr<vmf::MetadataDesc>> descs = schema->getAll();
+        for (int i = 0; i < count; i++)
+        {
+            shared_ptr<vmf::Metadata> md = make_shared<vmf::Metadata>(descs[i % descriptors]);
+            md->setFieldValue("value", (vmf::vmf_integer) i);
+            md->setFieldValue("label", "item " + to_string(i));
+            md->setFrameIndex(i);
+            stream.add(md);
+        }
+        if (!stream.save())
+            throw vmf::Exception("Can't save metadata");
+        stream.close();
+    }
+
+    Timer loadTimer;
+    size_t loaded = 0;
+    {
+        vmf::MetadataStream stream;
+        if (!stream.open(workFile, vmf::MetadataStream::ReadOnly))
+            throw vmf::Exception("Can't open file by VMF stream");
+        if (!stream.load("load-schema"))
+            throw vmf::Exception("Can't load metadata");
+        loaded = stream.getAll().size();
+        stream.close();
+    }
+    double loadTime = loadTimer.ms();
+
+    cout << setw(10) << (srcFile.empty() ? "memory" : "XMP") << setw(10) << loaded << setw(8) << descriptors
+         << setw(12) << fixed << setprecision(1) << loadTime
+         << setw(12) << setprecision(3) << loadTime * 1000 / loaded << endl;
+    if (srcFile.empty())
+        vmf::resetMemoryStorage();
+}
+
+void benchmarkMapped(const string& mappedFile, int count)
+{
+    vmf::MetadataStream stream;
+    shared_ptr<vmf::MetadataSchema> gps = createGpsSchema();
+    stream.addSchema(gps);
+    fillGps(stream, gps, count);
+
+    Timer exportTimer;
+    vmf::MappedMetadataStream::exportStream(stream, mappedFile);
+    double exportTime = exportTimer.ms();
+
+    vmf::MappedMetadataStream mapped;
+    Timer openTimer;
+    if (!mapped.open(mappedFile))
+        throw vmf::Exception("Can't open mapped metadata file");
+    double openTime = openTimer.ms();
+
+    Timer queryTimer;
+    size_t found = mapped.findByTime(1000LL * count / 2, 1000LL * count / 2 + 60000).size();
+    double queryTime = queryTimer.ms();
+    mapped.close();
+
+    cout << setw(10) << count << setw(14) << getFileSize(mappedFile)
+         << setw(12) << fixed << setprecision(1) << exportTime
+         << setw(12) << setprecision(3) << openTime
+         << setw(12) << queryTime << setw(8) << found << endl;
+    remove(mappedFile.c_str());
+}
+
+void benchmarkSerialization(const string& format, vmf::IWriter& writer, vmf::IReader& reader, int count)
+{
+    vmf::MetadataStream stream;
+    shared_ptr<vmf::MetadataSchema> gps = createGpsSchema(), faces = createFaceSchema();
+    stream.addSchema(gps);
+    stream.addSchema(faces);
+    fillGps(stream, gps, count);
+    fillFaces(stream, faces, count);
+
+    Timer serializeTimer;
+    string data = stream.serialize(writer);
+    double serializeTime = serializeTimer.ms();
+
+    vmf::MetadataStream loaded;
+    Timer deserializeTimer;
+    loaded.deserialize(data, reader);
+    double deserializeTime = deserializeTimer.ms();
+
+    cout << setw(10) << format << setw(10) << loaded.getAll().size() << setw(14) << data.size()
+         << setw(12) << fixed << setprecision(1) << serializeTime
+         << setw(12) << deserializeTime << endl;
+}
+
+void benchmarkParallelSerialization(const string& format, vmf::IWriter& writer, int count)
+{
+    vmf::MetadataStream stream;
+    shared_ptr<vmf::MetadataSchema> gps = createGpsSchema(), faces = createFaceSchema();
+    stream.addSchema(gps);
+    stream.addSchema(faces);
+    fillGps(stream, gps, count);
+    fillFaces(stream, faces, count);
+
+    Timer sequentialTimer;
+    string sequential = stream.serialize(writer);
+    double sequentialTime = sequentialTimer.ms();
+
+    unsigned int threadCounts[] = { 2, 4, 0 };
+    for (auto threads : threadCounts)
+    {
+        Timer parallelTimer;
+        string parallel = stream.serialize(writer, threads);
+        double parallelTime = parallelTimer.ms();
+        cout << setw(10) << format << setw(9) << (threads ? to_string(threads) : string("all"))
+             << setw(12) << fixed << setprecision(1) << sequentialTime << setw(12) << parallelTime
+             << setw(8) << (parallel == sequential ? "yes" : "no") << endl;
+    }
+}
+
+vector<vmf::Variant> createCodecValues()
+{
+    vmf::vmf_vec4d vec(37.387512345678, -121.96374, 15.5, 0.1);
+    vmf::vmf_rawbuffer buffer(256);
+    for (size_t i = 0; i < buffer.size(); i++)
+        buffer[i] = (char) i;
+
+    vector<vmf::Variant> values;
+    values.push_back(vmf::Variant((vmf::vmf_integer) 1234567890123LL));
+    values.push_back(vmf::Variant(vec.x));
+    values.push_back(vmf::Variant(string("$GPGGA,120000.00,3738.7512,N,12196.3740,W,1,08,0.9,15.0,M,-25.0,M,,*47")));
+    values.push_back(vmf::Variant(vmf::vmf_vec2d(vec.x, vec.y)));
+    values.push_back(vmf::Variant(vmf::vmf_vec3d(vec.x, vec.y, vec.z)));
+    values.push_back(vmf::Variant(vec));
+    values.push_back(vmf::Variant(buffer));
+    values.push_back(vmf::Variant(vector<vmf::vmf_integer>(16, -12345)));
+    values.push_back(vmf::Variant(vector<vmf::vmf_real>(16, vec.x)));
+    values.push_back(vmf::Variant(vector<vmf::vmf_string>(16, "face")));
+    values.push_back(vmf::Variant(vector<vmf::vmf_vec2d>(16, vmf::vmf_vec2d(vec.x, vec.y))));
+    values.push_back(vmf::Variant(vector<vmf::vmf_vec3d>(16, vmf::vmf_vec3d(vec.x, vec.y, vec.z))));
+    values.push_back(vmf::Variant(vector<vmf::vmf_vec4d>(16, vec)));
+    return values;
+}
+
+void benchmarkCodec(const vmf::Variant& value, int count)
+{
+    string text;
+    Timer toStringTimer;
+    for (int i = 0; i < count; i++)
+        text = value.toString();
+    double toStringTime = toStringTimer.ms();
+
+    vmf::Variant parsed;
+    Timer fromStringTimer;
+    for (int i = 0; i < count; i++)
+        parsed.fromString(value.getType(), text);
+    double fromStringTime = fromStringTimer.ms();
+
+    cout << setw(12) << value.getTypeName() << setw(8) << text.size()
+         << setw(14) << fixed << setprecision(0) << toStringTime * 1e6 / count
+         << setw(16) << fromStringTime * 1e6 / count
+         << setw(8) << (parsed == value ? "yes" : "no") << endl;
+}
+
+void benchmarkBase64(size_t size, int count)
+{
+    vmf::vmf_rawbuffer data(size);
+    for (size_t i = 0; i < size; i++)
+        data[i] = (char) (i * 7 + i / 256);
+
+    string text;
+    Timer encodeTimer;
+    for (int i = 0; i < count; i++)
+        text = vmf::Variant::base64encode(data);
+    double encodeTime = encodeTimer.ms();
+
+    vmf::vmf_rawbuffer decoded;
+    Timer decodeTimer;
+    for (int i = 0; i < count; i++)
+        decoded = vmf::Variant::base64decode(text);
+    double decodeTime = decodeTimer.ms();
+
+    cout << setw(10) << size << setw(14) << fixed << setprecision(1) << size * (double) count / encodeTime / 1e3
+         << setw(14) << size * (double) count / decodeTime / 1e3
+         << setw(8) << (decoded == data ? "yes" : "no") << endl;
+}
+
+void benchmarkChecksum(const string& dataFile, int sizeMb, vmf::MetadataStream::ChecksumAlgorithm algorithm, unsigned int threads)
+{
+    if (getFileSize(dataFile) != 1024LL * 1024 * sizeMb)
+    {
+        ofstream file(dataFile, ios_base::binary | ios_base::out | ios_base::trunc);
+        string block(1024 * 1024, '\0');
+        for (int i = 0; i < sizeMb; i++)
+        {
+            for (size_t j = 0; j < block.size(); j++)
+                block[j] = (char) (i * 131 + j * 7 + j / 4096);
+            file.write(block.data(), block.size());
+        }
+    }
+
+    // exclude a region in the middle like an embedded XMP packet
+    long long offset = 1024LL * 1024 * sizeMb / 2, size = 4096;
+    Timer timer;
+    string digest = vmf::computeFileChecksum(dataFile, algorithm, offset, size, threads);
+    double time = timer.ms();
+
+    cout << setw(10) << (algorithm == vmf::MetadataStream::ChecksumMD5 ? "MD5" : "tree hash")
+         << setw(9) << (threads ? to_string(threads) : string("all"))
+         << setw(12) << fixed << setprecision(1) << time
+         << setw(10) << setprecision(2) << (1024.0 * 1024 * sizeMb - size) / time / 1e6
+         << "  " << digest << endl;
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        string srcFileName;
+        if (argc > 1)
+            srcFileName = argv[1];
+        else
+            throw vmf::Exception("USAGE:\nbenchmark <video file path> [number of items] [number of mapped items] [checksum data size, MB]"
+                                 " [max number of loaded items]");
+
+        int count = (argc > 2) ? atoi(argv[2]) : 1000;
+        int mappedCount = (argc > 3) ? atoi(argv[3]) : 100000;
+        int checksumSizeMb = (argc > 4) ? atoi(argv[4]) : 256;
+        int maxLoadCount = (argc > 5) ? atoi(argv[5]) : 1000000;
+
+        string ext = string(srcFileName, srcFileName.find_last_of('.'));
+        string dstFileName = std::string(srcFileName, 0, srcFileName.find_last_of('.')) + "Bench" + ext;
+
+        vmf::initialize();
+
+        cout << "Storage of " << count << " GPS and " << count << " face items" << endl;
+        cout << setw(10) << "threshold" << setw(7) << "level" << setw(10) << "items"
+             << setw(14) << "packet, B" << setw(12) << "save, ms" << setw(12) << "load, ms" << endl;
+        benchmarkStorage(srcFileName, dstFileName, count, 0, -1);
+        benchmarkStorage(srcFileName, dstFileName, count, 64, 1);
+        benchmarkStorage(srcFileName, dstFileName, count, 64, 6);
+        benchmarkStorage(srcFileName, dstFileName, count, 64, 9);
+        benchmarkStorage(srcFileName, dstFileName, count, 512, 6);
+
+        vmf::terminate();
+        vmf::initialize(vmf::StorageMemory);
+        cout << endl << "In-memory data source, MetadataStream logic only" << endl;
+        cout << setw(10) << "latency" << setw(10) << "items" << setw(8) << "calls"
+             << setw(12) << "save, ms" << setw(12) << "load, ms" << endl;
+        benchmarkMemory(count, 0);
+        benchmarkMemory(count, 1000);
+
+        cout << endl << "Load of a schema by number of items and descriptors" << endl;
+        cout << setw(10) << "storage" << setw(10) << "items" << setw(8) << "descs"
+             << setw(12) << "load, ms" << setw(12) << "item, us" << endl;
+        for (int loadCount = 1000; loadCount <= maxLoadCount; loadCount *= 10)
+        {
+            benchmarkLoad("", "memory.avi", loadCount, 1);
+            benchmarkLoad("", "memory.avi", loadCount, 10);
+            benchmarkLoad("", "memory.avi", loadCount, 50);
+        }
+        vmf::terminate();
+        vmf::initialize();
+        // the XMP toolkit itself is slow on huge packets, so XMP loading is measured on smaller sets
+        for (int loadCount = 1000; loadCount <= min(maxLoadCount, 10000); loadCount *= 10)
+        {
+            benchmarkLoad(srcFileName, dstFileName, loadCount, 1);
+            benchmarkLoad(srcFileName, dstFileName, loadCount, 50);
+        }
+
+        cout << endl << "Read-only mapped format" << endl;
+        cout << setw(10) << "items" << setw(14) << "file, B" << setw(12) << "export, ms"
+             << setw(12) << "open, ms" << setw(12) << "query, ms" << setw(8) << "found" << endl;
+        benchmarkMapped(dstFileName + ".vmfmap", mappedCount);
+
+        cout << endl << "Serialization of " << count << " GPS and " << count << " face items" << endl;
+        cout << setw(10) << "format" << setw(10) << "items" << setw(14) << "size, B"
+             << setw(12) << "write, ms" << setw(12) << "read, ms" << endl;
+        vmf::XMLWriter xmlWriter;
+        vmf::XMLReader xmlReader;
+        benchmarkSerialization("XML", xmlWriter, xmlReader, count);
+        vmf::JSONWriter jsonWriter;
+        vmf::JSONReader jsonReader;
+        benchmarkSerialization("JSON", jsonWriter, jsonReader, count);
+        vmf::BinaryWriter binaryWriter;
+        vmf::BinaryReader binaryReader;
+        benchmarkSerialization("binary", binaryWriter, binaryReader, count);
+
+        cout << endl << "Parallel serialization of " << count << " GPS and " << count << " face items" << endl;
+        cout << setw(10) << "format" << setw(9) << "threads" << setw(12) << "seq, ms"
+             << setw(12) << "par, ms" << setw(8) << "equal" << endl;
+        benchmarkParallelSerialization("XML", xmlWriter, count);
+        benchmarkParallelSerialization("JSON", jsonWriter, count);
+
+        cout << endl << "Variant text codec" << endl;
+        cout << setw(12) << "type" << setw(8) << "chars" << setw(14) << "toString, ns"
+             << setw(16) << "fromString, ns" << setw(8) << "equal" << endl;
+        vector<vmf::Variant> codecValues = createCodecValues();
+        for (auto value = codecValues.begin(); value != codecValues.end(); value++)
+            benchmarkCodec(*value, 100000);
+
+        cout << endl << "Base64 throughput of raw data" << endl;
+        cout << setw(10) << "size, B" << setw(14) << "encode, MB/s" << setw(14) << "decode, MB/s" << setw(8) << "equal" << endl;
+        // a face embedding of 128 floats, a 64x64 thumbnail and a large blob
+        benchmarkBase64(64, 200000);
+        benchmarkBase64(128 * 4, 50000);
+        benchmarkBase64(64 * 64, 10000);
+        benchmarkBase64(1024 * 1024, 40);
+
+        cout << endl << "Checksum of " << checksumSizeMb << " MB file, page cache is warmed by the first run" << endl;
+        cout << setw(10) << "algorithm" << setw(9) << "threads" << setw(12) << "time, ms" << setw(10) << "GB/s" << endl;
+        string checksumFile = dstFileName + ".checksum";
+        benchmarkChecksum(checksumFile, checksumSizeMb, vmf::MetadataStream::ChecksumMD5, 1);
+        benchmarkChecksum(checksumFile, checksumSizeMb, vmf::MetadataStream::ChecksumMD5, 1);
+        benchmarkChecksum(checksumFile, checksumSizeMb, vmf::MetadataStream::ChecksumMD5, 0);
+        benchmarkChecksum(checksumFile, checksumSizeMb, vmf::MetadataStream::ChecksumTreeHash, 1);
+        benchmarkChecksum(checksumFile, checksumSizeMb, vmf::MetadataStream::ChecksumTreeHash, 0);
+        remove(checksumFile.c_str());
+
+        vmf::terminate();
+        return 0;
+    }
+    catch (vmf::Exception& e)
+    {
+        cout << "Fatal error: " << e.what() << endl;
+        return -1;
+    }
+}